@@ -10,6 +10,7 @@ extern "C" {
 #pragma once
 #include <esp_attr.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #include "epd_internals.h"
@@ -196,6 +197,23 @@ typedef struct {
     enum EpdFontFlags flags;
 } EpdFontProperties;
 
+/// Default memory budget in bytes for inflated glyphs of compressed fonts.
+#ifndef EPD_GLYPH_CACHE_SIZE
+#define EPD_GLYPH_CACHE_SIZE (24 * 1024)
+#endif
+
+/// Counters of the inflated glyph cache.
+typedef struct {
+    /// Glyphs drawn from the cache.
+    uint32_t hits;
+    /// Glyphs that had to be inflated.
+    uint32_t misses;
+    /// Glyphs dropped to stay within the budget.
+    uint32_t evictions;
+    /// Memory currently used by cached glyphs.
+    size_t used_bytes;
+} EpdGlyphCacheStats;
+
 #include "epd_board.h"
 #include "epd_board_specific.h"
 #include "epd_display.h"
@@ -483,6 +501,23 @@ enum EpdDrawError epd_write_default(
  */
 const EpdGlyph* epd_get_glyph(const EpdFont* font, uint32_t code_point);
 
+/**
+ * Set the memory budget for inflated glyphs of compressed fonts.
+ * Drops the least recently drawn glyphs until the cache fits.
+ * A size of 0 turns the cache off.
+ */
+void epd_set_glyph_cache_size(size_t bytes);
+
+/**
+ * Drop all cached glyphs.
+ */
+void epd_clear_glyph_cache();
+
+/**
+ * Get the glyph cache counters.
+ */
+EpdGlyphCacheStats epd_glyph_cache_stats();
+
 /**
  * Darken / lighten an area for a given time.
  *
@@ -79,30 +79,40 @@ EpdFontProperties epd_font_properties_default() {
 
 const EpdGlyph* epd_get_glyph(const EpdFont* font, uint32_t code_point) {
     const EpdUnicodeInterval* intervals = font->intervals;
-    for (int i = 0; i < font->interval_count; i++) {
-        const EpdUnicodeInterval* interval = &intervals[i];
-        if (code_point >= interval->first && code_point <= interval->last) {
-            return &font->glyph[interval->offset + (code_point - interval->first)];
-        }
+    if (font->interval_count == 0) {
+        return NULL;
+    }
+    // most text is ASCII, which is the first interval of the generated fonts
+    if (code_point >= intervals[0].first && code_point <= intervals[0].last) {
+        return &font->glyph[intervals[0].offset + (code_point - intervals[0].first)];
+    }
+    // the intervals are sorted and don't overlap
+    int low = 0;
+    int high = (int)font->interval_count - 1;
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        const EpdUnicodeInterval* interval = &intervals[mid];
         if (code_point < interval->first) {
-            return NULL;
+            high = mid - 1;
+        } else if (code_point > interval->last) {
+            low = mid + 1;
+        } else {
+            return &font->glyph[interval->offset + (code_point - interval->first)];
         }
     }
     return NULL;
 }
 
 static int uncompress(
-    uint8_t* dest, size_t uncompressed_size, const uint8_t* source, size_t source_size
+    tinfl_decompressor* decomp,
+    uint8_t* dest,
+    size_t uncompressed_size,
+    const uint8_t* source,
+    size_t source_size
 ) {
-    tinfl_decompressor* decomp;
     if (uncompressed_size == 0 || dest == NULL || source_size == 0 || source == NULL) {
         return -1;
     }
-    decomp = malloc(sizeof(tinfl_decompressor));
-    if (!decomp) {
-        // Out of memory
-        return -1;
-    }
     tinfl_init(decomp);
 
     // we know everything will fit into the buffer.
@@ -115,13 +125,268 @@ static int uncompress(
         &uncompressed_size,
         TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF
     );
-    free(decomp);
     if (decomp_status != TINFL_STATUS_DONE) {
         return decomp_status;
     }
     return 0;
 }
 
+/*
+ * Inflated bitmaps of compressed glyphs, so text doesn't pay for a malloc,
+ * an inflate and a free for every character drawn. Entries are keyed by the
+ * glyph pointer, which is unique across all (static) fonts, and the least
+ * recently drawn ones are dropped once the budget is used up.
+ *
+ * Like the rest of the drawing functions this is not thread safe, text has
+ * to be drawn from one task at a time.
+ */
+#define GLYPH_CACHE_BUCKETS 128
+
+typedef struct CachedGlyph {
+    const EpdGlyph* glyph;
+    struct CachedGlyph* bucket_next;
+    // most recently used first
+    struct CachedGlyph* lru_prev;
+    struct CachedGlyph* lru_next;
+    size_t size;
+    uint8_t bitmap[];
+} CachedGlyph;
+
+static struct {
+    CachedGlyph* buckets[GLYPH_CACHE_BUCKETS];
+    CachedGlyph* lru_head;
+    CachedGlyph* lru_tail;
+    size_t budget;
+    size_t used;
+    EpdGlyphCacheStats stats;
+    // kept around between glyphs, it's too big to allocate for each one
+    tinfl_decompressor* decomp;
+} glyph_cache = { .budget = EPD_GLYPH_CACHE_SIZE };
+
+static inline int glyph_bucket(const EpdGlyph* glyph) {
+    return ((uintptr_t)glyph / sizeof(EpdGlyph)) % GLYPH_CACHE_BUCKETS;
+}
+
+static void glyph_cache_unlink_lru(CachedGlyph* entry) {
+    if (entry->lru_prev) {
+        entry->lru_prev->lru_next = entry->lru_next;
+    } else {
+        glyph_cache.lru_head = entry->lru_next;
+    }
+    if (entry->lru_next) {
+        entry->lru_next->lru_prev = entry->lru_prev;
+    } else {
+        glyph_cache.lru_tail = entry->lru_prev;
+    }
+}
+
+static void glyph_cache_push_front(CachedGlyph* entry) {
+    entry->lru_prev = NULL;
+    entry->lru_next = glyph_cache.lru_head;
+    if (glyph_cache.lru_head) {
+        glyph_cache.lru_head->lru_prev = entry;
+    } else {
+        glyph_cache.lru_tail = entry;
+    }
+    glyph_cache.lru_head = entry;
+}
+
+static void glyph_cache_evict(CachedGlyph* entry) {
+    CachedGlyph** link = &glyph_cache.buckets[glyph_bucket(entry->glyph)];
+    while (*link != entry) {
+        link = &(*link)->bucket_next;
+    }
+    *link = entry->bucket_next;
+    glyph_cache_unlink_lru(entry);
+    glyph_cache.used -= entry->size;
+    glyph_cache.stats.evictions++;
+    free(entry);
+}
+
+static void glyph_cache_trim(size_t budget) {
+    while (glyph_cache.lru_tail && glyph_cache.used > budget) {
+        glyph_cache_evict(glyph_cache.lru_tail);
+    }
+}
+
+void epd_set_glyph_cache_size(size_t bytes) {
+    glyph_cache.budget = bytes;
+    glyph_cache_trim(bytes);
+    if (bytes == 0 && glyph_cache.decomp) {
+        free(glyph_cache.decomp);
+        glyph_cache.decomp = NULL;
+    }
+}
+
+void epd_clear_glyph_cache() {
+    glyph_cache_trim(0);
+}
+
+EpdGlyphCacheStats epd_glyph_cache_stats() {
+    EpdGlyphCacheStats stats = glyph_cache.stats;
+    stats.used_bytes = glyph_cache.used;
+    return stats;
+}
+
+/*!
+ * Get the 4 bit bitmap of a compressed glyph. It's either owned by the cache,
+ * or - if it can't be cached - a temporary one the caller has to free.
+ * Returns NULL if it can't be allocated or inflated.
+ */
+static const uint8_t* inflate_glyph(
+    const EpdFont* font, const EpdGlyph* glyph, size_t bitmap_size, bool* needs_free
+) {
+    *needs_free = false;
+    int bucket = glyph_bucket(glyph);
+    for (CachedGlyph* entry = glyph_cache.buckets[bucket]; entry; entry = entry->bucket_next) {
+        if (entry->glyph == glyph) {
+            glyph_cache_unlink_lru(entry);
+            glyph_cache_push_front(entry);
+            glyph_cache.stats.hits++;
+            return entry->bitmap;
+        }
+    }
+    glyph_cache.stats.misses++;
+
+    if (glyph_cache.decomp == NULL) {
+        glyph_cache.decomp = malloc(sizeof(tinfl_decompressor));
+        if (glyph_cache.decomp == NULL) {
+            return NULL;
+        }
+    }
+
+    size_t entry_size = sizeof(CachedGlyph) + bitmap_size;
+    if (entry_size > glyph_cache.budget) {
+        // doesn't fit (or caching is off) - inflate it just for this once
+        uint8_t* bitmap = malloc(bitmap_size);
+        if (bitmap == NULL) {
+            return NULL;
+        }
+        int status = uncompress(
+            glyph_cache.decomp,
+            bitmap,
+            bitmap_size,
+            &font->bitmap[glyph->data_offset],
+            glyph->compressed_size
+        );
+        if (status != 0) {
+            ESP_LOGE("font", "inflating glyph failed: %d", status);
+            free(bitmap);
+            return NULL;
+        }
+        *needs_free = true;
+        return bitmap;
+    }
+
+    glyph_cache_trim(glyph_cache.budget - entry_size);
+    CachedGlyph* entry = malloc(entry_size);
+    if (entry == NULL) {
+        return NULL;
+    }
+    int status = uncompress(
+        glyph_cache.decomp,
+        entry->bitmap,
+        bitmap_size,
+        &font->bitmap[glyph->data_offset],
+        glyph->compressed_size
+    );
+    if (status != 0) {
+        // don't keep a broken bitmap around to be drawn again
+        ESP_LOGE("font", "inflating glyph failed: %d", status);
+        free(entry);
+        return NULL;
+    }
+    entry->glyph = glyph;
+    entry->size = entry_size;
+    entry->bucket_next = glyph_cache.buckets[bucket];
+    glyph_cache.buckets[bucket] = entry;
+    glyph_cache_push_front(entry);
+    glyph_cache.used += entry_size;
+    return entry->bitmap;
+}
+
+/*!
+ * Draw a 4 bit glyph bitmap with its top left corner at logical (x, y)
+ * without going through epd_draw_pixel for each pixel.
+ *
+ * In EPD_ROT_INVERTED_PORTRAIT logical (x, y) is physical (y, height - 1 - x),
+ * so each column of the glyph is a run of neighbouring nibbles in one
+ * framebuffer line. The glyph is clipped once, then each column is packed
+ * into 32 bit words of 8 pixels, with a mask of the pixels that get drawn,
+ * and written a word at a time.
+ *
+ * Returns false if the glyph has to be drawn pixel by pixel instead.
+ */
+static bool IRAM_ATTR draw_glyph_spans(
+    const uint8_t* bitmap,
+    int byte_width,
+    int width,
+    int height,
+    int x,
+    int y,
+    const uint8_t* color_lut,
+    bool background_needed,
+    uint8_t* buffer
+) {
+    int fb_width = epd_width();
+    int fb_height = epd_height();
+    if (epd_get_rotation() != EPD_ROT_INVERTED_PORTRAIT || ((uintptr_t)buffer & 3) != 0
+        || (fb_width & 7) != 0) {
+        return false;
+    }
+    // logical x runs up the framebuffer lines and logical y along them
+    int col_start = max(0, -x);
+    int col_end = min(width, fb_height - x);
+    int row_start = max(0, -y);
+    int row_end = min(height, fb_width - y);
+    if (col_start >= col_end || row_start >= row_end) {
+        return true;
+    }
+    int first_word = (y + row_start) / 8;
+    // where row_start lands in the first word
+    int first_shift = ((y + row_start) & 7) * 4;
+
+    // no branches per pixel: a pixel that isn't drawn has neither value nor mask
+    uint32_t values[16];
+    uint32_t masks[16];
+    for (int c = 0; c < 16; c++) {
+        bool drawn = background_needed || c != 0;
+        values[c] = drawn ? color_lut[c] : 0;
+        masks[c] = drawn ? 0xF : 0;
+    }
+
+    int words_per_line = fb_width / 8;
+    for (int col = col_start; col < col_end; col++) {
+        const uint8_t* src = bitmap + row_start * byte_width + col / 2;
+        int nibble_shift = (col & 1) * 4;
+        uint32_t* dest
+            = (uint32_t*)buffer + (fb_height - 1 - (x + col)) * words_per_line + first_word;
+        uint32_t value = 0;
+        uint32_t mask = 0;
+        int shift = first_shift;
+        for (int row = row_start; row < row_end; row++) {
+            uint8_t bm = (*src >> nibble_shift) & 0xF;
+            src += byte_width;
+            value |= values[bm] << shift;
+            mask |= masks[bm] << shift;
+            shift += 4;
+            if (shift == 32) {
+                if (mask) {
+                    *dest = (*dest & ~mask) | value;
+                }
+                dest++;
+                value = 0;
+                mask = 0;
+                shift = 0;
+            }
+        }
+        if (mask) {
+            *dest = (*dest & ~mask) | value;
+        }
+    }
+    return true;
+}
+
 /*!
    @brief   Draw a single character to a pre-allocated buffer.
 */
@@ -151,14 +416,13 @@ static enum EpdDrawError IRAM_ATTR draw_char(
     int byte_width = (width / 2 + width % 2);
     unsigned long bitmap_size = byte_width * height;
     const uint8_t* bitmap = NULL;
+    bool free_bitmap = false;
     if (bitmap_size > 0 && font->compressed) {
-        uint8_t* tmp_bitmap = (uint8_t*)malloc(bitmap_size);
-        if (tmp_bitmap == NULL && bitmap_size) {
-            ESP_LOGE("font", "malloc failed.");
+        bitmap = inflate_glyph(font, glyph, bitmap_size, &free_bitmap);
+        if (bitmap == NULL) {
+            ESP_LOGE("font", "cannot get glyph bitmap.");
             return EPD_DRAW_FAILED_ALLOC;
         }
-        uncompress(tmp_bitmap, bitmap_size, &font->bitmap[offset], glyph->compressed_size);
-        bitmap = tmp_bitmap;
     } else {
         bitmap = &font->bitmap[offset];
     }
@@ -170,30 +434,27 @@ static enum EpdDrawError IRAM_ATTR draw_char(
     }
     bool background_needed = props->flags & EPD_DRAW_BACKGROUND;
 
-    for (int y = 0; y < height; y++) {
-        int yy = cursor_y - glyph->top + y;
-        int start_pos = *cursor_x + left;
-        bool byte_complete = start_pos % 2;
-        int x = max(0, -start_pos);
-        int max_x = start_pos + width;
-        uint8_t color;
-
-        for (int xx = start_pos; xx < max_x; xx++) {
-            uint8_t bm = bitmap[y * byte_width + x / 2];
-            if ((x & 1) == 0) {
-                bm = bm & 0xF;
-            } else {
-                bm = bm >> 4;
+    int start_x = *cursor_x + left;
+    int start_y = cursor_y - glyph->top;
+    if (!draw_glyph_spans(
+            bitmap, byte_width, width, height, start_x, start_y, color_lut, background_needed, buffer
+        )) {
+        for (int y = 0; y < height; y++) {
+            int yy = start_y + y;
+            for (int x = 0; x < width; x++) {
+                uint8_t bm = bitmap[y * byte_width + x / 2];
+                if ((x & 1) == 0) {
+                    bm = bm & 0xF;
+                } else {
+                    bm = bm >> 4;
+                }
+                if (background_needed || bm) {
+                    epd_draw_pixel(start_x + x, yy, color_lut[bm] << 4, buffer);
+                }
             }
-            if (background_needed || bm) {
-                color = color_lut[bm] << 4;
-                epd_draw_pixel(xx, yy, color, buffer);
-            }
-            byte_complete = !byte_complete;
-            x++;
         }
     }
-    if (bitmap_size > 0 && font->compressed) {
+    if (free_bitmap) {
         free((uint8_t*)bitmap);
     }
     *cursor_x += glyph->advance_x;
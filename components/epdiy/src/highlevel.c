@@ -133,16 +133,23 @@ enum EpdDrawError epd_hl_update_area(
 
     uint32_t t1 = esp_timer_get_time() / 1000;
 
-    diff_area.x = 0;
-    diff_area.y = 0;
-    diff_area.width = epd_width();
-    diff_area.height = epd_height();
+    // The LCD output needs the image to span the full panel width, so the
+    // difference image is passed as full screen and cropped to the dirty
+    // line range. Columns outside the dirty ones are masked off by the line
+    // mask built from dirty_columns, and lines outside the crop (or not
+    // marked dirty) are sent as no-ops without touching the difference image.
+    EpdRect dirty_lines_crop = {
+        .x = 0,
+        .y = diff_area.y,
+        .width = epd_width(),
+        .height = diff_area.height,
+    };
 
     enum EpdDrawError err = EPD_DRAW_SUCCESS;
     err = epd_draw_base(
         epd_full_screen(),
         state->difference_fb,
-        diff_area,
+        dirty_lines_crop,
         MODE_PACKING_1PPB_DIFFERENCE | mode,
         temperature,
         state->dirty_lines,
@@ -152,15 +159,13 @@ enum EpdDrawError epd_hl_update_area(
 
     uint32_t t2 = esp_timer_get_time() / 1000;
 
-    diff_area.x = 0;
-    diff_area.y = 0;
-    diff_area.width = epd_width();
-    diff_area.height = epd_height();
-
+    // only the dirty rectangle can differ between the front and back buffers
     int buf_width = epd_width();
+    int lines_driven = 0;
 
     for (int l = diff_area.y; l < diff_area.y + diff_area.height; l++) {
         if (state->dirty_lines[l] > 0) {
+            lines_driven++;
             uint8_t* lfb = state->front_fb + buf_width / 2 * l;
             uint8_t* lbb = state->back_fb + buf_width / 2 * l;
 
@@ -177,7 +182,9 @@ enum EpdDrawError epd_hl_update_area(
                 x_last -= 1;
             }
 
-            memcpy(lbb + (x / 2), lfb + (x / 2), (x_last - x + 1) / 2);
+            if (x_last > x) {
+                memcpy(lbb + (x / 2), lfb + (x / 2), (x_last - x + 1) / 2);
+            }
         }
     }
 
@@ -185,11 +192,17 @@ enum EpdDrawError epd_hl_update_area(
 
     ESP_LOGI(
         "epdiy",
-        "diff: %dms, draw: %dms, buffer update: %dms, total: %dms",
+        "diff: %dms, draw: %dms, buffer update: %dms, total: %dms, lines driven: %d of %d (area %d,%d %dx%d)",
         t1 - ts,
         t2 - t1,
         t3 - t2,
-        t3 - ts
+        t3 - ts,
+        lines_driven,
+        epd_height(),
+        diff_area.x,
+        diff_area.y,
+        diff_area.width,
+        diff_area.height
     );
     return err;
 }
@@ -209,6 +209,18 @@ void IRAM_ATTR calc_epd_input_1ppB_1k_S3_VE(
     }
 }
 
+/**
+ * Plain C version of `calc_epd_input_1ppB_1k_S3_VE` for the whole line.
+ * Kept as the reference the vector path is checked against.
+ */
+void calc_epd_input_1ppB_1k_S3_VE_reference(
+    const uint32_t* ld, uint8_t* epd_input, const uint8_t* conversion_lut, uint32_t epd_width
+) {
+    for (int i = 0; i < epd_width / 4; i++) {
+        epd_input[i] = lookup_pixels_in_VE_LUT(ld[i], conversion_lut);
+    }
+}
+
 /**
  * Calculate EPD input for a difference image with one pixel per byte.
  */
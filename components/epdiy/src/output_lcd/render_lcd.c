@@ -184,15 +184,18 @@ lcd_calculate_frame(RenderContext_t* ctx, int thread_id) {
 
     assert(area.width == ctx->display_width && area.x == 0 && !ctx->error);
 
-    // index of the line that triggers the frame output when processed
-    int trigger_line = int_min(63, max_y - min_y);
+    // index of the line that triggers the frame output when processed.
+    // This counts from the top of the frame rather than from min_y: with a
+    // vertically cropped update the no-op lines above the crop fill the line
+    // queues, so waiting for lines inside the crop would never start the frame.
+    int trigger_line = int_min(63, ctx->lines_total - 1);
 
     while (l = atomic_fetch_add(&ctx->lines_prepared, 1), l < ctx->lines_total) {
         ctx->line_threads[l] = thread_id;
 
         // queue is sufficiently filled to fill both bounce buffers, frame
         // can begin
-        if (l - min_y == trigger_line) {
+        if (l == trigger_line) {
             epd_lcd_line_source_cb((line_cb_func_t)&retrieve_line_isr, ctx);
             epd_lcd_start_frame();
         }
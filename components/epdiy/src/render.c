@@ -385,6 +385,15 @@ __attribute__((optimize("O3"))) static inline int _interlace_line_unaligned(
     return dirty;
 }
 
+/**
+ * Plain C interlacing of a whole line, the reference for the vector path.
+ */
+bool epd_interlace_line_reference(
+    const uint8_t* to, const uint8_t* from, uint8_t* interlaced, uint8_t* col_dirtyness, int fb_width
+) {
+    return _interlace_line_unaligned(to, from, interlaced, col_dirtyness, fb_width) > 0;
+}
+
 /**
  * Interlaces the lines at `to`, `from` into `interlaced`.
  * returns `1` if there are differences, `0` otherwise.
@@ -469,7 +478,7 @@ EpdRect epd_difference_image_base(
             break;
     }
     for (max_x = x_end - 1; max_x >= crop_to.x; max_x--) {
-        uint8_t mask = min_x % 2 ? 0xF0 : 0x0F;
+        uint8_t mask = max_x % 2 ? 0xF0 : 0x0F;
         if ((col_dirtyness[max_x / 2] & mask) != 0)
             break;
     }
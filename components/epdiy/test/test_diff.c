@@ -16,6 +16,13 @@ bool _epd_interlace_line(
     uint8_t* col_dirtyness,
     int fb_width
 );
+bool epd_interlace_line_reference(
+    const uint8_t* to,
+    const uint8_t* from,
+    uint8_t* interlaced,
+    uint8_t* col_dirtyness,
+    int fb_width
+);
 
 static const uint8_t from_pattern[8] = { 0xFF, 0xF0, 0x0F, 0x01, 0x55, 0xAA, 0xFF, 0x80 };
 static const uint8_t to_pattern[8] = { 0xFF, 0xFF, 0x0F, 0x10, 0xAA, 0x55, 0xFF, 0x00 };
@@ -181,4 +188,54 @@ TEST_CASE("different 4-byte alignments work", "[epdiy,unit]") {
     }
 
     diff_test_buffers_free(&bufs);
-}
\ No newline at end of file
+}
+
+TEST_CASE("diff matches C reference on random lines", "[epdiy,unit]") {
+    const int example_len = DEFAULT_EXAMPLE_LEN;
+    DiffTestBuffers bufs;
+    diff_test_buffers_init(&bufs, example_len);
+    // the expectation buffers hold the reference results here
+    uint8_t* expected_interlaced = bufs.expected_interlaced;
+    uint8_t* expected_col_dirtyness = bufs.expected_col_dirtyness;
+
+    uint32_t random_state = 0x9E3779B9;
+    for (int line = 0; line < 200; line++) {
+        for (int i = 0; i < example_len; i++) {
+            // xorshift, so a failing line can be reproduced
+            random_state ^= random_state << 13;
+            random_state ^= random_state >> 17;
+            random_state ^= random_state << 5;
+            bufs.from[i] = random_state;
+            // mostly unchanged pixels, like a real page turn
+            bufs.to[i] = (random_state >> 8) % 4 ? bufs.from[i] : random_state >> 16;
+        }
+        int start_offset = ((random_state >> 24) % 5) * 4;
+        int len = 64 + ((random_state >> 4) % ((example_len - start_offset - 64) / 4 + 1)) * 4;
+
+        memset(bufs.interlaced, 0, example_len * 2);
+        memset(bufs.col_dirtyness, 0, example_len);
+        memset(expected_interlaced, 0, example_len * 2);
+        memset(expected_col_dirtyness, 0, example_len);
+
+        bool dirty = _epd_interlace_line(
+            bufs.to + start_offset,
+            bufs.from + start_offset,
+            bufs.interlaced + 2 * start_offset,
+            bufs.col_dirtyness + start_offset,
+            2 * len
+        );
+        bool expected_dirty = epd_interlace_line_reference(
+            bufs.to + start_offset,
+            bufs.from + start_offset,
+            expected_interlaced + 2 * start_offset,
+            expected_col_dirtyness + start_offset,
+            2 * len
+        );
+
+        TEST_ASSERT(dirty == expected_dirty);
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(expected_col_dirtyness, bufs.col_dirtyness, example_len);
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(expected_interlaced, bufs.interlaced, example_len * 2);
+    }
+
+    diff_test_buffers_free(&bufs);
+}
@@ -0,0 +1,370 @@
+#include <esp_heap_caps.h>
+#include <miniz.h>
+#include <stdio.h>
+#include <string.h>
+#include <unity.h>
+#include "epd_board.h"
+#include "epd_display.h"
+#include "epdiy.h"
+#include "esp_timer.h"
+
+// the compressed font the reader uses for the UI and the bitmap font reading mode - the
+// fonts pick their epdiy header by board
+#ifndef BOARD_TYPE_PAPER_S3
+#define BOARD_TYPE_PAPER_S3
+#endif
+#include "../../../lib/Fonts/regular_font.h"
+
+#ifdef CONFIG_IDF_TARGET_ESP32
+#define TEST_BOARD epd_board_v6
+#elif defined(CONFIG_IDF_TARGET_ESP32S3)
+#define TEST_BOARD epd_board_v7
+#endif
+
+#define PAGE_WIDTH 540
+#define PAGE_MARGIN 20
+#define MAX_LINES 64
+#define MAX_LINE_LEN 256
+
+// book text, with the curly quotes and dashes that live at the far end of the interval table
+static const char* page_text
+    = "“Good morning, Mr. Utterson,” said the doctor — and the lawyer noticed that his "
+      "voice had changed; it was low and broken. “I have been wanting to see you. You "
+      "know I never approved of it; and I never approved of him, either, you’ll remember "
+      "that.” Mr. Utterson’s face was grave as he looked at his old friend across the "
+      "hearth, where the fire burned low in the grate and the shadows climbed the walls "
+      "of the cabinet. “It is a strange story,” he said at last, “and a stranger "
+      "ending — I would give a great deal to know the truth of it, but I fear the truth "
+      "is not a thing that either of us will care to hear.” The doctor made no answer; "
+      "he sat with his head bowed, and the clock on the chimney‐piece ticked on in the "
+      "silence, café‐table, naïve façade, déjà vu, ½ past eleven.";
+
+// the lookup before it was a binary search
+static const EpdGlyph* linear_get_glyph(const EpdFont* font, uint32_t code_point) {
+    const EpdUnicodeInterval* intervals = font->intervals;
+    for (int i = 0; i < font->interval_count; i++) {
+        const EpdUnicodeInterval* interval = &intervals[i];
+        if (code_point >= interval->first && code_point <= interval->last) {
+            return &font->glyph[interval->offset + (code_point - interval->first)];
+        }
+        if (code_point < interval->first) {
+            return NULL;
+        }
+    }
+    return NULL;
+}
+
+// enough UTF-8 decoding for the test text
+static uint32_t next_code_point(const uint8_t** p) {
+    uint32_t cp = *(*p)++;
+    if (cp >= 0xE0) {
+        cp = ((cp & 0x0F) << 12) | (((*p)[0] & 0x3F) << 6) | ((*p)[1] & 0x3F);
+        *p += 2;
+    } else if (cp >= 0xC0) {
+        cp = ((cp & 0x1F) << 6) | ((*p)[0] & 0x3F);
+        *p += 1;
+    }
+    return cp;
+}
+
+// greedy line breaking by measuring every word - returns the number of lines
+static int layout_page(char lines[MAX_LINES][MAX_LINE_LEN]) {
+    EpdFontProperties props = epd_font_properties_default();
+    int line_count = 0;
+    lines[0][0] = '\0';
+    const char* word = page_text;
+    while (*word && line_count < MAX_LINES) {
+        const char* end = strchr(word, ' ');
+        int len = end ? end - word : strlen(word);
+
+        char candidate[MAX_LINE_LEN];
+        snprintf(
+            candidate,
+            sizeof(candidate),
+            "%s%s%.*s",
+            lines[line_count],
+            lines[line_count][0] ? " " : "",
+            len,
+            word
+        );
+        int x = 0, y = 0, x1, y1, w, h;
+        epd_get_text_bounds(&regular_font, candidate, &x, &y, &x1, &y1, &w, &h, &props);
+        if (w > PAGE_WIDTH - 2 * PAGE_MARGIN && lines[line_count][0]) {
+            line_count++;
+            if (line_count == MAX_LINES) {
+                break;
+            }
+            snprintf(lines[line_count], MAX_LINE_LEN, "%.*s", len, word);
+        } else {
+            strcpy(lines[line_count], candidate);
+        }
+        word += len;
+        while (*word == ' ') {
+            word++;
+        }
+    }
+    return line_count + 1;
+}
+
+static void render_page(char lines[MAX_LINES][MAX_LINE_LEN], int line_count, uint8_t* fb) {
+    memset(fb, 0xFF, epd_width() / 2 * epd_height());
+    int cursor_y = PAGE_MARGIN + regular_font.ascender;
+    for (int i = 0; i < line_count; i++) {
+        int cursor_x = PAGE_MARGIN;
+        TEST_ASSERT_EQUAL(
+            EPD_DRAW_SUCCESS,
+            epd_write_default(&regular_font, lines[i], &cursor_x, &cursor_y, fb)
+        );
+    }
+}
+
+TEST_CASE("glyph lookup matches a linear scan", "[epdiy,unit,font]") {
+    for (uint32_t cp = 0; cp < 0x10000; cp++) {
+        TEST_ASSERT_EQUAL_PTR(linear_get_glyph(&regular_font, cp), epd_get_glyph(&regular_font, cp));
+    }
+    TEST_ASSERT_NULL(epd_get_glyph(&regular_font, 0x10FFFF));
+
+    // time the lookups for every character on the page
+    uint32_t code_points[1024];
+    int count = 0;
+    for (const uint8_t* p = (const uint8_t*)page_text; *p && count < 1024;) {
+        code_points[count++] = next_code_point(&p);
+    }
+    const EpdGlyph* volatile sink = NULL;
+    uint64_t start = esp_timer_get_time();
+    for (int run = 0; run < 100; run++) {
+        for (int i = 0; i < count; i++) {
+            sink = linear_get_glyph(&regular_font, code_points[i]);
+        }
+    }
+    uint64_t linear_end = esp_timer_get_time();
+    for (int run = 0; run < 100; run++) {
+        for (int i = 0; i < count; i++) {
+            sink = epd_get_glyph(&regular_font, code_points[i]);
+        }
+    }
+    uint64_t end = esp_timer_get_time();
+    (void)sink;
+    printf(
+        "%d glyph lookups: linear %.2fus, binary search %.2fus\n",
+        count,
+        (linear_end - start) / 100.0,
+        (end - linear_end) / 100.0
+    );
+}
+
+TEST_CASE("cached glyphs draw the same page faster", "[epdiy,e2e,font]") {
+    epd_init(&TEST_BOARD, &ED047TC2, EPD_OPTIONS_DEFAULT);
+    epd_set_rotation(EPD_ROT_INVERTED_PORTRAIT);
+    size_t fb_size = epd_width() / 2 * epd_height();
+    uint8_t* expected = heap_caps_malloc(fb_size, MALLOC_CAP_SPIRAM);
+    uint8_t* fb = heap_caps_malloc(fb_size, MALLOC_CAP_SPIRAM);
+    char(*lines)[MAX_LINE_LEN] = heap_caps_malloc(MAX_LINES * MAX_LINE_LEN, MALLOC_CAP_SPIRAM);
+    TEST_ASSERT_NOT_NULL(expected);
+    TEST_ASSERT_NOT_NULL(fb);
+    TEST_ASSERT_NOT_NULL(lines);
+
+    uint64_t start = esp_timer_get_time();
+    int line_count = layout_page(lines);
+    uint64_t layout_end = esp_timer_get_time();
+    TEST_ASSERT_TRUE(line_count > 5);
+    printf("laying out %d lines took %lluus\n", line_count, layout_end - start);
+
+    // every glyph inflated as it is drawn, like before the cache
+    epd_set_glyph_cache_size(0);
+    start = esp_timer_get_time();
+    render_page(lines, line_count, expected);
+    uint64_t uncached = esp_timer_get_time() - start;
+    TEST_ASSERT_EQUAL(0, epd_glyph_cache_stats().used_bytes);
+
+    epd_set_glyph_cache_size(EPD_GLYPH_CACHE_SIZE);
+    EpdGlyphCacheStats before = epd_glyph_cache_stats();
+    start = esp_timer_get_time();
+    render_page(lines, line_count, fb);
+    uint64_t cold = esp_timer_get_time() - start;
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, fb, fb_size);
+
+    start = esp_timer_get_time();
+    render_page(lines, line_count, fb);
+    uint64_t warm = esp_timer_get_time() - start;
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, fb, fb_size);
+    EpdGlyphCacheStats after = epd_glyph_cache_stats();
+    TEST_ASSERT_TRUE(after.used_bytes <= EPD_GLYPH_CACHE_SIZE);
+    TEST_ASSERT_TRUE(after.hits > after.misses);
+    printf(
+        "drawing the page: uncached %lluus, cold cache %lluus, warm cache %lluus (%lu misses, "
+        "%u bytes)\n",
+        uncached,
+        cold,
+        warm,
+        (unsigned long)(after.misses - before.misses),
+        (unsigned)after.used_bytes
+    );
+
+    // a budget smaller than the page still draws it right, evicting as it goes
+    epd_set_glyph_cache_size(2048);
+    render_page(lines, line_count, fb);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, fb, fb_size);
+    TEST_ASSERT_TRUE(epd_glyph_cache_stats().used_bytes <= 2048);
+    TEST_ASSERT_TRUE(epd_glyph_cache_stats().evictions > after.evictions);
+
+    epd_set_glyph_cache_size(EPD_GLYPH_CACHE_SIZE);
+    epd_clear_glyph_cache();
+    TEST_ASSERT_EQUAL(0, epd_glyph_cache_stats().used_bytes);
+
+    heap_caps_free(lines);
+    heap_caps_free(fb);
+    heap_caps_free(expected);
+    epd_deinit();
+}
+
+TEST_CASE("glyphs that fail to inflate are not cached", "[epdiy,e2e,font]") {
+    // a single glyph whose "compressed" data isn't zlib
+    static const uint8_t bitmap[] = { 0xDE, 0xAD, 0xBE, 0xEF, 0xDE, 0xAD, 0xBE, 0xEF };
+    static const EpdGlyph glyphs[] = { { 8, 8, 9, 0, 8, sizeof(bitmap), 0 } };
+    static const EpdUnicodeInterval intervals[] = { { 'A', 'A', 0 } };
+    const EpdFont broken = { bitmap, glyphs, intervals, 1, 1, 10, 8, -2 };
+
+    epd_init(&TEST_BOARD, &ED047TC2, EPD_OPTIONS_DEFAULT);
+    epd_set_rotation(EPD_ROT_INVERTED_PORTRAIT);
+    size_t fb_size = epd_width() / 2 * epd_height();
+    uint8_t* fb = heap_caps_malloc(fb_size, MALLOC_CAP_SPIRAM);
+    TEST_ASSERT_NOT_NULL(fb);
+    memset(fb, 0xFF, fb_size);
+
+    epd_clear_glyph_cache();
+    for (int i = 0; i < 2; i++) {
+        int cursor_x = 10, cursor_y = 20;
+        enum EpdDrawError err = epd_write_default(&broken, "A", &cursor_x, &cursor_y, fb);
+        TEST_ASSERT_TRUE(err & EPD_DRAW_FAILED_ALLOC);
+        TEST_ASSERT_EQUAL(0, epd_glyph_cache_stats().used_bytes);
+    }
+    // nothing garbled got drawn either
+    for (size_t i = 0; i < fb_size; i++) {
+        TEST_ASSERT_EQUAL(0xFF, fb[i]);
+    }
+
+    heap_caps_free(fb);
+    epd_deinit();
+}
+
+// glyphs inflated by the reference drawing, so it is only the pixel writing that gets compared
+#define MAX_GLYPHS 1024
+static uint8_t* reference_bitmaps[MAX_GLYPHS];
+
+static const uint8_t* reference_bitmap(const EpdFont* font, const EpdGlyph* glyph) {
+    int index = glyph - font->glyph;
+    TEST_ASSERT_TRUE(index < MAX_GLYPHS);
+    if (reference_bitmaps[index] == NULL) {
+        size_t size = (glyph->width / 2 + glyph->width % 2) * glyph->height;
+        reference_bitmaps[index] = malloc(size + 1);
+        TEST_ASSERT_NOT_NULL(reference_bitmaps[index]);
+        tinfl_decompress_mem_to_mem(
+            reference_bitmaps[index],
+            size,
+            &font->bitmap[glyph->data_offset],
+            glyph->compressed_size,
+            TINFL_FLAG_PARSE_ZLIB_HEADER
+        );
+    }
+    return reference_bitmaps[index];
+}
+
+// a line of text drawn the way draw_char used to, with epd_draw_pixel for every pixel
+static void reference_write_line(
+    const EpdFont* font, const char* string, int cursor_x, int cursor_y, uint8_t flags, uint8_t* fb
+) {
+    EpdFontProperties props = epd_font_properties_default();
+    props.flags = flags;
+    if (flags & EPD_DRAW_BACKGROUND) {
+        int x = cursor_x, y = cursor_y, x1, y1, w, h;
+        epd_get_text_bounds(font, string, &x, &y, &x1, &y1, &w, &h, &props);
+        for (int l = cursor_y - font->ascender; l < cursor_y - font->descender; l++) {
+            epd_draw_hline(cursor_x, l, w, props.bg_color << 4, fb);
+        }
+    }
+    uint8_t color_lut[16];
+    for (int c = 0; c < 16; c++) {
+        color_lut[c] = props.bg_color + c * ((int)props.fg_color - (int)props.bg_color) / 15;
+    }
+    for (const uint8_t* p = (const uint8_t*)string; *p;) {
+        const EpdGlyph* glyph = epd_get_glyph(font, next_code_point(&p));
+        TEST_ASSERT_NOT_NULL(glyph);
+        const uint8_t* bitmap = reference_bitmap(font, glyph);
+        int byte_width = glyph->width / 2 + glyph->width % 2;
+        for (int y = 0; y < glyph->height; y++) {
+            for (int x = 0; x < glyph->width; x++) {
+                uint8_t bm = bitmap[y * byte_width + x / 2];
+                bm = (x & 1) ? bm >> 4 : bm & 0xF;
+                if ((flags & EPD_DRAW_BACKGROUND) || bm) {
+                    epd_draw_pixel(
+                        cursor_x + glyph->left + x,
+                        cursor_y - glyph->top + y,
+                        color_lut[bm] << 4,
+                        fb
+                    );
+                }
+            }
+        }
+        cursor_x += glyph->advance_x;
+    }
+}
+
+TEST_CASE("glyph spans match drawing pixel by pixel", "[epdiy,e2e,font]") {
+    epd_init(&TEST_BOARD, &ED047TC2, EPD_OPTIONS_DEFAULT);
+    epd_set_rotation(EPD_ROT_INVERTED_PORTRAIT);
+    size_t fb_size = epd_width() / 2 * epd_height();
+    uint8_t* expected = heap_caps_malloc(fb_size, MALLOC_CAP_SPIRAM);
+    uint8_t* fb = heap_caps_malloc(fb_size, MALLOC_CAP_SPIRAM);
+    char(*lines)[MAX_LINE_LEN] = heap_caps_malloc(MAX_LINES * MAX_LINE_LEN, MALLOC_CAP_SPIRAM);
+    TEST_ASSERT_NOT_NULL(expected);
+    TEST_ASSERT_NOT_NULL(fb);
+    TEST_ASSERT_NOT_NULL(lines);
+    int line_count = layout_page(lines);
+
+    // a full page, warm so both sides only write pixels
+    render_page(lines, line_count, fb);
+    memset(expected, 0xFF, fb_size);
+    uint64_t start = esp_timer_get_time();
+    for (int i = 0; i < line_count; i++) {
+        int cursor_y = PAGE_MARGIN + regular_font.ascender + i * regular_font.advance_y;
+        reference_write_line(&regular_font, lines[i], PAGE_MARGIN, cursor_y, 0, expected);
+    }
+    uint64_t pixels = esp_timer_get_time() - start;
+    start = esp_timer_get_time();
+    render_page(lines, line_count, fb);
+    uint64_t spans = esp_timer_get_time() - start;
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, fb, fb_size);
+    printf("drawing the page: pixel by pixel %lluus, spans %lluus\n", pixels, spans);
+
+    // glyphs hanging off every edge, odd and even positions, with and without background
+    const int positions[][2] = {
+        { -7, 40 }, { -30, 41 }, { 500, 60 }, { 531, 961 }, { 100, 5 }, { 101, 990 }, { 3, 950 },
+    };
+    for (int bg = 0; bg < 2; bg++) {
+        uint8_t flags = bg ? EPD_DRAW_BACKGROUND : 0;
+        EpdFontProperties props = epd_font_properties_default();
+        props.flags |= flags;
+        memset(expected, 0xA5, fb_size);
+        memset(fb, 0xA5, fb_size);
+        for (int i = 0; i < sizeof(positions) / sizeof(positions[0]); i++) {
+            int cursor_x = positions[i][0];
+            int cursor_y = positions[i][1];
+            reference_write_line(&regular_font, "Wg“½", cursor_x, cursor_y, flags, expected);
+            TEST_ASSERT_EQUAL(
+                EPD_DRAW_SUCCESS,
+                epd_write_string(&regular_font, "Wg“½", &cursor_x, &cursor_y, fb, &props)
+            );
+        }
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, fb, fb_size);
+    }
+
+    for (int i = 0; i < MAX_GLYPHS; i++) {
+        free(reference_bitmaps[i]);
+        reference_bitmaps[i] = NULL;
+    }
+    heap_caps_free(lines);
+    heap_caps_free(fb);
+    heap_caps_free(expected);
+    epd_deinit();
+}
@@ -38,6 +38,9 @@ static uint8_t waveform_phases[16][4];
 void calc_epd_input_1ppB_1k_S3_VE(
     const uint32_t* ld, uint8_t* epd_input, const uint8_t* conversion_lut, uint32_t epd_width
 );
+void calc_epd_input_1ppB_1k_S3_VE_reference(
+    const uint32_t* ld, uint8_t* epd_input, const uint8_t* conversion_lut, uint32_t epd_width
+);
 
 static EpdWaveformPhases test_waveform = {
     .phase_times = NULL,
@@ -204,6 +207,83 @@ TEST_CASE("1ppB lookup LCD, 1k LUT, PIE", "[epdiy,unit,lut]") {
     test_with_alignments(&bufs, calc_epd_input_1ppB_1k_S3_VE);
     diff_test_buffers_free(&bufs);
 }
+
+static uint32_t test_random_state = 0x12345678;
+
+/// xorshift, so a failing line can be reproduced
+static uint32_t test_random() {
+    test_random_state ^= test_random_state << 13;
+    test_random_state ^= test_random_state >> 17;
+    test_random_state ^= test_random_state << 5;
+    return test_random_state;
+}
+
+TEST_CASE("1ppB lookup LCD, 1k LUT, PIE matches C reference on random lines", "[epdiy,unit,lut]") {
+    LutTestBuffers bufs;
+    lut_test_buffers_init(&bufs, DEFAULT_EXAMPLE_LEN, result_pattern_1ppB, 4);
+    int out_len = DEFAULT_EXAMPLE_LEN / 4;
+    uint8_t* reference_line = heap_caps_aligned_alloc(16, out_len, MALLOC_CAP_DEFAULT);
+
+    for (int line = 0; line < 200; line++) {
+        // a random waveform phase and random pixels
+        for (int to = 0; to < 16; to++) {
+            for (int i = 0; i < 4; i++) {
+                waveform_phases[to][i] = test_random();
+            }
+        }
+        for (int i = 0; i < DEFAULT_EXAMPLE_LEN; i++) {
+            bufs.line_data[i] = test_random();
+        }
+        LutFunctionPair func_pair
+            = find_lut_functions(MODE_GL16 | MODE_PACKING_1PPB_DIFFERENCE, 1 << 10);
+        func_pair.build_func(bufs.lut, &test_waveform, 0);
+
+        // 4 byte aligned start, length a multiple of 4 pixels and long enough for the vector loop
+        int start_offset = (test_random() % 4) * 4;
+        int len = 64 + (test_random() % ((DEFAULT_EXAMPLE_LEN - start_offset - 64) / 4 + 1)) * 4;
+
+        memset(bufs.result_line, 0xA5, out_len);
+        memset(reference_line, 0xA5, out_len);
+        calc_epd_input_1ppB_1k_S3_VE(
+            (uint32_t*)(bufs.line_data + start_offset),
+            bufs.result_line + start_offset / 4,
+            bufs.lut,
+            len
+        );
+        calc_epd_input_1ppB_1k_S3_VE_reference(
+            (uint32_t*)(bufs.line_data + start_offset),
+            reference_line + start_offset / 4,
+            bufs.lut,
+            len
+        );
+        // the whole buffer, so writes outside the line are caught as well
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(reference_line, bufs.result_line, out_len);
+    }
+
+    // one display line (960px) must fit comfortably into a line time at a 20MHz pixel clock
+    const int display_width = 960;
+    uint64_t start = esp_timer_get_time();
+    for (int i = 0; i < 100; i++) {
+        calc_epd_input_1ppB_1k_S3_VE(
+            (uint32_t*)bufs.line_data, bufs.result_line, bufs.lut, display_width
+        );
+    }
+    uint64_t vector_end = esp_timer_get_time();
+    for (int i = 0; i < 100; i++) {
+        calc_epd_input_1ppB_1k_S3_VE_reference(
+            (uint32_t*)bufs.line_data, reference_line, bufs.lut, display_width
+        );
+    }
+    uint64_t reference_end = esp_timer_get_time();
+    printf(
+        "960px line: vector %.2fus, C reference %.2fus per iter.\n",
+        (vector_end - start) / 100.0,
+        (reference_end - vector_end) / 100.0
+    );
+
+    heap_caps_free(reference_line);
+    diff_test_buffers_free(&bufs);
+}
 #endif
 
 TEST_CASE("2ppB lookup LCD, 64k LUT, previously white", "[epdiy,unit,lut]") {
@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "CoverThumbnail.h"
+#include "Renderer/Renderer.h"
+
+#ifndef UNIT_TEST
+#include <esp_log.h>
+#else
+#define ESP_LOGE(args...)
+#define ESP_LOGD(args...)
+#endif
+
+static const char *TAG = "THUMB";
+
+static const uint32_t THUMBNAIL_MAGIC = 0x344d4854; // 'THM4'
+
+void CoverThumbnail::pack(const uint8_t *gray, int width, int height, uint8_t *packed)
+{
+  int stride = (width + 1) / 2;
+  for (int y = 0; y < height; y++)
+  {
+    const uint8_t *src = gray + y * width;
+    uint8_t *dest = packed + y * stride;
+    for (int x = 0; x < width; x += 2)
+    {
+      // 17 is 255 / 15
+      uint8_t high = (src[x] + 8) / 17;
+      uint8_t low = x + 1 < width ? (src[x + 1] + 8) / 17 : 0;
+      dest[x / 2] = (high << 4) | low;
+    }
+  }
+}
+
+bool CoverThumbnail::load(const std::string &path, int width, int height, std::vector<uint8_t> &packed)
+{
+  FILE *fp = fopen(path.c_str(), "rb");
+  if (!fp)
+  {
+    return false;
+  }
+  ThumbnailHeader header;
+  bool ok = fread(&header, sizeof(header), 1, fp) == 1 && header.magic == THUMBNAIL_MAGIC &&
+            header.width == width && header.height == height;
+  if (ok)
+  {
+    packed.resize(get_packed_size(width, height));
+    ok = fread(packed.data(), 1, packed.size(), fp) == packed.size();
+  }
+  fclose(fp);
+  if (!ok)
+  {
+    ESP_LOGD(TAG, "No usable %dx%d thumbnail at %s", width, height, path.c_str());
+  }
+  return ok;
+}
+
+bool CoverThumbnail::save(const std::string &path, int width, int height, const std::vector<uint8_t> &packed)
+{
+  if (packed.size() != get_packed_size(width, height))
+  {
+    return false;
+  }
+  FILE *fp = fopen(path.c_str(), "wb");
+  if (!fp)
+  {
+    ESP_LOGE(TAG, "Failed to create %s", path.c_str());
+    return false;
+  }
+  ThumbnailHeader header = {THUMBNAIL_MAGIC, (uint16_t)width, (uint16_t)height};
+  bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+            fwrite(packed.data(), 1, packed.size(), fp) == packed.size();
+  ok = fclose(fp) == 0 && ok;
+  if (!ok)
+  {
+    // don't leave half a thumbnail behind
+    remove(path.c_str());
+    ESP_LOGE(TAG, "Failed to write %s", path.c_str());
+  }
+  return ok;
+}
+
+bool CoverThumbnail::create(Renderer *renderer, const std::string &path, const std::string &cover_href,
+                            const uint8_t *data, size_t data_size, int width, int height, std::vector<uint8_t> &packed)
+{
+  if (!data || data_size == 0 || width <= 0 || height <= 0 || width > UINT16_MAX || height > UINT16_MAX)
+  {
+    return false;
+  }
+  uint8_t *gray = (uint8_t *)malloc(width * height);
+  if (!gray)
+  {
+    ESP_LOGE(TAG, "No memory to make a %dx%d thumbnail", width, height);
+    return false;
+  }
+  bool ok = renderer->decode_image(cover_href, data, data_size, width, height, gray);
+  if (ok)
+  {
+    packed.resize(get_packed_size(width, height));
+    pack(gray, width, height, packed.data());
+    // a thumbnail we couldn't save can still be drawn this time
+    save(path, width, height, packed);
+  }
+  free(gray);
+  return ok;
+}
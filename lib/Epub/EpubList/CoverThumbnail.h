@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+class Renderer;
+
+// A book cover decoded and scaled once to the size the library draws it at
+// and kept in the cache folder as 4 bit gray, two pixels to a byte (see
+// Renderer::draw_packed_gray). Drawing a page of the library is then a small
+// file read and a blit per book instead of a JPEG/PNG decode.
+//
+// The size is stored with the thumbnail - if the grid or the margins change
+// the thumbnail no longer matches what's asked for and is made again.
+class CoverThumbnail
+{
+private:
+  struct ThumbnailHeader
+  {
+    uint32_t magic;
+    uint16_t width;
+    uint16_t height;
+  };
+
+public:
+  static size_t get_packed_size(int width, int height) { return (size_t)((width + 1) / 2) * height; }
+  // pack an 8 bit gray bitmap down to 4 bits, rounding to the nearest level
+  static void pack(const uint8_t *gray, int width, int height, uint8_t *packed);
+  // read a thumbnail - false if it is missing, damaged or was made for a different size
+  static bool load(const std::string &path, int width, int height, std::vector<uint8_t> &packed);
+  static bool save(const std::string &path, int width, int height, const std::vector<uint8_t> &packed);
+  // decode the cover image to width x height, pack it and save it to path
+  static bool create(Renderer *renderer, const std::string &path, const std::string &cover_href,
+                     const uint8_t *data, size_t data_size, int width, int height, std::vector<uint8_t> &packed);
+};
@@ -17,163 +17,456 @@
   printf(args);                \
   printf("\n");
 #endif
-#include <map>
-#include <pugixml.hpp>
+#include <string.h>
+#include <algorithm>
 #include "../ZipFile/ZipFile.h"
+#include "../Renderer/ImageProbe.h"
 #include "Epub.h"
+#include "XmlReader.h"
+#include "StringArena.h"
 
 static const char *TAG = "EPUB";
 
+static const char *find_attribute(const XmlAttribute *attributes, int attribute_count, const char *name)
+{
+  for (int i = 0; i < attribute_count; i++)
+  {
+    if (strcmp(attributes[i].name, name) == 0)
+    {
+      return attributes[i].value;
+    }
+  }
+  return nullptr;
+}
+
+// reads the path of the OPF file out of META-INF/container.xml
+class ContainerHandler : public XmlHandler
+{
+private:
+  XmlReader *m_reader = nullptr;
+  bool m_in_rootfiles = false;
+
+public:
+  std::string content_opf_file;
+  bool found_container = false;
+  bool found_rootfiles = false;
+
+  void set_reader(XmlReader *reader) { m_reader = reader; }
+  void start_element(const char *name, int depth, const XmlAttribute *attributes, int attribute_count) override
+  {
+    if (depth == 0)
+    {
+      found_container = strcmp(name, "container") == 0;
+    }
+    else if (depth == 1 && found_container && strcmp(name, "rootfiles") == 0)
+    {
+      found_rootfiles = true;
+      m_in_rootfiles = true;
+    }
+    else if (depth == 2 && m_in_rootfiles && strcmp(name, "rootfile") == 0)
+    {
+      // find the root file that has the media-type="application/oebps-package+xml"
+      const char *media_type = find_attribute(attributes, attribute_count, "media-type");
+      const char *full_path = find_attribute(attributes, attribute_count, "full-path");
+      if (media_type && strcmp(media_type, "application/oebps-package+xml") == 0 && full_path && full_path[0] != '\0')
+      {
+        content_opf_file = full_path;
+        // that's all we need
+        m_reader->stop();
+      }
+    }
+  }
+  void end_element(const char *name, int depth) override
+  {
+    if (depth == 1)
+    {
+      m_in_rootfiles = false;
+    }
+  }
+};
+
 bool Epub::find_content_opf_file(ZipFile &zip, std::string &content_opf_file)
 {
   // open up the meta data to find where the content.opf file lives
-  char *meta_info = (char *)zip.read_file_to_memory("META-INF/container.xml");
-  if (!meta_info)
+  ZipFileStream *stream = zip.open_stream("META-INF/container.xml");
+  if (!stream)
   {
     ESP_LOGE(TAG, "Could not find META-INF/container.xml");
     return false;
   }
-  // Parse META-INF/container.xml using PugiXML
-  pugi::xml_document doc;
-  pugi::xml_parse_result result = doc.load_buffer(meta_info, strlen(meta_info));
-  free(meta_info);
-  if (!result)
+  ContainerHandler handler;
+  XmlReader reader(&handler);
+  handler.set_reader(&reader);
+  bool parsed = reader.read_stream(stream);
+  delete stream;
+  if (!handler.content_opf_file.empty())
   {
-    ESP_LOGE(TAG, "Could not parse META-INF/container.xml: %s", result.description());
-    return false;
+    content_opf_file = handler.content_opf_file;
+    return true;
   }
-
-  pugi::xml_node container = doc.child("container");
-  if (!container)
+  if (!parsed)
+  {
+    ESP_LOGE(TAG, "Could not parse META-INF/container.xml");
+  }
+  else if (!handler.found_container)
   {
     ESP_LOGE(TAG, "Could not find container element in META-INF/container.xml");
-    return false;
   }
-  pugi::xml_node rootfiles = container.child("rootfiles");
-  if (!rootfiles)
+  else if (!handler.found_rootfiles)
   {
     ESP_LOGE(TAG, "Could not find rootfiles element in META-INF/container.xml");
-    return false;
   }
-  // find the root file that has the media-type="application/oebps-package+xml"
-  for (pugi::xml_node rootfile = rootfiles.child("rootfile"); rootfile; rootfile = rootfile.next_sibling("rootfile"))
+  else
   {
-    const char *media_type = rootfile.attribute("media-type").value();
-    if (media_type && strcmp(media_type, "application/oebps-package+xml") == 0)
+    ESP_LOGE(TAG, "Could not get path to content.opf file");
+  }
+  return false;
+}
+
+// The manifest as a flat array sorted by id so the spine can be looked up
+// with a binary search - the ids and hrefs are kept in an arena rather than
+// allocated one by one.
+class EpubManifest
+{
+private:
+  struct Item
+  {
+    const char *id;
+    const char *href;
+  };
+  StringArena m_strings;
+  std::vector<Item> m_items;
+
+public:
+  void add(const char *id, const char *href)
+  {
+    const char *stored_id = m_strings.store(id);
+    const char *stored_href = m_strings.store(href);
+    if (stored_id && stored_href)
     {
-      const char *full_path = rootfile.attribute("full-path").value();
-      if (full_path && full_path[0] != '\0')
+      m_items.push_back({stored_id, stored_href});
+    }
+  }
+  // the items are added in document order - sort them once they are all in
+  void sort()
+  {
+    // stable so that if an id is used twice the last one wins, as it always has
+    std::stable_sort(m_items.begin(), m_items.end(), [](const Item &a, const Item &b)
+                     { return strcmp(a.id, b.id) < 0; });
+  }
+  const char *find(const char *id) const
+  {
+    auto it = std::upper_bound(m_items.begin(), m_items.end(), id, [](const char *id, const Item &item)
+                               { return strcmp(id, item.id) < 0; });
+    return it != m_items.begin() && strcmp((it - 1)->id, id) == 0 ? (it - 1)->href : nullptr;
+  }
+  size_t size() const { return m_items.size(); }
+  const char *store(const char *text) { return m_strings.store(text); }
+};
+
+// collects the title, cover, manifest and spine from the OPF file
+class ContentOpfHandler : public XmlHandler
+{
+private:
+  enum Section
+  {
+    NONE,
+    METADATA,
+    MANIFEST,
+    SPINE,
+  };
+  Section m_section = NONE;
+  bool m_in_title = false;
+
+public:
+  EpubManifest manifest;
+  // the spine's idrefs - resolved against the manifest once it has all been read
+  std::vector<const char *> spine;
+  std::string title;
+  const char *cover_id = nullptr;
+  const char *toc_id = nullptr;
+  bool found_package = false;
+  bool found_metadata = false;
+  bool found_title = false;
+  bool found_manifest = false;
+  bool found_spine = false;
+
+  void start_element(const char *name, int depth, const XmlAttribute *attributes, int attribute_count) override
+  {
+    if (depth == 0)
+    {
+      found_package = strcmp(name, "package") == 0;
+      return;
+    }
+    if (!found_package)
+    {
+      return;
+    }
+    if (depth == 1)
+    {
+      if (strcmp(name, "metadata") == 0)
       {
-        content_opf_file = full_path;
-        return true;
+        found_metadata = true;
+        m_section = METADATA;
+      }
+      else if (strcmp(name, "manifest") == 0)
+      {
+        found_manifest = true;
+        m_section = MANIFEST;
+      }
+      else if (strcmp(name, "spine") == 0)
+      {
+        found_spine = true;
+        m_section = SPINE;
+        const char *toc = find_attribute(attributes, attribute_count, "toc");
+        if (toc)
+        {
+          toc_id = manifest.store(toc);
+        }
+      }
+      return;
+    }
+    if (depth != 2)
+    {
+      return;
+    }
+    if (m_section == METADATA)
+    {
+      // the first dc:title is the title
+      if (!found_title && strcmp(name, "title") == 0)
+      {
+        found_title = true;
+        m_in_title = true;
+      }
+      // find <meta name="cover" content="..."> if present
+      else if (!cover_id && strcmp(name, "meta") == 0)
+      {
+        const char *meta_name = find_attribute(attributes, attribute_count, "name");
+        const char *content = find_attribute(attributes, attribute_count, "content");
+        if (meta_name && content && strcmp(meta_name, "cover") == 0)
+        {
+          cover_id = manifest.store(content);
+        }
+      }
+    }
+    else if (m_section == MANIFEST && strcmp(name, "item") == 0)
+    {
+      const char *id = find_attribute(attributes, attribute_count, "id");
+      const char *href = find_attribute(attributes, attribute_count, "href");
+      if (id && href)
+      {
+        manifest.add(id, href);
+      }
+    }
+    else if (m_section == SPINE && strcmp(name, "itemref") == 0)
+    {
+      const char *idref = find_attribute(attributes, attribute_count, "idref");
+      const char *stored = idref ? manifest.store(idref) : nullptr;
+      if (stored)
+      {
+        spine.push_back(stored);
       }
     }
   }
-  ESP_LOGE(TAG, "Could not get path to content.opf file");
-  return false;
-}
+  void end_element(const char *name, int depth) override
+  {
+    if (depth == 1)
+    {
+      m_section = NONE;
+    }
+    else if (depth == 2)
+    {
+      m_in_title = false;
+    }
+  }
+  void text(const char *text, size_t length, int depth) override
+  {
+    if (m_in_title && depth == 2)
+    {
+      title.append(text, length);
+    }
+  }
+};
 
 bool Epub::parse_content_opf(ZipFile &zip, std::string &content_opf_file)
 {
-  // read in the content.opf file and parse it
-  char *contents = (char *)zip.read_file_to_memory(content_opf_file.c_str());
-  if (!contents)
+  // stream the content.opf file through the parser
+  ZipFileStream *stream = zip.open_stream(content_opf_file.c_str());
+  if (!stream)
   {
     ESP_LOGE(TAG, "Failed to read content.opf '%s'", content_opf_file.c_str());
     return false;
   }
-
-  pugi::xml_document doc;
-  pugi::xml_parse_result result = doc.load_buffer(contents, strlen(contents));
-  free(contents);
-  if (!result)
+  ContentOpfHandler handler;
+  XmlReader reader(&handler);
+  bool parsed = reader.read_stream(stream);
+  delete stream;
+  if (!parsed)
   {
-    ESP_LOGE(TAG, "Error parsing content.opf (pugixml): %s", result.description());
+    ESP_LOGE(TAG, "Error parsing content.opf");
     return false;
   }
-
-  pugi::xml_node package = doc.child("package");
-  if (!package)
+  if (!handler.found_package)
   {
     ESP_LOGE(TAG, "Could not find package element in content.opf");
     return false;
   }
-
   // get the metadata - title and cover image
-  pugi::xml_node metadata = package.child("metadata");
-  if (!metadata)
+  if (!handler.found_metadata)
   {
     ESP_LOGE(TAG, "Missing metadata");
     return false;
   }
-  pugi::xml_node title = metadata.child("dc:title");
-  if (!title || !title.child_value())
+  if (!handler.found_title)
   {
     ESP_LOGE(TAG, "Missing title");
     return false;
   }
-  m_title = title.child_value();
-
-  // find <meta name="cover" content="..."> if present
-  pugi::xml_node cover = metadata.find_child_by_attribute("meta", "name", "cover");
-  const char *cover_item = cover ? cover.attribute("content").value() : nullptr;
-  if (!cover)
+  m_title = handler.title;
+  if (!handler.cover_id)
   {
     ESP_LOGW(TAG, "Missing cover");
   }
-
   // read the manifest and spine
-  pugi::xml_node manifest = package.child("manifest");
-  if (!manifest)
+  if (!handler.found_manifest)
   {
     ESP_LOGE(TAG, "Missing manifest");
     return false;
   }
-
-  std::map<std::string, std::string> items;
-  for (pugi::xml_node item = manifest.child("item"); item; item = item.next_sibling("item"))
+  if (!handler.found_spine)
+  {
+    ESP_LOGE(TAG, "Missing spine");
+    return false;
+  }
+  EpubManifest &manifest = handler.manifest;
+  manifest.sort();
+  const char *cover_href = handler.cover_id ? manifest.find(handler.cover_id) : nullptr;
+  if (cover_href)
+  {
+    m_cover_image_item = m_base_path + cover_href;
+  }
+  // the NCX is usually the item with the id "ncx" - otherwise the one the spine names
+  const char *ncx_href = manifest.find("ncx");
+  if (!ncx_href && handler.toc_id)
   {
-    const char *id_attr = item.attribute("id").value();
-    const char *href_attr = item.attribute("href").value();
-    if (!id_attr || !href_attr)
+    ncx_href = manifest.find(handler.toc_id);
+  }
+  if (ncx_href)
+  {
+    m_toc_ncx_item = m_base_path + ncx_href;
+  }
+  m_spine.reserve(handler.spine.size());
+  for (const char *idref : handler.spine)
+  {
+    const char *href = manifest.find(idref);
+    if (href)
     {
-      continue;
+      m_spine.push_back(std::make_pair(std::string(idref), m_base_path + href));
     }
-    std::string item_id = id_attr;
-    std::string href = m_base_path + href_attr;
+  }
+  ESP_LOGD(TAG, "Manifest has %d items, spine %d", (int)manifest.size(), (int)m_spine.size());
+  return true;
+}
 
-    if (cover_item && item_id == cover_item)
+// collects the top level navPoints from the NCX file
+class TocNcxHandler : public XmlHandler
+{
+private:
+  bool m_in_nav_map = false;
+  bool m_in_nav_point = false;
+  bool m_in_nav_label = false;
+  bool m_in_text = false;
+  bool m_seen_label = false;
+  bool m_seen_text = false;
+  bool m_seen_content = false;
+  std::string m_title;
+  std::string m_src;
+  const std::string &m_base_path;
+  std::vector<EpubTocEntry> &m_toc;
+
+public:
+  bool found_ncx = false;
+  bool found_nav_map = false;
+
+  TocNcxHandler(const std::string &base_path, std::vector<EpubTocEntry> &toc) : m_base_path(base_path), m_toc(toc) {}
+  void start_element(const char *name, int depth, const XmlAttribute *attributes, int attribute_count) override
+  {
+    if (depth == 0)
     {
-      m_cover_image_item = href;
+      found_ncx = strcmp(name, "ncx") == 0;
     }
-    if (item_id == "ncx")
+    else if (depth == 1 && found_ncx && strcmp(name, "navMap") == 0)
     {
-      m_toc_ncx_item = href;
+      found_nav_map = true;
+      m_in_nav_map = true;
+    }
+    else if (depth == 2 && m_in_nav_map && strcmp(name, "navPoint") == 0)
+    {
+      m_in_nav_point = true;
+      m_seen_label = m_seen_text = m_seen_content = false;
+      m_title.clear();
+      m_src.clear();
+    }
+    else if (depth == 3 && m_in_nav_point)
+    {
+      // the first label and content of the navPoint - the ones of any nested navPoints are ignored
+      if (!m_seen_label && strcmp(name, "navLabel") == 0)
+      {
+        m_seen_label = true;
+        m_in_nav_label = true;
+      }
+      else if (!m_seen_content && strcmp(name, "content") == 0)
+      {
+        m_seen_content = true;
+        const char *src = find_attribute(attributes, attribute_count, "src");
+        if (src)
+        {
+          m_src = src;
+        }
+      }
+    }
+    else if (depth == 4 && m_in_nav_label && !m_seen_text && strcmp(name, "text") == 0)
+    {
+      m_seen_text = true;
+      m_in_text = true;
     }
-    items[item_id] = href;
-  }
-
-  pugi::xml_node spine = package.child("spine");
-  if (!spine)
-  {
-    ESP_LOGE(TAG, "Missing spine");
-    return false;
   }
-  for (pugi::xml_node itemref = spine.child("itemref"); itemref; itemref = itemref.next_sibling("itemref"))
+  void end_element(const char *name, int depth) override
   {
-    const char *idref = itemref.attribute("idref").value();
-    if (!idref)
+    if (depth == 4)
+    {
+      m_in_text = false;
+    }
+    else if (depth == 3)
     {
-      continue;
+      m_in_nav_label = false;
     }
-    auto it = items.find(idref);
-    if (it != items.end())
+    else if (depth == 2 && m_in_nav_point)
     {
-      m_spine.push_back(std::make_pair(std::string(idref), it->second));
+      m_in_nav_point = false;
+      std::string href = m_base_path + m_src;
+      size_t pos = href.find('#');
+      std::string anchor;
+      if (pos != std::string::npos)
+      {
+        anchor = href.substr(pos + 1);
+        href = href.substr(0, pos);
+      }
+      m_toc.push_back(EpubTocEntry(m_title, href, anchor, 0));
+    }
+    else if (depth == 1)
+    {
+      m_in_nav_map = false;
     }
   }
-  return true;
-}
+  void text(const char *text, size_t length, int depth) override
+  {
+    if (m_in_text && depth == 4)
+    {
+      m_title.append(text, length);
+    }
+  }
+};
 
 bool Epub::parse_toc_ncx_file(ZipFile &zip)
 {
@@ -185,63 +478,32 @@ bool Epub::parse_toc_ncx_file(ZipFile &zip)
   }
   ESP_LOGI(TAG, "toc path: %s\n", m_toc_ncx_item.c_str());
 
-  char *ncx_data = (char *)zip.read_file_to_memory(m_toc_ncx_item.c_str());
-  if (!ncx_data)
+  ZipFileStream *stream = zip.open_stream(m_toc_ncx_item.c_str());
+  if (!stream)
   {
     ESP_LOGE(TAG, "Could not find %s", m_toc_ncx_item.c_str());
     return false;
   }
-
-  pugi::xml_document doc;
-  pugi::xml_parse_result result = doc.load_buffer(ncx_data, strlen(ncx_data));
-  free(ncx_data);
-  if (!result)
+  TocNcxHandler handler(m_base_path, m_toc);
+  XmlReader reader(&handler);
+  bool parsed = reader.read_stream(stream);
+  delete stream;
+  if (!parsed)
   {
-    ESP_LOGE(TAG, "Error parsing toc (pugixml): %s", result.description());
+    ESP_LOGE(TAG, "Error parsing toc");
+    m_toc.clear();
     return false;
   }
-
-  pugi::xml_node ncx = doc.child("ncx");
-  if (!ncx)
+  if (!handler.found_ncx)
   {
     ESP_LOGE(TAG, "Could not find first child ncx in toc");
     return false;
   }
-
-  pugi::xml_node navMap = ncx.child("navMap");
-  if (!navMap)
+  if (!handler.found_nav_map)
   {
     ESP_LOGE(TAG, "Could not find navMap child in ncx");
     return false;
   }
-
-  for (pugi::xml_node navPoint = navMap.child("navPoint"); navPoint; navPoint = navPoint.next_sibling("navPoint"))
-  {
-    pugi::xml_node navLabel = navPoint.child("navLabel").child("text");
-    const char *title_text = navLabel.child_value();
-    if (!title_text)
-    {
-      continue;
-    }
-    std::string title = title_text;
-
-    pugi::xml_node content = navPoint.child("content");
-    const char *src = content.attribute("src").value();
-    if (!src)
-    {
-      continue;
-    }
-    std::string href = m_base_path + src;
-
-    size_t pos = href.find('#');
-    std::string anchor;
-    if (pos != std::string::npos)
-    {
-      anchor = href.substr(pos + 1);
-      href = href.substr(0, pos);
-    }
-    m_toc.push_back(EpubTocEntry(title, href, anchor, 0));
-  }
   return true;
 }
 
@@ -249,10 +511,30 @@ Epub::Epub(const std::string &path) : m_path(path)
 {
 }
 
+Epub::~Epub()
+{
+}
+
+std::shared_ptr<ZipFile> Epub::get_zip()
+{
+  if (!m_zip)
+  {
+    m_zip = std::make_shared<ZipFile>(m_path.c_str());
+  }
+  return m_zip;
+}
+
 // load in the meta data for the epub file
 bool Epub::load()
 {
-  ZipFile zip(m_path.c_str());
+  // open the archive and index its entries once - every item read after this reuses it
+  std::shared_ptr<ZipFile> zip_handle = get_zip();
+  if (!zip_handle->open())
+  {
+    ESP_LOGE(TAG, "Could not open ePub '%s'", m_path.c_str());
+    return false;
+  }
+  ZipFile &zip = *zip_handle;
   std::string content_opf_file;
   if (!find_content_opf_file(zip, content_opf_file))
   {
@@ -334,9 +616,8 @@ std::string normalise_path(const std::string &path)
 
 uint8_t *Epub::get_item_contents(const std::string &item_href, size_t *size)
 {
-  ZipFile zip(m_path.c_str());
   std::string path = normalise_path(item_href);
-  auto content = zip.read_file_to_memory(path.c_str(), size);
+  auto content = get_zip()->read_file_to_memory(path.c_str(), size);
   if (!content)
   {
     ESP_LOGE(TAG, "Failed to read item %s", path.c_str());
@@ -345,6 +626,34 @@ uint8_t *Epub::get_item_contents(const std::string &item_href, size_t *size)
   return content;
 }
 
+ZipFileStream *Epub::open_item_stream(const std::string &item_href)
+{
+  std::string path = normalise_path(item_href);
+  ZipFileStream *stream = get_zip()->open_stream(path.c_str());
+  if (!stream)
+  {
+    ESP_LOGE(TAG, "Failed to stream item %s", path.c_str());
+  }
+  return stream;
+}
+
+bool Epub::get_item_image_header(const std::string &item_href, ImageHeader *header)
+{
+  ZipFileStream *stream = open_item_stream(item_href);
+  if (!stream)
+  {
+    return false;
+  }
+  ImageProbeResult result = probe_image_stream(stream, header);
+  delete stream;
+  if (result != ImageProbeResult::FOUND)
+  {
+    ESP_LOGW(TAG, "Could not read the image header of %s", item_href.c_str());
+    return false;
+  }
+  return true;
+}
+
 int Epub::get_spine_items_count()
 {
   return m_spine.size();
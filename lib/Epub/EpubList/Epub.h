@@ -3,12 +3,15 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <memory>
 #ifndef UNIT_TEST
   #include <freertos/FreeRTOS.h>
   #include <freertos/task.h>
 #endif
 
 class ZipFile;
+class ZipFileStream;
+struct ImageHeader;
 
 class EpubTocEntry
 {
@@ -37,6 +40,8 @@ private:
   std::vector<EpubTocEntry> m_toc;
   // the base path for items in the EPUB file
   std::string m_base_path;
+  // the zip archive - opened once and shared with anything reading items from the book
+  std::shared_ptr<ZipFile> m_zip;
   // find the path for the content.opf file
   bool find_content_opf_file(ZipFile &zip, std::string &content_opf_file);
   bool parse_content_opf(ZipFile &zip, std::string &content_opf_file);
@@ -44,15 +49,21 @@ private:
 
 public:
   Epub(const std::string &path);
-  ~Epub() {}
+  ~Epub();
   std::string &get_base_path() { return m_base_path; }
   bool load();
 
   const std::string &get_path() const { return m_path; }
+  // the archive for this book - opened and indexed on first use
+  std::shared_ptr<ZipFile> get_zip();
   const std::string &get_title();
   const std::string &get_cover_image_item();
   uint8_t *get_item_contents(const std::string &item_href, size_t *size = nullptr);
   std::vector<uint8_t> get_item_contents_as_vector(const std::string &item_href);
+  // stream an item in chunks instead of inflating it all at once - the caller owns the stream
+  ZipFileStream *open_item_stream(const std::string &item_href);
+  // the size and type of an image item read from its header - only inflates the start of the item
+  bool get_item_image_header(const std::string &item_href, ImageHeader *header);
 
   std::string &get_spine_item(int spine_index);
   int get_spine_item_id(std::string spine_key);
@@ -0,0 +1,671 @@
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <ctype.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <unordered_map>
+extern "C" {
+  #include <dirent.h>
+}
+#include "EpubCatalog.h"
+
+#ifndef UNIT_TEST
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#else
+#define ESP_LOGE(args...)
+#define ESP_LOGI(args...)
+#define ESP_LOGD(args...)
+#define vTaskDelay(t)
+#endif
+
+static const char *TAG = "CATALOG";
+
+static const uint32_t CATALOG_MAGIC = 0x54434245; // 'EBCT'
+static const uint16_t CATALOG_VERSION = 2;
+// records read from the title table in one go
+static const int CATALOG_READ_CHUNK = 16;
+// how much of each end of a file goes into its hash
+static const size_t HASH_CHUNK_SIZE = 4096;
+
+EpubCatalog::~EpubCatalog()
+{
+  if (m_build_fp)
+  {
+    fclose(m_build_fp);
+  }
+}
+
+long EpubCatalog::record_offset(uint32_t record) const
+{
+  return sizeof(CatalogHeader) + (long)record * sizeof(CatalogRecord);
+}
+
+bool EpubCatalog::open()
+{
+  m_is_open = false;
+  FILE *fp = fopen(m_path.c_str(), "rb");
+  if (!fp)
+  {
+    return false;
+  }
+  CatalogHeader header;
+  bool ok = fread(&header, sizeof(header), 1, fp) == 1;
+  fclose(fp);
+  if (!ok || header.magic != CATALOG_MAGIC || header.version != CATALOG_VERSION ||
+      header.record_size != sizeof(CatalogRecord) || header.table_offset != record_offset(header.count))
+  {
+    ESP_LOGI(TAG, "No usable catalog at %s", m_path.c_str());
+    return false;
+  }
+  if (header.last_opened >= (int32_t)header.count)
+  {
+    header.last_opened = -1;
+  }
+  m_header = header;
+  m_is_open = true;
+  return true;
+}
+
+bool EpubCatalog::read_record_numbers(FILE *fp, int first, int count, uint32_t *records)
+{
+  return fseek(fp, m_header.table_offset + first * sizeof(uint32_t), SEEK_SET) == 0 &&
+         fread(records, sizeof(uint32_t), count, fp) == (size_t)count;
+}
+
+int EpubCatalog::read_page(int first, int count, std::vector<EpubListItem> &items)
+{
+  items.clear();
+  if (!m_is_open || first < 0 || first >= (int)m_header.count || count <= 0)
+  {
+    return 0;
+  }
+  count = std::min(count, (int)m_header.count - first);
+  FILE *fp = fopen(m_path.c_str(), "rb");
+  if (!fp)
+  {
+    ESP_LOGE(TAG, "Failed to open %s", m_path.c_str());
+    return 0;
+  }
+  items.reserve(count);
+  uint32_t records[CATALOG_READ_CHUNK];
+  for (int done = 0; done < count;)
+  {
+    int chunk = std::min(count - done, CATALOG_READ_CHUNK);
+    if (!read_record_numbers(fp, first + done, chunk, records))
+    {
+      break;
+    }
+    bool ok = true;
+    for (int i = 0; i < chunk && ok; i++)
+    {
+      CatalogRecord record;
+      ok = records[i] < m_header.count && fseek(fp, record_offset(records[i]), SEEK_SET) == 0 &&
+           fread(&record, sizeof(record), 1, fp) == 1;
+      if (ok)
+      {
+        // never trust strings from disk to be terminated
+        record.item.path[MAX_PATH_SIZE - 1] = '\0';
+        record.item.title[MAX_TITLE_SIZE - 1] = '\0';
+        record.item.cover_path[MAX_PATH_SIZE - 1] = '\0';
+        items.push_back(record.item);
+      }
+    }
+    if (!ok)
+    {
+      break;
+    }
+    done += chunk;
+  }
+  fclose(fp);
+  if ((int)items.size() != count)
+  {
+    ESP_LOGE(TAG, "Catalog %s is truncated", m_path.c_str());
+  }
+  return items.size();
+}
+
+bool EpubCatalog::read(int index, EpubListItem &item)
+{
+  std::vector<EpubListItem> items;
+  if (read_page(index, 1, items) != 1)
+  {
+    return false;
+  }
+  item = items[0];
+  return true;
+}
+
+bool EpubCatalog::write_position(int index, const EpubListItem &item)
+{
+  if (!m_is_open || index < 0 || index >= (int)m_header.count)
+  {
+    return false;
+  }
+  FILE *fp = fopen(m_path.c_str(), "r+b");
+  if (!fp)
+  {
+    ESP_LOGE(TAG, "Failed to open %s for update", m_path.c_str());
+    return false;
+  }
+  uint32_t record = 0;
+  // current_section, current_page and pages_in_current_section sit next to each other
+  const size_t position_offset = offsetof(EpubListItem, current_section);
+  const long item_offset = offsetof(CatalogRecord, item);
+  const size_t position_size = offsetof(EpubListItem, pages_in_current_section) + sizeof(item.pages_in_current_section) - position_offset;
+  bool ok = read_record_numbers(fp, index, 1, &record) && record < m_header.count &&
+            fseek(fp, record_offset(record) + item_offset + position_offset, SEEK_SET) == 0 &&
+            fwrite((const uint8_t *)&item + position_offset, position_size, 1, fp) == 1;
+  fclose(fp);
+  if (!ok)
+  {
+    ESP_LOGE(TAG, "Failed to save the position of book %d", index);
+  }
+  return ok;
+}
+
+bool EpubCatalog::set_last_opened(int index)
+{
+  if (!m_is_open || index >= (int)m_header.count)
+  {
+    return false;
+  }
+  if (m_header.last_opened == index)
+  {
+    return true;
+  }
+  FILE *fp = fopen(m_path.c_str(), "r+b");
+  if (!fp)
+  {
+    return false;
+  }
+  m_header.last_opened = index;
+  bool ok = write_header(fp);
+  fclose(fp);
+  return ok;
+}
+
+bool EpubCatalog::write_header(FILE *fp)
+{
+  return fseek(fp, 0, SEEK_SET) == 0 && fwrite(&m_header, sizeof(m_header), 1, fp) == 1;
+}
+
+std::string EpubCatalog::get_build_path() const
+{
+  // keep it 8.3 friendly - BOOKS.CAT is built as BOOKS.TMP
+  size_t dot = m_path.find_last_of('.');
+  size_t slash = m_path.find_last_of('/');
+  if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+  {
+    return m_path + ".TMP";
+  }
+  return m_path.substr(0, dot) + ".TMP";
+}
+
+bool EpubCatalog::begin_build()
+{
+  m_is_open = false;
+  m_build_entries.clear();
+  if (m_build_fp)
+  {
+    fclose(m_build_fp);
+  }
+  m_build_fp = fopen(get_build_path().c_str(), "wb");
+  if (!m_build_fp)
+  {
+    ESP_LOGE(TAG, "Failed to create %s", get_build_path().c_str());
+    return false;
+  }
+  // the real header goes in once everything else is written - until then open() won't accept the file
+  m_header = {};
+  if (!write_header(m_build_fp))
+  {
+    fclose(m_build_fp);
+    m_build_fp = nullptr;
+    return false;
+  }
+  return true;
+}
+
+int EpubCatalog::add(const EpubListItem &item, const BookFingerprint &fingerprint)
+{
+  if (!m_build_fp)
+  {
+    return -1;
+  }
+  CatalogRecord record = {item, fingerprint};
+  if (fwrite(&record, sizeof(record), 1, m_build_fp) != 1)
+  {
+    ESP_LOGE(TAG, "Failed to write to %s", get_build_path().c_str());
+    return -1;
+  }
+  // only the titles are kept in memory while building so we can sort them
+  m_build_entries.push_back({item.title, (uint32_t)m_build_entries.size()});
+  return m_build_entries.size() - 1;
+}
+
+bool EpubCatalog::finish_build(int last_opened_record)
+{
+  if (!m_build_fp)
+  {
+    return false;
+  }
+  std::stable_sort(m_build_entries.begin(), m_build_entries.end(), [](const BuildEntry &a, const BuildEntry &b)
+                   { return strcmp(a.title.c_str(), b.title.c_str()) < 0; });
+  bool ok = true;
+  m_header.last_opened = -1;
+  for (size_t i = 0; i < m_build_entries.size(); i++)
+  {
+    ok = ok && fwrite(&m_build_entries[i].record, sizeof(uint32_t), 1, m_build_fp) == 1;
+    if ((int)m_build_entries[i].record == last_opened_record)
+    {
+      m_header.last_opened = i;
+    }
+  }
+  m_header.magic = CATALOG_MAGIC;
+  m_header.version = CATALOG_VERSION;
+  m_header.record_size = sizeof(CatalogRecord);
+  m_header.count = m_build_entries.size();
+  m_header.table_offset = record_offset(m_header.count);
+  ok = ok && write_header(m_build_fp);
+  ok = fclose(m_build_fp) == 0 && ok;
+  m_build_fp = nullptr;
+  m_build_entries.clear();
+  m_build_entries.shrink_to_fit();
+  // FAT won't rename over an existing file
+  remove(m_path.c_str());
+  if (!ok || rename(get_build_path().c_str(), m_path.c_str()) != 0)
+  {
+    ESP_LOGE(TAG, "Failed to write %s", m_path.c_str());
+    return false;
+  }
+  m_is_open = true;
+  ESP_LOGI(TAG, "Wrote %u books to %s", (unsigned)m_header.count, m_path.c_str());
+  return true;
+}
+
+void EpubCatalog::abandon_build()
+{
+  if (m_build_fp)
+  {
+    fclose(m_build_fp);
+    m_build_fp = nullptr;
+    remove(get_build_path().c_str());
+  }
+  m_build_entries.clear();
+  m_build_entries.shrink_to_fit();
+  // the catalog we had is still there
+  open();
+}
+
+int EpubCatalog::find(const char *path)
+{
+  int record_number = -1;
+  int record = 0;
+  for_each_record([&](const CatalogRecord &candidate)
+                  {
+    if (strcmp(candidate.item.path, path) == 0)
+    {
+      record_number = record;
+      return false;
+    }
+    record++;
+    return true; });
+  if (record_number < 0)
+  {
+    return -1;
+  }
+  FILE *fp = fopen(m_path.c_str(), "rb");
+  if (!fp)
+  {
+    return -1;
+  }
+  int index = -1;
+  uint32_t records[CATALOG_READ_CHUNK];
+  for (int first = 0; first < (int)m_header.count && index < 0; first += CATALOG_READ_CHUNK)
+  {
+    int chunk = std::min((int)m_header.count - first, CATALOG_READ_CHUNK);
+    if (!read_record_numbers(fp, first, chunk, records))
+    {
+      break;
+    }
+    for (int i = 0; i < chunk; i++)
+    {
+      if ((int)records[i] == record_number)
+      {
+        index = first + i;
+        break;
+      }
+    }
+  }
+  fclose(fp);
+  return index;
+}
+
+bool EpubCatalog::for_each_record(const std::function<bool(const CatalogRecord &)> &fn)
+{
+  if (!m_is_open)
+  {
+    return false;
+  }
+  FILE *fp = fopen(m_path.c_str(), "rb");
+  if (!fp)
+  {
+    return false;
+  }
+  bool ok = fseek(fp, record_offset(0), SEEK_SET) == 0;
+  CatalogRecord record;
+  for (uint32_t i = 0; ok && i < m_header.count; i++)
+  {
+    ok = fread(&record, sizeof(record), 1, fp) == 1;
+    if (ok)
+    {
+      record.item.path[MAX_PATH_SIZE - 1] = '\0';
+      record.item.title[MAX_TITLE_SIZE - 1] = '\0';
+      record.item.cover_path[MAX_PATH_SIZE - 1] = '\0';
+      if (!fn(record))
+      {
+        break;
+      }
+    }
+  }
+  fclose(fp);
+  return ok;
+}
+
+static uint32_t fnv1a(uint32_t hash, const uint8_t *data, size_t length)
+{
+  for (size_t i = 0; i < length; i++)
+  {
+    hash = (hash ^ data[i]) * 16777619u;
+  }
+  return hash;
+}
+
+static const uint32_t FNV_OFFSET_BASIS = 2166136261u;
+
+uint32_t EpubCatalog::hash_file(const char *path, uint32_t size)
+{
+  uint32_t hash = fnv1a(FNV_OFFSET_BASIS, (const uint8_t *)&size, sizeof(size));
+  FILE *fp = fopen(path, "rb");
+  if (!fp)
+  {
+    return hash;
+  }
+  uint8_t buffer[512];
+  for (long start : {0L, (long)size - (long)HASH_CHUNK_SIZE})
+  {
+    if (start < 0 || fseek(fp, start, SEEK_SET) != 0)
+    {
+      continue;
+    }
+    size_t remaining = HASH_CHUNK_SIZE;
+    size_t read = 0;
+    while (remaining > 0 && (read = fread(buffer, 1, std::min(remaining, sizeof(buffer)), fp)) > 0)
+    {
+      hash = fnv1a(hash, buffer, read);
+      remaining -= read;
+    }
+  }
+  fclose(fp);
+  return hash;
+}
+
+// Accept "epub" and also the 8.3 short-name variant "epu" (case-insensitive).
+// Hidden files starting with "." and files starting with '_' (on macOS FAT
+// volumes these are AppleDouble metadata, e.g. "_THEGR~6.EPU") are ignored.
+static bool is_epub_file(const struct dirent *ent)
+{
+  if (ent->d_name[0] == '.' || ent->d_name[0] == '_' || ent->d_type == DT_DIR)
+  {
+    return false;
+  }
+  const char *dot = strrchr(ent->d_name, '.');
+  if (!dot || !dot[1])
+  {
+    return false;
+  }
+  const char *ext = dot + 1;
+  char e0 = tolower(ext[0]);
+  char e1 = tolower(ext[1]);
+  char e2 = tolower(ext[2]);
+  char e3 = tolower(ext[3]);
+  bool is_epu = (e0 == 'e' && e1 == 'p' && e2 == 'u' && (ext[3] == '\0'));
+  bool is_epub = (e0 == 'e' && e1 == 'p' && e2 == 'u' && e3 == 'b' && ext[4] == '\0');
+  return is_epu || is_epub;
+}
+
+bool EpubCatalog::list_books(const char *books_path, std::vector<std::string> &paths, std::vector<BookFingerprint> &fingerprints,
+                             uint32_t &dir_mtime, uint32_t &files_hash)
+{
+  std::string base_path = books_path;
+  if (!base_path.empty() && base_path.back() != '/')
+  {
+    base_path += "/";
+  }
+  struct stat st;
+  if (stat(books_path, &st) != 0)
+  {
+    return false;
+  }
+  dir_mtime = st.st_mtime;
+  // readdir order isn't fixed so the files are combined with a sum
+  files_hash = 0;
+  DIR *dir = opendir(books_path);
+  if (!dir)
+  {
+    return false;
+  }
+  paths.clear();
+  fingerprints.clear();
+  struct dirent *ent;
+  while ((ent = readdir(dir)) != nullptr)
+  {
+    if (is_epub_file(ent))
+    {
+      paths.push_back(base_path + ent->d_name);
+      // a book overwritten under the same name has to show up here too
+      BookFingerprint fingerprint = {};
+      if (stat(paths.back().c_str(), &st) == 0)
+      {
+        fingerprint.size = st.st_size;
+        fingerprint.mtime = st.st_mtime;
+      }
+      fingerprints.push_back(fingerprint);
+      uint32_t hash = fnv1a(FNV_OFFSET_BASIS, (const uint8_t *)ent->d_name, strlen(ent->d_name));
+      hash = fnv1a(hash, (const uint8_t *)&fingerprint.size, sizeof(fingerprint.size));
+      hash = fnv1a(hash, (const uint8_t *)&fingerprint.mtime, sizeof(fingerprint.mtime));
+      files_hash += hash;
+    }
+  }
+  closedir(dir);
+  return true;
+}
+
+bool EpubCatalog::matches(uint32_t dir_mtime, uint32_t files_hash, size_t count) const
+{
+  // Nothing added, removed, renamed or rewritten - the folder's mtime only has a
+  // resolution of a second or two (and FAT doesn't always update it) so the
+  // names, sizes and mtimes of the books have to match as well. Getting here
+  // without reading a record or hashing a file is what keeps opening a big
+  // library quick.
+  return m_is_open && m_header.dir_mtime == dir_mtime && m_header.files_hash == files_hash && m_header.count == count;
+}
+
+bool EpubCatalog::is_up_to_date(const char *books_path)
+{
+  std::vector<std::string> paths;
+  std::vector<BookFingerprint> fingerprints;
+  uint32_t dir_mtime = 0;
+  uint32_t files_hash = 0;
+  return list_books(books_path, paths, fingerprints, dir_mtime, files_hash) && open() && matches(dir_mtime, files_hash, paths.size());
+}
+
+bool EpubCatalog::sync(const char *books_path, const std::function<bool(const std::string &path, EpubListItem &item)> &load_book,
+                       CatalogSyncStats *stats, const std::function<bool(const EpubListItem &item)> &on_book)
+{
+  CatalogSyncStats local_stats = {};
+  if (!stats)
+  {
+    stats = &local_stats;
+  }
+  *stats = {};
+  // what's in the folder now
+  std::vector<std::string> paths;
+  std::vector<BookFingerprint> fingerprints;
+  uint32_t dir_mtime = 0;
+  uint32_t files_hash = 0;
+  if (!list_books(books_path, paths, fingerprints, dir_mtime, files_hash))
+  {
+    return false;
+  }
+  bool have_catalog = open();
+  if (matches(dir_mtime, files_hash, paths.size()))
+  {
+    stats->unchanged = m_header.count;
+    return true;
+  }
+
+  struct stat st;
+  std::unordered_map<std::string, size_t> path_index;
+  for (size_t i = 0; i < paths.size(); i++)
+  {
+    path_index[paths[i]] = i;
+  }
+  std::vector<bool> catalogued(paths.size(), false);
+
+  int last_opened = have_catalog ? m_header.last_opened : -1;
+  std::string last_opened_path;
+  EpubListItem last_opened_item;
+  if (last_opened >= 0 && read(last_opened, last_opened_item))
+  {
+    last_opened_path = last_opened_item.path;
+  }
+  int last_opened_record = -1;
+
+  // books that have gone - they may turn up again under a new name
+  std::vector<CatalogRecord> missing;
+  // the old catalog stays where it is until the new one is finished
+  EpubCatalog old_catalog;
+  old_catalog.set_path(m_path);
+  bool have_old = have_catalog && old_catalog.open();
+  if (!begin_build())
+  {
+    return false;
+  }
+  // set if on_book asks us to stop
+  bool stopped = false;
+  auto add_book = [&](const CatalogRecord &record)
+  {
+    int number = add(record.item, record.fingerprint);
+    if (!last_opened_path.empty() && last_opened_path == record.item.path)
+    {
+      last_opened_record = number;
+    }
+    stopped = on_book && !on_book(record.item);
+    return !stopped;
+  };
+  if (have_old)
+  {
+    old_catalog.for_each_record([&](const CatalogRecord &old_record)
+                                {
+      auto found = path_index.find(old_record.item.path);
+      if (found == path_index.end() || catalogued[found->second])
+      {
+        missing.push_back(old_record);
+        return true;
+      }
+      size_t i = found->second;
+      catalogued[i] = true;
+      CatalogRecord record = old_record;
+      if (record.fingerprint.size == fingerprints[i].size && record.fingerprint.mtime == fingerprints[i].mtime)
+      {
+        stats->unchanged++;
+        return add_book(record);
+      }
+      // copying a folder of books about changes the mtimes but not what's in them
+      fingerprints[i].hash = hash_file(paths[i].c_str(), fingerprints[i].size);
+      if (record.fingerprint.size == fingerprints[i].size && record.fingerprint.hash == fingerprints[i].hash)
+      {
+        record.fingerprint = fingerprints[i];
+        stats->unchanged++;
+        return add_book(record);
+      }
+      // a different book (or edition) - it starts from the beginning again
+      record = {};
+      if (load_book(paths[i], record.item))
+      {
+        record.fingerprint = fingerprints[i];
+        stats->changed++;
+        if (!add_book(record))
+        {
+          return false;
+        }
+      }
+      vTaskDelay(1);
+      return true; });
+  }
+  for (size_t i = 0; i < paths.size() && !stopped; i++)
+  {
+    if (catalogued[i])
+    {
+      continue;
+    }
+    fingerprints[i].hash = hash_file(paths[i].c_str(), fingerprints[i].size);
+    // a book we already know that's been renamed keeps its details and position
+    auto renamed = std::find_if(missing.begin(), missing.end(), [&](const CatalogRecord &record)
+                                { return record.fingerprint.size == fingerprints[i].size && record.fingerprint.hash == fingerprints[i].hash; });
+    CatalogRecord record = {};
+    if (renamed != missing.end())
+    {
+      record = *renamed;
+      missing.erase(renamed);
+      if (last_opened_path == record.item.path)
+      {
+        last_opened_path = paths[i];
+      }
+      strncpy(record.item.path, paths[i].c_str(), MAX_PATH_SIZE - 1);
+      record.item.path[MAX_PATH_SIZE - 1] = '\0';
+      stats->renamed++;
+    }
+    else if (load_book(paths[i], record.item))
+    {
+      stats->added++;
+    }
+    else
+    {
+      ESP_LOGE(TAG, "Failed to load epub %s", paths[i].c_str());
+      continue;
+    }
+    record.fingerprint = fingerprints[i];
+    add_book(record);
+    vTaskDelay(1);
+  }
+  if (stopped)
+  {
+    ESP_LOGI(TAG, "Sync of %s stopped - keeping the old catalog", books_path);
+    abandon_build();
+    return false;
+  }
+  stats->removed = missing.size();
+  stats->rewritten = true;
+  ESP_LOGI(TAG, "Synced %s: %d unchanged, %d added, %d changed, %d renamed, %d removed", books_path,
+           stats->unchanged, stats->added, stats->changed, stats->renamed, stats->removed);
+  if (!finish_build(last_opened_record))
+  {
+    return false;
+  }
+  // writing the catalog into the books folder has just changed its mtime
+  FILE *fp = fopen(m_path.c_str(), "r+b");
+  if (!fp)
+  {
+    return false;
+  }
+  m_header.dir_mtime = stat(books_path, &st) == 0 ? st.st_mtime : 0;
+  m_header.files_hash = files_hash;
+  bool ok = write_header(fp);
+  fclose(fp);
+  return ok;
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <functional>
+#include "State.h"
+
+// enough to tell whether a book file has changed since it was catalogued
+struct BookFingerprint
+{
+  uint32_t size;
+  uint32_t mtime;
+  // hash of the start and end of the file (see EpubCatalog::hash_file)
+  uint32_t hash;
+};
+
+struct CatalogRecord
+{
+  EpubListItem item;
+  BookFingerprint fingerprint;
+};
+
+// what a sync had to do
+struct CatalogSyncStats
+{
+  int unchanged;
+  int added;
+  int changed;
+  int renamed;
+  int removed;
+  // false if the catalog was already up to date and wasn't touched
+  bool rewritten;
+};
+
+// The library catalog on the SD card. Books are stored as fixed-size
+// EpubListItem records in the order they were found, followed by a table of
+// record numbers sorted by title. The library only ever reads the page of
+// records it is showing, so opening it costs the same however many books
+// there are.
+//
+// Each record carries the size, mtime and a hash of its file so a rescan
+// only has to parse the books that are new or have changed.
+//
+// File format:
+//   CatalogHeader
+//   count * CatalogRecord records
+//   count * uint32_t record numbers in title order (at table_offset)
+class EpubCatalog
+{
+private:
+  struct CatalogHeader
+  {
+    uint32_t magic;
+    uint16_t version;
+    // sizeof(CatalogRecord) when the catalog was written - anything else is stale
+    uint16_t record_size;
+    uint32_t count;
+    uint32_t table_offset;
+    // index (in title order) of the last book that was read, -1 for none
+    int32_t last_opened;
+    // mtime of the books folder when the catalog was written
+    uint32_t dir_mtime;
+    // of the names, sizes and mtimes of the books in the folder, in any order
+    uint32_t files_hash;
+  };
+
+  std::string m_path;
+  CatalogHeader m_header = {};
+  bool m_is_open = false;
+
+  // only used while building
+  struct BuildEntry
+  {
+    std::string title;
+    uint32_t record;
+  };
+  FILE *m_build_fp = nullptr;
+  std::vector<BuildEntry> m_build_entries;
+
+  long record_offset(uint32_t record) const;
+  bool read_record_numbers(FILE *fp, int first, int count, uint32_t *records);
+  bool write_header(FILE *fp);
+  // the catalog is built here and renamed over the real one when it's finished
+  std::string get_build_path() const;
+  // call fn for every record in the order they are stored - stops early if fn returns false
+  bool for_each_record(const std::function<bool(const CatalogRecord &)> &fn);
+  // the EPUB files in books_path with their sizes and mtimes, the folder's mtime and a hash of all of them
+  static bool list_books(const char *books_path, std::vector<std::string> &paths, std::vector<BookFingerprint> &fingerprints,
+                         uint32_t &dir_mtime, uint32_t &files_hash);
+  // the catalog was written for a folder that looked like this
+  bool matches(uint32_t dir_mtime, uint32_t files_hash, size_t count) const;
+
+public:
+  EpubCatalog() {}
+  ~EpubCatalog();
+  EpubCatalog(const EpubCatalog &) = delete;
+  EpubCatalog &operator=(const EpubCatalog &) = delete;
+
+  void set_path(const std::string &path) { m_path = path; }
+  const std::string &get_path() const { return m_path; }
+  // read the header - false if the catalog is missing, unfinished or was written by an incompatible version
+  bool open();
+  bool is_open() const { return m_is_open; }
+  int get_count() const { return m_is_open ? m_header.count : 0; }
+
+  // read count books starting at first (in title order) - returns how many were read
+  int read_page(int first, int count, std::vector<EpubListItem> &items);
+  bool read(int index, EpubListItem &item);
+  // write the reading position of the book back to its record
+  bool write_position(int index, const EpubListItem &item);
+  int get_last_opened() const { return m_is_open ? m_header.last_opened : -1; }
+  bool set_last_opened(int index);
+  // index (in title order) of the book at path, -1 if it isn't in the catalog
+  int find(const char *path);
+
+  // Bring the catalog up to date with the EPUB files in books_path. load_book
+  // is only called for books that are new or have changed - books that are
+  // unchanged or have just been renamed keep their details and reading
+  // position. on_book is called for each book as it goes into the new catalog - returning
+  // false stops the sync and leaves the old catalog as it was. Returns false if the folder
+  // can't be read, the catalog can't be written or the sync was stopped.
+  bool sync(const char *books_path, const std::function<bool(const std::string &path, EpubListItem &item)> &load_book,
+            CatalogSyncStats *stats = nullptr, const std::function<bool(const EpubListItem &item)> &on_book = nullptr);
+  // true if the catalog is there and nothing has been added, removed or renamed since it was written - sync has nothing to do
+  bool is_up_to_date(const char *books_path);
+  // FNV-1a of the first and last few KB - the end of an EPUB is the zip's central directory
+  static uint32_t hash_file(const char *path, uint32_t size);
+
+  // replace the catalog - add each book and then finish to sort and write the title table.
+  // add returns the record number of the book.
+  bool begin_build();
+  int add(const EpubListItem &item, const BookFingerprint &fingerprint = {});
+  // last_opened_record is the record number of the book to remember as the last one read
+  bool finish_build(int last_opened_record = -1);
+  // throw away the catalog being built
+  void abandon_build();
+};
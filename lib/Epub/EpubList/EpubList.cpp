@@ -1,4 +1,6 @@
 #include "EpubList.h"
+#include "CoverThumbnail.h"
+#include "../Renderer/ImageProbe.h"
 
 #include <ctype.h>
 #include <stdio.h>
@@ -13,6 +15,7 @@
 #else
   #define vTaskDelay(t)
   #define ESP_LOGE(args...)
+  #define ESP_LOGW(args...)
   #define ESP_LOGI(args...)
   #define ESP_LOGD(args...)
 #endif
@@ -22,6 +25,10 @@ static const char *TAG = "PUBLIST";
 #define PADDING 20
 #define EPUBS_PER_PAGE 5
 
+// cover thumbnails sit next to the raw cover in the cache folder - one for each view
+static const char *GRID_THUMBNAIL_EXTENSION = ".g4";
+static const char *LIST_THUMBNAIL_EXTENSION = ".l4";
+
 void EpubList::next()
 {
   if (state.num_epubs == 0)
@@ -42,184 +49,573 @@ void EpubList::prev()
 
 bool EpubList::load(const char *path)
 {
-  if (state.is_loaded)
+  // normalise the base path for epub files so we can support
+  // directories like /fs/Books as well as the root /fs/.
+  std::string base_path = path;
+  if (!base_path.empty() && base_path.back() != '/')
+  {
+    base_path += "/";
+  }
+  // Use an 8.3-safe filename so the FAT implementation can always create it.
+  m_catalog.set_path(base_path + "BOOKS.CAT");
+  if (m_scanner)
+  {
+    // still scanning - the library fills itself in
+    return true;
+  }
+  if (state.is_loaded && m_catalog.open() && m_catalog.get_count() == state.num_epubs)
   {
     ESP_LOGD(TAG, "Already loaded books");
     return true;
   }
-  // Use an 8.3-safe filename so the FAT implementation can always create it.
-  const char *index_path = "/fs/Books/BOOKS.IDX";
-  if (load_index(path, index_path))
+  m_page_first = -1;
+  DIR *dir = opendir(path);
+  if (!dir)
+  {
+    show_no_sd_card(path);
+    return false;
+  }
+  closedir(dir);
+  ensure_cache_dir();
+  bool have_catalog = m_catalog.open();
+  // anything the sync doesn't have to look at again keeps its position so save ours first
+  if (have_catalog)
   {
-    ESP_LOGI(TAG, "Loaded EPUB index from %s", index_path);
+    save_current_book();
+  }
+  if (have_catalog && m_catalog.is_up_to_date(path))
+  {
+    ESP_LOGI(TAG, "Loaded EPUB catalog from %s", m_catalog.get_path().c_str());
+    return finish_loading(path);
+  }
+  // opening every new book takes a while - do it in the background if we can
+  Renderer *scan_renderer = renderer->create_measuring_renderer();
+  if (scan_renderer)
+  {
+    start_scan(path, scan_renderer);
     return true;
   }
-  renderer->show_busy();
+  // only the books that are new or have changed get opened
+  bool shown_busy = false;
+  CatalogSyncStats stats;
+  bool synced = m_catalog.sync(path, [&](const std::string &book_path, EpubListItem &item)
+                               {
+    if (!shown_busy)
+    {
+      renderer->show_busy();
+      shown_busy = true;
+    }
+    if (!load_book(renderer, book_path, item))
+    {
+      return false;
+    }
+    make_thumbnails(renderer, item);
+    return true; }, &stats);
+  if (!synced)
+  {
+    state.num_epubs = 0;
+    return false;
+  }
+  if (stats.rewritten)
+  {
+    // indexes into the old catalog don't mean anything now
+    state.has_current_book = false;
+  }
+  return finish_loading(path);
+}
+
+bool EpubList::finish_loading(const char *path)
+{
+  state.num_epubs = m_catalog.get_count();
   // trigger a proper redraw
   state.previous_rendered_page = -1;
-  // read in the list of epubs
-  state.num_epubs = 0;
-  // normalise the base path for epub files so we can support
-  // directories like /fs/Books as well as the root /fs/.
-  std::string base_path = path;
-  if (!base_path.empty() && base_path.back() != '/')
+  state.previous_selected_item = -1;
+  // sanity check our state
+  if (state.selected_item >= state.num_epubs)
   {
-    base_path += "/";
+    state.selected_item = 0;
   }
-  DIR *dir;
-  struct dirent *ent;
-  if ((dir = opendir(path)) != nullptr)
+  if (state.has_current_book && state.current_book_index >= state.num_epubs)
   {
-    while ((ent = readdir(dir)) != nullptr)
+    state.has_current_book = false;
+  }
+  ESP_LOGI(TAG, "Loaded %d EPUBs from %s", state.num_epubs, path);
+  state.is_loaded = true;
+  return true;
+}
+
+void EpubList::start_scan(const char *path, Renderer *scan_renderer)
+{
+  // the book that was being read is available straight away as the first book found
+  EpubListItem last_book;
+  int last_opened = m_catalog.get_last_opened();
+  m_scan_has_last_book = last_opened >= 0 && m_catalog.read(last_opened, last_book);
+  // until the scan is done books are numbered in the order they were found
+  state.has_current_book = false;
+  state.selected_item = 0;
+  state.previous_rendered_page = -1;
+  state.previous_selected_item = -1;
+  state.is_loaded = false;
+  m_scan_path = path;
+  m_scan_book_index = -1;
+  m_scanner = std::unique_ptr<LibraryScanner>(new LibraryScanner(
+      m_catalog.get_path(), path, scan_renderer,
+      [](Renderer *scan_renderer, const std::string &book_path, EpubListItem &item)
+      { return load_book(scan_renderer, book_path, item); },
+      [](Renderer *scan_renderer, const EpubListItem &item)
+      { make_thumbnails(scan_renderer, item); },
+      m_scan_has_last_book ? &last_book : nullptr));
+  m_scan_catalog_ready = false;
+  state.num_epubs = m_scanner->get_book_count();
+  ESP_LOGI(TAG, "Scanning %s in the background", path);
+}
+
+void EpubList::stop_scan()
+{
+  if (!m_scanner)
+  {
+    return;
+  }
+  m_scanner->stop();
+  m_scanner->wait_until_finished();
+  // picks up the catalog if it was written before we stopped
+  update_scan(false);
+  m_scanner.reset();
+}
+
+bool EpubList::finish_scan_catalog(bool catalog_ok)
+{
+  m_scan_catalog_ready = true;
+  // the books were numbered in the order they were found - find the ones we're using in the catalog
+  std::string selected_path;
+  int selected_in_page = state.selected_item - m_page_first;
+  if (m_page_first >= 0 && selected_in_page >= 0 && selected_in_page < (int)m_page_items.size())
+  {
+    selected_path = m_page_items[selected_in_page].path;
+  }
+  m_scan_has_last_book = false;
+  m_page_first = -1;
+  clear_title_blocks();
+  if (!m_catalog.open())
+  {
+    // stopped before there was ever a catalog
+    state.num_epubs = 0;
+    state.has_current_book = false;
+    state.previous_rendered_page = -1;
+    return true;
+  }
+  if (!catalog_ok)
+  {
+    ESP_LOGE(TAG, "Library scan didn't finish - using the catalog we had");
+  }
+  int selected_index = selected_path.empty() ? -1 : m_catalog.find(selected_path.c_str());
+  state.selected_item = std::max(0, selected_index);
+  if (state.has_current_book)
+  {
+    state.current_book_index = m_catalog.find(state.current_book.path);
+    state.has_current_book = state.current_book_index >= 0;
+    // it may have been read while we were scanning
+    save_current_book();
+  }
+  m_scan_book_index = -1;
+  return finish_loading(m_scan_path.c_str());
+}
+
+bool EpubList::update_scan(bool on_screen)
+{
+  if (!m_scanner)
+  {
+    return false;
+  }
+  LibraryScanUpdate update = m_scanner->take_update();
+  bool reordered = false;
+  std::vector<int> changed;
+  int items_per_page = get_items_per_page();
+  int page_first = (state.selected_item / items_per_page) * items_per_page;
+  if (!m_scan_catalog_ready && update.catalog_ready)
+  {
+    reordered = finish_scan_catalog(update.catalog_ok);
+  }
+  else if (!m_scan_catalog_ready && update.books != state.num_epubs)
+  {
+    // new books on the page we're showing are drawn as title cards
+    for (int i = std::max(state.num_epubs, page_first); i < update.books && i < page_first + items_per_page; i++)
+    {
+      changed.push_back(i - page_first);
+    }
+    state.num_epubs = update.books;
+    m_bottom_bar_changed = true;
+  }
+  if (!reordered)
+  {
+    // swap title cards for covers that are ready
+    for (auto &path : update.covers_ready)
     {
-      ESP_LOGD(TAG, "Found file: %s", ent->d_name);
-      // ignore any hidden files starting with "." and any directories
-      // Also ignore files starting with '_' which on macOS FAT volumes are
-      // typically AppleDouble metadata (e.g. "_THEGR~6.EPU").
-      if (ent->d_name[0] == '.' || ent->d_name[0] == '_' || ent->d_type == DT_DIR)
+      for (int i = 0; i < (int)m_page_items.size(); i++)
       {
-        continue;
+        if (m_page_first == page_first && path == m_page_items[i].path)
+        {
+          changed.push_back(i);
+        }
       }
+    }
+  }
+  if (update.finished)
+  {
+    m_scanner.reset();
+  }
+  if (on_screen && !reordered && (!changed.empty() || m_bottom_bar_changed))
+  {
+    // everything on the page is drawn again (they're thumbnails and title cards so that's quick) but only what changed is sent to the display
+    m_redraw_items = true;
+    render();
+    for (int index_in_page : changed)
+    {
+      int x, y, width, height;
+      get_item_rect(index_in_page, x, y, width, height);
+      renderer->flush_area(x, y, width, height);
+    }
+    if (m_bottom_bar_changed)
+    {
+      int bar_height = EPUB_LIST_BOTTOM_BAR_HEIGHT;
+      renderer->flush_area(0, renderer->get_page_height() - bar_height, renderer->get_page_width(), bar_height);
+      m_bottom_bar_changed = false;
+    }
+  }
+  return reordered;
+}
 
-      const char *dot = strrchr(ent->d_name, '.');
-      if (!dot || !dot[1])
-      {
-        continue;
-      }
-      const char *ext = dot + 1;
-      // Accept "epub" and also the 8.3 short-name variant "epu" (case-insensitive)
-      char e0 = tolower(ext[0]);
-      char e1 = tolower(ext[1]);
-      char e2 = tolower(ext[2]);
-      char e3 = tolower(ext[3]);
-      bool is_epu = (e0 == 'e' && e1 == 'p' && e2 == 'u' && (ext[3] == '\0'));
-      bool is_epub = (e0 == 'e' && e1 == 'p' && e2 == 'u' && e3 == 'b' && ext[4] == '\0');
-      if (!is_epu && !is_epub)
-      {
-        continue;
-      }
-      ESP_LOGD(TAG, "Loading epub %s", ent->d_name);
-      Epub *epub = new Epub(base_path + ent->d_name);
-      if (epub->load())
+bool EpubList::load_book(Renderer *renderer, const std::string &path, EpubListItem &item)
+{
+  ESP_LOGD(TAG, "Loading epub %s", path.c_str());
+  Epub *epub = new Epub(path);
+  if (!epub->load())
+  {
+    delete epub;
+    return false;
+  }
+  item = {};
+  strncpy(item.path, epub->get_path().c_str(), MAX_PATH_SIZE - 1);
+  strncpy(item.title, replace_html_entities(epub->get_title()).c_str(), MAX_TITLE_SIZE - 1);
+  const std::string &cover_item = epub->get_cover_image_item();
+  if (!cover_item.empty())
+  {
+    // Copy the declared cover path into the catalog, then
+    // validate that the image can actually be decoded. If anything
+    // about the cover is invalid (missing resource, corrupt data,
+    // or nonsensical dimensions), treat it as "no cover" so the
+    // UI will render a safe title-only card instead of attempting
+    // to draw a bad image later in the grid/list or sleep cover.
+    strncpy(item.cover_path, cover_item.c_str(), MAX_PATH_SIZE - 1);
+
+    // the header is enough to know the size and whether we can decode it - no need to inflate the whole image
+    ImageHeader cover_header;
+    bool valid_cover = false;
+    if (epub->get_item_image_header(cover_item, &cover_header) && cover_header.decodable)
+    {
+      int cw = cover_header.width;
+      int ch = cover_header.height;
+      // Reject covers that are implausibly large relative to the
+      // device resolution. Extremely high-resolution or corrupt
+      // images can cause slow, oversized rendering in the grid.
+      int page_w = renderer->get_page_width();
+      int page_h = renderer->get_page_height();
+      int max_dim = std::max(page_w, page_h);
+      if (max_dim <= 0)
       {
-        strncpy(state.epub_list[state.num_epubs].path, epub->get_path().c_str(), MAX_PATH_SIZE);
-        strncpy(state.epub_list[state.num_epubs].title, replace_html_entities(epub->get_title()).c_str(), MAX_TITLE_SIZE);
-        const std::string &cover_item = epub->get_cover_image_item();
-        if (!cover_item.empty())
-        {
-          // Copy the declared cover path into the persisted state, then
-          // validate that the image can actually be decoded. If anything
-          // about the cover is invalid (missing resource, corrupt data,
-          // or nonsensical dimensions), treat it as "no cover" so the
-          // UI will render a safe title-only card instead of attempting
-          // to draw a bad image later in the grid/list or sleep cover.
-          strncpy(state.epub_list[state.num_epubs].cover_path, cover_item.c_str(), MAX_PATH_SIZE);
-          state.epub_list[state.num_epubs].cover_path[MAX_PATH_SIZE - 1] = '\0';
-
-          size_t cover_data_size = 0;
-          uint8_t *cover_data = epub->get_item_contents(cover_item, &cover_data_size);
-          bool valid_cover = false;
-          if (cover_data && cover_data_size > 0)
-          {
-            int cw = 0;
-            int ch = 0;
-            if (renderer->get_image_size(cover_item, cover_data, cover_data_size, &cw, &ch) && cw > 0 && ch > 0)
-            {
-              // Reject covers that are implausibly large relative to the
-              // device resolution. Extremely high-resolution or corrupt
-              // images can cause slow, oversized rendering in the grid.
-              int page_w = renderer->get_page_width();
-              int page_h = renderer->get_page_height();
-              int max_dim = std::max(page_w, page_h);
-              if (max_dim <= 0)
-              {
-                max_dim = 4000; // conservative upper bound
-              }
-              int max_allowed = max_dim * 4; // allow up to 4x screen size
-              if (cw <= max_allowed && ch <= max_allowed)
-              {
-                valid_cover = true;
-              }
-            }
-          }
-          if (!valid_cover)
-          {
-            ESP_LOGW(TAG, "Invalid cover for '%s', using title-only card instead", state.epub_list[state.num_epubs].title);
-            state.epub_list[state.num_epubs].cover_path[0] = '\0';
-          }
-          free(cover_data);
-        }
-        else
-        {
-          state.epub_list[state.num_epubs].cover_path[0] = '\0';
-        }
-        state.num_epubs++;
-        if (state.num_epubs == MAX_EPUB_LIST_SIZE)
-        {
-          ESP_LOGE(TAG, "Too many epubs, max is %d", MAX_EPUB_LIST_SIZE);
-          break;
-        }
+        max_dim = 4000; // conservative upper bound
       }
-      else
+      int max_allowed = max_dim * 4; // allow up to 4x screen size
+      if (cw <= max_allowed && ch <= max_allowed)
       {
-        ESP_LOGE(TAG, "Failed to load epub %s", ent->d_name);
+        valid_cover = true;
       }
-      delete epub;
     }
-    closedir(dir);
-    std::ranges::sort(std::span(state.epub_list, state.num_epubs),
-        [](const EpubListItem &a, const EpubListItem &b)
-        {
-          return strcmp(a.title, b.title) < 0;
-        });
+    if (!valid_cover)
+    {
+      ESP_LOGW(TAG, "Invalid cover for '%s', using title-only card instead", item.title);
+      item.cover_path[0] = '\0';
+    }
   }
-  else
+  delete epub;
+  return true;
+}
+
+void EpubList::make_thumbnails(Renderer *renderer, const EpubListItem &item)
+{
+  if (item.cover_path[0] == '\0')
+  {
+    return;
+  }
+  // decode the cover now, while we're scanning, so showing the library doesn't have to
+  std::vector<uint8_t> cover;
+  if (!read_cached_cover(item, cover))
+  {
+    return;
+  }
+  std::vector<uint8_t> packed;
+  int width = 0;
+  int height = 0;
+  get_grid_cover_size(renderer, width, height);
+  CoverThumbnail::create(renderer, get_cache_path(item.path, GRID_THUMBNAIL_EXTENSION), item.cover_path, cover.data(), cover.size(), width, height, packed);
+  get_list_cover_size(renderer, width, height);
+  CoverThumbnail::create(renderer, get_cache_path(item.path, LIST_THUMBNAIL_EXTENSION), item.cover_path, cover.data(), cover.size(), width, height, packed);
+}
+
+int EpubList::get_content_height(Renderer *renderer)
+{
+  int page_height = renderer->get_page_height();
+  int bottom_bar_height = EPUB_LIST_BOTTOM_BAR_HEIGHT;
+  if (bottom_bar_height > 0 && bottom_bar_height < page_height)
+  {
+    return page_height - bottom_bar_height;
+  }
+  return page_height;
+}
+
+void EpubList::get_grid_cover_size(Renderer *renderer, int &width, int &height)
+{
+  int cell_width = renderer->get_page_width() / EPUB_GRID_COLUMNS;
+  int cell_height = get_content_height(renderer) / EPUB_GRID_ROWS;
+  height = std::max(1, cell_height - PADDING * 2);
+  width = 2 * height / 3;
+  if (width > cell_width - PADDING * 2)
+  {
+    width = cell_width - PADDING * 2;
+  }
+}
+
+void EpubList::get_list_cover_size(Renderer *renderer, int &width, int &height)
+{
+  int cell_height = get_content_height(renderer) / EPUB_LIST_ITEMS_PER_PAGE;
+  height = cell_height - PADDING * 2;
+  width = 2 * height / 3;
+}
+
+bool EpubList::read_cached_cover(const EpubListItem &item, std::vector<uint8_t> &cover)
+{
+  std::string cache_path = get_cache_path(item.path);
+  FILE *f = fopen(cache_path.c_str(), "rb");
+  if (f)
+  {
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    cover.resize(size > 0 ? size : 0);
+    bool ok = size > 0 && fread(cover.data(), 1, size, f) == (size_t)size;
+    fclose(f);
+    if (ok)
+    {
+      return true;
+    }
+  }
+  // not cached - get it out of the book and keep it for next time
+  Epub epub(item.path);
+  cover = epub.get_item_contents_as_vector(item.cover_path);
+  write_cached_cover(item.path, cover);
+  return !cover.empty();
+}
+
+void EpubList::write_cached_cover(const char *epub_path, const std::vector<uint8_t> &cover)
+{
+  if (cover.empty())
+  {
+    return;
+  }
+  FILE *f = fopen(get_cache_path(epub_path).c_str(), "wb");
+  if (f)
+  {
+    fwrite(cover.data(), 1, cover.size(), f);
+    fclose(f);
+  }
+}
+
+bool EpubList::draw_cover(const EpubListItem &item, const char *extension, int x, int y, int width, int height)
+{
+  if (item.cover_path[0] == '\0' || width <= 0 || height <= 0)
   {
-    renderer->clear_screen();
-    uint16_t y = renderer->get_page_height()/2-80;
-    renderer->show_img(18, y+41, warning_width, warning_height, warning_data);
-    const char * warning = "Please insert SD Card";
-    renderer->draw_rect(1, y, renderer->get_text_width(warning, true, false)+150, 115, 80);
-    renderer->draw_text_box(warning, warning_width+25, y+4, renderer->get_page_width(), 80, true, false);
-    renderer->draw_text_box("Restarting in 10 secs.", warning_width+25, y+34, renderer->get_page_width(), 80, false, false);
-    perror("");
-    renderer->flush_display();
-    ESP_LOGE(TAG, "Is SD-Card inserted and properly connected?\nCould not open directory %s", path);
-    #ifndef UNIT_TEST
-      vTaskDelay(pdMS_TO_TICKS(1000*10));
-      esp_restart();
-    #endif
-    
     return false;
   }
-  // sanity check our state
-  if (state.selected_item >= state.num_epubs)
+  if (m_scanner && m_scanner->is_cover_pending(item.path))
   {
-    state.selected_item = 0;
-    state.previous_rendered_page = -1;
-    state.previous_selected_item = -1;
+    // the scan is still making it - a title card until it's ready
+    return false;
   }
-  ESP_LOGI(TAG, "Loaded %d EPUBs from %s", state.num_epubs, path);
-  state.is_loaded = true;
-  // prepare title layout cache
-  // ensure the title blocks vector has an entry for each epub; layout will
-  // be performed lazily on first render for each item.
-  // (We avoid storing pointers in RTC state; this cache is per-session only.)
-  // Note: MAX_EPUB_LIST_SIZE is small (20), so this is safe.
-  extern EpubListState epub_list_state; // declaration elsewhere; we use state directly here
-  (void)epub_list_state;
-  // ensure capacity but leave pointers null for lazy init
-  // m_title_blocks is a member of EpubList; here we just size it
-  // to match the number of epubs.
-  // Any existing blocks (if reload ever happens) are left as-is for indices < num_epubs.
-  if (m_title_blocks.size() < static_cast<size_t>(state.num_epubs))
-  {
-    m_title_blocks.resize(state.num_epubs, nullptr);
-  }
-  save_index(index_path);
+  std::string thumbnail_path = get_cache_path(item.path, extension);
+  std::vector<uint8_t> packed;
+  if (!CoverThumbnail::load(thumbnail_path, width, height, packed))
+  {
+    // first time we've seen this book or the layout has changed since the thumbnail was made
+    ESP_LOGI(TAG, "Making a %dx%d thumbnail for %s", width, height, item.path);
+    std::vector<uint8_t> cover;
+    if (!read_cached_cover(item, cover) ||
+        !CoverThumbnail::create(renderer, thumbnail_path, item.cover_path, cover.data(), cover.size(), width, height, packed))
+    {
+      return false;
+    }
+  }
+  renderer->draw_packed_gray(x, y, width, height, packed.data());
   return true;
 }
 
+void EpubList::show_no_sd_card(const char *path)
+{
+  renderer->clear_screen();
+  uint16_t y = renderer->get_page_height()/2-80;
+  renderer->show_img(18, y+41, warning_width, warning_height, warning_data);
+  const char * warning = "Please insert SD Card";
+  renderer->draw_rect(1, y, renderer->get_text_width(warning, true, false)+150, 115, 80);
+  renderer->draw_text_box(warning, warning_width+25, y+4, renderer->get_page_width(), 80, true, false);
+  renderer->draw_text_box("Restarting in 10 secs.", warning_width+25, y+34, renderer->get_page_width(), 80, false, false);
+  perror("");
+  renderer->flush_display();
+  ESP_LOGE(TAG, "Is SD-Card inserted and properly connected?\nCould not open directory %s", path);
+  #ifndef UNIT_TEST
+    vTaskDelay(pdMS_TO_TICKS(1000*10));
+    esp_restart();
+  #endif
+}
+
+void EpubList::load_page(int first, int count)
+{
+  int expected = std::max(0, std::min(count, state.num_epubs - first));
+  if (first == m_page_first && (int)m_page_items.size() == expected)
+  {
+    return;
+  }
+  clear_title_blocks();
+  if (is_reading_scan())
+  {
+    m_scanner->read_page(first, count, m_page_items);
+  }
+  else
+  {
+    m_catalog.read_page(first, count, m_page_items);
+  }
+  m_page_first = first;
+  m_title_blocks.assign(m_page_items.size(), nullptr);
+}
+
+void EpubList::clear_title_blocks()
+{
+  for (auto *block : m_title_blocks)
+  {
+    delete block;
+  }
+  m_title_blocks.clear();
+}
+
+bool EpubList::select_book(int index)
+{
+  if (is_reading_scan())
+  {
+    // only numbered in the order they were found - the book gets its catalog index when the scan is done
+    if (state.has_current_book && m_scan_book_index == index)
+    {
+      return true;
+    }
+    save_current_book();
+    EpubListItem item;
+    if (!m_scanner->read(index, item))
+    {
+      ESP_LOGE(TAG, "Failed to read book %d from the scan", index);
+      return false;
+    }
+    state.current_book = item;
+    state.current_book_index = -1;
+    state.has_current_book = true;
+    m_scan_book_index = index;
+    return true;
+  }
+  if (state.has_current_book && state.current_book_index == index)
+  {
+    return true;
+  }
+  save_current_book();
+  EpubListItem item;
+  if (!m_catalog.read(index, item))
+  {
+    ESP_LOGE(TAG, "Failed to read book %d from the catalog", index);
+    return false;
+  }
+  state.current_book = item;
+  state.current_book_index = index;
+  state.has_current_book = true;
+  return true;
+}
+
+void EpubList::save_current_book()
+{
+  if (!state.has_current_book)
+  {
+    return;
+  }
+  if (is_reading_scan())
+  {
+    m_scanner->set_position(state.current_book);
+    int page_index = m_scan_book_index - m_page_first;
+    if (m_page_first >= 0 && page_index >= 0 && page_index < (int)m_page_items.size())
+    {
+      m_page_items[page_index] = state.current_book;
+    }
+    return;
+  }
+  if (state.current_book_index < 0)
+  {
+    state.current_book_index = m_catalog.find(state.current_book.path);
+    if (state.current_book_index < 0)
+    {
+      ESP_LOGE(TAG, "%s isn't in the catalog", state.current_book.path);
+      state.has_current_book = false;
+      return;
+    }
+  }
+  m_catalog.write_position(state.current_book_index, state.current_book);
+  m_catalog.set_last_opened(state.current_book_index);
+  // keep the page we're showing in step
+  int page_index = state.current_book_index - m_page_first;
+  if (m_page_first >= 0 && page_index >= 0 && page_index < (int)m_page_items.size())
+  {
+    m_page_items[page_index] = state.current_book;
+  }
+}
+
+int EpubList::get_last_opened()
+{
+  if (is_reading_scan())
+  {
+    // the book that was being read is published first
+    return m_scan_has_last_book ? 0 : -1;
+  }
+  return m_catalog.get_last_opened();
+}
+
+int EpubList::get_items_per_page()
+{
+  int items_per_page = state.use_grid_view ? (EPUB_GRID_ROWS * EPUB_GRID_COLUMNS) : EPUB_LIST_ITEMS_PER_PAGE;
+  return std::max(1, items_per_page);
+}
+
+void EpubList::get_item_rect(int index_in_page, int &x, int &y, int &width, int &height)
+{
+  int page_width = renderer->get_page_width();
+  int content_height = get_content_height(renderer);
+  if (state.use_grid_view)
+  {
+    width = page_width / EPUB_GRID_COLUMNS;
+    height = content_height / EPUB_GRID_ROWS;
+    x = (index_in_page % EPUB_GRID_COLUMNS) * width;
+    y = (index_in_page / EPUB_GRID_COLUMNS) * height;
+  }
+  else
+  {
+    width = page_width;
+    height = content_height / EPUB_LIST_ITEMS_PER_PAGE;
+    x = 0;
+    y = index_in_page * height;
+  }
+}
+
 void EpubList::render()
 {
   ESP_LOGD(TAG, "Rendering EPUB list");
@@ -233,17 +629,9 @@ void EpubList::render()
   ensure_cache_dir();
 
   int bottom_bar_height = EPUB_LIST_BOTTOM_BAR_HEIGHT;
-  int content_height = page_height;
-  if (bottom_bar_height > 0 && bottom_bar_height < page_height)
-  {
-    content_height = page_height - bottom_bar_height;
-  }
+  int content_height = get_content_height(renderer);
 
-  int items_per_page = state.use_grid_view ? (EPUB_GRID_ROWS * EPUB_GRID_COLUMNS) : EPUB_LIST_ITEMS_PER_PAGE;
-  if (items_per_page <= 0)
-  {
-    items_per_page = 1;
-  }
+  int items_per_page = get_items_per_page();
 
   // what page are we on?
   int current_page = 0;
@@ -265,110 +653,45 @@ void EpubList::render()
 
   int start_index = current_page * items_per_page;
 
-  if (m_title_blocks.size() < static_cast<size_t>(state.num_epubs))
+  // only the books on this page are read from the catalog
+  load_page(start_index, items_per_page);
+
+  // books turning up or covers being made during a scan - the page is drawn again over itself
+  bool draw_items = current_page != state.previous_rendered_page;
+  if (m_redraw_items && !draw_items)
   {
-    m_title_blocks.resize(state.num_epubs, nullptr);
+    draw_items = true;
+    renderer->fill_rect(0, 0, page_width, content_height, 255);
+    state.previous_selected_item = -1;
   }
+  m_redraw_items = false;
 
   if (state.use_grid_view)
   {
     int cell_width = page_width / EPUB_GRID_COLUMNS;
     int cell_height = content_height / EPUB_GRID_ROWS;
     ESP_LOGD(TAG, "Grid cell size is %dx%d", cell_width, cell_height);
-    int end_index = std::min(start_index + items_per_page, state.num_epubs);
+    int end_index = start_index + m_page_items.size();
     for (int i : std::views::iota(start_index, end_index))
     {
       int index_in_page = i - start_index;
+      const EpubListItem &item = m_page_items[index_in_page];
       int row = index_in_page / EPUB_GRID_COLUMNS;
       int col = index_in_page % EPUB_GRID_COLUMNS;
       int cell_x = col * cell_width;
       int cell_y = row * cell_height;
 
       // do we need to draw a new page of items?
-      if (current_page != state.previous_rendered_page)
+      if (draw_items)
       {
         ESP_LOGD(TAG, "Rendering item %d", i);
-        Epub epub(state.epub_list[i].path);
-        int available_height = cell_height - PADDING * 2;
-        if (available_height < 1)
-        {
-          available_height = 1;
-        }
-        int image_height = available_height;
-        int image_width = 2 * image_height / 3;
-        if (image_width > cell_width - PADDING * 2)
-        {
-          image_width = cell_width - PADDING * 2;
-        }
+        int image_width = 0;
+        int image_height = 0;
+        get_grid_cover_size(renderer, image_width, image_height);
         int image_xpos = cell_x + (cell_width - image_width) / 2;
         int image_ypos = cell_y + (cell_height - image_height) / 2;
 
-        bool needs_title_card = false;
-        size_t image_data_size = 0;
-        uint8_t *image_data = nullptr;
-
-        // Check if the cover image is cached.
-          if (state.epub_list[i].cover_path[0] != '\0')
-        {
-          std::string cache_path = get_cache_path(state.epub_list[i].path);
-          struct stat st;
-          std::vector<uint8_t> image_buffer;
-          if (stat(cache_path.c_str(), &st) == 0)
-          {
-             FILE *f = fopen(cache_path.c_str(), "rb");
-             if (f)
-             {
-               fseek(f, 0, SEEK_END);
-               image_data_size = ftell(f);
-               fseek(f, 0, SEEK_SET);
-               image_buffer.resize(image_data_size);
-               image_data = image_buffer.data();
-               if (image_data)
-               {
-                 fread(image_data, 1, image_data_size, f);
-               }
-               fclose(f);
-             }
-          }
-
-          if (!image_data)
-          {
-            image_buffer = epub.get_item_contents_as_vector(state.epub_list[i].cover_path);
-            image_data = image_buffer.data();
-            image_data_size = image_buffer.size();
-            // Cache the cover image.
-            if (image_data && image_data_size > 0)
-            {
-               FILE *f = fopen(cache_path.c_str(), "wb");
-               if (f)
-               {
-                 fwrite(image_data, 1, image_data_size, f);
-                 fclose(f);
-               }
-            }
-          }
-          bool can_render = false;
-          if (image_data && image_data_size > 0)
-          {
-            int dummy_w = 0;
-            int dummy_h = 0;
-            can_render = renderer->get_image_size(state.epub_list[i].cover_path, image_data, image_data_size, &dummy_w, &dummy_h);
-          }
-          if (can_render)
-          {
-            renderer->set_image_placeholder_enabled(false);
-            renderer->draw_image(state.epub_list[i].cover_path, image_data, image_data_size, image_xpos, image_ypos, image_width, image_height);
-            renderer->set_image_placeholder_enabled(true);
-          }
-          else
-          {
-            needs_title_card = true;
-          }
-        }
-        else
-        {
-          needs_title_card = true;
-        }
+        bool needs_title_card = !draw_cover(item, GRID_THUMBNAIL_EXTENSION, image_xpos, image_ypos, image_width, image_height);
 
         if (needs_title_card)
         {
@@ -389,14 +712,13 @@ void EpubList::render()
             if (inner_w > 0 && inner_h > 0)
             {
               // Use bold for the title in the grid title card.
-              renderer->draw_text_box(state.epub_list[i].title, inner_x, inner_y, inner_w, inner_h, true, false);
+              renderer->draw_text_box(item.title, inner_x, inner_y, inner_w, inner_h, true, false);
             }
           }
         }
 
-        // image_buffer goes out of scope and frees memory
         // Yield briefly while rendering a page of covers so the main
-        // task does not starve the watchdog when decoding many JPEGs.
+        // task does not starve the watchdog when a thumbnail has to be made.
         vTaskDelay(1);
       }
 
@@ -434,86 +756,22 @@ void EpubList::render()
     int cell_height = content_height / EPUB_LIST_ITEMS_PER_PAGE;
     ESP_LOGD(TAG, "Cell height is %d", cell_height);
     int ypos = 0;
-    int end_index = std::min(start_index + EPUB_LIST_ITEMS_PER_PAGE, state.num_epubs);
+    int end_index = start_index + m_page_items.size();
     for (int i : std::views::iota(start_index, end_index))
     {
+      const EpubListItem &item = m_page_items[i - start_index];
       // do we need to draw a new page of items?
-      if (current_page != state.previous_rendered_page)
+      if (draw_items)
       {
         ESP_LOGI(TAG, "Rendering item %d", i);
-        Epub epub(state.epub_list[i].path);
         // draw the cover page
         int image_xpos = PADDING;
         int image_ypos = ypos + PADDING;
-        int image_height = cell_height - PADDING * 2;
-        int image_width = 2 * image_height / 3;
-        size_t image_data_size = 0;
-        uint8_t *image_data = nullptr;
-
-        bool needs_title_card = false;
-
-        // Load the cover image if it exists.
-        if (state.epub_list[i].cover_path[0] != '\0')
-        {
-          std::string cache_path = get_cache_path(state.epub_list[i].path);
-          struct stat st;
-          std::vector<uint8_t> image_buffer;
-          if (stat(cache_path.c_str(), &st) == 0)
-          {
-             FILE *f = fopen(cache_path.c_str(), "rb");
-             if (f)
-             {
-               fseek(f, 0, SEEK_END);
-               image_data_size = ftell(f);
-               fseek(f, 0, SEEK_SET);
-               image_buffer.resize(image_data_size);
-               image_data = image_buffer.data();
-               if (image_data)
-               {
-                 fread(image_data, 1, image_data_size, f);
-               }
-               fclose(f);
-             }
-          }
-
-          if (!image_data)
-          {
-            image_buffer = epub.get_item_contents_as_vector(state.epub_list[i].cover_path);
-            image_data = image_buffer.data();
-            image_data_size = image_buffer.size();
+        int image_width = 0;
+        int image_height = 0;
+        get_list_cover_size(renderer, image_width, image_height);
 
-            if (image_data && image_data_size > 0)
-            {
-               FILE *f = fopen(cache_path.c_str(), "wb");
-               if (f)
-               {
-                 fwrite(image_data, 1, image_data_size, f);
-                 fclose(f);
-               }
-            }
-          }
-          bool can_render = false;
-          if (image_data && image_data_size > 0)
-          {
-            int dummy_w = 0;
-            int dummy_h = 0;
-            can_render = renderer->get_image_size(state.epub_list[i].cover_path, image_data, image_data_size, &dummy_w, &dummy_h);
-          }
-          if (can_render)
-          {
-            renderer->set_image_placeholder_enabled(false);
-            renderer->draw_image(state.epub_list[i].cover_path, image_data, image_data_size, image_xpos, image_ypos, image_width, image_height);
-            renderer->set_image_placeholder_enabled(true);
-          }
-          else
-          {
-            needs_title_card = true;
-          }
-        }
-        else
-        {
-          needs_title_card = true;
-        }
+        bool needs_title_card = !draw_cover(item, LIST_THUMBNAIL_EXTENSION, image_xpos, image_ypos, image_width, image_height);
 
         if (needs_title_card)
         {
@@ -534,26 +792,26 @@ void EpubList::render()
             if (inner_w > 0 && inner_h > 0)
             {
               // Use bold for the title in the list-view title card.
-              renderer->draw_text_box(state.epub_list[i].title, inner_x, inner_y, inner_w, inner_h, true, false);
+              renderer->draw_text_box(item.title, inner_x, inner_y, inner_w, inner_h, true, false);
             }
           }
         }
 
-        // image_buffer frees memory
         // draw the title
         int text_xpos = image_xpos + image_width + PADDING;
         int text_ypos = ypos + PADDING / 2;
         int text_width = page_width - (text_xpos + PADDING);
         int text_height = cell_height - PADDING * 2;
         // use the text block to layout the title
-        TextBlock *title_block = m_title_blocks[i];
+        TextBlock *title_block = m_title_blocks[i - start_index];
         if (!title_block)
         {
+          Epub epub(item.path);
           title_block = new TextBlock(LEFT_ALIGN);
           // Render library titles in bold in the list view.
-          title_block->add_span(state.epub_list[i].title, true, false);
+          title_block->add_span(item.title, true, false);
           title_block->layout(renderer, &epub, text_width);
-          m_title_blocks[i] = title_block;
+          m_title_blocks[i - start_index] = title_block;
         }
         // work out the height of the title
         int title_height = title_block->line_breaks.size() * renderer->get_line_height();
@@ -741,130 +999,7 @@ void EpubList::render()
   state.previous_rendered_page = current_page;
 }
 
-// Binary index format:
-// uint32_t magic ('EBIX'), uint16_t version (1), uint16_t count,
-// followed by count EpubListItem records.
-bool EpubList::load_index(const char *books_path, const char *index_path)
-{
-  FILE *fp = fopen(index_path, "rb");
-  if (!fp)
-  {
-    return false;
-  }
-  uint32_t magic = 0;
-  uint16_t version = 0;
-  uint16_t count = 0;
-  if (fread(&magic, sizeof(magic), 1, fp) != 1 ||
-      fread(&version, sizeof(version), 1, fp) != 1 ||
-      fread(&count, sizeof(count), 1, fp) != 1)
-  {
-    fclose(fp);
-    return false;
-  }
-  const uint32_t EXPECTED_MAGIC = 0x58494245; // 'EBIX'
-  if (magic != EXPECTED_MAGIC || version != 1 || count == 0 || count > MAX_EPUB_LIST_SIZE)
-  {
-    fclose(fp);
-    return false;
-  }
-  if (fread(state.epub_list, sizeof(EpubListItem), count, fp) != count)
-  {
-    fclose(fp);
-    return false;
-  }
-  fclose(fp);
-
-  // Quick validation: count EPUB-like files in books_path and ensure it matches
-  int dir_count = 0;
-  DIR *dir = opendir(books_path);
-  if (dir)
-  {
-    struct dirent *ent;
-    while ((ent = readdir(dir)) != NULL)
-    {
-      if (ent->d_name[0] == '.' || ent->d_name[0] == '_' || ent->d_type == DT_DIR)
-      {
-        continue;
-      }
-      const char *dot = strrchr(ent->d_name, '.');
-      if (!dot || !dot[1])
-      {
-        continue;
-      }
-      const char *ext = dot + 1;
-      char e0 = tolower(ext[0]);
-      char e1 = tolower(ext[1]);
-      char e2 = tolower(ext[2]);
-      char e3 = tolower(ext[3]);
-      bool is_epu = (e0 == 'e' && e1 == 'p' && e2 == 'u' && (ext[3] == '\0'));
-      bool is_epub = (e0 == 'e' && e1 == 'p' && e2 == 'u' && e3 == 'b' && ext[4] == '\0');
-      if (!is_epu && !is_epub)
-      {
-        continue;
-      }
-      dir_count++;
-    }
-    closedir(dir);
-  }
-  if (dir_count != count)
-  {
-    return false;
-  }
-
-  state.num_epubs = count;
-  state.is_loaded = true;
-  state.previous_rendered_page = -1;
-  state.previous_selected_item = -1;
-  if (state.selected_item >= state.num_epubs)
-  {
-    state.selected_item = 0;
-  }
-  return true;
-}
-
-void EpubList::save_index(const char *index_path)
-{
-  char path_buf[MAX_PATH_SIZE];
-  strncpy(path_buf, index_path, sizeof(path_buf));
-  path_buf[sizeof(path_buf) - 1] = '\0';
-  char *last_slash = strrchr(path_buf, '/');
-  if (last_slash)
-  {
-    *last_slash = '\0';
-    struct stat st;
-    if (stat(path_buf, &st) != 0)
-    {
-      mkdir(path_buf, 0775);
-    }
-  }
-  FILE *fp = fopen(index_path, "wb");
-  if (!fp)
-  {
-    ESP_LOGE(TAG, "Failed to open index file %s for write: errno=%d (%s)", index_path, errno, strerror(errno));
-    return;
-  }
-  const uint32_t magic = 0x58494245; // 'EBIX'
-  const uint16_t version = 1;
-  uint16_t count = static_cast<uint16_t>(state.num_epubs);
-  if (fwrite(&magic, sizeof(magic), 1, fp) != 1 ||
-      fwrite(&version, sizeof(version), 1, fp) != 1 ||
-      fwrite(&count, sizeof(count), 1, fp) != 1)
-  {
-    ESP_LOGE(TAG, "Failed to write index header to %s", index_path);
-    fclose(fp);
-    return;
-  }
-  if (count > 0)
-  {
-    if (fwrite(state.epub_list, sizeof(EpubListItem), count, fp) != count)
-    {
-      ESP_LOGE(TAG, "Failed to write index entries to %s", index_path);
-    }
-  }
-  fclose(fp);
-}
-
-std::string EpubList::get_cache_path(const char *epub_path)
+std::string EpubList::get_cache_path(const char *epub_path, const char *extension)
 {
   std::string s = epub_path;
   for (size_t i = 0; i < s.length(); i++)
@@ -874,7 +1009,7 @@ std::string EpubList::get_cache_path(const char *epub_path)
       s[i] = '_';
     }
   }
-  return "/fs/cache/" + s + ".raw";
+  return "/fs/cache/" + s + extension;
 }
 
 void EpubList::ensure_cache_dir()
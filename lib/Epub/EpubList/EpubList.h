@@ -16,6 +16,8 @@ extern "C" {
 #include "../RubbishHtmlParser/blocks/TextBlock.h"
 #include "../RubbishHtmlParser/htmlEntities.h"
 #include "./State.h"
+#include "./EpubCatalog.h"
+#include "./LibraryScanner.h"
 
 #ifndef UNIT_TEST
   #include <freertos/FreeRTOS.h>
@@ -32,19 +34,61 @@ private:
   Renderer *renderer;
   EpubListState &state;
   bool m_needs_redraw = false;
+  EpubCatalog m_catalog;
+  // the page of books being shown - the rest stay in the catalog
+  int m_page_first = -1;
+  std::vector<EpubListItem> m_page_items;
   std::vector<TextBlock *> m_title_blocks;
+  // draw the books on the page again without clearing the screen
+  bool m_redraw_items = false;
+  bool m_bottom_bar_changed = false;
 
-  bool load_index(const char *books_path, const char *index_path);
+  // bringing the catalog up to date in the background - until the catalog is
+  // ready the books are read from the scanner in the order they were found
+  std::unique_ptr<LibraryScanner> m_scanner;
+  std::string m_scan_path;
+  bool m_scan_catalog_ready = false;
+  // the last book opened was published first so it can be opened straight away
+  bool m_scan_has_last_book = false;
+  // the current book's index in the scan
+  int m_scan_book_index = -1;
+
+  // read the title and cover of a book for the catalog - this can be called from the scan task
+  static bool load_book(Renderer *renderer, const std::string &path, EpubListItem &item);
+  // decode the cover into the grid and list thumbnails
+  static void make_thumbnails(Renderer *renderer, const EpubListItem &item);
+  void show_no_sd_card(const char *path);
+  bool finish_loading(const char *path);
+  void start_scan(const char *path, Renderer *scan_renderer);
+  // switch over to the new catalog - true if the books have moved around
+  bool finish_scan_catalog(bool catalog_ok);
+  bool is_reading_scan() { return m_scanner && !m_scan_catalog_ready; }
+  void load_page(int first, int count);
+  void clear_title_blocks();
+  int get_items_per_page();
+  // the part of the screen a book on the current page is drawn in
+  void get_item_rect(int index_in_page, int &x, int &y, int &width, int &height);
+  // the height of the grid or list - the page without the bottom bar
+  static int get_content_height(Renderer *renderer);
+  // the size covers are drawn at in a grid cell and in a row of the list
+  static void get_grid_cover_size(Renderer *renderer, int &width, int &height);
+  static void get_list_cover_size(Renderer *renderer, int &width, int &height);
+  // the cover image exactly as it is in the book, from the cache or the book itself
+  static bool read_cached_cover(const EpubListItem &item, std::vector<uint8_t> &cover);
+  static void write_cached_cover(const char *epub_path, const std::vector<uint8_t> &cover);
+  // draw the book's cover from its thumbnail, making the thumbnail if it needs to - false if there's no cover to draw
+  bool draw_cover(const EpubListItem &item, const char *extension, int x, int y, int width, int height);
   // Get the cache path for a given EPUB file.
   //
-  // The cache path is used to store the EPUB index and metadata.
+  // The cache path is used to store the cover image and its thumbnails.
   //
   // Args:
   //   epub_path: The path to the EPUB file.
+  //   extension: Which of the cached files - the raw cover by default.
   //
   // Returns:
   //   The cache path for the EPUB file.
-  std::string get_cache_path(const char *epub_path);
+  static std::string get_cache_path(const char *epub_path, const char *extension = ".raw");
   // Ensure the cache directory exists.
   void ensure_cache_dir();
 
@@ -58,16 +102,24 @@ public:
   }
   ~EpubList()
   {
-    for (auto *block : m_title_blocks)
-    {
-      delete block;
-    }
-    m_title_blocks.clear();
+    stop_scan();
+    clear_title_blocks();
   }
   bool load(const char *path);
   void set_needs_redraw() { m_needs_redraw = true; }
   void next();
   void prev();
   void render();
-  void save_index(const char *index_path);
+  // make the book at index the current book (state.current_book) - the previous one's position is saved first
+  bool select_book(int index);
+  // write the current book's reading position back to the catalog and remember it as the last one opened
+  void save_current_book();
+  // the book that was being read last time, -1 if there isn't one
+  int get_last_opened();
+  bool is_scanning() { return m_scanner != nullptr; }
+  // show what the scan has found since the last call - draws and flushes the books that changed if the library
+  // is on screen. True if the catalog has replaced the scan and the library needs drawing from scratch.
+  bool update_scan(bool on_screen);
+  // stop scanning and wait for the scan task - the old catalog is kept if the new one wasn't finished
+  void stop_scan();
 };
\ No newline at end of file
@@ -1,24 +1,58 @@
 #include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/stat.h>
 #ifndef UNIT_TEST
 #include <esp_log.h>
 #include <esp_system.h>
+#include <esp_timer.h>
 #else
 #define ESP_LOGI(args...)
 #define ESP_LOGE(args...)
 #define ESP_LOGI(args...)
 #define ESP_LOGD(args...)
 #endif
+#include <vector>
 #include "EpubReader.h"
 #include "Epub.h"
+#include "SectionPrefetcher.h"
 #include "../RubbishHtmlParser/RubbishHtmlParser.h"
+#include "../ZipFile/ZipFile.h"
 #include "../Renderer/Renderer.h"
+#include "../Renderer/PageCache.h"
 
 static const char *TAG = "EREADER";
 
+// how much of the section we inflate at a time
+static const size_t HTML_CHUNK_SIZE = 4096;
+
+// measured as part of the layout cache key so a different font face gives a different key
+static const char *FONT_PROBE_TEXT = "The quick brown fox jumps over the lazy dog";
+
+// FNV-1a
+static uint32_t hash_bytes(uint32_t hash, const void *data, size_t length)
+{
+  const uint8_t *bytes = (const uint8_t *)data;
+  for (size_t i = 0; i < length; i++)
+  {
+    hash ^= bytes[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+EpubReader::EpubReader(EpubListItem &state, Renderer *renderer)
+    : state(state), renderer(renderer), page_cache_pages(PAGE_CACHE_PAGES)
+{
+}
+
 EpubReader::~EpubReader()
 {
+  // stop the prefetch task before the things it uses go away
+  delete prefetcher;
+  delete measurer;
+  delete page_cache;
   delete parser;
-  delete next_parser;
   delete epub;
 }
 
@@ -29,13 +63,15 @@ bool EpubReader::load()
   if (!epub || epub->get_path() != state.path)
   {
     renderer->show_busy();
+    cancel_prefetch();
+    if (page_cache)
+    {
+      page_cache->clear();
+    }
     delete epub;
     delete parser;
-    delete next_parser;
     parser = nullptr;
-    next_parser = nullptr;
     parser_section = -1;
-    next_parser_section = -1;
     // make sure we have a valid path before trying to load
     if (state.path[0] == '\0')
     {
@@ -52,117 +88,267 @@ bool EpubReader::load()
       epub = nullptr;
       return false;
     }
+    // cache files are named after the book's path, but the key also covers the file's size
+    // and modification time so a replaced book doesn't pick up the old layouts
+    book_hash = hash_bytes(2166136261u, state.path, strlen(state.path));
+    book_key = book_hash;
+    struct stat st;
+    if (stat(state.path, &st) == 0)
+    {
+      int64_t file_info[2] = {(int64_t)st.st_size, (int64_t)st.st_mtime};
+      book_key = hash_bytes(book_key, file_info, sizeof(file_info));
+    }
     ESP_LOGD(TAG, "After epub load: %d", esp_get_free_heap_size());
   }
   return true;
 }
 
-void EpubReader::parse_and_layout_current_section()
+uint32_t EpubReader::get_layout_key(Renderer *layout_renderer, int section)
 {
-  if (!epub)
+  // the page size covers the margins, the probe text and line height cover the font face and size
+  int32_t values[] = {
+      section,
+      layout_renderer->get_page_width(),
+      layout_renderer->get_page_height(),
+      layout_renderer->get_line_height(),
+      layout_renderer->get_space_width(),
+      layout_renderer->get_text_width(FONT_PROBE_TEXT),
+#ifdef USE_FREETYPE
+      layout_renderer->get_reading_font_pixel_height(),
+#endif
+      use_justified};
+  return hash_bytes(book_key, values, sizeof(values));
+}
+
+std::string EpubReader::get_layout_cache_path(int section)
+{
+  char name[32];
+  snprintf(name, sizeof(name), "/%08x_%d.lay", (unsigned int)book_hash, section);
+  return layout_cache_dir + name;
+}
+
+RubbishHtmlParser *EpubReader::load_section(Epub *epub, int section, const std::string &cache_path, uint32_t layout_key,
+                                             bool use_justified, bool &needs_saving,
+                                             const std::function<bool()> &keep_going)
+{
+  RubbishHtmlParser *section_parser = new RubbishHtmlParser("", use_justified);
+  if (section_parser->load_layout(cache_path.c_str(), layout_key))
   {
-    ESP_LOGE(TAG, "parse_and_layout_current_section called with null epub");
-    return;
+    ESP_LOGI(TAG, "Loaded section %d from the layout cache", section);
+    needs_saving = false;
+    return section_parser;
   }
+  delete section_parser;
+  needs_saving = true;
+  return parse_section(epub, section, use_justified, keep_going);
+}
 
-  if (parser && parser_section == state.current_section)
+void EpubReader::save_layout_cache()
+{
+  if (!parser || !parser_needs_saving || !parser->is_layout_complete())
   {
     return;
   }
-
-  if (next_parser && next_parser_section == state.current_section)
+  // only try once - if the card is full or read only we don't want to keep trying
+  parser_needs_saving = false;
+  if (!layout_cache_dir_ready)
   {
-    delete parser;
-    parser = next_parser;
-    parser_section = next_parser_section;
-    next_parser = nullptr;
-    next_parser_section = -1;
-    state.pages_in_current_section = parser->get_page_count();
-    // Prefetching the next section can be very expensive on
-    // image-heavy books. Skip it to keep TOC -> reader
-    // transitions responsive.
-    return;
+    std::string parent = layout_cache_dir.substr(0, layout_cache_dir.find_last_of('/'));
+    struct stat st;
+    if (!parent.empty() && stat(parent.c_str(), &st) != 0)
+    {
+      mkdir(parent.c_str(), 0775);
+    }
+    if (stat(layout_cache_dir.c_str(), &st) != 0)
+    {
+      mkdir(layout_cache_dir.c_str(), 0775);
+    }
+    layout_cache_dir_ready = true;
   }
+  std::string cache_path = get_layout_cache_path(parser_section);
+  if (!parser->save_layout(cache_path.c_str(), parser_layout_key))
+  {
+    ESP_LOGE(TAG, "Failed to save the layout cache for section %d", parser_section);
+  }
+}
 
-  renderer->show_busy();
-  ESP_LOGD(TAG, "Parse and render section %d", state.current_section);
-  ESP_LOGD(TAG, "Before read html: %d", esp_get_free_heap_size());
-
-  std::string item = epub->get_spine_item(state.current_section);
+RubbishHtmlParser *EpubReader::parse_section(Epub *epub, int section, bool use_justified,
+                                              const std::function<bool()> &keep_going)
+{
+  std::string item = epub->get_spine_item(section);
   if (item.empty())
   {
-    ESP_LOGE(TAG, "No spine item for section %d", state.current_section);
-    return;
+    ESP_LOGE(TAG, "No spine item for section %d", section);
+    return nullptr;
   }
   std::string base_path = item.substr(0, item.find_last_of('/') + 1);
-  char *html = reinterpret_cast<char *>(epub->get_item_contents(item));
-  if (!html)
+  // inflate the html a chunk at a time straight into the parser so we never
+  // have the whole section in memory
+  ZipFileStream *stream = epub->open_item_stream(item);
+  if (!stream)
   {
     ESP_LOGE(TAG, "Failed to read HTML for spine item '%s'", item.c_str());
-    return;
+    return nullptr;
   }
-  ESP_LOGD(TAG, "After read html: %d", esp_get_free_heap_size());
-  delete parser;
-  parser = new RubbishHtmlParser(html, strlen(html), base_path, use_justified);
-  parser_section = state.current_section;
-  free(html);
-  ESP_LOGD(TAG, "After parse: %d", esp_get_free_heap_size());
-  parser->layout(renderer, epub);
-  ESP_LOGD(TAG, "After layout: %d", esp_get_free_heap_size());
-  state.pages_in_current_section = parser->get_page_count();
+  uint8_t *chunk = (uint8_t *)malloc(HTML_CHUNK_SIZE);
+  if (!chunk)
+  {
+    ESP_LOGE(TAG, "Failed to allocate HTML chunk buffer");
+    delete stream;
+    return nullptr;
+  }
+  RubbishHtmlParser *section_parser = new RubbishHtmlParser(base_path, use_justified);
+  size_t read;
+  while ((read = stream->read(chunk, HTML_CHUNK_SIZE)) > 0)
+  {
+    section_parser->feed(reinterpret_cast<const char *>(chunk), read);
+    if (keep_going && !keep_going())
+    {
+      free(chunk);
+      delete stream;
+      delete section_parser;
+      return nullptr;
+    }
+  }
+  section_parser->finish();
+  if (stream->has_error())
+  {
+    ESP_LOGE(TAG, "Error while streaming '%s' - showing what we have", item.c_str());
+  }
+  free(chunk);
+  delete stream;
+  return section_parser;
 }
 
-void EpubReader::prefetch_next_section()
+void EpubReader::parse_and_layout_current_section()
 {
   if (!epub)
   {
+    ESP_LOGE(TAG, "parse_and_layout_current_section called with null epub");
     return;
   }
 
-  int total_sections = epub->get_spine_items_count();
-  int next_section = state.current_section + 1;
-  if (next_section >= total_sections)
+  if (parser && parser_section == state.current_section)
   {
     return;
   }
 
-  if (next_parser && next_parser_section == next_section)
+  delete parser;
+  parser_layout_key = get_layout_key(state.current_section);
+  // the prefetch task may have this ready already (or be part way through it)
+  parser = prefetcher ? prefetcher->take(state.current_section, parser_layout_key, parser_needs_saving) : nullptr;
+  if (parser)
   {
-    return;
+    ESP_LOGD(TAG, "Using prefetched section %d", state.current_section);
   }
+  else
+  {
+    renderer->show_busy();
+    ESP_LOGD(TAG, "Parse and render section %d", state.current_section);
+    ESP_LOGD(TAG, "Before read html: %d", esp_get_free_heap_size());
+    parser = load_section(epub, state.current_section, get_layout_cache_path(state.current_section), parser_layout_key,
+                          use_justified, parser_needs_saving);
+    if (!parser)
+    {
+      parser_section = -1;
+      return;
+    }
+    ESP_LOGD(TAG, "After parse: %d", esp_get_free_heap_size());
+  }
+  parser_section = state.current_section;
+  // only lay out as far as the page after the one we're showing - the rest is done on demand
+  parser->layout_to_page(renderer, epub, state.current_page + 1);
+  ESP_LOGD(TAG, "After layout: %d", esp_get_free_heap_size());
+  ESP_LOGD(TAG, "Section arena: %u allocations, %u of %u bytes used in %u chunks",
+           (unsigned)parser->get_arena().get_allocation_count(), (unsigned)parser->get_arena().get_bytes_used(),
+           (unsigned)parser->get_arena().get_bytes_reserved(), (unsigned)parser->get_arena().get_chunk_count());
+  state.pages_in_current_section = parser->get_page_count();
+  save_layout_cache();
+}
 
-  delete next_parser;
-  next_parser = nullptr;
-  next_parser_section = -1;
+void EpubReader::release_current_section()
+{
+  // no point keeping it if the settings have changed since it was laid out
+  if (parser && prefetcher && parser_layout_key == get_layout_key(parser_section))
+  {
+    prefetcher->keep(parser_section, parser_layout_key, parser, parser_needs_saving);
+  }
+  else
+  {
+    delete parser;
+  }
+  parser = nullptr;
+  parser_section = -1;
+}
 
-  std::string item = epub->get_spine_item(next_section);
-  if (item.empty())
+void EpubReader::prefetch_adjacent_sections()
+{
+  if (!epub || !parser)
   {
     return;
   }
-  std::string base_path = item.substr(0, item.find_last_of('/') + 1);
-  char *html = reinterpret_cast<char *>(epub->get_item_contents(item));
-  if (!html)
+  // the key for a section that doesn't exist covers just the book and the settings
+  uint32_t settings = get_layout_key(-1);
+  if (measurer_settings != settings)
+  {
+    cancel_prefetch();
+    delete measurer;
+    measurer = renderer->create_measuring_renderer();
+    measurer_settings = settings;
+    // if the measurer lays things out differently to the display everything it did would be thrown away
+    if (measurer && get_layout_key(measurer, -1) != settings)
+    {
+      ESP_LOGE(TAG, "The measuring renderer doesn't match the display - not prefetching");
+      delete measurer;
+      measurer = nullptr;
+    }
+  }
+  if (!measurer)
   {
     return;
   }
+  if (!prefetcher)
+  {
+    prefetcher = new SectionPrefetcher(epub, measurer, use_justified);
+  }
+  std::vector<PrefetchJob> jobs;
+  int next_section = state.current_section + 1;
+  if (next_section < epub->get_spine_items_count())
+  {
+    // the first page of the next section is all we need to turn the page
+    jobs.push_back({next_section, get_layout_key(next_section), 1, get_layout_cache_path(next_section)});
+  }
+  int prev_section = state.current_section - 1;
+  if (prev_section >= 0)
+  {
+    // going back lands on the last page so we need the whole section
+    jobs.push_back({prev_section, get_layout_key(prev_section), -1, get_layout_cache_path(prev_section)});
+  }
+  prefetcher->prefetch(jobs);
+}
 
-  RubbishHtmlParser *p = new RubbishHtmlParser(html, strlen(html), base_path, use_justified);
-  free(html);
-  p->layout(renderer, epub);
-  next_parser = p;
-  next_parser_section = next_section;
+void EpubReader::cancel_prefetch()
+{
+  // deleting it stops the task - it picks up use_justified when it is created so it can't just be cleared
+  delete prefetcher;
+  prefetcher = nullptr;
 }
 
 void EpubReader::next()
 {
   state.current_page++;
+  // the section may not be fully laid out yet - make sure we know whether there is another page
+  if (parser && parser_section == state.current_section && !parser->is_layout_complete())
+  {
+    parser->layout_to_page(renderer, epub, state.current_page + 1);
+    state.pages_in_current_section = parser->get_page_count();
+    save_layout_cache();
+  }
   if (state.current_page >= state.pages_in_current_section)
   {
     state.current_section++;
     state.current_page = 0;
-    delete parser;
-    parser = nullptr;
+    release_current_section();
   }
 }
 
@@ -172,11 +358,17 @@ void EpubReader::prev()
   {
     if (state.current_section > 0)
     {
-      delete parser;
-      parser = nullptr;
+      release_current_section();
       state.current_section--;
       ESP_LOGD(TAG, "Going to previous section %d", state.current_section);
       parse_and_layout_current_section();
+      // we're going to the last page so we need the whole section
+      if (parser)
+      {
+        parser->layout(renderer, epub);
+        state.pages_in_current_section = parser->get_page_count();
+        save_layout_cache();
+      }
       state.current_page = state.pages_in_current_section - 1;
       return;
     }
@@ -202,8 +394,7 @@ void EpubReader::next_section()
 
   state.current_section++;
   state.current_page = 0;
-  delete parser;
-  parser = nullptr;
+  release_current_section();
   parse_and_layout_current_section();
 }
 
@@ -225,13 +416,26 @@ void EpubReader::prev_section()
 
   state.current_section--;
   state.current_page = 0;
-  delete parser;
-  parser = nullptr;
+  release_current_section();
   parse_and_layout_current_section();
 }
 
 void EpubReader::render()
 {
+  // the font or margins have changed since we laid this out - start again
+  bool settings_changed = parser && parser_layout_key != get_layout_key(parser_section);
+  if (settings_changed)
+  {
+    ESP_LOGI(TAG, "Layout settings changed - re-laying out section %d", parser_section);
+    delete parser;
+    parser = nullptr;
+    parser_section = -1;
+    cancel_prefetch();
+    if (page_cache)
+    {
+      page_cache->clear();
+    }
+  }
   if (!parser)
   {
     parse_and_layout_current_section();
@@ -241,17 +445,68 @@ void EpubReader::render()
     ESP_LOGE(TAG, "EpubReader::render called with null parser after layout; aborting render");
     return;
   }
+  // make sure the page we're showing (and the one after it) are ready
+  parser->layout_to_page(renderer, epub, state.current_page + 1);
+  state.pages_in_current_section = parser->get_page_count();
+  save_layout_cache();
+  // a bigger font can leave us past the end of the section
+  if (settings_changed && state.current_page >= state.pages_in_current_section && state.pages_in_current_section > 0)
+  {
+    state.current_page = state.pages_in_current_section - 1;
+  }
+  if (!page_cache && page_cache_pages > 0 && renderer->get_page_buffer_size() > 0)
+  {
+    page_cache = new PageCache(renderer->get_page_buffer_size(), page_cache_pages);
+  }
   ESP_LOGD(TAG, "rendering page %d of %d", state.current_page, parser->get_page_count());
-  parser->render_page(state.current_page, renderer, epub);
+#ifndef UNIT_TEST
+  // only used for the log
+  int64_t start = esp_timer_get_time();
+#endif
+  uint64_t page_key = PageCache::make_key(parser_layout_key, state.current_page);
+  const CachedPage *cached = page_cache ? page_cache->find(page_key) : nullptr;
+  if (cached)
+  {
+    // the same clean up render_page does before drawing a page
+    renderer->clear_screen();
+    if (renderer->has_gray())
+    {
+      renderer->flush_display();
+    }
+    renderer->restore_page(cached->buffer, cached->has_gray);
+    ESP_LOGI(TAG, "Page %d copied from the page cache in %dms", state.current_page, (int)((esp_timer_get_time() - start) / 1000));
+  }
+  else
+  {
+    parser->render_page(state.current_page, renderer, epub);
+    ESP_LOGI(TAG, "Page %d rasterized in %dms", state.current_page, (int)((esp_timer_get_time() - start) / 1000));
+    // keep a copy so coming back to this page is quick
+    CachedPage *page = page_cache ? page_cache->insert(page_key) : nullptr;
+    if (page)
+    {
+      renderer->save_page(page->buffer);
+      page->has_gray = renderer->has_gray();
+    }
+  }
 
   ESP_LOGD(TAG, "rendered page %d of %d", state.current_page, parser->get_page_count());
   ESP_LOGD(TAG, "after render: %d", esp_get_free_heap_size());
+  // get the neighbouring sections ready while the reader reads this page
+  prefetch_adjacent_sections();
 }
 
 void EpubReader::set_state_section(uint16_t current_section) {
   ESP_LOGI(TAG, "go to section:%d", current_section);
   state.current_section = current_section;
   state.current_page = 0;
+  // whatever we were prefetching is for the wrong part of the book now
+  if (prefetcher)
+  {
+    prefetcher->cancel();
+  }
+  delete parser;
+  parser = nullptr;
+  parser_section = -1;
 }
 
 void EpubReader::set_justified(bool justified)
@@ -264,8 +519,76 @@ void EpubReader::set_justified(bool justified)
     delete parser;
     parser = nullptr;
     parser_section = -1;
-    delete next_parser;
-    next_parser = nullptr;
-    next_parser_section = -1;
+    cancel_prefetch();
+    if (page_cache)
+    {
+      page_cache->clear();
+    }
   }
-}
\ No newline at end of file
+}
+bool EpubReader::has_pending_layout()
+{
+  return parser && parser_section == state.current_section && !parser->is_layout_complete();
+}
+
+bool EpubReader::layout_in_background()
+{
+  if (!has_pending_layout())
+  {
+    return false;
+  }
+  bool more = parser->layout_step(renderer, epub);
+  state.pages_in_current_section = parser->get_page_count();
+  save_layout_cache();
+  return more;
+}
+
+bool EpubReader::has_background_work()
+{
+  return prefetcher && prefetcher->is_busy();
+}
+
+bool EpubReader::has_pending_prerender()
+{
+  if (!prerender_enabled || !page_cache || !parser || parser_section != state.current_section)
+  {
+    return false;
+  }
+  // the last page laid out isn't finished until the layout has moved past it
+  int next_page = state.current_page + 1;
+  int ready_pages = parser->is_layout_complete() ? parser->get_page_count() : parser->get_page_count() - 1;
+  if (next_page >= ready_pages)
+  {
+    return false;
+  }
+  return !page_cache->contains(PageCache::make_key(parser_layout_key, next_page));
+}
+
+bool EpubReader::prerender_next_page()
+{
+  if (!has_pending_prerender())
+  {
+    return false;
+  }
+  int next_page = state.current_page + 1;
+  uint64_t page_key = PageCache::make_key(parser_layout_key, next_page);
+  CachedPage *page = page_cache->insert(page_key);
+  if (!page || !renderer->begin_offscreen(page->buffer))
+  {
+    // don't keep trying - we'd never block waiting for input
+    ESP_LOGE(TAG, "Can't draw pages off screen - turning it off");
+    if (page)
+    {
+      page_cache->remove(page_key);
+    }
+    prerender_enabled = false;
+    return false;
+  }
+#ifndef UNIT_TEST
+  int64_t start = esp_timer_get_time();
+#endif
+  parser->render_page(next_page, renderer, epub);
+  page->has_gray = renderer->end_offscreen();
+  ESP_LOGI(TAG, "Page %d rasterized off screen in %dms", next_page, (int)((esp_timer_get_time() - start) / 1000));
+  return true;
+}
@@ -3,7 +3,11 @@
 class Epub;
 class Renderer;
 class RubbishHtmlParser;
+class SectionPrefetcher;
+class PageCache;
 
+#include <string>
+#include <functional>
 #include "./State.h"
 
 class EpubReader
@@ -13,17 +17,54 @@ private:
   Epub *epub = nullptr;
   Renderer *renderer = nullptr;
   RubbishHtmlParser *parser = nullptr;
-  RubbishHtmlParser *next_parser = nullptr;
   int16_t parser_section = -1;
-  int16_t next_parser_section = -1;
 
   bool use_justified = false;
 
+  // laid out sections are cached on the SD card - the key covers everything that
+  // changes the layout so a font or margin change means the old file is ignored
+  std::string layout_cache_dir = "/fs/cache/layout";
+  bool layout_cache_dir_ready = false;
+  uint32_t book_hash = 0;
+  uint32_t book_key = 0;
+  uint32_t parser_layout_key = 0;
+  bool parser_needs_saving = false;
+
+  // the sections either side of the current one are laid out in the background
+  // with a measuring renderer that matches the settings the key was made for
+  SectionPrefetcher *prefetcher = nullptr;
+  Renderer *measurer = nullptr;
+  uint32_t measurer_settings = 0;
+
+  // pages we've drawn (or drawn ahead of time) so turning to them is just a copy
+  PageCache *page_cache = nullptr;
+  size_t page_cache_pages;
+  bool prerender_enabled = true;
+
+  uint32_t get_layout_key(Renderer *layout_renderer, int section);
+  uint32_t get_layout_key(int section) { return get_layout_key(renderer, section); }
+  std::string get_layout_cache_path(int section);
+  // write the current section to the layout cache once it is fully laid out
+  void save_layout_cache();
   void parse_and_layout_current_section();
-  void prefetch_next_section();
+  // we're moving off the current section - hand it to the prefetcher in case we come back
+  void release_current_section();
+  // queue up the sections either side of the current one
+  void prefetch_adjacent_sections();
+  // stop prefetching and throw away anything prefetched - e.g. when the settings change
+  void cancel_prefetch();
 
 public:
-  EpubReader(EpubListItem &state, Renderer *renderer) : state(state), renderer(renderer){};
+  // load a section from the layout cache if we can, otherwise parse it. keep_going is checked
+  // between chunks and the parse is abandoned (returning nullptr) if it returns false.
+  static RubbishHtmlParser *load_section(Epub *epub, int section, const std::string &cache_path, uint32_t layout_key,
+                                         bool use_justified, bool &needs_saving,
+                                         const std::function<bool()> &keep_going = nullptr);
+  // stream a section out of the epub into a new parser - returns nullptr on failure
+  static RubbishHtmlParser *parse_section(Epub *epub, int section, bool use_justified,
+                                          const std::function<bool()> &keep_going = nullptr);
+
+  EpubReader(EpubListItem &state, Renderer *renderer);
   ~EpubReader();
   bool load();
   void next();
@@ -33,4 +74,21 @@ public:
   void next_section();
   void prev_section();
   void set_justified(bool justified);
+  // true if the current section still has pages that haven't been laid out
+  bool has_pending_layout();
+  // lay out a little more of the current section while we're idle - returns true while there is more to do
+  bool layout_in_background();
+  // true if the page after the current one hasn't been drawn ahead of time yet
+  bool has_pending_prerender();
+  // draw the next page off screen while we're idle so turning to it is quick - returns false if there was nothing to do
+  bool prerender_next_page();
+  // how many rendered pages to keep (defaults to PAGE_CACHE_PAGES) - 0 turns the page cache off
+  void set_page_cache_pages(size_t pages) { page_cache_pages = pages; }
+  PageCache *get_page_cache() { return page_cache; }
+  // where the layout cache files go (defaults to /fs/cache/layout)
+  void set_layout_cache_dir(const char *dir) { layout_cache_dir = dir; }
+  // the background section prefetcher - nullptr until we've rendered a page with a renderer that can measure off screen
+  SectionPrefetcher *get_prefetcher() { return prefetcher; }
+  // true while the prefetcher is working on a section in the background
+  bool has_background_work();
 };
\ No newline at end of file
@@ -0,0 +1,222 @@
+#ifndef UNIT_TEST
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#else
+#define ESP_LOGI(args...)
+#define ESP_LOGE(args...)
+#endif
+#include <string.h>
+#include <algorithm>
+#include "LibraryScanner.h"
+#include "EpubCatalog.h"
+#include "Renderer/Renderer.h"
+
+static const char *TAG = "SCAN";
+
+// opening a book means parsing its OPF and decoding covers takes a fair bit of stack
+static const uint32_t SCAN_TASK_STACK_SIZE = 16 * 1024;
+
+LibraryScanner::LibraryScanner(const std::string &catalog_path, const std::string &books_path, Renderer *renderer,
+                               ScanBookLoader load_book, ScanThumbnailMaker make_thumbnails, const EpubListItem *first_book)
+    : m_catalog_path(catalog_path), m_books_path(books_path), m_renderer(renderer),
+      m_load_book(load_book), m_make_thumbnails(make_thumbnails)
+{
+  if (first_book)
+  {
+    publish(*first_book);
+    m_first_path = first_book->path;
+  }
+  m_running = true;
+#ifdef UNIT_TEST
+  m_thread = std::thread(task_entry, this);
+#else
+  // the same core as the section prefetcher - the UI and display updates run on core 1
+  if (xTaskCreatePinnedToCore(task_entry, "scan", SCAN_TASK_STACK_SIZE, this, 1, nullptr, 0) != pdPASS)
+  {
+    ESP_LOGE(TAG, "Failed to start the library scan task");
+    m_running = false;
+    m_catalog_ready = true;
+    m_finished = true;
+  }
+#endif
+}
+
+LibraryScanner::~LibraryScanner()
+{
+  stop();
+  wait_until_finished();
+#ifdef UNIT_TEST
+  if (m_thread.joinable())
+  {
+    m_thread.join();
+  }
+#endif
+  delete m_renderer;
+}
+
+void LibraryScanner::task_entry(void *param)
+{
+  LibraryScanner *scanner = (LibraryScanner *)param;
+  scanner->run();
+#ifndef UNIT_TEST
+  // the scanner may already be gone - don't touch it after run returns
+  vTaskDelete(nullptr);
+#endif
+}
+
+void LibraryScanner::publish(const EpubListItem &item)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_books.push_back({item.path, item.title, item.cover_path, item.current_section, item.current_page, item.pages_in_current_section});
+}
+
+void LibraryScanner::run()
+{
+  ESP_LOGI(TAG, "Scanning %s", m_books_path.c_str());
+  // the books that were opened and need their covers decoding - path and cover
+  std::vector<std::pair<std::string, std::string>> needs_thumbnails;
+  EpubCatalog catalog;
+  catalog.set_path(m_catalog_path);
+  CatalogSyncStats stats;
+  bool ok = catalog.sync(
+      m_books_path.c_str(),
+      [&](const std::string &path, EpubListItem &item)
+      {
+        if (m_stop)
+        {
+          // failing here would just skip the book - let it through so on_book can stop the sync
+          strncpy(item.path, path.c_str(), MAX_PATH_SIZE - 1);
+          return true;
+        }
+        if (!m_load_book(m_renderer, path, item))
+        {
+          return false;
+        }
+        if (item.cover_path[0] != '\0')
+        {
+          needs_thumbnails.push_back({item.path, item.cover_path});
+          std::lock_guard<std::mutex> lock(m_mutex);
+          m_covers_pending.insert(item.path);
+        }
+        return true;
+      },
+      &stats,
+      [&](const EpubListItem &item)
+      {
+        if (m_first_path != item.path)
+        {
+          publish(item);
+        }
+        return !m_stop;
+      });
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_catalog_ready = true;
+    m_catalog_ok = ok;
+    m_books.clear();
+    m_books.shrink_to_fit();
+    if (!ok)
+    {
+      m_covers_pending.clear();
+    }
+  }
+  ESP_LOGI(TAG, "Catalog %s, %d covers to make", ok ? "written" : "not written", ok ? (int)needs_thumbnails.size() : 0);
+  for (size_t i = 0; ok && i < needs_thumbnails.size() && !m_stop; i++)
+  {
+    EpubListItem item = {};
+    strncpy(item.path, needs_thumbnails[i].first.c_str(), MAX_PATH_SIZE - 1);
+    strncpy(item.cover_path, needs_thumbnails[i].second.c_str(), MAX_PATH_SIZE - 1);
+    m_make_thumbnails(m_renderer, item);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_covers_pending.erase(needs_thumbnails[i].first);
+    m_covers_ready.push_back(needs_thumbnails[i].first);
+  }
+  std::lock_guard<std::mutex> lock(m_mutex);
+  // covers we didn't get round to are made when they are drawn
+  m_covers_pending.clear();
+  m_finished = true;
+  m_running = false;
+  m_changed.notify_all();
+}
+
+void LibraryScanner::stop()
+{
+  m_stop = true;
+}
+
+void LibraryScanner::wait_until_finished()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_changed.wait(lock, [this]
+                 { return !m_running; });
+}
+
+LibraryScanUpdate LibraryScanner::take_update()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  LibraryScanUpdate update;
+  update.books = m_books.size();
+  update.catalog_ready = m_catalog_ready;
+  update.catalog_ok = m_catalog_ok;
+  update.covers_ready.swap(m_covers_ready);
+  update.finished = m_finished;
+  return update;
+}
+
+int LibraryScanner::get_book_count()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_books.size();
+}
+
+int LibraryScanner::read_page(int first, int count, std::vector<EpubListItem> &items)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  items.clear();
+  for (int i = std::max(first, 0); i < first + count && i < (int)m_books.size(); i++)
+  {
+    const FoundBook &book = m_books[i];
+    EpubListItem item = {};
+    strncpy(item.path, book.path.c_str(), MAX_PATH_SIZE - 1);
+    strncpy(item.title, book.title.c_str(), MAX_TITLE_SIZE - 1);
+    strncpy(item.cover_path, book.cover_path.c_str(), MAX_PATH_SIZE - 1);
+    item.current_section = book.current_section;
+    item.current_page = book.current_page;
+    item.pages_in_current_section = book.pages_in_current_section;
+    items.push_back(item);
+  }
+  return items.size();
+}
+
+bool LibraryScanner::read(int index, EpubListItem &item)
+{
+  std::vector<EpubListItem> items;
+  if (read_page(index, 1, items) != 1)
+  {
+    return false;
+  }
+  item = items[0];
+  return true;
+}
+
+void LibraryScanner::set_position(const EpubListItem &item)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (auto &book : m_books)
+  {
+    if (book.path == item.path)
+    {
+      book.current_section = item.current_section;
+      book.current_page = item.current_page;
+      book.pages_in_current_section = item.pages_in_current_section;
+      break;
+    }
+  }
+}
+
+bool LibraryScanner::is_cover_pending(const char *path)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_covers_pending.count(path) > 0;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <functional>
+#include <unordered_set>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#ifdef UNIT_TEST
+#include <thread>
+#endif
+#include "State.h"
+
+class Renderer;
+
+// read the title and cover of a book - called on the scan task with the scanner's own renderer
+typedef std::function<bool(Renderer *renderer, const std::string &path, EpubListItem &item)> ScanBookLoader;
+// make the cover thumbnails for a book - called on the scan task after the catalog is written
+typedef std::function<void(Renderer *renderer, const EpubListItem &item)> ScanThumbnailMaker;
+
+// what has happened since the last call to LibraryScanner::take_update
+struct LibraryScanUpdate
+{
+  // how many books have been found so far
+  int books;
+  // the catalog has been written - books should be read from it (in title order) from now on
+  bool catalog_ready;
+  // false if the catalog couldn't be written or the scan was stopped
+  bool catalog_ok;
+  // the books that have had their covers made
+  std::vector<std::string> covers_ready;
+  // nothing left to do - the scanner can be deleted
+  bool finished;
+};
+
+// Brings the library catalog up to date (see EpubCatalog::sync) on a task of
+// its own so the library can be used while books are still being opened.
+// Books are published as soon as they have a title - in the order they were
+// found - and the slow part, decoding covers into thumbnails, happens once
+// the catalog has been written. Decoding is done with a renderer of our own
+// (Renderer::create_measuring_renderer) so the task never touches the
+// framebuffer or the UI's image decoders.
+class LibraryScanner
+{
+private:
+  struct FoundBook
+  {
+    std::string path;
+    std::string title;
+    std::string cover_path;
+    uint16_t current_section;
+    uint16_t current_page;
+    uint16_t pages_in_current_section;
+  };
+
+  std::string m_catalog_path;
+  std::string m_books_path;
+  Renderer *m_renderer;
+  ScanBookLoader m_load_book;
+  ScanThumbnailMaker m_make_thumbnails;
+
+  std::mutex m_mutex;
+  std::condition_variable m_changed;
+  // published books until the catalog is ready
+  std::vector<FoundBook> m_books;
+  // this is published first so it can be opened straight away
+  std::string m_first_path;
+  std::unordered_set<std::string> m_covers_pending;
+  std::vector<std::string> m_covers_ready;
+  bool m_catalog_ready = false;
+  bool m_catalog_ok = false;
+  bool m_finished = false;
+  bool m_running = false;
+  std::atomic<bool> m_stop{false};
+
+#ifdef UNIT_TEST
+  std::thread m_thread;
+#endif
+
+  static void task_entry(void *param);
+  void run();
+  void publish(const EpubListItem &item);
+
+public:
+  // first_book (if there is one) is published straight away - the book that was being read last time.
+  // The scanner owns renderer.
+  LibraryScanner(const std::string &catalog_path, const std::string &books_path, Renderer *renderer,
+                 ScanBookLoader load_book, ScanThumbnailMaker make_thumbnails, const EpubListItem *first_book = nullptr);
+  ~LibraryScanner();
+  LibraryScanner(const LibraryScanner &) = delete;
+  LibraryScanner &operator=(const LibraryScanner &) = delete;
+
+  // give up as soon as possible - the old catalog is left as it was if it hasn't been replaced yet
+  void stop();
+  void wait_until_finished();
+  LibraryScanUpdate take_update();
+
+  // the books found so far, in the order they were found - only until the catalog is ready
+  int get_book_count();
+  int read_page(int first, int count, std::vector<EpubListItem> &items);
+  bool read(int index, EpubListItem &item);
+  // keep the reading position of a book that was opened during the scan
+  void set_position(const EpubListItem &item);
+  // the book's thumbnails haven't been made yet - draw a title card for now
+  bool is_cover_pending(const char *path);
+};
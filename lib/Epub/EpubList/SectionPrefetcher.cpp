@@ -0,0 +1,289 @@
+#ifndef UNIT_TEST
+#include <esp_log.h>
+#include <esp_system.h>
+#include <esp_heap_caps.h>
+#else
+#define ESP_LOGI(args...)
+#define ESP_LOGE(args...)
+#define ESP_LOGW(args...)
+#define ESP_LOGD(args...)
+#define vTaskDelay(t)
+#endif
+#include <chrono>
+#include "SectionPrefetcher.h"
+#include "EpubReader.h"
+#include "../RubbishHtmlParser/RubbishHtmlParser.h"
+
+static const char *TAG = "PREFETCH";
+
+// FreeType and the parser need a fair bit of stack - the main task has 32K
+static const uint32_t PREFETCH_TASK_STACK_SIZE = 20 * 1024;
+
+SectionPrefetcher::SectionPrefetcher(Epub *epub, Renderer *measurer, bool use_justified)
+    : m_epub(epub), m_measurer(measurer), m_use_justified(use_justified)
+{
+  m_running = true;
+#ifdef UNIT_TEST
+  m_thread = std::thread(task_entry, this);
+#else
+  // core 0 is otherwise mostly idle - the UI and display updates run on core 1
+  if (xTaskCreatePinnedToCore(task_entry, "prefetch", PREFETCH_TASK_STACK_SIZE, this, 1, nullptr, 0) != pdPASS)
+  {
+    ESP_LOGE(TAG, "Failed to start the prefetch task");
+    m_running = false;
+  }
+#endif
+}
+
+SectionPrefetcher::~SectionPrefetcher()
+{
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_stop = true;
+    m_abort = true;
+    m_queue.clear();
+    m_changed.notify_all();
+    m_changed.wait(lock, [this]
+                   { return !m_running; });
+  }
+#ifdef UNIT_TEST
+  m_thread.join();
+#endif
+  for (auto &result : m_results)
+  {
+    delete result.parser;
+  }
+}
+
+bool SectionPrefetcher::has_memory_headroom()
+{
+#if defined(UNIT_TEST)
+  return true;
+#elif defined(BOARD_HAS_PSRAM)
+  return heap_caps_get_free_size(MALLOC_CAP_SPIRAM) >= PREFETCH_MIN_FREE_MEMORY;
+#else
+  return esp_get_free_heap_size() >= PREFETCH_MIN_FREE_MEMORY;
+#endif
+}
+
+void SectionPrefetcher::task_entry(void *param)
+{
+  SectionPrefetcher *prefetcher = (SectionPrefetcher *)param;
+  prefetcher->run();
+#ifndef UNIT_TEST
+  // the prefetcher may already be gone - don't touch it after run returns
+  vTaskDelete(nullptr);
+#endif
+}
+
+void SectionPrefetcher::run()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  int backoffs = 0;
+  while (!m_stop)
+  {
+    if (m_queue.empty())
+    {
+      m_changed.wait(lock);
+      continue;
+    }
+    if (!has_memory_headroom())
+    {
+      // give the reader a chance to free something up before we try again
+      if (++backoffs > PREFETCH_MAX_BACKOFFS)
+      {
+        ESP_LOGW(TAG, "Low on memory - not prefetching section %d", m_queue.front().section);
+        m_queue.pop_front();
+        m_dropped++;
+        backoffs = 0;
+        m_changed.notify_all();
+        continue;
+      }
+      m_changed.wait_for(lock, std::chrono::milliseconds(PREFETCH_BACKOFF_MS));
+      continue;
+    }
+    backoffs = 0;
+    m_active = m_queue.front();
+    m_queue.pop_front();
+    m_busy = true;
+    m_abort = false;
+    lock.unlock();
+
+    bool needs_saving = false;
+    RubbishHtmlParser *parser = run_job(m_active, needs_saving);
+
+    lock.lock();
+    m_busy = false;
+    if (parser && !m_abort)
+    {
+      ESP_LOGI(TAG, "Prefetched section %d (%d pages)", m_active.section, parser->get_page_count());
+      m_results.push_back({m_active.section, m_active.layout_key, parser, needs_saving});
+      m_completed++;
+    }
+    else
+    {
+      delete parser;
+      m_dropped++;
+    }
+    m_changed.notify_all();
+  }
+  m_running = false;
+  m_changed.notify_all();
+}
+
+bool SectionPrefetcher::keep_going()
+{
+  if (m_abort)
+  {
+    return false;
+  }
+  if (!has_memory_headroom())
+  {
+    ESP_LOGW(TAG, "Low on memory - giving up on section %d", m_active.section);
+    return false;
+  }
+  // let the idle task on this core feed the watchdog
+  vTaskDelay(1);
+  return true;
+}
+
+RubbishHtmlParser *SectionPrefetcher::run_job(const PrefetchJob &job, bool &needs_saving)
+{
+  RubbishHtmlParser *parser = EpubReader::load_section(m_epub, job.section, job.cache_path, job.layout_key, m_use_justified,
+                                                       needs_saving, [this]
+                                                       { return keep_going(); });
+  if (!parser)
+  {
+    return nullptr;
+  }
+  // a step at a time so we can give up part way through
+  while (!parser->is_layout_complete() && (job.last_page < 0 || parser->get_page_count() - 1 <= job.last_page))
+  {
+    if (!keep_going())
+    {
+      delete parser;
+      return nullptr;
+    }
+    parser->layout_step(m_measurer, m_epub);
+  }
+  return parser;
+}
+
+bool SectionPrefetcher::is_wanted(int section, uint32_t layout_key, const std::vector<PrefetchJob> &jobs)
+{
+  for (auto &job : jobs)
+  {
+    if (job.section == section && job.layout_key == layout_key)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+void SectionPrefetcher::prefetch(const std::vector<PrefetchJob> &jobs)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (auto it = m_results.begin(); it != m_results.end();)
+  {
+    if (is_wanted(it->section, it->layout_key, jobs))
+    {
+      ++it;
+      continue;
+    }
+    delete it->parser;
+    it = m_results.erase(it);
+  }
+  if (m_busy && !is_wanted(m_active.section, m_active.layout_key, jobs))
+  {
+    m_abort = true;
+  }
+  m_queue.clear();
+  for (auto &job : jobs)
+  {
+    bool have_it = m_busy && !m_abort && m_active.section == job.section && m_active.layout_key == job.layout_key;
+    for (auto &result : m_results)
+    {
+      have_it |= result.section == job.section && result.layout_key == job.layout_key;
+    }
+    if (!have_it)
+    {
+      m_queue.push_back(job);
+    }
+  }
+  m_changed.notify_all();
+}
+
+void SectionPrefetcher::keep(int section, uint32_t layout_key, RubbishHtmlParser *parser, bool needs_saving)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (auto it = m_results.begin(); it != m_results.end(); ++it)
+  {
+    if (it->section == section)
+    {
+      delete it->parser;
+      m_results.erase(it);
+      break;
+    }
+  }
+  m_results.push_back({section, layout_key, parser, needs_saving});
+}
+
+RubbishHtmlParser *SectionPrefetcher::take(int section, uint32_t layout_key, bool &needs_saving)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  // it's cheaper to wait for a job that's already started than to start again
+  m_changed.wait(lock, [&]
+                 { return !m_busy || m_abort || m_active.section != section || m_active.layout_key != layout_key; });
+  for (auto it = m_results.begin(); it != m_results.end(); ++it)
+  {
+    if (it->section == section && it->layout_key == layout_key)
+    {
+      RubbishHtmlParser *parser = it->parser;
+      needs_saving = it->needs_saving;
+      m_results.erase(it);
+      m_hits++;
+      return parser;
+    }
+  }
+  // the caller is about to do it - don't do it twice
+  for (auto it = m_queue.begin(); it != m_queue.end(); ++it)
+  {
+    if (it->section == section)
+    {
+      m_queue.erase(it);
+      break;
+    }
+  }
+  return nullptr;
+}
+
+void SectionPrefetcher::cancel()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_queue.clear();
+  if (m_busy)
+  {
+    m_abort = true;
+    m_changed.wait(lock, [this]
+                   { return !m_busy; });
+  }
+  for (auto &result : m_results)
+  {
+    delete result.parser;
+  }
+  m_results.clear();
+}
+
+void SectionPrefetcher::wait_until_idle()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_changed.wait(lock, [this]
+                 { return !m_running || (!m_busy && m_queue.empty()); });
+}
+
+bool SectionPrefetcher::is_busy()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_running && (m_busy || !m_queue.empty());
+}
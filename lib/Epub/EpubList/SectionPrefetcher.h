@@ -0,0 +1,118 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#ifdef UNIT_TEST
+#include <thread>
+#else
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#endif
+
+class Epub;
+class Renderer;
+class RubbishHtmlParser;
+
+// the prefetch task backs off while there is less free memory than this (PSRAM when we have it)
+#if defined(BOARD_HAS_PSRAM)
+static const size_t PREFETCH_MIN_FREE_MEMORY = 1024 * 1024;
+#else
+static const size_t PREFETCH_MIN_FREE_MEMORY = 64 * 1024;
+#endif
+// how long to wait for memory to be freed before trying again, and how many times to try
+static const int PREFETCH_BACKOFF_MS = 2000;
+static const int PREFETCH_MAX_BACKOFFS = 5;
+
+// a section to parse and lay out ahead of time
+struct PrefetchJob
+{
+  int section;
+  // the layout key the section should have - a result is only used if this still matches
+  uint32_t layout_key;
+  // lay out until this page is complete, -1 for the whole section
+  int last_page;
+  std::string cache_path;
+};
+
+// Parses and lays out the sections either side of the one being read on a
+// task of its own (pinned to core 0 - the UI runs on core 1) so turning the
+// page into the next chapter doesn't have to wait for it. Layout is done with
+// a measuring renderer so the task never touches the framebuffer.
+class SectionPrefetcher
+{
+private:
+  struct Result
+  {
+    int section;
+    uint32_t layout_key;
+    RubbishHtmlParser *parser;
+    bool needs_saving;
+  };
+
+  Epub *m_epub;
+  Renderer *m_measurer;
+  bool m_use_justified;
+
+  std::mutex m_mutex;
+  // signalled when a job is queued, a job finishes or we're asked to stop
+  std::condition_variable m_changed;
+  std::deque<PrefetchJob> m_queue;
+  std::vector<Result> m_results;
+  // the job the task is working on
+  bool m_busy = false;
+  PrefetchJob m_active;
+  // set to make the task give up on the job it is working on
+  std::atomic<bool> m_abort{false};
+  bool m_stop = false;
+  bool m_running = false;
+
+  uint32_t m_completed = 0;
+  uint32_t m_hits = 0;
+  uint32_t m_dropped = 0;
+
+#ifdef UNIT_TEST
+  std::thread m_thread;
+#endif
+
+  static void task_entry(void *param);
+  void run();
+  // returns nullptr if the job was cancelled or ran out of memory
+  RubbishHtmlParser *run_job(const PrefetchJob &job, bool &needs_saving);
+  // checked between chunks of work - false if we should give up on the current job
+  bool keep_going();
+  bool is_wanted(int section, uint32_t layout_key, const std::vector<PrefetchJob> &jobs);
+
+public:
+  // the epub and measurer must outlive the prefetcher
+  SectionPrefetcher(Epub *epub, Renderer *measurer, bool use_justified);
+  ~SectionPrefetcher();
+  SectionPrefetcher(const SectionPrefetcher &) = delete;
+  SectionPrefetcher &operator=(const SectionPrefetcher &) = delete;
+
+  // is there enough free memory to prefetch a section?
+  static bool has_memory_headroom();
+
+  // replace what we're prefetching - anything queued, in progress or finished that isn't in jobs is dropped
+  void prefetch(const std::vector<PrefetchJob> &jobs);
+  // keep a section the reader has finished with (e.g. the one before the current one) so going back is quick
+  void keep(int section, uint32_t layout_key, RubbishHtmlParser *parser, bool needs_saving);
+  // hand over a prefetched section - waits if the task is working on it right now.
+  // Returns nullptr if we don't have it, in which case the caller should load it itself.
+  RubbishHtmlParser *take(int section, uint32_t layout_key, bool &needs_saving);
+  // drop everything and wait for the task to stop work - after this returns it isn't using the epub or measurer
+  void cancel();
+  // wait for the queue to empty
+  void wait_until_idle();
+  // true if there is a job in progress or queued
+  bool is_busy();
+
+  uint32_t get_completed() const { return m_completed; }
+  uint32_t get_hits() const { return m_hits; }
+  uint32_t get_dropped() const { return m_dropped; }
+};
@@ -2,7 +2,6 @@
 
 #include <stdint.h>
 
-const int MAX_EPUB_LIST_SIZE = 20;
 const int MAX_PATH_SIZE = 256;
 const int MAX_TITLE_SIZE = 100;
 
@@ -23,7 +22,8 @@ typedef struct
   char cover_path[MAX_PATH_SIZE];
 } EpubListItem;
 
-// this is held in the RTC memory
+// this is held in the RTC memory - the books themselves are in the catalog on the SD card
+// (see EpubCatalog) and only the one being read is kept here
 typedef struct
 {
   int previous_rendered_page;
@@ -32,7 +32,10 @@ typedef struct
   int num_epubs;
   bool is_loaded;
   bool use_grid_view;
-  EpubListItem epub_list[MAX_EPUB_LIST_SIZE];
+  // the book being read and its index in the catalog
+  bool has_current_book;
+  int current_book_index;
+  EpubListItem current_book;
 } EpubListState;
 
 // this is held in the RTC memory
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// Strings copied into a few big blocks instead of being allocated one at a
+// time. Nothing is freed until the arena is - good for tables that are built
+// once, looked up for a while and then thrown away (e.g. an EPUB manifest).
+class StringArena
+{
+private:
+  static const size_t BLOCK_SIZE = 4096;
+  std::vector<char *> m_blocks;
+  // how much of the last block has been handed out
+  size_t m_used = BLOCK_SIZE;
+  size_t m_allocated = 0;
+
+public:
+  StringArena() {}
+  ~StringArena() { clear(); }
+  StringArena(const StringArena &) = delete;
+  StringArena &operator=(const StringArena &) = delete;
+
+  // a null terminated copy of length bytes of text - nullptr if we're out of memory
+  const char *store(const char *text, size_t length)
+  {
+    size_t needed = length + 1;
+    char *dest = nullptr;
+    if (needed > BLOCK_SIZE / 4)
+    {
+      // big strings get a block of their own so they don't waste the end of the current one
+      dest = (char *)malloc(needed);
+      if (!dest)
+      {
+        return nullptr;
+      }
+      // keep the current block at the end so we carry on filling it
+      m_blocks.insert(m_blocks.empty() ? m_blocks.end() : m_blocks.end() - 1, dest);
+      m_allocated += needed;
+    }
+    else
+    {
+      if (m_used + needed > BLOCK_SIZE)
+      {
+        char *block = (char *)malloc(BLOCK_SIZE);
+        if (!block)
+        {
+          return nullptr;
+        }
+        m_blocks.push_back(block);
+        m_used = 0;
+        m_allocated += BLOCK_SIZE;
+      }
+      dest = m_blocks.back() + m_used;
+      m_used += needed;
+    }
+    memcpy(dest, text, length);
+    dest[length] = '\0';
+    return dest;
+  }
+  const char *store(const char *text) { return store(text, strlen(text)); }
+  void clear()
+  {
+    for (char *block : m_blocks)
+    {
+      free(block);
+    }
+    m_blocks.clear();
+    m_used = BLOCK_SIZE;
+    m_allocated = 0;
+  }
+  size_t get_allocated() const { return m_allocated; }
+};
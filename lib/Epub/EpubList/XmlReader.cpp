@@ -0,0 +1,419 @@
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <algorithm>
+#include "XmlReader.h"
+#include "../ZipFile/ZipFile.h"
+
+#ifndef UNIT_TEST
+#include <esp_log.h>
+#else
+#define ESP_LOGE(args...)
+#endif
+
+static const char *TAG = "XML";
+
+// longer tags than this are cut short - the metadata files never get near it
+static const size_t MAX_TAG_LENGTH = 4096;
+// text is passed on in pieces of about this size
+static const size_t MAX_TEXT_LENGTH = 1024;
+// the longest entity we'd decode - &#x10FFFF;
+static const size_t MAX_ENTITY_LENGTH = 10;
+// how much of the stream is inflated at a time
+static const size_t READ_CHUNK_SIZE = 1024;
+
+static bool is_space(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// drop the namespace prefix - dc:title is title
+static const char *local_name(const char *name)
+{
+  const char *colon = strrchr(name, ':');
+  return colon ? colon + 1 : name;
+}
+
+static size_t encode_utf8(uint32_t code_point, char *dest)
+{
+  if (code_point < 0x80)
+  {
+    dest[0] = code_point;
+    return 1;
+  }
+  if (code_point < 0x800)
+  {
+    dest[0] = 0xC0 | (code_point >> 6);
+    dest[1] = 0x80 | (code_point & 0x3F);
+    return 2;
+  }
+  if (code_point < 0x10000)
+  {
+    dest[0] = 0xE0 | (code_point >> 12);
+    dest[1] = 0x80 | ((code_point >> 6) & 0x3F);
+    dest[2] = 0x80 | (code_point & 0x3F);
+    return 3;
+  }
+  dest[0] = 0xF0 | (code_point >> 18);
+  dest[1] = 0x80 | ((code_point >> 12) & 0x3F);
+  dest[2] = 0x80 | ((code_point >> 6) & 0x3F);
+  dest[3] = 0x80 | (code_point & 0x3F);
+  return 4;
+}
+
+XmlReader::XmlReader(XmlHandler *handler) : m_handler(handler)
+{
+}
+
+size_t XmlReader::decode_entities(char *text, size_t length)
+{
+  char *end = text + length;
+  char *dest = (char *)memchr(text, '&', length);
+  if (!dest)
+  {
+    return length;
+  }
+  const char *src = dest;
+  while (src < end)
+  {
+    if (*src != '&')
+    {
+      *dest++ = *src++;
+      continue;
+    }
+    const char *semicolon = (const char *)memchr(src, ';', std::min((size_t)(end - src), MAX_ENTITY_LENGTH + 1));
+    if (!semicolon)
+    {
+      *dest++ = *src++;
+      continue;
+    }
+    const char *name = src + 1;
+    size_t name_length = semicolon - name;
+    char decoded[4];
+    size_t decoded_length = 0;
+    if (name_length > 1 && name[0] == '#')
+    {
+      char *number_end = nullptr;
+      uint32_t code_point = name[1] == 'x' || name[1] == 'X' ? strtoul(name + 2, &number_end, 16) : strtoul(name + 1, &number_end, 10);
+      if (number_end == semicolon && code_point > 0 && code_point <= 0x10FFFF)
+      {
+        decoded_length = encode_utf8(code_point, decoded);
+      }
+    }
+    else if (name_length == 3 && strncmp(name, "amp", 3) == 0)
+    {
+      decoded[0] = '&';
+      decoded_length = 1;
+    }
+    else if (name_length == 2 && strncmp(name, "lt", 2) == 0)
+    {
+      decoded[0] = '<';
+      decoded_length = 1;
+    }
+    else if (name_length == 2 && strncmp(name, "gt", 2) == 0)
+    {
+      decoded[0] = '>';
+      decoded_length = 1;
+    }
+    else if (name_length == 4 && strncmp(name, "quot", 4) == 0)
+    {
+      decoded[0] = '"';
+      decoded_length = 1;
+    }
+    else if (name_length == 4 && strncmp(name, "apos", 4) == 0)
+    {
+      decoded[0] = '\'';
+      decoded_length = 1;
+    }
+    if (decoded_length == 0)
+    {
+      // not one of ours (e.g. an HTML entity) - leave it for whoever uses the text
+      *dest++ = *src++;
+      continue;
+    }
+    // the decoded character is never longer than the entity
+    memcpy(dest, decoded, decoded_length);
+    dest += decoded_length;
+    src = semicolon + 1;
+  }
+  return dest - text;
+}
+
+bool XmlReader::tag_is_complete()
+{
+  if (m_tag.compare(0, 3, "!--") == 0)
+  {
+    return (m_tag.size() >= 5 || m_tag_truncated) && m_tag_tail[0] == '-' && m_tag_tail[1] == '-';
+  }
+  if (m_tag.compare(0, 8, "![CDATA[") == 0)
+  {
+    return (m_tag.size() >= 10 || m_tag_truncated) && m_tag_tail[0] == ']' && m_tag_tail[1] == ']';
+  }
+  return true;
+}
+
+void XmlReader::flush_text()
+{
+  if (m_text.empty())
+  {
+    return;
+  }
+  // text outside the root element is just the whitespace between the prolog and the document
+  if (m_depth > 0 && !m_stopped)
+  {
+    size_t length = decode_entities(m_text.data(), m_text.size());
+    m_handler->text(m_text.data(), length, m_depth - 1);
+  }
+  m_text.clear();
+}
+
+// work out what to do with the tag we've just read
+void XmlReader::process_tag()
+{
+  if (m_tag.empty() || m_tag[0] == '?')
+  {
+    // the XML declaration and processing instructions
+    return;
+  }
+  if (m_tag[0] == '!')
+  {
+    // CDATA is text as it is, anything else (comments, DOCTYPE) we ignore
+    if (m_tag.compare(0, 8, "![CDATA[") == 0 && !m_tag_truncated && m_tag.size() >= 10 && m_depth > 0 && !m_stopped)
+    {
+      m_handler->text(m_tag.data() + 8, m_tag.size() - 10, m_depth - 1);
+    }
+    return;
+  }
+  char *tag = m_tag.data();
+  char *end = tag + m_tag.size();
+  if (tag[0] == '/')
+  {
+    char *name = tag + 1;
+    char *name_end = name;
+    while (name_end < end && !is_space(*name_end))
+    {
+      name_end++;
+    }
+    *name_end = '\0';
+    if (m_depth == 0)
+    {
+      m_error = true;
+      return;
+    }
+    m_depth--;
+    if (!m_stopped)
+    {
+      m_handler->end_element(local_name(name), m_depth);
+    }
+    return;
+  }
+  if (m_depth == 0 && m_seen_root)
+  {
+    // only one root element
+    m_error = true;
+    return;
+  }
+  // <item ... /> - a truncated tag still ends the way the original did
+  bool self_closing = m_tag_truncated ? m_tag_tail[1] == '/' : end[-1] == '/';
+  if (!m_tag_truncated && self_closing)
+  {
+    end--;
+  }
+  *end = '\0';
+  char *name = tag;
+  char *cursor = name;
+  while (cursor < end && !is_space(*cursor))
+  {
+    cursor++;
+  }
+  if (cursor < end)
+  {
+    *cursor++ = '\0';
+  }
+  // name="value" pairs - the names and values are terminated in place
+  m_attributes.clear();
+  while (cursor < end)
+  {
+    while (cursor < end && is_space(*cursor))
+    {
+      cursor++;
+    }
+    char *attribute_name = cursor;
+    while (cursor < end && *cursor != '=' && !is_space(*cursor))
+    {
+      cursor++;
+    }
+    char *attribute_name_end = cursor;
+    while (cursor < end && is_space(*cursor))
+    {
+      cursor++;
+    }
+    if (cursor >= end || *cursor != '=' || attribute_name_end == attribute_name)
+    {
+      // a name on its own (or a value without one) isn't XML - skip it
+      if (cursor < end && cursor == attribute_name)
+      {
+        cursor++;
+      }
+      continue;
+    }
+    *attribute_name_end = '\0';
+    cursor++;
+    while (cursor < end && is_space(*cursor))
+    {
+      cursor++;
+    }
+    char *value = cursor;
+    char *value_end = nullptr;
+    if (cursor < end && (*cursor == '"' || *cursor == '\''))
+    {
+      char quote = *cursor;
+      value = ++cursor;
+      value_end = (char *)memchr(cursor, quote, end - cursor);
+      if (!value_end)
+      {
+        // cut off by truncation - the value is lost
+        break;
+      }
+      cursor = value_end + 1;
+    }
+    else
+    {
+      while (cursor < end && !is_space(*cursor))
+      {
+        cursor++;
+      }
+      value_end = cursor;
+      if (cursor < end)
+      {
+        cursor++;
+      }
+    }
+    value[decode_entities(value, value_end - value)] = '\0';
+    m_attributes.push_back({local_name(attribute_name), value});
+  }
+  m_seen_root = true;
+  if (!m_stopped)
+  {
+    m_handler->start_element(local_name(name), m_depth, m_attributes.data(), m_attributes.size());
+  }
+  if (self_closing)
+  {
+    if (!m_stopped)
+    {
+      m_handler->end_element(local_name(name), m_depth);
+    }
+  }
+  else
+  {
+    m_depth++;
+  }
+}
+
+void XmlReader::feed(const char *data, size_t length)
+{
+  size_t index = 0;
+  while (index < length && !m_stopped)
+  {
+    if (m_state == IN_TEXT)
+    {
+      const char *tag_start = (const char *)memchr(data + index, '<', length - index);
+      size_t text_end = tag_start ? tag_start - data : length;
+      m_text.append(data + index, text_end - index);
+      index = text_end;
+      if (tag_start)
+      {
+        flush_text();
+        m_state = IN_TAG;
+        m_tag.clear();
+        m_tag_truncated = false;
+        m_tag_tail[0] = m_tag_tail[1] = 0;
+        m_quote = 0;
+        index++;
+      }
+      else if (m_text.size() > MAX_TEXT_LENGTH)
+      {
+        // pass on what we have but keep back anything that could be the start of an entity
+        size_t split = m_text.size();
+        size_t ampersand = m_text.find_last_of('&');
+        if (ampersand != std::string::npos && m_text.size() - ampersand <= MAX_ENTITY_LENGTH)
+        {
+          split = ampersand;
+        }
+        std::string remainder = m_text.substr(split);
+        m_text.resize(split);
+        flush_text();
+        m_text = remainder;
+      }
+    }
+    else
+    {
+      char c = data[index++];
+      if (m_quote)
+      {
+        if (c == m_quote)
+        {
+          m_quote = 0;
+        }
+      }
+      else if (c == '>' && tag_is_complete())
+      {
+        process_tag();
+        m_state = IN_TEXT;
+        continue;
+      }
+      else if ((c == '"' || c == '\'') && !m_tag.empty() && m_tag[0] != '!' && m_tag[0] != '?')
+      {
+        m_quote = c;
+      }
+      if (m_tag.size() < MAX_TAG_LENGTH)
+      {
+        m_tag += c;
+      }
+      else
+      {
+        m_tag_truncated = true;
+      }
+      m_tag_tail[0] = m_tag_tail[1];
+      m_tag_tail[1] = c;
+    }
+  }
+}
+
+bool XmlReader::finish()
+{
+  if (m_stopped)
+  {
+    // the handler got what it wanted - the rest of the document doesn't matter
+    return true;
+  }
+  if (m_state == IN_TEXT)
+  {
+    flush_text();
+  }
+  bool ok = !m_error && m_seen_root && m_depth == 0 && m_state == IN_TEXT;
+  m_state = IN_TEXT;
+  m_text.clear();
+  m_tag.clear();
+  return ok;
+}
+
+bool XmlReader::read_stream(ZipFileStream *stream)
+{
+  char buffer[READ_CHUNK_SIZE];
+  while (!m_stopped && !stream->is_finished())
+  {
+    size_t read = stream->read((uint8_t *)buffer, sizeof(buffer));
+    if (read == 0)
+    {
+      break;
+    }
+    feed(buffer, read);
+  }
+  if (stream->has_error())
+  {
+    ESP_LOGE(TAG, "Failed to inflate the document");
+    return false;
+  }
+  return finish();
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+class ZipFileStream;
+
+struct XmlAttribute
+{
+  const char *name;
+  const char *value;
+};
+
+// What the XmlReader finds as it goes. Names are local names - any namespace
+// prefix (dc:, opf:) is dropped. Depth is 0 for the root element and text is
+// reported at the depth of the element it's in. Everything passed in is only
+// valid until the callback returns.
+class XmlHandler
+{
+public:
+  virtual ~XmlHandler() {}
+  virtual void start_element(const char *name, int depth, const XmlAttribute *attributes, int attribute_count) {}
+  virtual void end_element(const char *name, int depth) {}
+  virtual void text(const char *text, size_t length, int depth) {}
+};
+
+// A small streaming XML reader for the EPUB metadata files (container.xml,
+// the OPF and the NCX). It is fed the document a chunk at a time and only
+// ever keeps the current tag and run of text, so nothing is inflated in one
+// go and no document tree is built. Entities are decoded in text and
+// attribute values; DTDs and processing instructions are skipped.
+class XmlReader
+{
+private:
+  enum TokenizerState
+  {
+    IN_TEXT,
+    IN_TAG,
+  };
+  XmlHandler *m_handler;
+  TokenizerState m_state = IN_TEXT;
+  // quote character if we are inside a quoted attribute value
+  char m_quote = 0;
+  // the contents of the tag we are currently reading (without the < and >)
+  std::string m_tag;
+  bool m_tag_truncated = false;
+  // the last two characters of the tag - enough to spot the end of a comment or CDATA section
+  char m_tag_tail[2] = {0, 0};
+  std::string m_text;
+  std::vector<XmlAttribute> m_attributes;
+  int m_depth = 0;
+  bool m_seen_root = false;
+  bool m_error = false;
+  bool m_stopped = false;
+
+  bool tag_is_complete();
+  void process_tag();
+  void flush_text();
+
+public:
+  XmlReader(XmlHandler *handler);
+  void feed(const char *data, size_t length);
+  // the end of the document - false if it wasn't well formed (no root element, elements left open or closed twice)
+  bool finish();
+  // read the rest of the stream through the reader and finish
+  bool read_stream(ZipFileStream *stream);
+  // the handler has everything it wants - nothing more is reported
+  void stop() { m_stopped = true; }
+  bool is_stopped() const { return m_stopped; }
+  // decode the XML entities in text in place - returns the new length
+  static size_t decode_entities(char *text, size_t length);
+};
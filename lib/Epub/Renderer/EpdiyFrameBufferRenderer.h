@@ -16,7 +16,9 @@
 #endif
 
 #include <math.h>
+#include <algorithm>
 #include "Renderer.h"
+#include "GlyphBlitter.h"
 #include "miniz.h"
 
 #ifdef USE_FREETYPE
@@ -38,7 +40,11 @@ protected:
   uint8_t *m_frame_buffer;
   EpdFontProperties m_font_props;
   uint8_t gamma_curve[256] = {0};
+  GlyphBlitter glyph_blitter;
   bool needs_gray_flush = false;
+  // the display's framebuffer while we're drawing into a page buffer off screen
+  uint8_t *m_screen_buffer = nullptr;
+  bool m_screen_needs_gray_flush = false;
 
 #ifdef USE_FREETYPE
   FreeTypeFont *m_freetype_font = nullptr;
@@ -85,6 +91,7 @@ public:
     {
       gamma_curve[gray_value] = round(255 * pow(gray_value / 255.0, GAMMA_VALUE));
     }
+    glyph_blitter.init(gamma_curve);
   }
   virtual ~EpdiyFrameBufferRenderer()
   {
@@ -214,65 +221,94 @@ public:
     needs_gray(corrected_color);
     epd_draw_pixel(x + margin_left, y + margin_top, corrected_color, m_frame_buffer);
   }
+  // write glyphs straight into the framebuffer - this relies on the EPD_ROT_INVERTED_PORTRAIT rotation set above
+  virtual void draw_glyph(int x, int y, int width, int height, const uint8_t *coverage, int pitch) override
+  {
+    if (glyph_blitter.blit(m_frame_buffer, EPD_WIDTH, EPD_HEIGHT, x + margin_left, y + margin_top, width, height, coverage, pitch))
+    {
+      needs_gray_flush = true;
+    }
+  }
+  // draw an 8 bit gray bitmap - this relies on the EPD_ROT_INVERTED_PORTRAIT rotation set above
   virtual void draw_pixels(int x, int y, int width, int height, const uint8_t *data) override
   {
-      if (width <= 0 || height <= 0) return;
-      
-      // Calculate adjusted bounds within the display area
-      int start_x = x + margin_left;
-      int start_y = y + margin_top;
-
-      // Inverted portrait rotation for Paper S3:
-      // Logical (x, y) maps to physical (EPD_WIDTH - 1 - y, x)
-      // Since EPD_ROT_INVERTED_PORTRAIT is set, epd_draw_pixel does this transform.
-      // We want to write directly to m_frame_buffer (which is physical landscape, EPD_WIDTH x EPD_HEIGHT).
-      
-      // BUT: Epdiy's m_frame_buffer is 1 byte per pixel. Physical layout is row-major.
-      // Physical Resolution: 960x540.
-      // Logical Resolution: 540x960.
-      
-      // The epd_draw_pixel implementation for EPD_ROT_INVERTED_PORTRAIT:
-      // _epd_draw_pixel(EPD_WIDTH - 1 - y, x, color, framebuffer);
-      // Where EPD_WIDTH = 960 (physical width).
-      
-      // So for a logical block at (start_x, start_y) of size (width, height):
-      // Logical x varies: start_x to start_x + width - 1
-      // Logical y varies: start_y to start_y + height - 1
-      
-      // Physical x = EPD_WIDTH - 1 - logical_y
-      // Physical y = logical_x
-      
-      // This means a logical row (constant logical y, varying logical x) becomes a vertical column in physical memory.
-      // A logical column (constant logical x, varying logical y) becomes a horizontal row in physical memory (reversed).
-      
-      // Optimizing this block transfer is tricky because it's not contiguous in physical memory.
-      // However, we can avoid the function call overhead and duplicate gamma lookup.
-      
-      needs_gray_flush = true; // Assume we are drawing non-white/black pixels
-      
-      for (int dy = 0; dy < height; ++dy)
+    // logical (x, y) is physical (y, EPD_HEIGHT - 1 - x) so each column of the
+    // bitmap is a run of nibbles along one physical row of the framebuffer
+    int start_x = x + margin_left;
+    int start_y = y + margin_top;
+    int col_start = std::max(0, -start_x);
+    int col_end = std::min(width, EPD_HEIGHT - start_x);
+    int row_start = std::max(0, -start_y);
+    int row_end = std::min(height, EPD_WIDTH - start_y);
+    bool gray = false;
+    for (int col = col_start; col < col_end; col++)
+    {
+      uint8_t *line = m_frame_buffer + (EPD_HEIGHT - 1 - (start_x + col)) * (EPD_WIDTH / 2);
+      for (int row = row_start; row < row_end; row++)
       {
-          int logical_y = start_y + dy;
-          // Pre-calculate physical X for this row
-          int phys_x = EPD_WIDTH - 1 - logical_y;
-          
-          if (phys_x < 0 || phys_x >= EPD_WIDTH) continue;
-
-          for (int dx = 0; dx < width; ++dx)
-          {
-             int logical_x = start_x + dx;
-             int phys_y = logical_x;
-             
-             if (phys_y < 0 || phys_y >= EPD_HEIGHT) continue;
-             
-             uint8_t color = data[dy * width + dx];
-             
-             // Direct framebuffer access
-             // Framebuffer is EPD_WIDTH * EPD_HEIGHT bytes
-             // Index = phys_y * EPD_WIDTH + phys_x
-             m_frame_buffer[phys_y * EPD_WIDTH + phys_x] = gamma_curve[color];
-          }
+        uint8_t color = gamma_curve[data[row * width + col]];
+        gray |= color != 0 && color != 255;
+        int phys_x = start_y + row;
+        uint8_t *dest = line + phys_x / 2;
+        if (phys_x & 1)
+        {
+          *dest = (*dest & 0x0F) | (color & 0xF0);
+        }
+        else
+        {
+          *dest = (*dest & 0xF0) | (color >> 4);
+        }
+      }
+    }
+    if (gray)
+    {
+      needs_gray_flush = true;
+    }
+  }
+  // draw a packed 4 bit gray bitmap - same walk as draw_pixels with the gamma applied to the 16 levels up front
+  virtual void draw_packed_gray(int x, int y, int width, int height, const uint8_t *data) override
+  {
+    uint8_t levels[16];
+    bool level_is_gray[16];
+    for (int i = 0; i < 16; i++)
+    {
+      levels[i] = gamma_curve[i * 17] >> 4;
+      level_is_gray[i] = levels[i] != 0 && levels[i] != 15;
+    }
+    int stride = (width + 1) / 2;
+    int start_x = x + margin_left;
+    int start_y = y + margin_top;
+    int col_start = std::max(0, -start_x);
+    int col_end = std::min(width, EPD_HEIGHT - start_x);
+    int row_start = std::max(0, -start_y);
+    int row_end = std::min(height, EPD_WIDTH - start_y);
+    bool gray = false;
+    for (int col = col_start; col < col_end; col++)
+    {
+      uint8_t *line = m_frame_buffer + (EPD_HEIGHT - 1 - (start_x + col)) * (EPD_WIDTH / 2);
+      const uint8_t *src = data + col / 2;
+      int shift = (col & 1) ? 0 : 4;
+      for (int row = row_start; row < row_end; row++)
+      {
+        uint8_t level = (src[row * stride] >> shift) & 0x0F;
+        gray |= level_is_gray[level];
+        uint8_t color = levels[level];
+        int phys_x = start_y + row;
+        uint8_t *dest = line + phys_x / 2;
+        if (phys_x & 1)
+        {
+          *dest = (*dest & 0x0F) | (color << 4);
+        }
+        else
+        {
+          *dest = (*dest & 0xF0) | color;
+        }
       }
+    }
+    if (gray)
+    {
+      needs_gray_flush = true;
+    }
   }
   virtual void draw_circle(int x, int y, int r, uint8_t color = 0)
   {
@@ -405,7 +441,50 @@ public:
     }
     return success;
   }
+  virtual size_t get_page_buffer_size() override
+  {
+    return EPD_WIDTH * EPD_HEIGHT / 2;
+  }
+  virtual bool begin_offscreen(uint8_t *buffer) override
+  {
+    if (m_screen_buffer || !m_frame_buffer)
+    {
+      return false;
+    }
+    m_screen_buffer = m_frame_buffer;
+    m_screen_needs_gray_flush = needs_gray_flush;
+    m_frame_buffer = buffer;
+    needs_gray_flush = false;
+    return true;
+  }
+  virtual bool end_offscreen() override
+  {
+    if (!m_screen_buffer)
+    {
+      return false;
+    }
+    bool drew_gray = needs_gray_flush;
+    m_frame_buffer = m_screen_buffer;
+    needs_gray_flush = m_screen_needs_gray_flush;
+    m_screen_buffer = nullptr;
+    return drew_gray;
+  }
+  // subclasses mustn't flush while we're drawing off screen
+  bool is_offscreen() const
+  {
+    return m_screen_buffer != nullptr;
+  }
+  virtual void save_page(uint8_t *buffer) override
+  {
+    memcpy(buffer, m_frame_buffer, EPD_WIDTH * EPD_HEIGHT / 2);
+  }
+  virtual void restore_page(const uint8_t *buffer, bool has_gray) override
+  {
+    memcpy(m_frame_buffer, buffer, EPD_WIDTH * EPD_HEIGHT / 2);
+    needs_gray_flush |= has_gray;
+  }
   virtual void reset() = 0;
+  virtual Renderer *create_measuring_renderer() override;
 
 #ifdef USE_FREETYPE
   virtual void set_freetype_font_for_reading(FreeTypeFont *font) override
@@ -435,4 +514,91 @@ public:
     return m_freetype_font->set_pixel_height(pixel_height);
   }
 #endif
-};
\ No newline at end of file
+};
+
+// Measures text exactly like the renderer it was made from but has no
+// framebuffer - anything it is asked to draw is dropped. The section prefetch
+// task lays sections out with one of these on core 0 while the real renderer
+// keeps drawing on core 1.
+class EpdiyMeasuringRenderer : public EpdiyFrameBufferRenderer
+{
+public:
+  EpdiyMeasuringRenderer(
+      const EpdFont *regular_font,
+      const EpdFont *bold_font,
+      const EpdFont *italic_font,
+      const EpdFont *bold_italic_font)
+      : EpdiyFrameBufferRenderer(regular_font, bold_font, italic_font, bold_italic_font, nullptr, 0, 0)
+  {
+    m_frame_buffer = nullptr;
+  }
+  ~EpdiyMeasuringRenderer()
+  {
+#ifdef USE_FREETYPE
+    delete m_freetype_font;
+#endif
+  }
+#ifdef USE_FREETYPE
+  // FreeType faces can't be shared between tasks so we open our own copy of the reading font
+  bool open_freetype_font(const FreeTypeFont *font)
+  {
+    FreeTypeFont *own_font = new FreeTypeFont();
+    if (!own_font->init(font->get_font_path().c_str(), font->get_pixel_height()))
+    {
+      delete own_font;
+      return false;
+    }
+    // we never draw so there's no point caching rendered glyphs
+    own_font->set_glyph_cache_budget(0);
+    delete m_freetype_font;
+    m_freetype_font = own_font;
+    m_freetype_enabled = true;
+    return true;
+  }
+#endif
+  void show_busy() {}
+  void show_img(int x, int y, int width, int height, const uint8_t *img_buffer) {}
+  void draw_text(int x, int y, const char *text, bool bold = false, bool italic = false) {}
+  void draw_rect(int x, int y, int width, int height, uint8_t color = 0) {}
+  void fill_rect(int x, int y, int width, int height, uint8_t color = 0) {}
+  void fill_circle(int x, int y, int r, uint8_t color = 0) {}
+  void fill_triangle(int x0, int y0, int x1, int y1, int x2, int y2, uint8_t color) {}
+  void draw_triangle(int x0, int y0, int x1, int y1, int x2, int y2, uint8_t color) {}
+  void draw_pixel(int x, int y, uint8_t color) {}
+  void draw_glyph(int x, int y, int width, int height, const uint8_t *coverage, int pitch) {}
+  void draw_pixels(int x, int y, int width, int height, const uint8_t *data) {}
+  void draw_packed_gray(int x, int y, int width, int height, const uint8_t *data) {}
+  void draw_circle(int x, int y, int r, uint8_t color = 0) {}
+  void flush_display() {}
+  void flush_area(int x, int y, int width, int height) {}
+  void clear_screen() {}
+  bool dehydrate() { return false; }
+  bool hydrate() { return false; }
+  void reset() {}
+  Renderer *create_measuring_renderer() { return nullptr; }
+  size_t get_page_buffer_size() { return 0; }
+  bool begin_offscreen(uint8_t *buffer) { return false; }
+#ifdef USE_FREETYPE
+  // the font belongs to us - it can't be swapped or resized under the prefetch task
+  void set_freetype_font_for_reading(FreeTypeFont *font) {}
+  bool set_reading_font_pixel_height(int pixel_height) { return false; }
+#endif
+};
+
+inline Renderer *EpdiyFrameBufferRenderer::create_measuring_renderer()
+{
+  EpdiyMeasuringRenderer *measurer = new EpdiyMeasuringRenderer(m_regular_font, m_bold_font, m_italic_font, m_bold_italic_font);
+  measurer->set_margin_top(margin_top);
+  measurer->set_margin_bottom(margin_bottom);
+  measurer->set_margin_left(margin_left);
+  measurer->set_margin_right(margin_right);
+#ifdef USE_FREETYPE
+  if (m_freetype_enabled && m_freetype_font && m_freetype_font->is_valid() && !measurer->open_freetype_font(m_freetype_font))
+  {
+    ESP_LOGE("EPD", "Failed to open the reading font for measuring");
+    delete measurer;
+    return nullptr;
+  }
+#endif
+  return measurer;
+}
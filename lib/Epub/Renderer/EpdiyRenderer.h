@@ -12,6 +12,7 @@ extern const EpdBoardDefinition paper_s3_board;
 #endif
 
 #include <math.h>
+#include <esp_timer.h>
 #include "EpdiyFrameBufferRenderer.h"
 #include "miniz.h"
 
@@ -36,11 +37,11 @@ public:
     // For Paper S3 we use the new epdiy API with a custom board definition
     epd_set_board(&paper_s3_board);
     epd_init(epd_current_board(), &ED047TC2, EPD_OPTIONS_DEFAULT);
-    // The C fallback for the ESP32-S3 LUT path is slower than the original
-    // vector assembly, so a 20 MHz pixel clock can cause line buffer underruns
-    // (EPD_DRAW_EMPTY_LINE_QUEUE). Run the LCD at 5 MHz instead for stability
-    // on lower CPU clock configurations.
-    epd_set_lcd_pixel_clock_MHz(5);
+    // The LUT lookup and line interlacing use the S3 vector extensions
+    // (lut.S / diff.S), which keep up with the panel's 20 MHz pixel clock
+    // even at 160 MHz CPU. If the line queue ever runs dry
+    // (EPD_DRAW_EMPTY_LINE_QUEUE) drop this back down.
+    epd_set_lcd_pixel_clock_MHz(20);
 #else
     // Legacy epdiy API used by ESP32-based boards
     epd_init(EPD_OPTIONS_DEFAULT);
@@ -61,11 +62,22 @@ public:
   }
   void flush_display()
   {
-    epd_hl_update_screen(&m_hl, needs_gray_flush ? MODE_GC16 : MODE_DU, temperature);
+    if (is_offscreen())
+    {
+      return;
+    }
+    int64_t start = esp_timer_get_time();
+    bool gray = needs_gray_flush;
+    epd_hl_update_screen(&m_hl, gray ? MODE_GC16 : MODE_DU, temperature);
     needs_gray_flush = false;
+    ESP_LOGI("EPD", "Flushed the display (%s) in %dms", gray ? "GC16" : "DU", (int)((esp_timer_get_time() - start) / 1000));
   }
   void flush_area(int x, int y, int width, int height)
   {
+    if (is_offscreen())
+    {
+      return;
+    }
     epd_hl_update_area(&m_hl, MODE_DU, temperature, {.x = x, .y = y, .width = width, .height = height});
   }
   virtual void reset()
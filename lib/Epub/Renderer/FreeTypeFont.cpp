@@ -56,10 +56,39 @@ static unsigned int utf8_next_codepoint(const unsigned char *&p)
   return 0;
 }
 
+// Work out the advance of the glyph in the slot in pixels. If it somehow
+// ends up as zero, fall back to a small reasonable width so that
+// characters do not collapse on top of each other.
+static int glyph_advance(FT_GlyphSlot slot, int pixel_height)
+{
+  int advance = static_cast<int>(slot->advance.x >> 6);
+  if (advance <= 0)
+  {
+    int metrics_advance = static_cast<int>(slot->metrics.horiAdvance >> 6);
+    if (metrics_advance > 0)
+    {
+      advance = metrics_advance;
+    }
+    else
+    {
+      // Fallback: treat the glyph as at least half a cell wide.
+      advance = pixel_height > 0 ? pixel_height / 2 : 1;
+    }
+  }
+  return advance;
+}
+
 FreeTypeFont::FreeTypeFont() {}
 
 FreeTypeFont::~FreeTypeFont()
 {
+  m_glyph_cache.clear();
+  for (auto metrics : m_size_metrics)
+  {
+    delete metrics;
+  }
+  m_size_metrics.clear();
+  m_metrics = nullptr;
   if (m_face)
   {
     FT_Done_Face(m_face);
@@ -108,8 +137,11 @@ bool FreeTypeFont::init(const char *font_path, int pixel_height)
     return false;
   }
 
+  m_font_path = font_path;
   m_pixel_height = pixel_height;
+  m_has_kerning = FT_HAS_KERNING(m_face);
   m_initialized = true;
+  select_size_metrics();
   return true;
 }
 
@@ -127,9 +159,86 @@ bool FreeTypeFont::set_pixel_height(int pixel_height)
   }
 
   m_pixel_height = pixel_height;
+  select_size_metrics();
   return true;
 }
 
+// measurements are per pixel size - keep the tables for every size we've
+// used as the reader only ever cycles between a few
+void FreeTypeFont::select_size_metrics()
+{
+  for (auto metrics : m_size_metrics)
+  {
+    if (metrics->pixel_height == m_pixel_height)
+    {
+      m_metrics = metrics;
+      return;
+    }
+  }
+  m_metrics = new SizeMetrics();
+  m_metrics->pixel_height = m_pixel_height;
+  memset(m_metrics->latin1, 0, sizeof(m_metrics->latin1));
+  m_size_metrics.push_back(m_metrics);
+}
+
+const FreeTypeFont::GlyphMetrics &FreeTypeFont::get_metrics(uint32_t codepoint) const
+{
+  GlyphMetrics &metrics = codepoint < 256 ? m_metrics->latin1[codepoint] : m_metrics->other[codepoint];
+  if (!metrics.loaded)
+  {
+    metrics.loaded = true;
+    metrics.glyph_index = FT_Get_Char_Index(m_face, codepoint);
+    metrics.valid = FT_Load_Glyph(m_face, metrics.glyph_index, FT_LOAD_DEFAULT) == 0;
+    metrics.advance = metrics.valid ? glyph_advance(m_face->glyph, m_pixel_height) : 0;
+  }
+  return metrics;
+}
+
+int FreeTypeFont::get_kerning(FT_UInt left, FT_UInt right) const
+{
+  if (!m_has_kerning || left == 0 || right == 0)
+  {
+    return 0;
+  }
+  uint64_t key = ((uint64_t)left << 32) | right;
+  auto it = m_metrics->kerning.find(key);
+  if (it != m_metrics->kerning.end())
+  {
+    return it->second;
+  }
+  FT_Vector delta = {0, 0};
+  FT_Get_Kerning(m_face, left, right, FT_KERNING_DEFAULT, &delta);
+  int kerning = static_cast<int>(delta.x >> 6);
+  // don't let the table grow without bound on books with huge character sets
+  if (m_metrics->kerning.size() > 8192)
+  {
+    m_metrics->kerning.clear();
+  }
+  m_metrics->kerning[key] = kerning;
+  return kerning;
+}
+
+// find the rendered glyph in the cache or render it and add it
+const CachedGlyph *FreeTypeFont::get_glyph(uint32_t codepoint, const GlyphMetrics &metrics, bool &rendered) const
+{
+  rendered = false;
+  uint32_t key = GlyphCache::make_key(m_pixel_height, codepoint);
+  const CachedGlyph *glyph = m_glyph_cache.find(key);
+  if (glyph)
+  {
+    return glyph;
+  }
+  if (FT_Load_Glyph(m_face, metrics.glyph_index, FT_LOAD_DEFAULT) != 0 ||
+      FT_Render_Glyph(m_face->glyph, FT_RENDER_MODE_NORMAL) != 0)
+  {
+    return nullptr;
+  }
+  rendered = true;
+  FT_GlyphSlot slot = m_face->glyph;
+  return m_glyph_cache.insert(key, slot->bitmap_left, slot->bitmap_top, slot->bitmap.width, slot->bitmap.rows,
+                              slot->bitmap.buffer, slot->bitmap.pitch);
+}
+
 int FreeTypeFont::get_text_width(const char *text) const
 {
   if (!m_initialized || !text)
@@ -138,6 +247,7 @@ int FreeTypeFont::get_text_width(const char *text) const
   }
 
   int width = 0;
+  FT_UInt previous = 0;
   const unsigned char *p = reinterpret_cast<const unsigned char *>(text);
 
   while (*p)
@@ -148,28 +258,11 @@ int FreeTypeFont::get_text_width(const char *text) const
       continue;
     }
 
-    FT_UInt glyph_index = FT_Get_Char_Index(m_face, codepoint);
-    FT_Error err = FT_Load_Glyph(m_face, glyph_index, FT_LOAD_DEFAULT);
-    if (err == 0)
+    const GlyphMetrics &metrics = get_metrics(codepoint);
+    if (metrics.valid)
     {
-      // Use the horizontal advance in pixels; if it somehow ends up
-      // as zero, fall back to a small reasonable width so that
-      // characters do not collapse on top of each other.
-      int advance = static_cast<int>(m_face->glyph->advance.x >> 6);
-      if (advance <= 0)
-      {
-        int metrics_advance = static_cast<int>(m_face->glyph->metrics.horiAdvance >> 6);
-        if (metrics_advance > 0)
-        {
-          advance = metrics_advance;
-        }
-        else
-        {
-          // Fallback: treat the glyph as at least half a cell wide.
-          advance = m_pixel_height > 0 ? m_pixel_height / 2 : 1;
-        }
-      }
-      width += advance;
+      width += get_kerning(previous, metrics.glyph_index) + metrics.advance;
+      previous = metrics.glyph_index;
     }
   }
 
@@ -213,6 +306,7 @@ void FreeTypeFont::draw_text(Renderer *renderer, int x, int y, const char *text)
   // Place baseline roughly at y + pixel_height. This can be refined
   // later using ascender/descender metrics.
   int baseline_y = y + m_pixel_height;
+  FT_UInt previous = 0;
 
   const unsigned char *p = reinterpret_cast<const unsigned char *>(text);
 
@@ -224,77 +318,30 @@ void FreeTypeFont::draw_text(Renderer *renderer, int x, int y, const char *text)
       continue;
     }
 
-    FT_UInt glyph_index = FT_Get_Char_Index(m_face, codepoint);
-    FT_Error err = FT_Load_Glyph(m_face, glyph_index, FT_LOAD_DEFAULT);
-    if (err != 0)
+    // advances and kerning come from the same tables as get_text_width so
+    // what we draw always matches what was measured during layout
+    const GlyphMetrics &metrics = get_metrics(codepoint);
+    if (!metrics.valid)
     {
-      ++p;
       continue;
     }
+    pen_x += get_kerning(previous, metrics.glyph_index);
+    previous = metrics.glyph_index;
 
-    err = FT_Render_Glyph(m_face->glyph, FT_RENDER_MODE_NORMAL);
-    if (err != 0)
+    bool rendered = false;
+    const CachedGlyph *glyph = get_glyph(codepoint, metrics, rendered);
+    if (glyph)
     {
-      ++p;
-      continue;
+      renderer->draw_glyph(pen_x + glyph->left, baseline_y - glyph->top, glyph->width, glyph->rows, glyph->bitmap, glyph->width);
     }
-
-    FT_GlyphSlot slot = m_face->glyph;
-    FT_Bitmap &bmp = slot->bitmap;
-
-    int glyph_x = pen_x + slot->bitmap_left;
-    int glyph_y = baseline_y - slot->bitmap_top;
-
-    for (int row = 0; row < static_cast<int>(bmp.rows); ++row)
-    {
-      const unsigned char *src = bmp.buffer + row * bmp.pitch;
-      for (int col = 0; col < static_cast<int>(bmp.width); ++col)
-      {
-        unsigned char alpha = src[col];
-        if (alpha == 0)
-        {
-          continue;
-        }
-        // On Paper S3 we favor strong contrast over subtle
-        // antialiasing because the grayscale gamma curve tends to
-        // wash out light text. Use a simple alpha threshold to draw
-        // solid black text.
-#if defined(BOARD_TYPE_PAPER_S3)
-        if (alpha > 64)
-        {
-          renderer->draw_pixel(glyph_x + col, glyph_y + row, 0);
-        }
-#else
-        // Default path: map alpha (0 = transparent, 255 = solid) to
-        // a grayscale value (0 = black, 255 = white) by inverting it.
-        uint8_t gray = static_cast<uint8_t>(255 - alpha);
-        renderer->draw_pixel(glyph_x + col, glyph_y + row, gray);
-#endif
-      }
-    }
-
-    int advance = static_cast<int>(slot->advance.x >> 6);
-    if (advance <= 0)
+    else if (rendered)
     {
-      int metrics_advance = static_cast<int>(slot->metrics.horiAdvance >> 6);
-      if (metrics_advance > 0)
-      {
-        advance = metrics_advance;
-      }
-      else
-      {
-        int bitmap_width = static_cast<int>(bmp.width);
-        if (bitmap_width > 0)
-        {
-          advance = bitmap_width;
-        }
-        else
-        {
-          advance = m_pixel_height > 0 ? m_pixel_height / 2 : 1;
-        }
-      }
+      // too big to cache - draw straight from the glyph slot
+      FT_GlyphSlot slot = m_face->glyph;
+      renderer->draw_glyph(pen_x + slot->bitmap_left, baseline_y - slot->bitmap_top, slot->bitmap.width, slot->bitmap.rows,
+                           slot->bitmap.buffer, slot->bitmap.pitch);
     }
-    pen_x += advance;
+    pen_x += metrics.advance;
   }
 }
 
@@ -8,9 +8,20 @@
 
 #include <ft2build.h>
 #include FT_FREETYPE_H
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "GlyphCache.h"
 
 class Renderer;
 
+#if defined(BOARD_HAS_PSRAM)
+static const size_t FREETYPE_GLYPH_CACHE_BUDGET = 256 * 1024;
+#else
+static const size_t FREETYPE_GLYPH_CACHE_BUDGET = 32 * 1024;
+#endif
+
 class FreeTypeFont
 {
 public:
@@ -31,6 +42,8 @@ public:
   void draw_text(Renderer *renderer, int x, int y, const char *text) const;
 
   bool is_valid() const { return m_initialized; }
+  // the file the face was loaded from - used to open another copy for a different task
+  const std::string &get_font_path() const { return m_font_path; }
 
   // Return the recommended line height in pixels based on the current
   // font metrics.
@@ -44,11 +57,47 @@ public:
   // success and leaves the previous size unchanged on failure.
   bool set_pixel_height(int pixel_height);
 
+  // Rendered glyphs are kept in an LRU cache. The budget is in bytes and
+  // the cache's hit/miss counters can be read back to tune it.
+  void set_glyph_cache_budget(size_t bytes) { m_glyph_cache.set_budget(bytes); }
+  const GlyphCache &get_glyph_cache() const { return m_glyph_cache; }
+
 private:
+  // What we need to measure a glyph at one pixel size - filled in the
+  // first time each code point is seen so measuring text is just lookups.
+  struct GlyphMetrics
+  {
+    FT_UInt glyph_index;
+    int16_t advance;
+    bool loaded;
+    bool valid;
+  };
+  struct SizeMetrics
+  {
+    int pixel_height;
+    // Latin-1 covers nearly everything in most books so gets a flat table
+    GlyphMetrics latin1[256];
+    std::unordered_map<uint32_t, GlyphMetrics> other;
+    // kerning in pixels keyed by (left glyph index, right glyph index)
+    std::unordered_map<uint64_t, int16_t> kerning;
+  };
+
+  void select_size_metrics();
+  const GlyphMetrics &get_metrics(uint32_t codepoint) const;
+  int get_kerning(FT_UInt left, FT_UInt right) const;
+  // rendered is set if the glyph is left rendered in the face's glyph slot
+  const CachedGlyph *get_glyph(uint32_t codepoint, const GlyphMetrics &metrics, bool &rendered) const;
+
   FT_Library m_library = nullptr;
   FT_Face m_face = nullptr;
+  std::string m_font_path;
   int m_pixel_height = 0;
   bool m_initialized = false;
+  bool m_has_kerning = false;
+  // the caches fill in lazily from the const measure and draw calls
+  mutable std::vector<SizeMetrics *> m_size_metrics;
+  mutable SizeMetrics *m_metrics = nullptr;
+  mutable GlyphCache m_glyph_cache{FREETYPE_GLYPH_CACHE_BUDGET};
 };
 
 #endif // USE_FREETYPE
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <stdint.h>
+
+// Draws 8 bit coverage bitmaps (e.g. rendered FreeType glyphs) straight into
+// a 4 bit per pixel epdiy framebuffer that is rotated to inverted portrait,
+// instead of going through epd_draw_pixel one pixel at a time.
+//
+// In inverted portrait logical (x, y) is physical (y, fb_height - 1 - x), so
+// each column of the glyph is a run of neighbouring nibbles in one physical
+// row - we walk the glyph a column at a time and write pairs of pixels as
+// whole bytes.
+class GlyphBlitter
+{
+private:
+  // for each alpha value: which bits of the destination byte to keep and
+  // what to OR in, for a pixel in the low and in the high nibble. A
+  // transparent pixel keeps everything so there are no branches per pixel.
+  uint8_t m_low_mask[256];
+  uint8_t m_low_value[256];
+  uint8_t m_high_mask[256];
+  uint8_t m_high_value[256];
+  // 1 if the colour isn't pure black or white and needs a gray flush
+  uint8_t m_gray[256];
+
+public:
+  // gamma is the colour correction the renderer applies to every pixel it draws
+  void init(const uint8_t *gamma)
+  {
+    for (int alpha = 0; alpha < 256; alpha++)
+    {
+      m_low_mask[alpha] = 0xFF;
+      m_low_value[alpha] = 0;
+      m_high_mask[alpha] = 0xFF;
+      m_high_value[alpha] = 0;
+      m_gray[alpha] = 0;
+      if (alpha == 0)
+      {
+        continue;
+      }
+      // this has to match Renderer::draw_glyph
+#if defined(BOARD_TYPE_PAPER_S3)
+      if (alpha <= 64)
+      {
+        continue;
+      }
+      uint8_t color = gamma[0];
+#else
+      uint8_t color = gamma[255 - alpha];
+#endif
+      m_low_mask[alpha] = 0xF0;
+      m_low_value[alpha] = color >> 4;
+      m_high_mask[alpha] = 0x0F;
+      m_high_value[alpha] = color & 0xF0;
+      m_gray[alpha] = color != 0 && color != 255;
+    }
+  }
+
+  // draw the bitmap with its top left corner at logical x, y - returns true if anything gray was drawn
+  bool blit(uint8_t *frame_buffer, int fb_width, int fb_height, int x, int y, int width, int height, const uint8_t *coverage, int pitch) const
+  {
+    // clip once for the whole glyph - logical x runs down the physical rows and logical y along them
+    int col_start = x < 0 ? -x : 0;
+    int col_end = x + width > fb_height ? fb_height - x : width;
+    int row_start = y < 0 ? -y : 0;
+    int row_end = y + height > fb_width ? fb_width - y : height;
+    if (col_start >= col_end || row_start >= row_end)
+    {
+      return false;
+    }
+    int stride = fb_width / 2;
+    // a leading pixel in a high nibble, then whole bytes, then maybe a trailing low nibble
+    bool leading = ((y + row_start) & 1) != 0;
+    int pairs_start = row_start + (leading ? 1 : 0);
+    int pairs_end = pairs_start + ((row_end - pairs_start) & ~1);
+    bool trailing = pairs_end < row_end;
+    uint8_t gray = 0;
+    for (int col = col_start; col < col_end; col++)
+    {
+      uint8_t *line = frame_buffer + (fb_height - 1 - (x + col)) * stride;
+      const uint8_t *src = coverage + col;
+      if (leading)
+      {
+        uint8_t alpha = src[row_start * pitch];
+        uint8_t *dest = line + ((y + row_start) >> 1);
+        *dest = (*dest & m_high_mask[alpha]) | m_high_value[alpha];
+        gray |= m_gray[alpha];
+      }
+      uint8_t *dest = line + ((y + pairs_start) >> 1);
+      for (int row = pairs_start; row < pairs_end; row += 2)
+      {
+        uint8_t low = src[row * pitch];
+        uint8_t high = src[(row + 1) * pitch];
+        // skip the read-modify-write entirely for fully transparent pairs
+        if (low | high)
+        {
+          *dest = (*dest & m_low_mask[low] & m_high_mask[high]) | m_low_value[low] | m_high_value[high];
+          gray |= m_gray[low] | m_gray[high];
+        }
+        dest++;
+      }
+      if (trailing)
+      {
+        uint8_t alpha = src[pairs_end * pitch];
+        *dest = (*dest & m_low_mask[alpha]) | m_low_value[alpha];
+        gray |= m_gray[alpha];
+      }
+    }
+    return gray != 0;
+  }
+};
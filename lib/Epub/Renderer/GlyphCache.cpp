@@ -0,0 +1,108 @@
+#include "GlyphCache.h"
+#include <string.h>
+#include <stdlib.h>
+#if !defined(UNIT_TEST) && defined(BOARD_HAS_PSRAM)
+#include <esp_heap_caps.h>
+#endif
+
+static uint8_t *allocate_bitmap(size_t size)
+{
+#if !defined(UNIT_TEST) && defined(BOARD_HAS_PSRAM)
+  uint8_t *bitmap = (uint8_t *)heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  if (bitmap)
+  {
+    return bitmap;
+  }
+#endif
+  return (uint8_t *)malloc(size);
+}
+
+GlyphCache::~GlyphCache()
+{
+  clear();
+}
+
+const CachedGlyph *GlyphCache::find(uint32_t key)
+{
+  auto it = m_lookup.find(key);
+  if (it == m_lookup.end())
+  {
+    m_misses++;
+    return nullptr;
+  }
+  m_hits++;
+  // move to the front of the list - it's now the most recently used
+  m_glyphs.splice(m_glyphs.begin(), m_glyphs, it->second);
+  return &m_glyphs.front();
+}
+
+const CachedGlyph *GlyphCache::insert(uint32_t key, int left, int top, int width, int rows, const uint8_t *bitmap, int pitch)
+{
+  if (width < 0 || rows < 0 || width > UINT16_MAX || rows > UINT16_MAX)
+  {
+    return nullptr;
+  }
+  CachedGlyph glyph = {key, (int16_t)left, (int16_t)top, (uint16_t)width, (uint16_t)rows, nullptr};
+  size_t size = entry_size(glyph);
+  if (size > m_budget)
+  {
+    return nullptr;
+  }
+  // replace any existing copy
+  auto existing = m_lookup.find(key);
+  if (existing != m_lookup.end())
+  {
+    m_used -= entry_size(*existing->second);
+    free(existing->second->bitmap);
+    m_glyphs.erase(existing->second);
+    m_lookup.erase(existing);
+  }
+  evict_to(m_budget - size);
+  if (width > 0 && rows > 0)
+  {
+    glyph.bitmap = allocate_bitmap(width * rows);
+    if (!glyph.bitmap)
+    {
+      return nullptr;
+    }
+    for (int row = 0; row < rows; row++)
+    {
+      memcpy(glyph.bitmap + row * width, bitmap + row * pitch, width);
+    }
+  }
+  m_glyphs.push_front(glyph);
+  m_lookup[key] = m_glyphs.begin();
+  m_used += size;
+  return &m_glyphs.front();
+}
+
+// drop the least recently used glyphs until we're using no more than budget bytes
+void GlyphCache::evict_to(size_t budget)
+{
+  while (m_used > budget && !m_glyphs.empty())
+  {
+    CachedGlyph &oldest = m_glyphs.back();
+    m_used -= entry_size(oldest);
+    m_lookup.erase(oldest.key);
+    free(oldest.bitmap);
+    m_glyphs.pop_back();
+    m_evictions++;
+  }
+}
+
+void GlyphCache::clear()
+{
+  for (auto &glyph : m_glyphs)
+  {
+    free(glyph.bitmap);
+  }
+  m_glyphs.clear();
+  m_lookup.clear();
+  m_used = 0;
+}
+
+void GlyphCache::set_budget(size_t budget)
+{
+  m_budget = budget;
+  evict_to(m_budget);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <list>
+#include <unordered_map>
+
+// a rendered glyph - the bitmap is 8 bit coverage (0 = transparent, 255 = solid)
+struct CachedGlyph
+{
+  uint32_t key;
+  // offset of the bitmap from the pen position and the baseline
+  int16_t left;
+  int16_t top;
+  uint16_t width;
+  uint16_t rows;
+  uint8_t *bitmap;
+};
+
+// Least recently used cache of rendered glyph bitmaps with a byte budget.
+// The bitmaps live in PSRAM when we have it. Keys are built from the pixel
+// size and the code point so glyphs for several font sizes can share the
+// cache.
+class GlyphCache
+{
+private:
+  std::list<CachedGlyph> m_glyphs;
+  std::unordered_map<uint32_t, std::list<CachedGlyph>::iterator> m_lookup;
+  size_t m_budget;
+  size_t m_used = 0;
+  uint32_t m_hits = 0;
+  uint32_t m_misses = 0;
+  uint32_t m_evictions = 0;
+
+  static size_t entry_size(const CachedGlyph &glyph)
+  {
+    return sizeof(CachedGlyph) + glyph.width * glyph.rows;
+  }
+  void evict_to(size_t budget);
+
+public:
+  GlyphCache(size_t budget) : m_budget(budget) {}
+  ~GlyphCache();
+  GlyphCache(const GlyphCache &) = delete;
+  GlyphCache &operator=(const GlyphCache &) = delete;
+
+  static uint32_t make_key(int pixel_height, uint32_t codepoint)
+  {
+    // code points are at most 21 bits
+    return ((uint32_t)pixel_height << 21) | (codepoint & 0x1FFFFF);
+  }
+  // look up a glyph and mark it as recently used - returns nullptr on a miss.
+  // The returned glyph is only valid until the next insert.
+  const CachedGlyph *find(uint32_t key);
+  // copy a rendered bitmap into the cache, evicting old glyphs to stay within the budget.
+  // Returns nullptr if the glyph could not be stored (e.g. it is bigger than the whole budget).
+  const CachedGlyph *insert(uint32_t key, int left, int top, int width, int rows, const uint8_t *bitmap, int pitch);
+  void clear();
+
+  void set_budget(size_t budget);
+  size_t get_budget() const { return m_budget; }
+  size_t get_used_bytes() const { return m_used; }
+  size_t get_count() const { return m_glyphs.size(); }
+  uint32_t get_hits() const { return m_hits; }
+  uint32_t get_misses() const { return m_misses; }
+  uint32_t get_evictions() const { return m_evictions; }
+  void reset_stats()
+  {
+    m_hits = 0;
+    m_misses = 0;
+    m_evictions = 0;
+  }
+};
@@ -0,0 +1,102 @@
+#include "ImageCache.h"
+#include <stdlib.h>
+#if !defined(UNIT_TEST) && defined(BOARD_HAS_PSRAM)
+#include <esp_heap_caps.h>
+#endif
+
+ImageCache::~ImageCache()
+{
+  clear();
+}
+
+std::string ImageCache::make_key(const std::string &epub_path, const std::string &item_href, int width, int height)
+{
+  return epub_path + "\n" + item_href + "\n" + std::to_string(width) + "x" + std::to_string(height);
+}
+
+uint8_t *ImageCache::allocate_bitmap(size_t size)
+{
+#if !defined(UNIT_TEST) && defined(BOARD_HAS_PSRAM)
+  uint8_t *bitmap = (uint8_t *)heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  if (bitmap)
+  {
+    return bitmap;
+  }
+#endif
+  return (uint8_t *)malloc(size);
+}
+
+const CachedImage *ImageCache::find(const std::string &key)
+{
+  auto it = m_lookup.find(key);
+  if (it == m_lookup.end())
+  {
+    m_misses++;
+    return nullptr;
+  }
+  m_hits++;
+  // move to the front of the list - it's now the most recently used
+  m_images.splice(m_images.begin(), m_images, it->second);
+  return &m_images.front();
+}
+
+const CachedImage *ImageCache::insert(const std::string &key, int width, int height, uint8_t *bitmap)
+{
+  if (width <= 0 || height <= 0 || width > UINT16_MAX || height > UINT16_MAX)
+  {
+    free(bitmap);
+    return nullptr;
+  }
+  CachedImage image = {key, (uint16_t)width, (uint16_t)height, bitmap};
+  size_t size = entry_size(image);
+  if (size > m_budget)
+  {
+    free(bitmap);
+    return nullptr;
+  }
+  // replace any existing copy
+  auto existing = m_lookup.find(key);
+  if (existing != m_lookup.end())
+  {
+    m_used -= entry_size(*existing->second);
+    free(existing->second->bitmap);
+    m_images.erase(existing->second);
+    m_lookup.erase(existing);
+  }
+  evict_to(m_budget - size);
+  m_images.push_front(image);
+  m_lookup[key] = m_images.begin();
+  m_used += size;
+  return &m_images.front();
+}
+
+// drop the least recently used images until we're using no more than budget bytes
+void ImageCache::evict_to(size_t budget)
+{
+  while (m_used > budget && !m_images.empty())
+  {
+    CachedImage &oldest = m_images.back();
+    m_used -= entry_size(oldest);
+    m_lookup.erase(oldest.key);
+    free(oldest.bitmap);
+    m_images.pop_back();
+    m_evictions++;
+  }
+}
+
+void ImageCache::clear()
+{
+  for (auto &image : m_images)
+  {
+    free(image.bitmap);
+  }
+  m_images.clear();
+  m_lookup.clear();
+  m_used = 0;
+}
+
+void ImageCache::set_budget(size_t budget)
+{
+  m_budget = budget;
+  evict_to(m_budget);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <list>
+#include <unordered_map>
+
+// a decoded image already scaled to the size it is drawn at - 8 bit gray, one byte per pixel
+struct CachedImage
+{
+  std::string key;
+  uint16_t width;
+  uint16_t height;
+  uint8_t *bitmap;
+};
+
+// Least recently used cache of decoded images with a byte budget, so paging
+// back to a page with a picture on it doesn't have to inflate and decode the
+// image again. The bitmaps live in PSRAM when we have it.
+class ImageCache
+{
+private:
+  std::list<CachedImage> m_images;
+  std::unordered_map<std::string, std::list<CachedImage>::iterator> m_lookup;
+  size_t m_budget;
+  size_t m_used = 0;
+  uint32_t m_hits = 0;
+  uint32_t m_misses = 0;
+  uint32_t m_evictions = 0;
+
+  static size_t entry_size(const CachedImage &image)
+  {
+    return sizeof(CachedImage) + image.key.size() + image.width * image.height;
+  }
+  void evict_to(size_t budget);
+
+public:
+  ImageCache(size_t budget) : m_budget(budget) {}
+  ~ImageCache();
+  ImageCache(const ImageCache &) = delete;
+  ImageCache &operator=(const ImageCache &) = delete;
+
+  // images are identified by the book, the item in the book and the size they are drawn at
+  static std::string make_key(const std::string &epub_path, const std::string &item_href, int width, int height);
+  // allocate a bitmap that can be handed to insert - from PSRAM if possible
+  static uint8_t *allocate_bitmap(size_t size);
+
+  // look up an image and mark it as recently used - returns nullptr on a miss.
+  // The returned image is only valid until the next insert.
+  const CachedImage *find(const std::string &key);
+  // add a bitmap from allocate_bitmap to the cache - the cache takes ownership and frees it
+  // if it doesn't fit in the budget, in which case this returns nullptr.
+  const CachedImage *insert(const std::string &key, int width, int height, uint8_t *bitmap);
+  void clear();
+
+  void set_budget(size_t budget);
+  size_t get_budget() const { return m_budget; }
+  size_t get_used_bytes() const { return m_used; }
+  size_t get_count() const { return m_images.size(); }
+  uint32_t get_hits() const { return m_hits; }
+  uint32_t get_misses() const { return m_misses; }
+  uint32_t get_evictions() const { return m_evictions; }
+};
@@ -0,0 +1,154 @@
+#include "ImageProbe.h"
+#include "../ZipFile/ZipFile.h"
+#include <stdlib.h>
+#include <algorithm>
+
+static uint32_t read_be16(const uint8_t *data)
+{
+  return (data[0] << 8) | data[1];
+}
+
+static uint32_t read_be32(const uint8_t *data)
+{
+  return ((uint32_t)data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
+}
+
+static ImageProbeResult probe_jpeg_header(const uint8_t *data, size_t data_size, ImageHeader *header)
+{
+  size_t pos = 2;
+  while (pos + 1 < data_size)
+  {
+    if (data[pos] != 0xFF)
+    {
+      // not a marker - this isn't a JPEG we understand
+      return ImageProbeResult::NOT_SUPPORTED;
+    }
+    uint8_t marker = data[pos + 1];
+    pos += 2;
+    // padding and markers without a length
+    if (marker == 0xFF)
+    {
+      pos--;
+      continue;
+    }
+    if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8))
+    {
+      continue;
+    }
+    // end of image or start of scan before a frame header
+    if (marker == 0xD9 || marker == 0xDA)
+    {
+      return ImageProbeResult::NOT_SUPPORTED;
+    }
+    if (pos + 2 > data_size)
+    {
+      break;
+    }
+    uint32_t length = read_be16(data + pos);
+    if (length < 2)
+    {
+      return ImageProbeResult::NOT_SUPPORTED;
+    }
+    // SOF0 - SOF15, apart from DHT (C4), JPG (C8) and DAC (CC)
+    if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+    {
+      // length, precision, height, width
+      if (pos + 7 > data_size)
+      {
+        break;
+      }
+      header->height = read_be16(data + pos + 3);
+      header->width = read_be16(data + pos + 5);
+      header->is_jpeg = true;
+      // tjpgd only does baseline
+      header->decodable = marker == 0xC0;
+      return header->width > 0 && header->height > 0 ? ImageProbeResult::FOUND : ImageProbeResult::NOT_SUPPORTED;
+    }
+    pos += length;
+  }
+  return ImageProbeResult::NEED_MORE_DATA;
+}
+
+static ImageProbeResult probe_png_header(const uint8_t *data, size_t data_size, ImageHeader *header)
+{
+  // signature, chunk length, "IHDR", width, height
+  if (data_size < 24)
+  {
+    return ImageProbeResult::NEED_MORE_DATA;
+  }
+  if (data[12] != 'I' || data[13] != 'H' || data[14] != 'D' || data[15] != 'R')
+  {
+    return ImageProbeResult::NOT_SUPPORTED;
+  }
+  uint32_t png_width = read_be32(data + 16);
+  uint32_t png_height = read_be32(data + 20);
+  if (png_width == 0 || png_height == 0 || png_width > 0x7FFFFFFF || png_height > 0x7FFFFFFF)
+  {
+    return ImageProbeResult::NOT_SUPPORTED;
+  }
+  header->width = png_width;
+  header->height = png_height;
+  header->is_jpeg = false;
+  header->decodable = true;
+  return ImageProbeResult::FOUND;
+}
+
+ImageProbeResult probe_image_header(const uint8_t *data, size_t data_size, ImageHeader *header)
+{
+  if (data_size < 4)
+  {
+    return ImageProbeResult::NEED_MORE_DATA;
+  }
+  if (data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF)
+  {
+    return probe_jpeg_header(data, data_size, header);
+  }
+  if (data[0] == 0x89 && data[1] == 'P' && data[2] == 'N' && data[3] == 'G')
+  {
+    return probe_png_header(data, data_size, header);
+  }
+  return ImageProbeResult::NOT_SUPPORTED;
+}
+
+ImageProbeResult probe_image_stream(ZipFileStream *stream, ImageHeader *header)
+{
+  // start small - nearly every header is in the first couple of KB
+  size_t capacity = 2048;
+  size_t size = 0;
+  uint8_t *data = (uint8_t *)malloc(capacity);
+  ImageProbeResult result = ImageProbeResult::NEED_MORE_DATA;
+  while (data)
+  {
+    size_t read;
+    while (size < capacity && (read = stream->read(data + size, capacity - size)) > 0)
+    {
+      size += read;
+    }
+    result = probe_image_header(data, size, header);
+    if (result != ImageProbeResult::NEED_MORE_DATA || stream->is_finished() || capacity >= IMAGE_PROBE_MAX_BYTES)
+    {
+      break;
+    }
+    capacity = std::min(capacity * 4, (size_t)IMAGE_PROBE_MAX_BYTES);
+    uint8_t *bigger = (uint8_t *)realloc(data, capacity);
+    if (!bigger)
+    {
+      break;
+    }
+    data = bigger;
+  }
+  free(data);
+  return result;
+}
+
+bool probe_image_size(const uint8_t *data, size_t data_size, int *width, int *height)
+{
+  ImageHeader header;
+  if (probe_image_header(data, data_size, &header) != ImageProbeResult::FOUND)
+  {
+    return false;
+  }
+  *width = header.width;
+  *height = header.height;
+  return true;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+class ZipFileStream;
+
+// the most of an image we'll inflate looking for its header - JPEGs can have
+// big EXIF blocks and thumbnails in front of the frame header
+#define IMAGE_PROBE_MAX_BYTES (64 * 1024)
+
+enum class ImageProbeResult
+{
+  FOUND,
+  // the header is further into the file than the data we've got
+  NEED_MORE_DATA,
+  // not a JPEG or PNG, or a broken one
+  NOT_SUPPORTED
+};
+
+struct ImageHeader
+{
+  int width = 0;
+  int height = 0;
+  bool is_jpeg = false;
+  // false for JPEGs that aren't baseline (e.g. progressive) - our JPEG decoder can't draw those
+  bool decodable = false;
+};
+
+// Read the dimensions of a JPEG (from its SOFn marker) or a PNG (from its
+// IHDR chunk) without decoding the image. data only needs to hold the start
+// of the file.
+ImageProbeResult probe_image_header(const uint8_t *data, size_t data_size, ImageHeader *header);
+// read just enough of a zip entry to find the header - at most IMAGE_PROBE_MAX_BYTES
+ImageProbeResult probe_image_stream(ZipFileStream *stream, ImageHeader *header);
+// returns false if the header isn't in data or the data isn't a JPEG or PNG
+bool probe_image_size(const uint8_t *data, size_t data_size, int *width, int *height);
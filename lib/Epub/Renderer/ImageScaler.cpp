@@ -0,0 +1,187 @@
+#include <algorithm>
+#include "ImageScaler.h"
+#include "Renderer.h"
+#ifndef UNIT_TEST
+#include <esp_log.h>
+#else
+#define ESP_LOGE(args...)
+#endif
+
+static const char *TAG = "SCALER";
+
+bool ImageScaler::begin(Renderer *renderer, int x_pos, int y_pos, int source_width, int source_height, int width, int height)
+{
+  // positions are kept in units of 1 / (source size * destination size) so they have to fit in 32 bits
+  if (source_width <= 0 || source_height <= 0 || width <= 0 || height <= 0 ||
+      (uint64_t)source_width * width > UINT32_MAX || (uint64_t)source_height * height > UINT32_MAX)
+  {
+    ESP_LOGE(TAG, "Can't scale %dx%d to %dx%d", source_width, source_height, width, height);
+    return false;
+  }
+  m_renderer = renderer;
+  m_x_pos = x_pos;
+  m_y_pos = y_pos;
+  m_source_width = source_width;
+  m_source_height = source_height;
+  m_width = width;
+  m_height = height;
+  m_clip_left = 0;
+  m_clip_top = 0;
+  m_clip_right = width;
+  m_clip_bottom = height;
+  m_first_source_row = 0;
+  m_end_source_row = source_height;
+  m_first_source_column = 0;
+  m_end_source_column = source_width;
+  m_source_row = 0;
+  m_row = 0;
+  m_position = 0;
+  m_column_reciprocal = (((uint64_t)1 << 32) + source_width / 2) / source_width;
+  m_row_reciprocal = (((uint64_t)1 << 32) + source_height / 2) / source_height;
+  m_scaled_row.assign(width, 0);
+  m_accumulated.assign(width, 0);
+  m_errors.assign(width + 2, 0);
+  m_next_errors.assign(width + 2, 0);
+  m_output.resize(width);
+  return true;
+}
+
+void ImageScaler::end()
+{
+  m_renderer = nullptr;
+  // swap with empties so the memory actually goes
+  std::vector<uint16_t>().swap(m_scaled_row);
+  std::vector<uint32_t>().swap(m_accumulated);
+  std::vector<int32_t>().swap(m_errors);
+  std::vector<int32_t>().swap(m_next_errors);
+  std::vector<uint8_t>().swap(m_output);
+}
+
+void ImageScaler::set_clip(int x, int y, int width, int height)
+{
+  m_clip_left = std::max(0, std::min(m_width, x));
+  m_clip_top = std::max(0, std::min(m_height, y));
+  m_clip_right = std::max(m_clip_left, std::min(m_width, x + width));
+  m_clip_bottom = std::max(m_clip_top, std::min(m_height, y + height));
+  // the source pixels under the clip - rounded outwards so the edge pixels still get their whole average
+  m_first_source_row = (uint64_t)m_clip_top * m_source_height / m_height;
+  m_end_source_row = ((uint64_t)m_clip_bottom * m_source_height + m_height - 1) / m_height;
+  m_first_source_column = (uint64_t)m_clip_left * m_source_width / m_width;
+  m_end_source_column = ((uint64_t)m_clip_right * m_source_width + m_width - 1) / m_width;
+  // start part way down - the destination row this lands in is above the clip if it only gets part of its average
+  m_source_row = m_first_source_row;
+  m_position = (uint32_t)m_first_source_row * m_height;
+  m_row = m_position / m_source_height;
+}
+
+// walk the source and destination columns together - source pixels are m_width units
+// wide and destination pixels m_source_width units wide so every boundary is a whole number
+void ImageScaler::scale_row(const uint8_t *gray)
+{
+  if (m_source_width == m_width)
+  {
+    for (int x = 0; x < m_width; x++)
+    {
+      m_scaled_row[x] = gray[x] << 8;
+    }
+    return;
+  }
+  uint32_t position = 0;
+  uint32_t sum = 0;
+  int source_x = 0;
+  int x = 0;
+  while (x < m_width)
+  {
+    uint32_t source_end = (uint32_t)(source_x + 1) * m_width;
+    uint32_t end = (uint32_t)(x + 1) * m_source_width;
+    uint32_t overlap_end = std::min(source_end, end);
+    sum += gray[source_x] * (overlap_end - position);
+    position = overlap_end;
+    if (overlap_end == source_end)
+    {
+      source_x++;
+    }
+    if (overlap_end == end)
+    {
+      m_scaled_row[x++] = ((uint64_t)sum * m_column_reciprocal) >> 24;
+      sum = 0;
+    }
+  }
+}
+
+void ImageScaler::add_row(const uint8_t *gray)
+{
+  if (!m_renderer || m_source_row >= m_end_source_row)
+  {
+    return;
+  }
+  scale_row(gray);
+  // and the same walk down the rows - this source row can finish off several destination rows when we're scaling up
+  uint32_t source_end = (uint32_t)(m_source_row + 1) * m_height;
+  while (m_position < source_end && m_row < m_clip_bottom)
+  {
+    uint32_t end = (uint32_t)(m_row + 1) * m_source_height;
+    uint32_t overlap_end = std::min(source_end, end);
+    uint32_t weight = overlap_end - m_position;
+    m_position = overlap_end;
+    if (weight == (uint32_t)m_source_height)
+    {
+      // this source row covers the whole destination row - nothing to average
+      output_row(false);
+      continue;
+    }
+    for (int x = 0; x < m_width; x++)
+    {
+      m_accumulated[x] += m_scaled_row[x] * weight;
+    }
+    if (overlap_end == end)
+    {
+      output_row(true);
+    }
+  }
+  m_source_row++;
+}
+
+// dither the finished destination row down to the 16 levels and draw it
+void ImageScaler::output_row(bool from_accumulated)
+{
+  if (m_row < m_clip_top)
+  {
+    // above the clip - this row is missing the source rows we skipped
+    std::fill(m_accumulated.begin(), m_accumulated.end(), 0);
+    m_row++;
+    return;
+  }
+  // errors are in the same 8.8 fixed point as the accumulated values
+  int32_t *errors = m_errors.data() + 1;
+  int32_t *next_errors = m_next_errors.data() + 1;
+  for (int x = m_clip_left; x < m_clip_right; x++)
+  {
+    int32_t value = errors[x];
+    if (from_accumulated)
+    {
+      value += ((uint64_t)m_accumulated[x] * m_row_reciprocal) >> 32;
+    }
+    else
+    {
+      value += m_scaled_row[x];
+    }
+    // nearest of 0, 17, 34 ... 255
+    int32_t level = (value + 17 * 128) / (17 * 256);
+    level = std::max(0, std::min(15, (int)level));
+    m_output[x] = level * 17;
+    int32_t error = value - level * 17 * 256;
+    errors[x + 1] += error * 7 / 16;
+    next_errors[x - 1] += error * 3 / 16;
+    next_errors[x] += error * 5 / 16;
+    next_errors[x + 1] += error / 16;
+  }
+  if (from_accumulated)
+  {
+    std::fill(m_accumulated.begin(), m_accumulated.end(), 0);
+  }
+  m_errors.swap(m_next_errors);
+  std::fill(m_next_errors.begin(), m_next_errors.end(), 0);
+  m_renderer->draw_pixels(m_x_pos + m_clip_left, m_y_pos + m_row, m_clip_right - m_clip_left, 1, m_output.data() + m_clip_left);
+  m_row++;
+}
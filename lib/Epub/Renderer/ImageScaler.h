@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+class Renderer;
+
+// Scales a decoded image fed in a row of 8 bit gray at a time into a target rectangle.
+// Each destination pixel is the average of the source pixels under it, weighted by how
+// much of each one it covers, so downscaling doesn't alias and upscaling doesn't leave
+// gaps. The result is Floyd-Steinberg dithered to the 16 gray levels of the panel and
+// drawn a whole row at a time with draw_pixels.
+class ImageScaler
+{
+private:
+  Renderer *m_renderer = nullptr;
+  int m_x_pos = 0;
+  int m_y_pos = 0;
+  int m_source_width = 0;
+  int m_source_height = 0;
+  int m_width = 0;
+  int m_height = 0;
+  // the part of the destination that gets drawn, relative to its top left
+  int m_clip_left = 0;
+  int m_clip_top = 0;
+  int m_clip_right = 0;
+  int m_clip_bottom = 0;
+  // the source rows and columns that end up inside the clip
+  int m_first_source_row = 0;
+  int m_end_source_row = 0;
+  int m_first_source_column = 0;
+  int m_end_source_column = 0;
+  // the source row we're expecting next and the destination row it goes into
+  int m_source_row = 0;
+  int m_row = 0;
+  // how far down we've got, in units of 1 / (m_source_height * m_height) of the image
+  uint32_t m_position = 0;
+  // 2^32 / the source size - so we can multiply instead of divide when averaging
+  uint64_t m_column_reciprocal = 0;
+  uint64_t m_row_reciprocal = 0;
+  // the current source row scaled to the destination width (8.8 fixed point gray)
+  std::vector<uint16_t> m_scaled_row;
+  // the source rows that make up the current destination row, weighted by how much of it they cover
+  std::vector<uint32_t> m_accumulated;
+  // dithering errors carried into this row and the next (one extra column each side)
+  std::vector<int32_t> m_errors;
+  std::vector<int32_t> m_next_errors;
+  std::vector<uint8_t> m_output;
+
+  void scale_row(const uint8_t *gray);
+  // dither and draw a destination row from the accumulated rows or straight from the scaled source row
+  void output_row(bool from_accumulated);
+
+public:
+  // start scaling a source_width x source_height image to width x height drawn at x_pos, y_pos
+  bool begin(Renderer *renderer, int x_pos, int y_pos, int source_width, int source_height, int width, int height);
+  // only draw the part of the destination inside this rectangle (relative to its top left) - call it before
+  // the first row. Rows then start at get_first_source_row() and only the columns from
+  // get_first_source_column() up to get_end_source_column() have to be filled in.
+  void set_clip(int x, int y, int width, int height);
+  int get_first_source_row() const { return m_first_source_row; }
+  int get_end_source_row() const { return m_end_source_row; }
+  int get_first_source_column() const { return m_first_source_column; }
+  int get_end_source_column() const { return m_end_source_column; }
+  // the next row of the source image - source_width pixels of 8 bit gray
+  void add_row(const uint8_t *gray);
+  // true once every destination row in the clip has been drawn
+  bool is_complete() const { return m_row >= m_clip_bottom; }
+  // free the row buffers
+  void end();
+};
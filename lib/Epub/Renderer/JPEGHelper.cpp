@@ -11,13 +11,17 @@
 #define ESP_LOGE(args...)
 #define ESP_LOGI(args...)
 #endif
+#include <string.h>
+#include <algorithm>
 #include <esp_timer.h>
 #include "JPEGHelper.h"
 #include "Renderer.h"
 
 static const char *TAG = "JPG";
 
-#define POOL_SIZE 32768
+// tjpgd's working memory - the stream buffer, huffman and quantisation tables and one MCU. A
+// baseline JPEG needs about 4K of it in grayscale output mode and this leaves room for odd ones.
+#define POOL_SIZE 8192
 
 bool JPEGHelper::get_size(const uint8_t *data, size_t data_size, int *width, int *height)
 {
@@ -56,9 +60,14 @@ bool JPEGHelper::get_size(const uint8_t *data, size_t data_size, int *width, int
 }
 bool JPEGHelper::render(const uint8_t *data, size_t data_size, Renderer *renderer, int x_pos, int y_pos, int width, int height)
 {
-  this->renderer = renderer;
-  this->y_pos = y_pos;
-  this->x_pos = x_pos;
+  // nothing off the page needs decoding
+  return render_clipped(data, data_size, renderer, x_pos, y_pos, width, height,
+                        0, 0, renderer->get_page_width(), renderer->get_page_height());
+}
+
+bool JPEGHelper::render_clipped(const uint8_t *data, size_t data_size, Renderer *renderer, int x_pos, int y_pos, int width, int height,
+                                int clip_x, int clip_y, int clip_width, int clip_height)
+{
   this->last_yield_time = esp_timer_get_time();
   void *pool;
 #if !defined(UNIT_TEST) && defined(BOARD_HAS_PSRAM)
@@ -77,49 +86,57 @@ bool JPEGHelper::render(const uint8_t *data, size_t data_size, Renderer *rendere
   // decode the jpeg and get its size
   JDEC dec;
   JRESULT res = jd_prepare(&dec, read_jpeg_data, pool, POOL_SIZE, this);
+  m_pool_used = POOL_SIZE - dec.sz_pool;
   if (res == JDR_OK)
   {
-    // Correctly calculate the required scale to fit the target dimensions
-    float required_x_scale = (float)width / (float)dec.width;
-    float required_y_scale = (float)height / (float)dec.height;
-    
-    // We want the smaller of the two scales to ensure the image fits entirely
-    // (aspect fit), or use one if ignoring aspect ratio is intended.
-    // Use the smaller scale to fit the image within the bounds.
-    float effective_scale = std::min(required_x_scale, required_y_scale);
+    // Use the smaller scale to fit the image within the bounds (aspect fit)
+    float effective_scale = std::min((float)width / (float)dec.width, (float)height / (float)dec.height);
 
     // The JPEG decoder only supports downscaling by powers of 2 (1/1, 1/2, 1/4, 1/8)
-    // which corresponds to scale_factor 0, 1, 2, 3.
-    // calculate the power of 2 that is closest to but not smaller than the effective scale?
-    // Actually, we should pick a scale factor such that the decoded image is larger 
-    // than the target size, and then we software-scale it down.
-    
+    // which corresponds to scale_factor 0, 1, 2, 3. Pick the smallest one that still
+    // decodes at least as many pixels as we need and let the scaler do the rest.
     scale_factor = 0;
     if (effective_scale <= 0.125f) scale_factor = 3;      // 1/8
     else if (effective_scale <= 0.25f) scale_factor = 2;  // 1/4
     else if (effective_scale <= 0.5f) scale_factor = 1;   // 1/2
     else scale_factor = 0;                                // 1/1
 
-    // Store the actual scaling ratios we will use for the software scaler
     // The decoder will produce an image of size (dec.width >> scale_factor) by (dec.height >> scale_factor)
-    int decoded_width = dec.width >> scale_factor;
+    m_decoded_width = dec.width >> scale_factor;
     int decoded_height = dec.height >> scale_factor;
-
-    // The final software scale needs to map from the decoded size to the target size.
-    // effective_scale is relative to the *original* size.
-    // We need the scale relative to the *decoded* size.
-    this->x_scale = (float)width / (float)decoded_width;
-    this->y_scale = (float)height / (float)decoded_height;
-
-    // Use aspect fit: use the smaller scale for both axes to preserve aspect ratio
-    // but fill the space as much as possible.
-    float final_scale = std::min(this->x_scale, this->y_scale);
-    this->x_scale = final_scale;
-    this->y_scale = final_scale;
-
-    ESP_LOGI(TAG, "JPEG Decoded - size %d,%d, target %d,%d, scale_factor %d, final scale %f", 
-             dec.width, dec.height, width, height, scale_factor, final_scale);
-    jd_decomp(&dec, draw_jpeg_function, scale_factor);
+    int scaled_width = std::max(1, std::min(width, (int)(dec.width * effective_scale + 0.5f)));
+    int scaled_height = std::max(1, std::min(height, (int)(dec.height * effective_scale + 0.5f)));
+
+    ESP_LOGI(TAG, "JPEG Decoded - size %d,%d, target %d,%d, scale_factor %d, scaled to %d,%d",
+             dec.width, dec.height, width, height, scale_factor, scaled_width, scaled_height);
+    // an MCU is at most 16 rows high
+    m_gray_buffer.resize(m_decoded_width * 16);
+    if (m_scaler.begin(renderer, x_pos, y_pos, m_decoded_width, decoded_height, scaled_width, scaled_height))
+    {
+      m_scaler.set_clip(clip_x - x_pos, clip_y - y_pos, clip_width, clip_height);
+      // only the MCUs under the clip get an IDCT and nothing below it is decoded at all
+      dec.clip.left = m_scaler.get_first_source_column() << scale_factor;
+      dec.clip.right = (m_scaler.get_end_source_column() << scale_factor) - 1;
+      dec.clip.top = m_scaler.get_first_source_row() << scale_factor;
+      dec.clip.bottom = (m_scaler.get_end_source_row() << scale_factor) - 1;
+      if (m_scaler.get_end_source_row() > m_scaler.get_first_source_row() &&
+          m_scaler.get_end_source_column() > m_scaler.get_first_source_column())
+      {
+        res = jd_decomp(&dec, draw_jpeg_function, scale_factor);
+      }
+      if (res != JDR_OK && !m_scaler.is_complete())
+      {
+        ESP_LOGE(TAG, "JPEG Decode failed (decompress) - %d", res);
+      }
+      // a truncated image still draws what we got
+      res = JDR_OK;
+    }
+    else
+    {
+      res = JDR_PAR;
+    }
+    m_scaler.end();
+    std::vector<uint8_t>().swap(m_gray_buffer);
   }
   else
   {
@@ -163,7 +180,7 @@ size_t read_jpeg_data(
 
 
 
-// this is not a very efficient way of doing this - could be improved considerably
+// collect each MCU into a band of whole rows and pass the rows to the scaler once the band is complete
 int draw_jpeg_function(
     JDEC *jdec,   /* Pointer to the decompression object */
     void *bitmap, /* Bitmap to be output */
@@ -171,8 +188,7 @@ int draw_jpeg_function(
 )
 {
   JPEGHelper *context = (JPEGHelper *)jdec->device;
-  Renderer *renderer = (Renderer *)context->renderer;
-  uint8_t *rgb = (uint8_t *)bitmap;
+  uint8_t *gray = (uint8_t *)bitmap;
   // this is a bit of dirty hack to only delay every line to feed the watchdog
   // feed the watchdog every 50ms
   int64_t now = esp_timer_get_time();
@@ -182,50 +198,28 @@ int draw_jpeg_function(
     vTaskDelay(1);
   }
 
-  // Check if we can use the optimized batch drawing (1:1 scaling)
-  bool fast_path = (context->x_scale > 0.99f && context->x_scale < 1.01f && 
-                    context->y_scale > 0.99f && context->y_scale < 1.01f);
-
-  if (fast_path)
+  // tjpgd is built for grayscale output (JD_FORMAT 2) so this is just the Y channel
+  int width = context->m_decoded_width;
+  int rect_width = rect->right - rect->left + 1;
+  for (int y = 0; y <= rect->bottom - rect->top; y++)
   {
-      int w = rect->right - rect->left + 1;
-      int h = rect->bottom - rect->top + 1;
-      
-      // Ensure buffer is large enough
-      if (context->m_gray_buffer.size() < (size_t)(w * h)) {
-          context->m_gray_buffer.resize(w * h);
-      }
-      
-      uint8_t *gray_ptr = context->m_gray_buffer.data();
-      
-      for (int i = 0; i < w * h; ++i)
-      {
-          uint8_t r = *rgb++;
-          uint8_t g = *rgb++;
-          uint8_t b = *rgb++;
-          // Fast integer approximation of grayscale
-          *gray_ptr++ = (r * 38 + g * 75 + b * 15) >> 7;
-      }
-      
-      // Call optimized batch drawer
-      // Note: rect->left/top are relative to the *decoded* image
-      // We need to offset by x_pos/y_pos
-      // Since scale is 1, coordinates map directly
-      renderer->draw_pixels(context->x_pos + rect->left, context->y_pos + rect->top, w, h, context->m_gray_buffer.data());
+    memcpy(context->m_gray_buffer.data() + y * width + rect->left, gray + y * rect_width, rect_width);
   }
-  else
+  // the last MCU in the row we need - tjpgd clips it to the edge of the image and skips any after the clip
+  ImageScaler &scaler = context->m_scaler;
+  if (rect->right >= scaler.get_end_source_column() - 1)
   {
-      for (int y = rect->top; y <= rect->bottom; y++)
-      {
-        for (int x = rect->left; x <= rect->right; x++)
-        {
-          uint8_t r = *rgb++;
-          uint8_t g = *rgb++;
-          uint8_t b = *rgb++;
-          uint32_t gray = (r * 38 + g * 75 + b * 15) >> 7;
-          renderer->draw_pixel(context->x_pos + x * context->x_scale, context->y_pos + y * context->y_scale, gray);
-        }
-      }
+    // the first MCU row under the clip can start above it
+    int first_row = std::max((int)rect->top, scaler.get_first_source_row());
+    for (int y = first_row; y <= rect->bottom; y++)
+    {
+      scaler.add_row(context->m_gray_buffer.data() + (y - rect->top) * width);
+    }
+    // nothing more to draw - stop decoding
+    if (scaler.is_complete())
+    {
+      return 0;
+    }
   }
   return 1;
 }
@@ -4,6 +4,7 @@
 #include <string>
 #include <vector>
 #include "ImageHelper.h"
+#include "ImageScaler.h"
 
 size_t read_jpeg_data(
     JDEC *jdec,    /* Pointer to the decompression object */
@@ -20,8 +21,6 @@ int draw_jpeg_function(
 class JPEGHelper : public ImageHelper
 {
 private:
-  float x_scale;
-  float y_scale;
   int scale_factor;
   uint32_t last_yield_time;
   // temporary vars used for the JPEG callbacks
@@ -29,11 +28,12 @@ private:
   size_t m_data_pos;
 
   size_t m_data_size;
+  // how much of the pool tjpgd needed for the last image
+  size_t m_pool_used = 0;
+  // tjpgd hands us one MCU at a time - a row of MCUs is collected here before going to the scaler
   std::vector<uint8_t> m_gray_buffer;
-
-  Renderer *renderer;
-  int x_pos;
-  int y_pos;
+  int m_decoded_width;
+  ImageScaler m_scaler;
 
   friend size_t read_jpeg_data(
       JDEC *jdec,    /* Pointer to the decompression object */
@@ -50,4 +50,9 @@ private:
 public:
   bool get_size(const uint8_t *data, size_t data_size, int *width, int *height);
   bool render(const uint8_t *data, size_t data_size, Renderer *renderer, int x_pos, int y_pos, int width, int height);
+  // the same but only the part of the image inside the clip rectangle (in the same coordinates as x_pos and y_pos)
+  // is drawn. MCUs entirely outside it skip the IDCT and decoding stops after the last row that's needed.
+  bool render_clipped(const uint8_t *data, size_t data_size, Renderer *renderer, int x_pos, int y_pos, int width, int height,
+                      int clip_x, int clip_y, int clip_width, int clip_height);
+  size_t get_pool_used() const { return m_pool_used; }
 };
@@ -34,12 +34,20 @@ public:
   }
   void flush_display()
   {
+    if (is_offscreen())
+    {
+      return;
+    }
     driver.WriteFullGram4bpp(m_frame_buffer);
     driver.UpdateFull(needs_gray_flush ? UPDATE_MODE_GC16 : UPDATE_MODE_DU);
     needs_gray_flush = false;
   }
   void flush_area(int x, int y, int width, int height)
   {
+    if (is_offscreen())
+    {
+      return;
+    }
     // there's probably a way of only sending the data we need to send for the area
     driver.WriteFullGram4bpp(m_frame_buffer);
     // don't forger we're rotated
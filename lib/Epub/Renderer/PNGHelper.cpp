@@ -36,6 +36,15 @@ void pngle_init_callback(pngle_t *pngle, uint32_t w, uint32_t h)
     helper->x_scale = static_cast<float>(helper->target_width) / static_cast<float>(w);
     helper->y_scale = static_cast<float>(helper->target_height) / static_cast<float>(h);
   }
+  // non-interlaced images come a row at a time from left to right so they can go through the scaler
+  pngle_ihdr_t *ihdr = pngle_get_ihdr(pngle);
+  helper->m_use_scaler = ihdr && ihdr->interlace == 0 &&
+                         helper->m_scaler.begin(helper->renderer, helper->x_pos, helper->y_pos, w, h,
+                                                helper->target_width, helper->target_height);
+  if (helper->m_use_scaler)
+  {
+    helper->m_gray_row.assign(w, 255);
+  }
 }
 
 void pngle_draw_callback(pngle_t *pngle, uint32_t x, uint32_t y, uint32_t w, uint32_t h, const uint8_t rgba[4])
@@ -58,6 +67,28 @@ void pngle_draw_callback(pngle_t *pngle, uint32_t x, uint32_t y, uint32_t w, uin
   }
   uint8_t gray8 = static_cast<uint8_t>(gray);
 
+  if (helper->m_use_scaler)
+  {
+    size_t end = std::min<size_t>(x + w, helper->m_gray_row.size());
+    for (size_t column = x; column < end; column++)
+    {
+      helper->m_gray_row[column] = gray8;
+    }
+    // that's the row finished
+    if (end == helper->m_gray_row.size())
+    {
+      helper->m_scaler.add_row(helper->m_gray_row.data());
+      // Feed watchdog if needed (once a row)
+      int64_t now = esp_timer_get_time();
+      if (now - helper->last_yield_time > 50000)
+      {
+        vTaskDelay(1);
+        helper->last_yield_time = now;
+      }
+    }
+    return;
+  }
+
   int sx0 = helper->x_pos + static_cast<int>(x * helper->x_scale);
   int sy0 = helper->y_pos + static_cast<int>(y * helper->y_scale);
   int sx1 = helper->x_pos + static_cast<int>((x + w) * helper->x_scale);
@@ -145,6 +176,7 @@ bool PNGHelper::render(const uint8_t *data, size_t data_size, Renderer *renderer
   this->last_y = -1;
   this->x_scale = 1.0f;
   this->y_scale = 1.0f;
+  this->m_use_scaler = false;
 
   pngle_t *png = pngle_new();
   if (!png)
@@ -158,6 +190,8 @@ bool PNGHelper::render(const uint8_t *data, size_t data_size, Renderer *renderer
   pngle_set_draw_callback(png, pngle_draw_callback);
 
   int fed = pngle_feed(png, data, data_size);
+  m_scaler.end();
+  std::vector<uint8_t>().swap(m_gray_row);
   if (fed < 0)
   {
     ESP_LOGE(TAG, "pngle error: %s", pngle_error(png));
@@ -203,17 +237,23 @@ bool PNGHelper::render(const uint8_t *data, size_t data_size, Renderer *renderer
   this->renderer = renderer;
   this->y_pos = y_pos;
   this->x_pos = x_pos;
+  this->last_yield_time = esp_timer_get_time();
   int rc = png.openRAM(const_cast<uint8_t *>(data), data_size, png_draw_callback);
   if (rc == PNG_SUCCESS)
   {
-    this->x_scale = float(width) / float(png.getWidth());
-    this->y_scale = float(height) / float(png.getHeight());
-    this->last_y = -1;
+    if (!m_scaler.begin(renderer, x_pos, y_pos, png.getWidth(), png.getHeight(), width, height))
+    {
+      png.close();
+      return false;
+    }
     this->tmp_rgb565_buffer = (uint16_t *)malloc(png.getWidth() * 2);
+    m_gray_row.resize(png.getWidth());
 
     png.decode(this, PNG_FAST_PALETTE);
     png.close();
     free(this->tmp_rgb565_buffer);
+    m_scaler.end();
+    std::vector<uint8_t>().swap(m_gray_row);
     return true;
   }
   else
@@ -225,24 +265,22 @@ bool PNGHelper::render(const uint8_t *data, size_t data_size, Renderer *renderer
 
 void PNGHelper::draw_callback(PNGDRAW *draw)
 {
-  // work out where we should be drawing this line
-  int y = y_pos + draw->y * y_scale;
-  // only bother to draw if we haven't already drawn to this destination line
-  if (y != last_y)
+  // feed the watchdog
+  int64_t now = esp_timer_get_time();
+  if (now - last_yield_time > 50000)
   {
-    // feed the watchdog
     vTaskDelay(1);
-    // get the rgb 565 pixel values                 BKG is in form of 00BBGGRR
-    png.getLineAsRGB565(draw, tmp_rgb565_buffer, 0, 0x00FFFFFF);
-    for (int x = 0; x < png.getWidth() * x_scale; x++)
-    {
-      uint8_t r, g, b;
-      convert_rgb_565_to_rgb(tmp_rgb565_buffer[int(x / x_scale)], &r, &g, &b);
-      uint32_t gray = (r * 38 + g * 75 + b * 15) >> 7;
-      renderer->draw_pixel(x_pos + x, y, gray);
-    }
-    last_y = y;
+    last_yield_time = now;
+  }
+  // get the rgb 565 pixel values                 BKG is in form of 00BBGGRR
+  png.getLineAsRGB565(draw, tmp_rgb565_buffer, 0, 0x00FFFFFF);
+  for (int x = 0; x < draw->iWidth; x++)
+  {
+    uint8_t r, g, b;
+    convert_rgb_565_to_rgb(tmp_rgb565_buffer[x], &r, &g, &b);
+    m_gray_row[x] = (r * 38 + g * 75 + b * 15) >> 7;
   }
+  m_scaler.add_row(m_gray_row.data());
 };
 
 void png_draw_callback(PNGDRAW *draw)
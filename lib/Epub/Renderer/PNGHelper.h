@@ -1,7 +1,9 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include "ImageHelper.h"
+#include "ImageScaler.h"
 
 class Renderer;
 
@@ -25,6 +27,11 @@ private:
   int target_width;
   int target_height;
   int64_t last_yield_time;
+  // rows of gray go through the scaler - m_use_scaler is false for interlaced images that
+  // don't arrive a row at a time and are drawn with fill_rect instead
+  bool m_use_scaler;
+  ImageScaler m_scaler;
+  std::vector<uint8_t> m_gray_row;
 #ifndef USE_PNGLE
   uint16_t *tmp_rgb565_buffer;
   PNG png;
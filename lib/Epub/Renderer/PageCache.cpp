@@ -0,0 +1,96 @@
+#include "PageCache.h"
+#include <stdlib.h>
+#include <iterator>
+#if !defined(UNIT_TEST) && defined(BOARD_HAS_PSRAM)
+#include <esp_heap_caps.h>
+#endif
+
+PageCache::~PageCache()
+{
+  clear();
+}
+
+const CachedPage *PageCache::find(uint64_t key)
+{
+  for (auto it = m_pages.begin(); it != m_pages.end(); ++it)
+  {
+    if (it->key == key)
+    {
+      m_hits++;
+      m_pages.splice(m_pages.begin(), m_pages, it);
+      return &m_pages.front();
+    }
+  }
+  m_misses++;
+  return nullptr;
+}
+
+bool PageCache::contains(uint64_t key) const
+{
+  for (auto &page : m_pages)
+  {
+    if (page.key == key)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+CachedPage *PageCache::insert(uint64_t key)
+{
+  for (auto it = m_pages.begin(); it != m_pages.end(); ++it)
+  {
+    if (it->key == key)
+    {
+      m_pages.splice(m_pages.begin(), m_pages, it);
+      return &m_pages.front();
+    }
+  }
+  if (m_capacity == 0)
+  {
+    return nullptr;
+  }
+  if (m_pages.size() >= m_capacity)
+  {
+    // recycle the least recently used page
+    m_pages.splice(m_pages.begin(), m_pages, std::prev(m_pages.end()));
+    m_pages.front().key = key;
+    m_pages.front().has_gray = false;
+    return &m_pages.front();
+  }
+  uint8_t *buffer = nullptr;
+#if !defined(UNIT_TEST) && defined(BOARD_HAS_PSRAM)
+  buffer = (uint8_t *)heap_caps_malloc(m_buffer_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+#else
+  buffer = (uint8_t *)malloc(m_buffer_size);
+#endif
+  if (!buffer)
+  {
+    return nullptr;
+  }
+  m_pages.push_front({key, buffer, false});
+  return &m_pages.front();
+}
+
+void PageCache::remove(uint64_t key)
+{
+  for (auto it = m_pages.begin(); it != m_pages.end(); ++it)
+  {
+    if (it->key == key)
+    {
+      free(it->buffer);
+      m_pages.erase(it);
+      return;
+    }
+  }
+}
+
+void PageCache::clear()
+{
+  for (auto &page : m_pages)
+  {
+    free(page.buffer);
+  }
+  m_pages.clear();
+}
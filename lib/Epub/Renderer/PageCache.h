@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <list>
+
+// how many rendered pages to keep - each one is a whole framebuffer so only with PSRAM
+#if defined(BOARD_HAS_PSRAM)
+static const size_t PAGE_CACHE_PAGES = 4;
+#else
+static const size_t PAGE_CACHE_PAGES = 0;
+#endif
+
+// a page rendered into a copy of the framebuffer
+struct CachedPage
+{
+  uint64_t key;
+  uint8_t *buffer;
+  // the page has gray in it so needs a full grayscale update
+  bool has_gray;
+};
+
+// Least recently used cache of rendered pages so turning to a page we've
+// already drawn (or drawn ahead of time) is a copy into the framebuffer
+// rather than drawing every word again. Buffers are reused as pages are
+// evicted so we only allocate up to capacity of them.
+class PageCache
+{
+private:
+  std::list<CachedPage> m_pages;
+  size_t m_buffer_size;
+  size_t m_capacity;
+  uint32_t m_hits = 0;
+  uint32_t m_misses = 0;
+
+public:
+  PageCache(size_t buffer_size, size_t capacity) : m_buffer_size(buffer_size), m_capacity(capacity) {}
+  ~PageCache();
+  PageCache(const PageCache &) = delete;
+  PageCache &operator=(const PageCache &) = delete;
+
+  // pages are identified by the layout key of their section and the page number
+  static uint64_t make_key(uint32_t layout_key, int page) { return ((uint64_t)layout_key << 32) | (uint32_t)page; }
+
+  // look up a page and mark it as recently used - returns nullptr on a miss
+  const CachedPage *find(uint64_t key);
+  // is the page there? - doesn't count as a use
+  bool contains(uint64_t key) const;
+  // get an entry for a page for the caller to render into - the least recently used page's buffer
+  // is reused once the cache is full. Returns nullptr if there's no memory for another buffer.
+  CachedPage *insert(uint64_t key);
+  // forget a page - e.g. if rendering into it didn't work out
+  void remove(uint64_t key);
+  void clear();
+
+  size_t get_buffer_size() const { return m_buffer_size; }
+  size_t get_count() const { return m_pages.size(); }
+  uint32_t get_hits() const { return m_hits; }
+  uint32_t get_misses() const { return m_misses; }
+};
@@ -1,6 +1,9 @@
 #include "Renderer.h"
 #include "JPEGHelper.h"
 #include "PNGHelper.h"
+#include "ImageCache.h"
+#include <string.h>
+#include <algorithm>
 #ifndef UNIT_TEST
 #include <esp_log.h>
 #else
@@ -13,6 +16,16 @@ Renderer::~Renderer()
 {
   delete png_helper;
   delete jpeg_helper;
+  delete image_cache;
+}
+
+ImageCache &Renderer::get_image_cache()
+{
+  if (!image_cache)
+  {
+    image_cache = new ImageCache(IMAGE_CACHE_BUDGET);
+  }
+  return *image_cache;
 }
 
 ImageHelper *Renderer::get_image_helper(const std::string &filename, const uint8_t *data, size_t data_size)
@@ -87,6 +100,78 @@ void Renderer::draw_image(const std::string &filename, const uint8_t *data, size
   }
 }
 
+// Catches what the image helpers draw in a bitmap instead of on the screen.
+// The helpers only use draw_pixel, draw_pixels and fill_rect.
+class BitmapRenderer : public Renderer
+{
+private:
+  uint8_t *m_bitmap;
+  int m_width;
+  int m_height;
+
+public:
+  BitmapRenderer(uint8_t *bitmap, int width, int height) : m_bitmap(bitmap), m_width(width), m_height(height) {}
+  void draw_pixel(int x, int y, uint8_t color)
+  {
+    if (x >= 0 && x < m_width && y >= 0 && y < m_height)
+    {
+      m_bitmap[y * m_width + x] = color;
+    }
+  }
+  void draw_pixels(int x, int y, int width, int height, const uint8_t *data)
+  {
+    int start_x = std::max(x, 0);
+    int end_x = std::min(x + width, m_width);
+    for (int row = std::max(y, 0); row < std::min(y + height, m_height); row++)
+    {
+      if (start_x < end_x)
+      {
+        memcpy(m_bitmap + row * m_width + start_x, data + (row - y) * width + (start_x - x), end_x - start_x);
+      }
+    }
+  }
+  void fill_rect(int x, int y, int width, int height, uint8_t color = 0)
+  {
+    int start_x = std::max(x, 0);
+    int end_x = std::min(x + width, m_width);
+    for (int row = std::max(y, 0); row < std::min(y + height, m_height); row++)
+    {
+      if (start_x < end_x)
+      {
+        memset(m_bitmap + row * m_width + start_x, color, end_x - start_x);
+      }
+    }
+  }
+  int get_text_width(const char *text, bool bold = false, bool italic = false) { return 0; }
+  void draw_text(int x, int y, const char *text, bool bold = false, bool italic = false) {}
+  void draw_rect(int x, int y, int width, int height, uint8_t color = 0) {}
+  void draw_triangle(int x0, int y0, int x1, int y1, int x2, int y2, uint8_t color) {}
+  void draw_circle(int x, int y, int r, uint8_t color = 0) {}
+  void fill_triangle(int x0, int y0, int x1, int y1, int x2, int y2, uint8_t color) {}
+  void fill_circle(int x, int y, int r, uint8_t color = 0) {}
+  void needs_gray(uint8_t color) {}
+  bool has_gray() { return false; }
+  void show_busy() {}
+  void show_img(int x, int y, int width, int height, const uint8_t *img_buffer) {}
+  void clear_screen() {}
+  int get_page_width() { return m_width; }
+  int get_page_height() { return m_height; }
+  int get_space_width() { return 0; }
+  int get_line_height() { return 0; }
+};
+
+bool Renderer::decode_image(const std::string &filename, const uint8_t *data, size_t data_size, int width, int height, uint8_t *bitmap)
+{
+  ImageHelper *helper = get_image_helper(filename, data, data_size);
+  if (!helper || !data || width <= 0 || height <= 0)
+  {
+    return false;
+  }
+  memset(bitmap, 255, width * height);
+  BitmapRenderer bitmap_renderer(bitmap, width, height);
+  return helper->render(data, data_size, &bitmap_renderer, 0, 0, width, height);
+}
+
 bool Renderer::get_image_size(const std::string &filename, const uint8_t *data, size_t data_size, int *width, int *height)
 {
   ImageHelper *helper = get_image_helper(filename, data, data_size);
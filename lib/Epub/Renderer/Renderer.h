@@ -1,8 +1,17 @@
 #pragma once
 
 #include <string>
+#include <stdint.h>
+#include <stddef.h>
 
 class ImageHelper;
+class ImageCache;
+
+#if defined(BOARD_HAS_PSRAM)
+static const size_t IMAGE_CACHE_BUDGET = 2 * 1024 * 1024;
+#else
+static const size_t IMAGE_CACHE_BUDGET = 64 * 1024;
+#endif
 
 #ifdef USE_FREETYPE
 class FreeTypeFont;
@@ -15,6 +24,7 @@ class Renderer
 private:
   ImageHelper *png_helper = nullptr;
   ImageHelper *jpeg_helper = nullptr;
+  ImageCache *image_cache = nullptr;
 
   ImageHelper *get_image_helper(const std::string &filename, const uint8_t *data, size_t data_size);
 
@@ -30,6 +40,10 @@ public:
   void set_image_placeholder_enabled(bool enabled) { image_placeholder_enabled = enabled; }
   virtual void draw_image(const std::string &filename, const uint8_t *data, size_t data_size, int x, int y, int width, int height);
   virtual bool get_image_size(const std::string &filename, const uint8_t *data, size_t data_size, int *width, int *height);
+  // decode an image scaled to fit width x height into an 8 bit gray bitmap of that size (white where the image doesn't cover it)
+  bool decode_image(const std::string &filename, const uint8_t *data, size_t data_size, int width, int height, uint8_t *bitmap);
+  // decoded images that have already been drawn, so they can be drawn again with draw_pixels
+  ImageCache &get_image_cache();
   virtual void draw_pixel(int x, int y, uint8_t color) = 0;
   virtual void draw_pixels(int x, int y, int width, int height, const uint8_t *data) {
       for (int dy = 0; dy < height; ++dy) {
@@ -38,6 +52,52 @@ public:
           }
       }
   }
+  // draw a 4 bit gray bitmap packed two pixels to a byte - the left pixel in the high nibble and
+  // each row padded to a whole byte. Renderers that own a framebuffer can copy the nibbles directly.
+  virtual void draw_packed_gray(int x, int y, int width, int height, const uint8_t *data)
+  {
+    int stride = (width + 1) / 2;
+    for (int dy = 0; dy < height; ++dy)
+    {
+      const uint8_t *row = data + dy * stride;
+      for (int dx = 0; dx < width; ++dx)
+      {
+        uint8_t nibble = (dx & 1) ? (row[dx / 2] & 0x0F) : (row[dx / 2] >> 4);
+        draw_pixel(x + dx, y + dy, nibble * 17);
+      }
+    }
+  }
+  // draw an 8 bit coverage bitmap (0 = transparent, 255 = solid) such as a rendered glyph with its top left at x, y.
+  // The default goes through draw_pixel - renderers that own a framebuffer can write it directly.
+  virtual void draw_glyph(int x, int y, int width, int height, const uint8_t *coverage, int pitch)
+  {
+    for (int dy = 0; dy < height; ++dy)
+    {
+      const uint8_t *src = coverage + dy * pitch;
+      for (int dx = 0; dx < width; ++dx)
+      {
+        uint8_t alpha = src[dx];
+        if (alpha == 0)
+        {
+          continue;
+        }
+        // On Paper S3 we favor strong contrast over subtle
+        // antialiasing because the grayscale gamma curve tends to
+        // wash out light text. Use a simple alpha threshold to draw
+        // solid black text.
+#if defined(BOARD_TYPE_PAPER_S3)
+        if (alpha > 64)
+        {
+          draw_pixel(x + dx, y + dy, 0);
+        }
+#else
+        // Default path: map alpha (0 = transparent, 255 = solid) to
+        // a grayscale value (0 = black, 255 = white) by inverting it.
+        draw_pixel(x + dx, y + dy, 255 - alpha);
+#endif
+      }
+    }
+  }
   virtual int get_text_width(const char *text, bool bold = false, bool italic = false) = 0;
   virtual void draw_text(int x, int y, const char *text, bool bold = false, bool italic = false) = 0;
   virtual void draw_text_box(const std::string &text, int x, int y, int width, int height, bool bold = false, bool italic = false);
@@ -55,6 +115,21 @@ public:
   virtual void clear_screen() = 0;
   virtual void flush_display(){};
   virtual void flush_area(int x, int y, int width, int height){};
+  // Pages can be rendered off screen into a buffer of get_page_buffer_size() bytes and shown
+  // later with a copy. Renderers without a framebuffer return 0 and ignore the rest.
+  virtual size_t get_page_buffer_size() { return 0; }
+  // draw into buffer instead of the screen until end_offscreen - nothing is flushed in between
+  virtual bool begin_offscreen(uint8_t *buffer) { return false; }
+  // go back to drawing on the screen - returns true if anything gray was drawn off screen
+  virtual bool end_offscreen() { return false; }
+  // copy what has been drawn on the screen (flushed or not) into a page buffer
+  virtual void save_page(uint8_t *buffer) {}
+  // put a page buffer on the screen - flush_display shows it
+  virtual void restore_page(const uint8_t *buffer, bool has_gray) {}
+  // A renderer with the same page size and fonts as this one that only measures - it never
+  // touches the display so sections can be laid out with it on another task. The caller owns
+  // it. Returns nullptr if this renderer can't make one.
+  virtual Renderer *create_measuring_renderer() { return nullptr; }
 
 #ifdef USE_FREETYPE
   // Optional hooks for FreeType-backed rendering. Default
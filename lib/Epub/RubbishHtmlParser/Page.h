@@ -11,6 +11,9 @@ public:
   PageElement(int y_pos) : y_pos(y_pos) {}
   virtual ~PageElement() {}
   virtual void render(Renderer *renderer, Epub *epub) = 0;
+  // where the element came from - used when saving the layout
+  virtual Block *get_block() = 0;
+  virtual int get_line() { return 0; }
 };
 
 // a line from a block element
@@ -30,6 +33,8 @@ public:
   {
     block->render(renderer, line_break_index, 0, y_pos);
   }
+  Block *get_block() { return block; }
+  int get_line() { return line_break_index; }
 };
 
 // an image
@@ -46,14 +51,16 @@ public:
   {
     block->render(renderer, epub, y_pos);
   }
+  Block *get_block() { return block; }
 };
 
-// a layed out page ready to be rendered
+// a layed out page ready to be rendered - the page and its elements live in the section arena
 class Page
 {
 public:
   // the list of block index and line numbers on this page
-  std::vector<PageElement *> elements;
+  ArenaVector<PageElement *> elements;
+  Page(SectionArena *arena) : elements(arena) {}
   void render(Renderer *renderer, Epub *epub)
   {
     for (auto element : elements)
@@ -61,11 +68,4 @@ public:
       element->render(renderer, epub);
     }
   }
-  ~Page()
-  {
-    for (auto element : elements)
-    {
-      delete element;
-    }
-  }
 };
@@ -12,9 +12,10 @@
 #include <string>
 #include <list>
 #include <vector>
-#include <functional>
+#include <unordered_map>
 #include <exception>
 #include <ctype.h>
+#include <limits.h>
 #include "../ZipFile/ZipFile.h"
 #include "../Renderer/Renderer.h"
 #include "htmlEntities.h"
@@ -115,39 +116,121 @@ BLOCK_STYLE parse_text_align_from_style(const char *style_attr, BLOCK_STYLE defa
   return default_style;
 }
 
+// longest tag we bother keeping - anything past this is just attributes we don't care about
+static const size_t MAX_TAG_LENGTH = 1024;
+// once this much text has built up we hand it over to the current block at the next word break
+static const size_t MAX_TEXT_LENGTH = 1024;
+
+static bool is_tag_whitespace(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// pull the value of an attribute out of the raw contents of a tag - e.g. img src="test.png"
+static bool get_attribute(const std::string &tag, const char *name, std::string &value)
+{
+  size_t name_length = strlen(name);
+  size_t index = 0;
+  // skip the tag name
+  while (index < tag.size() && !is_tag_whitespace(tag[index]) && tag[index] != '/')
+  {
+    index++;
+  }
+  while (index < tag.size())
+  {
+    while (index < tag.size() && (is_tag_whitespace(tag[index]) || tag[index] == '/'))
+    {
+      index++;
+    }
+    size_t attr_start = index;
+    while (index < tag.size() && !is_tag_whitespace(tag[index]) && tag[index] != '=' && tag[index] != '/')
+    {
+      index++;
+    }
+    size_t attr_length = index - attr_start;
+    while (index < tag.size() && is_tag_whitespace(tag[index]))
+    {
+      index++;
+    }
+    size_t value_start = index;
+    size_t value_end = index;
+    if (index < tag.size() && tag[index] == '=')
+    {
+      index++;
+      while (index < tag.size() && is_tag_whitespace(tag[index]))
+      {
+        index++;
+      }
+      if (index < tag.size() && (tag[index] == '"' || tag[index] == '\''))
+      {
+        char quote = tag[index++];
+        value_start = index;
+        while (index < tag.size() && tag[index] != quote)
+        {
+          index++;
+        }
+        value_end = index;
+        index++;
+      }
+      else
+      {
+        value_start = index;
+        while (index < tag.size() && !is_tag_whitespace(tag[index]))
+        {
+          index++;
+        }
+        value_end = index;
+      }
+    }
+    if (attr_length == 0)
+    {
+      break;
+    }
+    if (attr_length == name_length && tag.compare(attr_start, attr_length, name) == 0)
+    {
+      value = replace_html_entities(tag.substr(value_start, value_end - value_start));
+      return true;
+    }
+  }
+  return false;
+}
+
 RubbishHtmlParser::RubbishHtmlParser(const char *html, int length, const std::string &base_path, bool justify_paragraphs)
-    : m_justify_paragraphs(justify_paragraphs)
+    : RubbishHtmlParser(base_path, justify_paragraphs)
 {
-  m_base_path = base_path;
   parse(html, length);
 }
 
+RubbishHtmlParser::RubbishHtmlParser(const std::string &base_path, bool justify_paragraphs)
+    : blocks(&m_arena), pages(&m_arena), m_justify_paragraphs(justify_paragraphs)
+{
+  m_base_path = base_path;
+  // Default paragraph alignment is controlled by the reader setting.
+  startNewTextBlock(m_justify_paragraphs ? JUSTIFIED : LEFT_ALIGN);
+}
+
 RubbishHtmlParser::~RubbishHtmlParser()
 {
-  for (auto block : blocks)
-  {
-    delete block;
-  }
+  // the blocks and pages all go with the arena
 }
 
-bool RubbishHtmlParser::enter_node(const pugi::xml_node &element)
+bool RubbishHtmlParser::enter_node(const char *tag_name, const std::string &tag)
 {
-  const char *tag_name = element.name();
   // we only handle image tags
   if (matches(tag_name, IMAGE_TAGS, NUM_IMAGE_TAGS))
   {
-    const char *src = element.attribute("src").value();
-    if (src)
+    std::string src;
+    if (get_attribute(tag, "src", src))
     {
       // don't leave an empty text block in the list
       BLOCK_STYLE style = currentTextBlock->get_style();
       if (currentTextBlock->is_empty())
       {
         blocks.pop_back();
-        delete currentTextBlock;
         currentTextBlock = nullptr;
       }
-      blocks.push_back(new ImageBlock(m_base_path + src));
+      std::string path = m_base_path + src;
+      blocks.push_back(m_arena.create<ImageBlock>(m_arena.copy_string(path.c_str(), path.size())));
       // start a new text block - with the same style as before
       startNewTextBlock(style);
     }
@@ -182,8 +265,12 @@ bool RubbishHtmlParser::enter_node(const pugi::xml_node &element)
       // depending on the reader setting, but still honour explicit
       // CSS text-align where present.
       BLOCK_STYLE default_style = m_justify_paragraphs ? JUSTIFIED : LEFT_ALIGN;
-      const char *style_attr = element.attribute("style").value();
-      BLOCK_STYLE style = parse_text_align_from_style(style_attr, default_style, m_justify_paragraphs);
+      std::string style_attr;
+      BLOCK_STYLE style = default_style;
+      if (get_attribute(tag, "style", style_attr))
+      {
+        style = parse_text_align_from_style(style_attr.c_str(), default_style, m_justify_paragraphs);
+      }
       startNewTextBlock(style);
     }
   }
@@ -198,18 +285,16 @@ bool RubbishHtmlParser::enter_node(const pugi::xml_node &element)
   return true;
 }
 /// Visit a text node.
-bool RubbishHtmlParser::visit_text(const pugi::xml_node &node)
+bool RubbishHtmlParser::visit_text(const char *text)
 {
-  const char *value = node.value();
-  if (value && value[0] != '\0')
+  if (text && text[0] != '\0')
   {
-    addText(value, is_bold, is_italic);
+    addText(text, is_bold, is_italic);
   }
   return true;
 }
-bool RubbishHtmlParser::exit_node(const pugi::xml_node &element)
+bool RubbishHtmlParser::exit_node(const char *tag_name)
 {
-  const char *tag_name = element.name();
   if (matches(tag_name, HEADER_TAGS, NUM_HEADER_TAGS))
   {
     is_bold = false;
@@ -245,56 +330,195 @@ void RubbishHtmlParser::startNewTextBlock(BLOCK_STYLE style)
       currentTextBlock->finish();
     }
   }
-  currentTextBlock = new TextBlock(style);
+  currentTextBlock = m_arena.create<TextBlock>(style, &m_arena);
   blocks.push_back(currentTextBlock);
 }
 
 void RubbishHtmlParser::parse(const char *html, int length)
 {
-  // Default paragraph alignment is controlled by the reader setting.
-  startNewTextBlock(m_justify_paragraphs ? JUSTIFIED : LEFT_ALIGN);
-  pugi::xml_document doc;
-  // Preserve significant text while still collapsing some whitespace via
-  // our own addText() handling.
-  pugi::xml_parse_result result =
-      doc.load_buffer(html, length, pugi::parse_default | pugi::parse_ws_pcdata);
+  feed(html, length);
+  finish();
+}
 
-  if (!result)
+// hand any pending text over to the current block
+void RubbishHtmlParser::flush_text()
+{
+  if (m_text.empty())
   {
-    // If parsing fails, just treat everything as a single text block.
-    addText(html, false, false);
     return;
   }
+  if (m_skip_depth == 0)
+  {
+    visit_text(m_text.c_str());
+  }
+  m_text.clear();
+}
+
+// comments and CDATA sections can contain '>' so only finish them on the proper terminator
+bool RubbishHtmlParser::tag_is_complete()
+{
+  if (m_tag.compare(0, 3, "!--") == 0)
+  {
+    return (m_tag.size() >= 5 || m_tag_truncated) && m_tag_tail[0] == '-' && m_tag_tail[1] == '-';
+  }
+  if (m_tag.compare(0, 8, "![CDATA[") == 0)
+  {
+    return (m_tag.size() >= 10 || m_tag_truncated) && m_tag_tail[0] == ']' && m_tag_tail[1] == ']';
+  }
+  return true;
+}
 
-  pugi::xml_node root = doc.child("html");
-  pugi::xml_node body = root ? root.child("body") : pugi::xml_node();
-  pugi::xml_node start = body ? body : doc;
+// work out what to do with the tag we've just read
+void RubbishHtmlParser::process_tag()
+{
+  if (m_tag.empty())
+  {
+    return;
+  }
+  if (m_tag[0] == '!')
+  {
+    // CDATA is text, anything else (comments, DOCTYPE) we ignore
+    if (m_tag.compare(0, 8, "![CDATA[") == 0 && !m_tag_truncated && m_tag.size() >= 10)
+    {
+      m_text = m_tag.substr(8, m_tag.size() - 10);
+      flush_text();
+    }
+    return;
+  }
+  if (m_tag[0] == '?')
+  {
+    // processing instruction - e.g. <?xml version="1.0"?>
+    return;
+  }
+  bool is_closing = m_tag[0] == '/';
+  bool is_self_closing = !is_closing && m_tag.back() == '/';
+  size_t name_start = is_closing ? 1 : 0;
+  size_t name_end = name_start;
+  while (name_end < m_tag.size() && !is_tag_whitespace(m_tag[name_end]) && m_tag[name_end] != '/')
+  {
+    name_end++;
+  }
+  std::string tag_name = m_tag.substr(name_start, name_end - name_start);
+  if (tag_name.empty())
+  {
+    return;
+  }
+  // inside an element we are skipping - just keep track of when it ends
+  if (m_skip_depth > 0)
+  {
+    if (tag_name == m_skip_tag)
+    {
+      if (is_closing)
+      {
+        m_skip_depth--;
+      }
+      else if (!is_self_closing)
+      {
+        m_skip_depth++;
+      }
+    }
+    return;
+  }
+  if (is_closing)
+  {
+    exit_node(tag_name.c_str());
+    return;
+  }
+  if (!enter_node(tag_name.c_str(), m_tag))
+  {
+    if (!is_self_closing)
+    {
+      m_skip_tag = tag_name;
+      m_skip_depth = 1;
+    }
+    return;
+  }
+  if (is_self_closing)
+  {
+    exit_node(tag_name.c_str());
+  }
+}
 
-  std::function<void(const pugi::xml_node &)> walk =
-      [&](const pugi::xml_node &node)
+// tokenize the next chunk of the document - tags and text can be split across chunks
+void RubbishHtmlParser::feed(const char *data, size_t length)
+{
+  size_t index = 0;
+  while (index < length)
+  {
+    if (m_state == IN_TEXT)
+    {
+      const char *tag_start = (const char *)memchr(data + index, '<', length - index);
+      size_t text_end = tag_start ? tag_start - data : length;
+      m_text.append(data + index, text_end - index);
+      index = text_end;
+      if (tag_start)
+      {
+        flush_text();
+        m_state = IN_TAG;
+        m_tag.clear();
+        m_tag_truncated = false;
+        m_tag_tail[0] = m_tag_tail[1] = 0;
+        m_quote = 0;
+        index++;
+      }
+      else if (m_text.size() > MAX_TEXT_LENGTH)
       {
-        if (node.type() == pugi::node_element)
+        // a very long run of text - pass over everything up to the last word break
+        size_t split = m_text.find_last_of(" \r\n");
+        if (split != std::string::npos && split > 0)
         {
-          if (!enter_node(node))
-          {
-            return;
-          }
-          for (pugi::xml_node child : node.children())
-          {
-            walk(child);
-          }
-          exit_node(node);
+          std::string remainder = m_text.substr(split);
+          m_text.resize(split);
+          flush_text();
+          m_text = remainder;
         }
-        else if (node.type() == pugi::node_pcdata || node.type() == pugi::node_cdata)
+      }
+    }
+    else
+    {
+      char c = data[index++];
+      if (m_quote)
+      {
+        if (c == m_quote)
         {
-          visit_text(node);
+          m_quote = 0;
         }
-      };
+      }
+      else if (c == '>' && tag_is_complete())
+      {
+        process_tag();
+        m_state = IN_TEXT;
+        continue;
+      }
+      else if ((c == '"' || c == '\'') && !m_tag.empty() && m_tag[0] != '!' && m_tag[0] != '?')
+      {
+        m_quote = c;
+      }
+      if (m_tag.size() < MAX_TAG_LENGTH)
+      {
+        m_tag += c;
+      }
+      else
+      {
+        m_tag_truncated = true;
+      }
+      m_tag_tail[0] = m_tag_tail[1];
+      m_tag_tail[1] = c;
+    }
+  }
+}
 
-  for (pugi::xml_node child : start.children())
+// the end of the document - anything left in an unterminated tag is dropped
+void RubbishHtmlParser::finish()
+{
+  if (m_state == IN_TEXT)
   {
-    walk(child);
+    flush_text();
   }
+  m_state = IN_TEXT;
+  m_text.clear();
+  m_tag.clear();
+  m_skip_depth = 0;
 }
 
 void RubbishHtmlParser::addText(const char *text, bool is_bold, bool is_italic)
@@ -306,75 +530,128 @@ void RubbishHtmlParser::addText(const char *text, bool is_bold, bool is_italic)
 
 static const int MAX_IMAGES_PER_SECTION = 8;
 
-void RubbishHtmlParser::layout(Renderer *renderer, Epub *epub)
+// get ready to lay out the section - the renderer decides the page geometry
+void RubbishHtmlParser::start_layout(Renderer *renderer)
 {
-  const int line_height = renderer->get_line_height();
-  const int page_height = renderer->get_page_height();
-  // first ask the blocks to work out where they should have
-  // line breaks based on the page width
-  int images_seen = 0;
-  for (auto block : blocks)
+  if (m_layout_started)
+  {
+    return;
+  }
+  m_layout_started = true;
+  m_line_height = renderer->get_line_height();
+  m_page_height = renderer->get_page_height();
+  m_layout_block = blocks.begin();
+  m_layout_complete = blocks.empty();
+  pages.push_back(m_arena.create<Page>(&m_arena));
+}
+
+// start a new page - returns false if we now have enough pages and should stop
+bool RubbishHtmlParser::start_new_page(int stop_after_page)
+{
+  pages.push_back(m_arena.create<Page>(&m_arena));
+  m_layout_y = 0;
+  return static_cast<int>(pages.size()) - 1 <= stop_after_page;
+}
+
+// work out the line breaks for the block under the cursor and allocate its lines to pages.
+// Returns false if we stopped part way through the block because enough pages are ready.
+bool RubbishHtmlParser::layout_block(Renderer *renderer, Epub *epub, int stop_after_page)
+{
+  Block *block = *m_layout_block;
+  if (!m_layout_block_measured)
   {
+    // ask the block to work out where it should have line breaks based on the page width
+    bool skip = false;
     if (block->getType() == BlockType::IMAGE_BLOCK)
     {
-      images_seen++;
-      if (images_seen > MAX_IMAGES_PER_SECTION)
+      m_images_seen++;
+      if (m_images_seen > MAX_IMAGES_PER_SECTION)
       {
         ImageBlock *imageBlock = (ImageBlock *)block;
         imageBlock->width = 0;
         imageBlock->height = 0;
-        // feed the watchdog even when skipping heavy images
-        vTaskDelay(1);
-        continue;
+        skip = true;
       }
     }
-
-    block->layout(renderer, epub);
+    if (!skip)
+    {
+      block->layout(renderer, epub);
+    }
+    m_layout_block_measured = true;
     // feed the watchdog
     vTaskDelay(1);
   }
-  // now we need to allocate the lines to pages
-  // we'll run through each block and the lines within each block and allocate
-  // them to pages. When we run out of space on a page we'll start a new page
-  // and continue
-  int y = 0;
-  pages.push_back(new Page());
-  for (auto block : blocks)
+  // now allocate the lines to pages - when we run out of space on a page we start a new page and continue
+  if (block->getType() == BlockType::TEXT_BLOCK)
   {
-    // feed the watchdog
-    vTaskDelay(1);
-    if (block->getType() == BlockType::TEXT_BLOCK)
+    TextBlock *textBlock = (TextBlock *)block;
+    for (; m_layout_line < static_cast<int>(textBlock->line_breaks.size()); m_layout_line++)
     {
-      TextBlock *textBlock = (TextBlock *)block;
-      for (int line_break_index = 0; line_break_index < textBlock->line_breaks.size(); line_break_index++)
+      if (m_layout_y + m_line_height > m_page_height)
       {
-        if (y + line_height > page_height)
+        if (!start_new_page(stop_after_page))
         {
-          pages.push_back(new Page());
-          y = 0;
+          return false;
         }
-        pages.back()->elements.push_back(new PageLine(textBlock, line_break_index, y));
-        y += line_height;
       }
-      // add some extra line between blocks
-      y += line_height * 0.5;
+      pages.back()->elements.push_back(m_arena.create<PageLine>(textBlock, m_layout_line, m_layout_y));
+      m_layout_y += m_line_height;
     }
-    if (block->getType() == BlockType::IMAGE_BLOCK)
+    // add some extra line between blocks
+    m_layout_y += m_line_height * 0.5;
+  }
+  if (block->getType() == BlockType::IMAGE_BLOCK)
+  {
+    ImageBlock *imageBlock = (ImageBlock *)block;
+    if (imageBlock->width > 0 && imageBlock->height > 0)
     {
-      ImageBlock *imageBlock = (ImageBlock *)block;
-      if (imageBlock->width <= 0 || imageBlock->height <= 0)
+      // for images m_layout_line records that we've already moved on to a fresh page
+      if (m_layout_line == 0 && m_layout_y + imageBlock->height > m_page_height)
       {
-        continue;
-      }
-      if (y + imageBlock->height > page_height)
-      {
-        pages.push_back(new Page());
-        y = 0;
+        m_layout_line = 1;
+        if (!start_new_page(stop_after_page))
+        {
+          return false;
+        }
       }
-      pages.back()->elements.push_back(new PageImage(imageBlock, y));
-      y += imageBlock->height;
+      pages.back()->elements.push_back(m_arena.create<PageImage>(imageBlock, m_layout_y));
+      m_layout_y += imageBlock->height;
     }
   }
+  // move on to the next block
+  ++m_layout_block;
+  m_layout_line = 0;
+  m_layout_block_measured = false;
+  m_layout_complete = m_layout_block == blocks.end();
+  return true;
+}
+
+void RubbishHtmlParser::layout(Renderer *renderer, Epub *epub)
+{
+  layout_to_page(renderer, epub, INT_MAX);
+}
+
+void RubbishHtmlParser::layout_to_page(Renderer *renderer, Epub *epub, int page_index)
+{
+  start_layout(renderer);
+  // page_index is complete once we've moved on to the page after it
+  while (!m_layout_complete && static_cast<int>(pages.size()) - 1 <= page_index)
+  {
+    if (!layout_block(renderer, epub, page_index))
+    {
+      break;
+    }
+  }
+}
+
+bool RubbishHtmlParser::layout_step(Renderer *renderer, Epub *epub)
+{
+  start_layout(renderer);
+  if (!m_layout_complete)
+  {
+    layout_block(renderer, epub, INT_MAX);
+  }
+  return !m_layout_complete;
 }
 
 void RubbishHtmlParser::render_page(int page_index, Renderer *renderer, Epub *epub)
@@ -400,3 +677,202 @@ void RubbishHtmlParser::render_page(int page_index, Renderer *renderer, Epub *ep
 
   pages[page_index]->render(renderer, epub);
 }
+
+// Layout cache file:
+// uint32_t magic, uint16_t version, uint16_t reserved, uint32_t key, uint32_t block count, uint32_t page count
+// then each block (uint8_t type followed by the block's own record)
+// then each page (uint32_t element count followed by uint8_t type, uint32_t block index, int32_t line, int32_t y for each element)
+static const uint32_t LAYOUT_CACHE_MAGIC = 0x59414c45; // 'ELAY'
+static const uint16_t LAYOUT_CACHE_VERSION = 1;
+
+typedef struct
+{
+  uint32_t magic;
+  uint16_t version;
+  uint16_t reserved;
+  uint32_t key;
+  uint32_t block_count;
+  uint32_t page_count;
+} LayoutCacheHeader;
+
+typedef struct
+{
+  uint8_t type;
+  uint32_t block_index;
+  int32_t line;
+  int32_t y_pos;
+} __attribute__((packed)) LayoutCacheElement;
+
+bool RubbishHtmlParser::save_layout(const char *path, uint32_t key)
+{
+  if (!m_layout_complete)
+  {
+    ESP_LOGE(TAG, "Can't cache a section that hasn't been fully laid out");
+    return false;
+  }
+  // write to a temporary file so we never leave a half written cache file behind
+  std::string tmp_path = std::string(path) + ".tmp";
+  FILE *fp = fopen(tmp_path.c_str(), "wb");
+  if (!fp)
+  {
+    ESP_LOGE(TAG, "Failed to open %s for writing", tmp_path.c_str());
+    return false;
+  }
+  LayoutCacheHeader header = {LAYOUT_CACHE_MAGIC, LAYOUT_CACHE_VERSION, 0, key, (uint32_t)blocks.size(), (uint32_t)pages.size()};
+  bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+  // remember where each block ended up so the pages can refer to them by index
+  std::unordered_map<Block *, uint32_t> block_indices;
+  block_indices.reserve(blocks.size());
+  for (auto block : blocks)
+  {
+    if (!ok)
+    {
+      break;
+    }
+    uint8_t type = block->getType();
+    ok = fwrite(&type, sizeof(type), 1, fp) == 1;
+    if (ok && type == BlockType::TEXT_BLOCK)
+    {
+      ok = ((TextBlock *)block)->write_layout(fp);
+    }
+    else if (ok)
+    {
+      ok = ((ImageBlock *)block)->write_layout(fp);
+    }
+    uint32_t index = block_indices.size();
+    block_indices[block] = index;
+  }
+  for (auto page : pages)
+  {
+    if (!ok)
+    {
+      break;
+    }
+    uint32_t element_count = page->elements.size();
+    ok = fwrite(&element_count, sizeof(element_count), 1, fp) == 1;
+    for (auto element : page->elements)
+    {
+      if (!ok)
+      {
+        break;
+      }
+      Block *block = element->get_block();
+      LayoutCacheElement record = {(uint8_t)block->getType(), block_indices[block], element->get_line(), element->y_pos};
+      ok = fwrite(&record, sizeof(record), 1, fp) == 1;
+    }
+  }
+  ok = fclose(fp) == 0 && ok;
+  if (!ok)
+  {
+    ESP_LOGE(TAG, "Failed to write layout cache %s", tmp_path.c_str());
+    remove(tmp_path.c_str());
+    return false;
+  }
+  remove(path);
+  if (rename(tmp_path.c_str(), path) != 0)
+  {
+    ESP_LOGE(TAG, "Failed to rename %s", tmp_path.c_str());
+    remove(tmp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool RubbishHtmlParser::load_layout(const char *path, uint32_t key)
+{
+  if (m_layout_started || blocks.size() > 1 || !currentTextBlock->is_empty())
+  {
+    ESP_LOGE(TAG, "Can only load a layout into an empty parser");
+    return false;
+  }
+  FILE *fp = fopen(path, "rb");
+  if (!fp)
+  {
+    return false;
+  }
+  LayoutCacheHeader header;
+  if (fread(&header, sizeof(header), 1, fp) != 1 || header.magic != LAYOUT_CACHE_MAGIC ||
+      header.version != LAYOUT_CACHE_VERSION || header.key != key)
+  {
+    // stale or from a different version - the caller will lay the section out again
+    fclose(fp);
+    return false;
+  }
+  // a corrupt file leaves some garbage in the arena - the caller throws the parser away when that happens
+  std::vector<Block *> block_list;
+  std::vector<Page *> page_list;
+  bool ok = true;
+  for (uint32_t i = 0; ok && i < header.block_count; i++)
+  {
+    uint8_t type = 0;
+    Block *block = nullptr;
+    if (fread(&type, sizeof(type), 1, fp) == 1)
+    {
+      if (type == BlockType::TEXT_BLOCK)
+      {
+        block = TextBlock::read_layout(fp, &m_arena);
+      }
+      else if (type == BlockType::IMAGE_BLOCK)
+      {
+        block = ImageBlock::read_layout(fp, &m_arena);
+      }
+    }
+    ok = block != nullptr;
+    if (ok)
+    {
+      block_list.push_back(block);
+    }
+  }
+  for (uint32_t i = 0; ok && i < header.page_count; i++)
+  {
+    uint32_t element_count = 0;
+    ok = fread(&element_count, sizeof(element_count), 1, fp) == 1;
+    if (!ok)
+    {
+      break;
+    }
+    Page *page = m_arena.create<Page>(&m_arena);
+    page_list.push_back(page);
+    for (uint32_t j = 0; ok && j < element_count; j++)
+    {
+      LayoutCacheElement record;
+      ok = fread(&record, sizeof(record), 1, fp) == 1 && record.block_index < block_list.size() &&
+           record.type == block_list[record.block_index]->getType();
+      if (!ok)
+      {
+        break;
+      }
+      Block *block = block_list[record.block_index];
+      // copies - the record is packed so its fields can't be passed by reference
+      int line = record.line;
+      int y_pos = record.y_pos;
+      if (record.type == TEXT_BLOCK)
+      {
+        TextBlock *text_block = (TextBlock *)block;
+        ok = line >= 0 && line < static_cast<int>(text_block->line_breaks.size());
+        if (ok)
+        {
+          page->elements.push_back(m_arena.create<PageLine>(text_block, line, y_pos));
+        }
+      }
+      else
+      {
+        page->elements.push_back(m_arena.create<PageImage>((ImageBlock *)block, y_pos));
+      }
+    }
+  }
+  fclose(fp);
+  if (!ok || page_list.empty())
+  {
+    ESP_LOGE(TAG, "Corrupt layout cache %s", path);
+    return false;
+  }
+  // swap out the empty starting block for the cached ones
+  blocks.assign(block_list.begin(), block_list.end());
+  pages.assign(page_list.begin(), page_list.end());
+  currentTextBlock = nullptr;
+  m_layout_started = true;
+  m_layout_complete = true;
+  m_layout_block = blocks.end();
+  return true;
+}
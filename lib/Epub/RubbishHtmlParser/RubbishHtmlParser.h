@@ -3,8 +3,8 @@
 #include <string>
 #include <list>
 #include <vector>
-#include <pugixml.hpp>
 #include "blocks/TextBlock.h"
+#include "SectionArena.h"
 
 using namespace std;
 
@@ -14,15 +14,53 @@ class Epub;
 
 // a very stupid xhtml parser - it will probably work for very simple cases
 // but will probably fail for complex ones
+//
+// The document can be fed in chunks (e.g. straight out of the zip inflater)
+// and blocks are created as the tags go past, so we never need the whole
+// chapter or a DOM in memory at once.
 class RubbishHtmlParser
 {
 private:
+  // where the tokenizer is in the document
+  enum TokenizerState
+  {
+    IN_TEXT,
+    IN_TAG,
+  };
+  TokenizerState m_state = IN_TEXT;
+  // quote character if we are inside a quoted attribute value
+  char m_quote = 0;
+  // text waiting to be added to the current block
+  std::string m_text;
+  // the contents of the tag we are currently reading (without the < and >)
+  std::string m_tag;
+  // set if the current tag was too long to keep - we still need to find the end of it
+  bool m_tag_truncated = false;
+  // the last two characters of the tag - enough to spot the end of a comment or CDATA section
+  char m_tag_tail[2] = {0, 0};
+  // when skipping an element (e.g. <head>) the name of the element and how deeply it is nested
+  std::string m_skip_tag;
+  int m_skip_depth = 0;
+
   bool is_bold = false;
   bool is_italic = false;
 
-  std::list<Block *> blocks;
+  // owns the blocks, pages and everything in them - it has to be declared before the lists that use it
+  SectionArena m_arena;
+  ArenaList<Block *> blocks;
   TextBlock *currentTextBlock = nullptr;
-  std::vector<Page *> pages;
+  ArenaVector<Page *> pages;
+
+  // incremental layout - the block and line we've got up to and where on the current page it goes
+  ArenaList<Block *>::iterator m_layout_block;
+  int m_layout_line = 0;
+  int m_layout_y = 0;
+  int m_images_seen = 0;
+  bool m_layout_block_measured = false;
+  bool m_layout_started = false;
+  bool m_layout_complete = false;
+  int m_line_height = 0;
+  int m_page_height = 0;
 
   std::string m_base_path;
 
@@ -34,26 +72,64 @@ private:
   // start a new text block if needed
   void startNewTextBlock(BLOCK_STYLE style);
 
-  // PugiXML-based traversal helpers
-  bool enter_node(const pugi::xml_node &node);
-  bool visit_text(const pugi::xml_node &node);
-  bool exit_node(const pugi::xml_node &node);
+  // tokenizer helpers
+  void flush_text();
+  void process_tag();
+  bool tag_is_complete();
+
+  // SAX style handlers called by the tokenizer
+  bool enter_node(const char *tag_name, const std::string &tag);
+  bool visit_text(const char *text);
+  bool exit_node(const char *tag_name);
+
+  // layout helpers
+  void start_layout(Renderer *renderer);
+  bool start_new_page(int stop_after_page);
+  bool layout_block(Renderer *renderer, Epub *epub, int stop_after_page);
 
 public:
+  // parse a complete document that is already in memory
   RubbishHtmlParser(const char *html, int length, const std::string &base_path, bool justify_paragraphs);
+  // start an empty parser - feed() it chunks of the document and then call finish()
+  RubbishHtmlParser(const std::string &base_path, bool justify_paragraphs);
   ~RubbishHtmlParser();
 
   void parse(const char *html, int length);
+  // incremental parsing
+  void feed(const char *data, size_t length);
+  void finish();
   void addText(const char *text, bool is_bold, bool is_italic);
+  // lay out the whole section
   void layout(Renderer *renderer, Epub *epub);
+  // lay out just enough of the section for page_index to be complete - later calls carry on from where we stopped
+  void layout_to_page(Renderer *renderer, Epub *epub, int page_index);
+  // lay out one more block - returns true while there is still more to do
+  bool layout_step(Renderer *renderer, Epub *epub);
+  bool is_layout_complete()
+  {
+    return m_layout_complete;
+  }
 
+  // the number of pages laid out so far - this is only the total once is_layout_complete() is true
   int get_page_count()
   {
     return pages.size();
   }
-  const std::list<Block *> &get_blocks()
+  const ArenaList<Block *> &get_blocks()
   {
     return blocks;
   }
+  // how much memory the section is using
+  const SectionArena &get_arena()
+  {
+    return m_arena;
+  }
   void render_page(int page_index, Renderer *renderer, Epub *epub);
+
+  // layout cache - save a fully laid out section to a file and load it back without parsing or measuring.
+  // The key identifies everything that affects the layout (book, section, font, page size...) - a file
+  // with a different key is ignored.
+  bool save_layout(const char *path, uint32_t key);
+  // only call this on a parser that hasn't been fed anything
+  bool load_layout(const char *path, uint32_t key);
 };
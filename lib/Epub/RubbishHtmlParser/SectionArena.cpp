@@ -0,0 +1,104 @@
+#include <stdlib.h>
+#include <string.h>
+#include "SectionArena.h"
+#if !defined(UNIT_TEST) && defined(BOARD_HAS_PSRAM)
+#include <esp_heap_caps.h>
+#endif
+#ifndef UNIT_TEST
+#include <esp_log.h>
+#else
+#define ESP_LOGE(args...)
+#endif
+
+static const char *TAG = "ARENA";
+
+// the chunk header is padded so the first allocation in a chunk is suitably aligned
+static const size_t CHUNK_HEADER_SIZE = (sizeof(void *) + sizeof(size_t) + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+
+static uint8_t *align_up(uint8_t *pointer, size_t alignment)
+{
+  return (uint8_t *)(((uintptr_t)pointer + alignment - 1) & ~(uintptr_t)(alignment - 1));
+}
+
+SectionArena::Chunk *SectionArena::allocate_chunk(size_t size)
+{
+  size_t total = CHUNK_HEADER_SIZE + size;
+  void *memory = nullptr;
+#if !defined(UNIT_TEST) && defined(BOARD_HAS_PSRAM)
+  memory = heap_caps_malloc(total, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+#endif
+  if (!memory)
+  {
+    memory = malloc(total);
+  }
+  if (!memory)
+  {
+    ESP_LOGE(TAG, "Failed to allocate a %u byte chunk", (unsigned)total);
+    throw std::bad_alloc();
+  }
+  Chunk *chunk = (Chunk *)memory;
+  chunk->next = nullptr;
+  chunk->size = size;
+  m_bytes_reserved += total;
+  m_chunk_count++;
+  return chunk;
+}
+
+void *SectionArena::allocate(size_t size, size_t alignment)
+{
+  m_allocation_count++;
+  if (size > CHUNK_SIZE / 4)
+  {
+    // big allocations get a chunk of their own so they don't waste the end of the current one
+    Chunk *chunk = allocate_chunk(size + alignment);
+    if (m_chunks)
+    {
+      // keep the current chunk at the front so we carry on filling it
+      chunk->next = m_chunks->next;
+      m_chunks->next = chunk;
+    }
+    else
+    {
+      m_chunks = chunk;
+    }
+    m_bytes_used += size + alignment;
+    return align_up((uint8_t *)chunk + CHUNK_HEADER_SIZE, alignment);
+  }
+  uint8_t *start = m_next ? align_up(m_next, alignment) : nullptr;
+  if (!start || start + size > m_end)
+  {
+    Chunk *chunk = allocate_chunk(CHUNK_SIZE);
+    chunk->next = m_chunks;
+    m_chunks = chunk;
+    m_next = (uint8_t *)chunk + CHUNK_HEADER_SIZE;
+    m_end = m_next + CHUNK_SIZE;
+    start = align_up(m_next, alignment);
+  }
+  m_bytes_used += start + size - m_next;
+  m_next = start + size;
+  return start;
+}
+
+char *SectionArena::copy_string(const char *text, size_t length)
+{
+  char *copy = (char *)allocate(length + 1, 1);
+  memcpy(copy, text, length);
+  copy[length] = '\0';
+  return copy;
+}
+
+void SectionArena::clear()
+{
+  while (m_chunks)
+  {
+    Chunk *next = m_chunks->next;
+    free(m_chunks);
+    m_chunks = next;
+  }
+  m_next = nullptr;
+  m_end = nullptr;
+  m_bytes_used = 0;
+  m_bytes_reserved = 0;
+  m_allocation_count = 0;
+  m_chunk_count = 0;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <stddef.h>
+#include <cstddef>
+#include <stdint.h>
+#include <new>
+#include <memory>
+#include <utility>
+#include <vector>
+#include <list>
+
+// A bump allocator for everything a section parse produces - blocks, the text
+// of their spans, the word tables and the laid out pages. Allocations are
+// carved out of big chunks (in PSRAM when we have it) and nothing is freed
+// until the whole arena is, so dropping a section is a handful of frees rather
+// than one per word table and page element.
+//
+// Destructors of objects made with create() are never run - anything living in
+// the arena must keep its own memory in the arena too.
+class SectionArena
+{
+private:
+  struct Chunk
+  {
+    Chunk *next;
+    size_t size;
+  };
+  static const size_t CHUNK_SIZE = 16 * 1024;
+  // the chunk we are filling is always at the front of the list
+  Chunk *m_chunks = nullptr;
+  uint8_t *m_next = nullptr;
+  uint8_t *m_end = nullptr;
+  size_t m_bytes_used = 0;
+  size_t m_bytes_reserved = 0;
+  size_t m_allocation_count = 0;
+  size_t m_chunk_count = 0;
+
+  Chunk *allocate_chunk(size_t size);
+
+public:
+  SectionArena() {}
+  ~SectionArena() { clear(); }
+  SectionArena(const SectionArena &) = delete;
+  SectionArena &operator=(const SectionArena &) = delete;
+
+  // like operator new this throws std::bad_alloc if we run out of memory
+  void *allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+  // a null terminated copy of length bytes of text
+  char *copy_string(const char *text, size_t length);
+  template <typename T, typename... Args>
+  T *create(Args &&...args)
+  {
+    return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+  }
+  // free everything in one go
+  void clear();
+
+  // bytes handed out (including alignment padding)
+  size_t get_bytes_used() const { return m_bytes_used; }
+  // bytes taken from the heap for the chunks
+  size_t get_bytes_reserved() const { return m_bytes_reserved; }
+  size_t get_allocation_count() const { return m_allocation_count; }
+  size_t get_chunk_count() const { return m_chunk_count; }
+};
+
+// Lets the standard containers live in a SectionArena. Without an arena it
+// falls back to the normal heap, so the same class works for blocks that are
+// made on their own (e.g. the titles in the library list).
+template <typename T>
+class ArenaAllocator
+{
+public:
+  typedef T value_type;
+  SectionArena *arena;
+
+  ArenaAllocator(SectionArena *arena = nullptr) noexcept : arena(arena) {}
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U> &other) noexcept : arena(other.arena) {}
+
+  T *allocate(size_t count)
+  {
+    if (arena)
+    {
+      return static_cast<T *>(arena->allocate(count * sizeof(T), alignof(T)));
+    }
+    return std::allocator<T>().allocate(count);
+  }
+  void deallocate(T *pointer, size_t count) noexcept
+  {
+    // memory in the arena goes when the arena does
+    if (!arena)
+    {
+      std::allocator<T>().deallocate(pointer, count);
+    }
+  }
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) noexcept
+{
+  return a.arena == b.arena;
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) noexcept
+{
+  return a.arena != b.arena;
+}
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+template <typename T>
+using ArenaList = std::list<T, ArenaAllocator<T>>;
@@ -1,7 +1,13 @@
 #pragma once
 #include "../../Renderer/Renderer.h"
+#include "../../Renderer/ImageCache.h"
+#include "../../Renderer/ImageProbe.h"
 #include "Block.h"
+#include "../SectionArena.h"
 #include "../../EpubList/Epub.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
 #ifndef UNIT_TEST
 #include <esp_log.h>
 #else
@@ -14,25 +20,37 @@
 class ImageBlock : public Block
 {
 public:
-  // the src attribute from the image element
-  std::string m_src;
+  // the src attribute from the image element - kept in the section arena
+  const char *m_src;
   int y_pos;
   int x_pos;
   int width;
   int height;
 
-  ImageBlock(std::string src) : m_src(src)
+  ImageBlock(const char *src) : m_src(src)
   {
   }
   virtual bool isEmpty()
   {
-    return m_src.empty();
+    return m_src[0] == '\0';
   }
   void layout(Renderer *renderer, Epub *epub, int max_width = -1)
   {
-    size_t image_data_size = 0;
-    uint8_t *image_data = epub->get_item_contents(m_src, &image_data_size);
-    renderer->get_image_size(m_src, image_data, image_data_size, &width, &height);
+    // only the header is needed for the size - don't inflate the whole image
+    ImageHeader header;
+    if (epub->get_item_image_header(m_src, &header))
+    {
+      width = header.width;
+      height = header.height;
+    }
+    else
+    {
+      // unusual header - fall back to asking the decoder
+      size_t image_data_size = 0;
+      uint8_t *image_data = epub->get_item_contents(m_src, &image_data_size);
+      renderer->get_image_size(m_src, image_data, image_data_size, &width, &height);
+      free(image_data);
+    }
     if (width > renderer->get_page_width() || height > renderer->get_page_height())
     {
       float scale = std::min(
@@ -43,24 +61,85 @@ public:
     }
     // horizontal center
     x_pos = (renderer->get_page_width() - width) / 2;
-    free(image_data);
   }
   void render(Renderer *renderer, Epub *epub, int y_pos)
   {
+    if (width <= 0 || height <= 0)
+    {
+      return;
+    }
+    // seen this image at this size before? Then it's already decoded and scaled
+    ImageCache &cache = renderer->get_image_cache();
+    std::string key = ImageCache::make_key(epub->get_path(), m_src, width, height);
+    const CachedImage *cached = cache.find(key);
+    if (cached)
+    {
+      renderer->draw_pixels(x_pos, y_pos, width, height, cached->bitmap);
+      return;
+    }
     size_t image_data_size = 0;
     uint8_t *image_data = epub->get_item_contents(m_src, &image_data_size);
     // Draw a square to remove text remainings before printing image
     renderer->fill_rect(x_pos, y_pos, width, height, 255);
     renderer->flush_area(x_pos, y_pos, width, height);
-    renderer->draw_image(m_src, image_data, image_data_size, x_pos, y_pos, width, height);
+    uint8_t *bitmap = ImageCache::allocate_bitmap(width * height);
+    if (bitmap)
+    {
+      if (renderer->decode_image(m_src, image_data, image_data_size, width, height, bitmap))
+      {
+        renderer->draw_pixels(x_pos, y_pos, width, height, bitmap);
+        // the cache owns the bitmap from here on
+        cache.insert(key, width, height, bitmap);
+      }
+      else
+      {
+        free(bitmap);
+      }
+    }
+    else
+    {
+      ESP_LOGW("ImageBlock", "No memory to cache %s, drawing it directly", m_src);
+      renderer->draw_image(m_src, image_data, image_data_size, x_pos, y_pos, width, height);
+    }
     free(image_data);
   }
   virtual void dump()
   {
-    printf("ImageBlock: %s\n", m_src.c_str());
+    printf("ImageBlock: %s\n", m_src);
   }
   virtual BlockType getType()
   {
     return IMAGE_BLOCK;
   }
+  // layout cache - just the size and position, the image data stays in the epub
+  bool write_layout(FILE *fp)
+  {
+    uint32_t src_length = strlen(m_src);
+    int32_t geometry[4] = {x_pos, y_pos, width, height};
+    return fwrite(&src_length, sizeof(src_length), 1, fp) == 1 &&
+           (src_length == 0 || fwrite(m_src, src_length, 1, fp) == 1) &&
+           fwrite(geometry, sizeof(geometry), 1, fp) == 1;
+  }
+  static ImageBlock *read_layout(FILE *fp, SectionArena *arena)
+  {
+    uint32_t src_length = 0;
+    int32_t geometry[4];
+    if (fread(&src_length, sizeof(src_length), 1, fp) != 1 || src_length > 1024)
+    {
+      return nullptr;
+    }
+    char *src = (char *)arena->allocate(src_length + 1, 1);
+    if ((src_length > 0 && fread(src, src_length, 1, fp) != 1) ||
+        fread(geometry, sizeof(geometry), 1, fp) != 1)
+    {
+      return nullptr;
+    }
+    src[src_length] = '\0';
+    ImageBlock *block = arena->create<ImageBlock>(src);
+    block->x_pos = geometry[0];
+    block->y_pos = geometry[1];
+    block->width = geometry[2];
+    block->height = geometry[3];
+    return block;
+  }
 };
@@ -42,8 +42,7 @@ void TextBlock::add_span(const char *span, bool is_bold, bool is_italic)
   // adding a span to text block
   // make a copy of the text as we'll modify it
   int length = strlen(span);
-  char *text = new char[length + 1];
-  strcpy(text, span);
+  char *text = m_arena ? m_arena->copy_string(span, length) : strcpy(new char[length + 1], span);
   spans.push_back(text);
   // work out where each word is in the span
   int index = 0;
@@ -70,6 +69,7 @@ void TextBlock::add_span(const char *span, bool is_bold, bool is_italic)
 void TextBlock::layout(Renderer *renderer, Epub *epub, int max_width)
 {
   // measure each word
+  word_widths.reserve(words.size());
   for (int i = 0; i < words.size(); i++)
   {
     // measure the word
@@ -82,6 +82,11 @@ void TextBlock::layout(Renderer *renderer, Epub *epub, int max_width)
 
   // now apply the dynamic programming algorithm to find the best line breaks
   int n = word_widths.size();
+  // nothing to lay out - and the tables below need at least one word
+  if (n == 0)
+  {
+    return;
+  }
 
   // DP table in which dp[i] represents cost of line starting with word words[i]
   int dp[n];
@@ -227,11 +232,15 @@ void TextBlock::layout(Renderer *renderer, Epub *epub, int max_width)
     }
     start_word = line_breaks[i];
   }
-  spans.shrink_to_fit();
-  words.shrink_to_fit();
-  word_widths.shrink_to_fit();
-  word_xpos.shrink_to_fit();
-  word_styles.shrink_to_fit();
+  // in an arena shrinking would just leave another copy behind
+  if (!m_arena)
+  {
+    spans.shrink_to_fit();
+    words.shrink_to_fit();
+    word_widths.shrink_to_fit();
+    word_xpos.shrink_to_fit();
+    word_styles.shrink_to_fit();
+  }
 }
 void TextBlock::render(Renderer *renderer, int line_break_index, int x_pos, int y_pos)
 {
@@ -253,3 +262,111 @@ void TextBlock::dump()
     printf("##%d#%s## ", word_widths[i], words[i]);
   }
 }
+
+// Layout cache record:
+// uint8_t style, uint32_t word count, uint32_t text size, uint32_t line break count,
+// the words as null terminated strings, then the per word styles, widths and x positions, then the line breaks.
+bool TextBlock::write_layout(FILE *fp)
+{
+  uint8_t block_style = style;
+  uint32_t word_count = words.size();
+  uint32_t text_size = 0;
+  for (auto word : words)
+  {
+    text_size += strlen(word) + 1;
+  }
+  uint32_t line_break_count = line_breaks.size();
+  if (word_widths.size() != word_count || word_xpos.size() != word_count)
+  {
+    ESP_LOGE("TextBlock", "Can't cache a block that hasn't been laid out");
+    return false;
+  }
+  if (fwrite(&block_style, sizeof(block_style), 1, fp) != 1 ||
+      fwrite(&word_count, sizeof(word_count), 1, fp) != 1 ||
+      fwrite(&text_size, sizeof(text_size), 1, fp) != 1 ||
+      fwrite(&line_break_count, sizeof(line_break_count), 1, fp) != 1)
+  {
+    return false;
+  }
+  for (auto word : words)
+  {
+    if (fwrite(word, strlen(word) + 1, 1, fp) != 1)
+    {
+      return false;
+    }
+  }
+  if (word_count > 0 &&
+      (fwrite(word_styles.data(), sizeof(uint8_t), word_count, fp) != word_count ||
+       fwrite(word_widths.data(), sizeof(uint16_t), word_count, fp) != word_count ||
+       fwrite(word_xpos.data(), sizeof(uint16_t), word_count, fp) != word_count))
+  {
+    return false;
+  }
+  if (line_break_count > 0 && fwrite(line_breaks.data(), sizeof(uint16_t), line_break_count, fp) != line_break_count)
+  {
+    return false;
+  }
+  return true;
+}
+
+TextBlock *TextBlock::read_layout(FILE *fp, SectionArena *arena)
+{
+  uint8_t block_style = 0;
+  uint32_t word_count = 0;
+  uint32_t text_size = 0;
+  uint32_t line_break_count = 0;
+  if (fread(&block_style, sizeof(block_style), 1, fp) != 1 ||
+      fread(&word_count, sizeof(word_count), 1, fp) != 1 ||
+      fread(&text_size, sizeof(text_size), 1, fp) != 1 ||
+      fread(&line_break_count, sizeof(line_break_count), 1, fp) != 1)
+  {
+    return nullptr;
+  }
+  // each word needs at least one character and its terminator
+  if (block_style > RIGHT_ALIGN || text_size < word_count * 2 || text_size > 1024 * 1024 || line_break_count > word_count)
+  {
+    ESP_LOGE("TextBlock", "Corrupt layout cache record");
+    return nullptr;
+  }
+  TextBlock *block = arena ? arena->create<TextBlock>((BLOCK_STYLE)block_style, arena) : new TextBlock((BLOCK_STYLE)block_style);
+  // all the words go in one span
+  char *text = arena ? (char *)arena->allocate(text_size + 1, 1) : new char[text_size + 1];
+  block->spans.push_back(text);
+  block->word_styles.resize(word_count);
+  block->word_widths.resize(word_count);
+  block->word_xpos.resize(word_count);
+  block->line_breaks.resize(line_break_count);
+  if (fread(text, 1, text_size, fp) != text_size ||
+      (word_count > 0 &&
+       (fread(block->word_styles.data(), sizeof(uint8_t), word_count, fp) != word_count ||
+        fread(block->word_widths.data(), sizeof(uint16_t), word_count, fp) != word_count ||
+        fread(block->word_xpos.data(), sizeof(uint16_t), word_count, fp) != word_count)) ||
+      (line_break_count > 0 && fread(block->line_breaks.data(), sizeof(uint16_t), line_break_count, fp) != line_break_count))
+  {
+    // one in an arena goes when the arena does
+    if (!arena)
+    {
+      delete block;
+    }
+    return nullptr;
+  }
+  text[text_size] = '\0';
+  // point the words back into the text
+  block->words.reserve(word_count);
+  uint32_t offset = 0;
+  for (uint32_t i = 0; i < word_count && offset < text_size; i++)
+  {
+    block->words.push_back(text + offset);
+    offset += strlen(text + offset) + 1;
+  }
+  if (block->words.size() != word_count || (line_break_count > 0 && block->line_breaks.back() != word_count))
+  {
+    ESP_LOGE("TextBlock", "Corrupt layout cache record");
+    if (!arena)
+    {
+      delete block;
+    }
+    return nullptr;
+  }
+  return block;
+}
@@ -2,7 +2,9 @@
 
 #include "../../Renderer/Renderer.h"
 #include <vector>
+#include <stdio.h>
 #include "Block.h"
+#include "../SectionArena.h"
 
 typedef enum
 {
@@ -22,33 +24,41 @@ typedef enum
 class TextBlock : public Block
 {
 private:
+  // where the text and word tables live - nullptr for a block on the normal heap
+  SectionArena *m_arena;
   // the spans of text in this block
-  std::vector<const char *> spans;
+  ArenaVector<const char *> spans;
   // pointer to each word
-  std::vector<const char *> words;
+  ArenaVector<const char *> words;
   // width of each word
-  std::vector<uint16_t> word_widths;
+  ArenaVector<uint16_t> word_widths;
   // x position of each word
-  std::vector<uint16_t> word_xpos;
+  ArenaVector<uint16_t> word_xpos;
   // the styles of each word
-  std::vector<uint8_t> word_styles;
+  ArenaVector<uint8_t> word_styles;
 
   // the style of the block - left, center, right aligned
   BLOCK_STYLE style;
 
 public:
   // where do we want to break the words into lines
-  std::vector<uint16_t> line_breaks;
+  ArenaVector<uint16_t> line_breaks;
 
   void add_span(const char *span, bool is_bold, bool is_italic);
-  TextBlock(BLOCK_STYLE style) : style(style)
+  TextBlock(BLOCK_STYLE style, SectionArena *arena = nullptr)
+      : m_arena(arena), spans(arena), words(arena), word_widths(arena), word_xpos(arena), word_styles(arena),
+        style(style), line_breaks(arena)
   {
   }
   ~TextBlock()
   {
-    for (auto span : spans)
+    // the arena frees its own spans
+    if (!m_arena)
     {
-      delete[] span;
+      for (auto span : spans)
+      {
+        delete[] span;
+      }
     }
   }
   void set_style(BLOCK_STYLE style)
@@ -68,6 +78,9 @@ public:
   void render(Renderer *renderer, int line_break_index, int x_pos, int y_pos);
   // debug helper - dumps out the contents of the block with line breaks
   void dump();
+  // layout cache - save the words and where they were laid out, and restore them without re-measuring
+  bool write_layout(FILE *fp);
+  static TextBlock *read_layout(FILE *fp, SectionArena *arena = nullptr);
   bool is_empty()
   {
     return words.empty();
@@ -7,44 +7,154 @@
 #define ESP_LOGE(args...)
 #define ESP_LOGI(args...)
 #endif
+#include <algorithm>
 #include "ZipFile.h"
 
 #include "miniz_local.h"
 
 #define TAG "ZIP"
 
-// read a file from the zip file allocating the required memory for the data
-uint8_t *ZipFile::read_file_to_memory(const char *filename, size_t *size)
+struct ZipFile::Archive
+{
+  local_mz_zip_archive zip;
+};
+
+struct ZipFileStream::Iterator
+{
+  local_mz_zip_reader_extract_iter_state *state;
+};
+
+// FNV-1a - cheap and good enough to spread the names of the entries in an EPUB
+static uint32_t hash_name(const char *name)
 {
-  // open up the epub file using miniz
-  local_mz_zip_archive zip_archive;
-  memset(&zip_archive, 0, sizeof(zip_archive));
-  bool status = local_mz_zip_reader_init_file(&zip_archive, m_filename.c_str(), 0);
-  if (!status)
+  uint32_t hash = 2166136261u;
+  while (*name)
+  {
+    hash ^= (uint8_t)*name++;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+ZipFile::~ZipFile()
+{
+  close();
+}
+
+bool ZipFile::open()
+{
+  std::lock_guard<std::recursive_mutex> lock(m_lock);
+  if (m_archive)
+  {
+    return true;
+  }
+  // don't keep hammering the SD card if the file is missing or corrupt
+  if (m_open_failed)
+  {
+    return false;
+  }
+  m_archive = new Archive();
+  memset(&m_archive->zip, 0, sizeof(m_archive->zip));
+  if (!local_mz_zip_reader_init_file(&m_archive->zip, m_filename.c_str(), 0))
   {
     ESP_LOGE(TAG, "local_mz_zip_reader_init_file() failed!\n");
-    ESP_LOGE(TAG, "Error %s\n", local_mz_zip_get_error_string(zip_archive.m_last_error));
-    return nullptr;
+    ESP_LOGE(TAG, "Error %s\n", local_mz_zip_get_error_string(m_archive->zip.m_last_error));
+    delete m_archive;
+    m_archive = nullptr;
+    m_open_failed = true;
+    return false;
   }
-  // find the file
-  local_mz_uint32 file_index = 0;
-  if (!local_mz_zip_reader_locate_file_v2(&zip_archive, filename, nullptr, 0, &file_index))
+  if (!build_index())
   {
-    ESP_LOGE(TAG, "Could not find file %s", filename);
-    local_mz_zip_reader_end(&zip_archive);
-    return nullptr;
+    close();
+    m_open_failed = true;
+    return false;
+  }
+  return true;
+}
+
+void ZipFile::close()
+{
+  std::lock_guard<std::recursive_mutex> lock(m_lock);
+  if (m_archive)
+  {
+    local_mz_zip_reader_end(&m_archive->zip);
+    delete m_archive;
+    m_archive = nullptr;
+  }
+  m_index.clear();
+  m_index.shrink_to_fit();
+}
+
+// walk the central directory once and remember where everything is
+bool ZipFile::build_index()
+{
+  local_mz_uint num_files = local_mz_zip_reader_get_num_files(&m_archive->zip);
+  m_index.clear();
+  m_index.reserve(num_files);
+  for (local_mz_uint i = 0; i < num_files; i++)
+  {
+    local_mz_zip_archive_file_stat file_stat;
+    if (!local_mz_zip_reader_file_stat(&m_archive->zip, i, &file_stat))
+    {
+      ESP_LOGE(TAG, "local_mz_zip_reader_file_stat() failed!\n");
+      ESP_LOGE(TAG, "Error %s\n", local_mz_zip_get_error_string(m_archive->zip.m_last_error));
+      return false;
+    }
+    if (file_stat.m_is_directory)
+    {
+      continue;
+    }
+    m_index.push_back({hash_name(file_stat.m_filename), (uint32_t)i, (uint32_t)file_stat.m_uncomp_size});
+  }
+  std::sort(m_index.begin(), m_index.end(), [](const IndexEntry &a, const IndexEntry &b)
+            { return a.name_hash < b.name_hash; });
+  ESP_LOGI(TAG, "Indexed %d entries in %s", (int)m_index.size(), m_filename.c_str());
+  return true;
+}
+
+bool ZipFile::find_file(const char *filename, uint32_t *file_index, size_t *uncompressed_size)
+{
+  std::lock_guard<std::recursive_mutex> lock(m_lock);
+  if (!open())
+  {
+    return false;
   }
-  // get the file size - we do this all manually so we can add a null terminator to any strings
-  local_mz_zip_archive_file_stat file_stat;
-  if (!local_mz_zip_reader_file_stat(&zip_archive, file_index, &file_stat))
+  uint32_t hash = hash_name(filename);
+  auto range = std::equal_range(m_index.begin(), m_index.end(), IndexEntry{hash, 0, 0},
+                                [](const IndexEntry &a, const IndexEntry &b)
+                                { return a.name_hash < b.name_hash; });
+  for (auto it = range.first; it != range.second; ++it)
   {
-    ESP_LOGE(TAG, "local_mz_zip_reader_file_stat() failed!\n");
-    ESP_LOGE(TAG, "Error %s\n", local_mz_zip_get_error_string(zip_archive.m_last_error));
-    local_mz_zip_reader_end(&zip_archive);
+    // confirm the name in case of a hash collision
+    char name[MZ_ZIP_MAX_ARCHIVE_FILENAME_SIZE];
+    local_mz_zip_reader_get_filename(&m_archive->zip, it->file_index, name, sizeof(name));
+    if (strcmp(name, filename) == 0)
+    {
+      *file_index = it->file_index;
+      if (uncompressed_size)
+      {
+        *uncompressed_size = it->uncompressed_size;
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+// read a file from the zip file allocating the required memory for the data
+uint8_t *ZipFile::read_file_to_memory(const char *filename, size_t *size)
+{
+  std::lock_guard<std::recursive_mutex> lock(m_lock);
+  // find the file - this will open the archive if we haven't already
+  uint32_t file_index = 0;
+  size_t file_size = 0;
+  if (!find_file(filename, &file_index, &file_size))
+  {
+    ESP_LOGE(TAG, "Could not find file %s", filename);
     return nullptr;
   }
-  // allocate memory for the file (optionally in PSRAM)
-  size_t file_size = file_stat.m_uncomp_size;
+  // allocate memory for the file (optionally in PSRAM) - we do this all manually so we can add a null terminator to any strings
   uint8_t *file_data;
 #if !defined(UNIT_TEST) && defined(BOARD_HAS_PSRAM)
   file_data = (uint8_t *)heap_caps_calloc(file_size + 1, 1, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
@@ -53,22 +163,17 @@ uint8_t *ZipFile::read_file_to_memory(const char *filename, size_t *size)
 #endif
   if (!file_data)
   {
-    ESP_LOGE(TAG, "Failed to allocate memory for %s\n", file_stat.m_filename);
-    local_mz_zip_reader_end(&zip_archive);
+    ESP_LOGE(TAG, "Failed to allocate memory for %s\n", filename);
     return nullptr;
   }
   // read the file
-  status = local_mz_zip_reader_extract_to_mem(&zip_archive, file_index, file_data, file_size, 0);
-  if (!status)
+  if (!local_mz_zip_reader_extract_to_mem(&m_archive->zip, file_index, file_data, file_size, 0))
   {
     ESP_LOGE(TAG, "local_mz_zip_reader_extract_to_mem() failed!\n");
-    ESP_LOGE(TAG, "Error %s\n", local_mz_zip_get_error_string(zip_archive.m_last_error));
+    ESP_LOGE(TAG, "Error %s\n", local_mz_zip_get_error_string(m_archive->zip.m_last_error));
     free(file_data);
-    local_mz_zip_reader_end(&zip_archive);
     return nullptr;
   }
-  // Close the archive, freeing any resources it was using
-  local_mz_zip_reader_end(&zip_archive);
   // return the size if required
   if (size)
   {
@@ -76,37 +181,63 @@ uint8_t *ZipFile::read_file_to_memory(const char *filename, size_t *size)
   }
   return file_data;
 }
+
 bool ZipFile::read_file_to_file(const char *filename, const char *dest)
 {
-  local_mz_zip_archive zip_archive;
-  memset(&zip_archive, 0, sizeof(zip_archive));
-  bool status = local_mz_zip_reader_init_file(&zip_archive, m_filename.c_str(), 0);
-  if (!status)
+  std::lock_guard<std::recursive_mutex> lock(m_lock);
+  uint32_t file_index = 0;
+  if (!find_file(filename, &file_index))
   {
-    ESP_LOGE(TAG, "local_mz_zip_reader_init_file() failed!\n");
-    ESP_LOGE(TAG, "Error %s\n", local_mz_zip_get_error_string(zip_archive.m_last_error));
     return false;
   }
-  // Run through the archive and find the requiested file
-  for (int i = 0; i < (int)local_mz_zip_reader_get_num_files(&zip_archive); i++)
+  ESP_LOGI(TAG, "Extracting %s\n", filename);
+  return local_mz_zip_reader_extract_to_file(&m_archive->zip, file_index, dest, 0);
+}
+
+ZipFileStream *ZipFile::open_stream(const char *filename)
+{
+  std::lock_guard<std::recursive_mutex> lock(m_lock);
+  uint32_t file_index = 0;
+  size_t file_size = 0;
+  if (!find_file(filename, &file_index, &file_size))
   {
-    local_mz_zip_archive_file_stat file_stat;
-    if (!local_mz_zip_reader_file_stat(&zip_archive, i, &file_stat))
-    {
-      ESP_LOGE(TAG, "local_mz_zip_reader_file_stat() failed!\n");
-      ESP_LOGE(TAG, "Error %s\n", local_mz_zip_get_error_string(zip_archive.m_last_error));
-      local_mz_zip_reader_end(&zip_archive);
-      return false;
-    }
-    // is this the file we're looking for?
-    if (strcmp(filename, file_stat.m_filename) == 0)
-    {
-      ESP_LOGI(TAG, "Extracting %s\n", file_stat.m_filename);
-      local_mz_zip_reader_extract_file_to_file(&zip_archive, file_stat.m_filename, dest, 0);
-      local_mz_zip_reader_end(&zip_archive);
-      return true;
-    }
+    ESP_LOGE(TAG, "Could not find file %s", filename);
+    return nullptr;
   }
-  local_mz_zip_reader_end(&zip_archive);
-  return false;
+  // the iterator holds the 32K inflate window plus a read buffer capped at the compressed size
+  local_mz_zip_reader_extract_iter_state *state = local_mz_zip_reader_extract_iter_new(&m_archive->zip, file_index, 0);
+  if (!state)
+  {
+    ESP_LOGE(TAG, "local_mz_zip_reader_extract_iter_new() failed!\n");
+    ESP_LOGE(TAG, "Error %s\n", local_mz_zip_get_error_string(m_archive->zip.m_last_error));
+    return nullptr;
+  }
+  return new ZipFileStream(new ZipFileStream::Iterator{state}, &m_lock, file_size);
+}
+
+ZipFileStream::~ZipFileStream()
+{
+  if (m_iterator)
+  {
+    std::lock_guard<std::recursive_mutex> lock(*m_lock);
+    local_mz_zip_reader_extract_iter_free(m_iterator->state);
+    delete m_iterator;
+  }
+}
+
+size_t ZipFileStream::read(uint8_t *buffer, size_t length)
+{
+  if (is_finished() || length == 0)
+  {
+    return 0;
+  }
+  std::lock_guard<std::recursive_mutex> lock(*m_lock);
+  size_t read = local_mz_zip_reader_extract_iter_read(m_iterator->state, buffer, length);
+  if (read == 0)
+  {
+    ESP_LOGE(TAG, "Stream ended early at %d of %d bytes", (int)m_position, (int)m_size);
+    m_error = true;
+  }
+  m_position += read;
+  return read;
 }
@@ -1,19 +1,92 @@
 #pragma once
 
 #include <string>
+#include <vector>
+#include <mutex>
+#include <stdint.h>
+#include <stddef.h>
 
+// Streams the uncompressed contents of a single entry in chunks. Inflation
+// runs through a fixed size window so memory use does not depend on how big
+// the entry is. Create one with ZipFile::open_stream.
+class ZipFileStream
+{
+private:
+  friend class ZipFile;
+  // opaque wrapper around the miniz extract iterator
+  struct Iterator;
+
+  Iterator *m_iterator = nullptr;
+  // the archive's lock - streams share its file handle
+  std::recursive_mutex *m_lock = nullptr;
+  size_t m_size = 0;
+  size_t m_position = 0;
+  bool m_error = false;
+
+  ZipFileStream(Iterator *iterator, std::recursive_mutex *lock, size_t size) : m_iterator(iterator), m_lock(lock), m_size(size) {}
+
+public:
+  ~ZipFileStream();
+  ZipFileStream(const ZipFileStream &) = delete;
+  ZipFileStream &operator=(const ZipFileStream &) = delete;
+
+  // read up to length bytes - returns 0 once the entry is finished or on error
+  size_t read(uint8_t *buffer, size_t length);
+  size_t get_size() const { return m_size; }
+  size_t get_position() const { return m_position; }
+  bool is_finished() const { return m_error || m_position >= m_size; }
+  bool has_error() const { return m_error; }
+};
+
+// Wraps a zip archive (an EPUB file). The archive is opened on first use and
+// then kept open, along with an index of the entries in the central
+// directory, so that reading an item does not need to re-open the file and
+// re-parse the central directory every time. Share one instance between
+// readers with a std::shared_ptr. Reads are serialised with a lock so the
+// section prefetch task and the main task can both use the same archive.
 class ZipFile
 {
 private:
+  // an entry in the lookup index - sorted by name_hash
+  struct IndexEntry
+  {
+    uint32_t name_hash;
+    uint32_t file_index;
+    uint32_t uncompressed_size;
+  };
+  // opaque wrapper around the miniz archive so we don't leak miniz into the header
+  struct Archive;
+
   std::string m_filename;
+  Archive *m_archive = nullptr;
+  std::vector<IndexEntry> m_index;
+  bool m_open_failed = false;
+  std::recursive_mutex m_lock;
+
+  bool build_index();
 
 public:
   ZipFile(const char *filename)
   {
     m_filename = filename;
   }
-  ~ZipFile() {}
+  ~ZipFile();
+  ZipFile(const ZipFile &) = delete;
+  ZipFile &operator=(const ZipFile &) = delete;
+
+  // open the archive and build the entry index - safe to call more than once
+  bool open();
+  void close();
+  bool is_open() const { return m_archive != nullptr; }
+  const std::string &get_filename() const { return m_filename; }
+  // number of entries in the archive (0 if it could not be opened)
+  size_t get_entry_count() const { return m_index.size(); }
+  // look up an entry - returns false if the file is not in the archive
+  bool find_file(const char *filename, uint32_t *file_index, size_t *uncompressed_size = nullptr);
   // read a file from the zip file allocating the required memory for the data
   uint8_t *read_file_to_memory(const char *filename, size_t *size = nullptr);
   bool read_file_to_file(const char *filename, const char *dest);
-};
\ No newline at end of file
+  // start streaming a file from the zip file - the caller owns the returned stream
+  // and must delete it before this ZipFile is closed
+  ZipFileStream *open_stream(const char *filename);
+};
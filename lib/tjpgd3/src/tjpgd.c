@@ -700,7 +700,8 @@ static void block_idct (
 /*-----------------------------------------------------------------------*/
 
 static JRESULT mcu_load (
-	JDEC* jd		/* Pointer to the decompressor object */
+	JDEC* jd,		/* Pointer to the decompressor object */
+	int idct		/* 0:Only decode the huffman coded stream (the MCU is not output) */
 )
 {
 	int32_t *tmp = (int32_t*)jd->workbuf;	/* Block working buffer for de-quantize and IDCT */
@@ -758,7 +759,7 @@ static JRESULT mcu_load (
 				}
 			} while (++z < 64);		/* Next AC element */
 
-			if (JD_FORMAT != 2 || !cmp) {	/* C components may not be processed if in grayscale output */
+			if (idct && (JD_FORMAT != 2 || !cmp)) {	/* C components may not be processed if in grayscale output */
 				if (z == 1 || (JD_USE_SCALE && jd->scale == 3)) {	/* If no AC element or scale ratio is 1/8, IDCT can be ommited and the block is filled with DC value */
 					d = (jd_yuv_t)((*tmp / 256) + 128);
 					if (JD_FASTDECODE >= 1) {
@@ -1006,6 +1007,8 @@ JRESULT jd_prepare (
 
 			jd->width = LDB_WORD(&seg[3]);		/* Image width in unit of pixel */
 			jd->height = LDB_WORD(&seg[1]);		/* Image height in unit of pixel */
+			jd->clip.left = 0; jd->clip.right = jd->width - 1;	/* Output the whole image unless told otherwise */
+			jd->clip.top = 0; jd->clip.bottom = jd->height - 1;
 			jd->ncomp = seg[5];					/* Number of color components */
 			if (jd->ncomp != 3 && jd->ncomp != 1) return JDR_FMT3;	/* Err: Supports only Grayscale and Y/Cb/Cr */
 
@@ -1071,7 +1074,7 @@ JRESULT jd_prepare (
 			/* Allocate working buffer for MCU and pixel output */
 			n = jd->msy * jd->msx;						/* Number of Y blocks in the MCU */
 			if (!n) return JDR_FMT1;					/* Err: SOF0 has not been loaded */
-			len = n * 64 * 2 + 64;						/* Allocate buffer for IDCT and RGB output */
+			len = (JD_FORMAT == 2) ? n * 64 : n * 64 * 2 + 64;	/* Allocate buffer for IDCT and RGB (or grayscale) output */
 			if (len < 256) len = 256;					/* but at least 256 byte is required for IDCT */
 			jd->workbuf = alloc_pool(jd, len);			/* and it may occupy a part of following MCU working buffer for RGB output */
 			if (!jd->workbuf) return JDR_MEM1;			/* Err: not enough memory */
@@ -1121,7 +1124,7 @@ JRESULT jd_decomp (
 	uint8_t scale							/* Output de-scaling factor (0 to 3) */
 )
 {
-	unsigned int x, y, mx, my;
+	unsigned int x, y, mx, my, visible;
 	uint16_t rst, rsc;
 	JRESULT rc;
 
@@ -1135,17 +1138,21 @@ JRESULT jd_decomp (
 	rst = rsc = 0;
 
 	rc = JDR_OK;
-	for (y = 0; y < jd->height; y += my) {		/* Vertical loop of MCUs */
+	for (y = 0; y < jd->height && y <= jd->clip.bottom; y += my) {	/* Vertical loop of MCUs (nothing more to do below the clip area) */
 		for (x = 0; x < jd->width; x += mx) {	/* Horizontal loop of MCUs */
 			if (jd->nrst && rst++ == jd->nrst) {	/* Process restart interval if enabled */
 				rc = restart(jd, rsc++);
 				if (rc != JDR_OK) return rc;
 				rst = 1;
 			}
-			rc = mcu_load(jd);					/* Load an MCU (decompress huffman coded stream, dequantize and apply IDCT) */
-			if (rc != JDR_OK) return rc;
-			rc = mcu_output(jd, outfunc, x, y);	/* Output the MCU (YCbCr to RGB, scaling and output) */
+			/* MCUs outside the clip area still have to be huffman decoded to find the next one but need no IDCT or output */
+			visible = y + my > jd->clip.top && x + mx > jd->clip.left && x <= jd->clip.right;
+			rc = mcu_load(jd, visible);			/* Load an MCU (decompress huffman coded stream, dequantize and apply IDCT) */
 			if (rc != JDR_OK) return rc;
+			if (visible) {
+				rc = mcu_output(jd, outfunc, x, y);	/* Output the MCU (YCbCr to RGB, scaling and output) */
+				if (rc != JDR_OK) return rc;
+			}
 		}
 	}
 
@@ -3,6 +3,9 @@
 #include "Renderer/Renderer.h"
 #include "EpubList/State.h"
 #include <esp_log.h>
+#include <esp_attr.h>
+#include <esp_timer.h>
+#include <esp_sleep.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <driver/gpio.h>
@@ -37,6 +40,22 @@ static const gpio_num_t PAPERS3_GT911_SCL_GPIO = GPIO_NUM_42;
 static const gpio_num_t PAPERS3_GT911_INT_GPIO = GPIO_NUM_48;
 static const i2c_port_t PAPERS3_GT911_I2C_PORT = I2C_NUM_0;
 
+// GT911 registers - the status byte is followed by up to 5 points of 8 bytes
+// (track id, x lo/hi, y lo/hi, size lo/hi, reserved) so one read gets the lot.
+static const uint16_t GT911_MODULE_SWITCH1_REG = 0x804D;
+static const uint16_t GT911_STATUS_REG = 0x814E;
+static const int GT911_MAX_POINTS = 5;
+static const int GT911_POINT_SIZE = 8;
+
+// while a finger is down we poll this often to follow the gesture
+static const uint32_t TOUCH_ACTIVE_POLL_MS = 10;
+// without the INT line we have to poll all the time
+static const uint32_t TOUCH_IDLE_POLL_MS = 30;
+// treat the finger as lifted if the controller goes quiet for this long mid-gesture
+static const uint32_t TOUCH_RELEASE_TIMEOUT_MS = 150;
+// how often to log wakeups and latency
+static const int64_t TOUCH_STATS_INTERVAL_US = 60 * 1000000LL;
+
 // Gesture sensitivity profile (updated via set_gesture_profile).
 static uint16_t s_swipe_threshold = 100;
 static uint16_t s_longpress_move_threshold = 30;
@@ -154,12 +173,114 @@ PaperS3TouchControls::PaperS3TouchControls(Renderer *renderer, ActionCallback_t
 
   ESP_LOGI(TAG, "GT911 detected at 0x%02X", i2c_addr);
 
-  // Create a polling task to read touch events.
-  if (xTaskCreatePinnedToCore(&PaperS3TouchControls::touchTask, "papers3_touch", 4096, this, 1, nullptr, 1) != pdPASS)
+  // The touch task sleeps until the INT line tells it there is something to read.
+  if (xTaskCreatePinnedToCore(&PaperS3TouchControls::touchTask, "papers3_touch", 4096, this, 1, &touch_task, 1) != pdPASS)
   {
     ESP_LOGE(TAG, "Failed to create touch task");
     driver_ok = false;
+    return;
+  }
+  use_interrupt = setupInterrupt();
+  if (!use_interrupt)
+  {
+    ESP_LOGW(TAG, "GT911 INT not available - polling every %ums", (unsigned)TOUCH_IDLE_POLL_MS);
+  }
+  // get the task going in case it is already waiting on a notification
+  xTaskNotifyGive(touch_task);
+}
+
+IRAM_ATTR void PaperS3TouchControls::touchInterrupt(void *param)
+{
+  auto *self = static_cast<PaperS3TouchControls *>(param);
+  self->last_interrupt_us = esp_timer_get_time();
+  BaseType_t higher_priority_task_woken = pdFALSE;
+  vTaskNotifyGiveFromISR(self->touch_task, &higher_priority_task_woken);
+  if (higher_priority_task_woken)
+  {
+    portYIELD_FROM_ISR();
+  }
+}
+
+bool PaperS3TouchControls::setupInterrupt()
+{
+  // The controller's config says which way INT goes when it has a report
+  // (bits 0-1: 0 rising, 1 falling, 2 low level, 3 high level). We only care
+  // about the edge - a level interrupt would keep firing until we read it.
+  uint8_t module_switch1 = 0;
+  if (gt911_read_reg(i2c_addr, GT911_MODULE_SWITCH1_REG, &module_switch1, 1) != ESP_OK)
+  {
+    ESP_LOGE(TAG, "Failed to read the GT911 INT mode");
+    return false;
+  }
+  uint8_t trigger = module_switch1 & 0x03;
+  interrupt_type = (trigger == 0 || trigger == 3) ? GPIO_INTR_POSEDGE : GPIO_INTR_NEGEDGE;
+
+  gpio_config_t io_conf = {};
+  io_conf.pin_bit_mask = 1ULL << PAPERS3_GT911_INT_GPIO;
+  io_conf.mode = GPIO_MODE_INPUT;
+  io_conf.pull_up_en = GPIO_PULLUP_DISABLE;
+  io_conf.pull_down_en = GPIO_PULLDOWN_DISABLE;
+  io_conf.intr_type = interrupt_type;
+  esp_err_t err = gpio_config(&io_conf);
+  if (err != ESP_OK)
+  {
+    ESP_LOGE(TAG, "gpio_config for INT failed: %d", err);
+    return false;
+  }
+  // someone else may already have installed the service
+  err = gpio_install_isr_service(0);
+  if (err != ESP_OK && err != ESP_ERR_INVALID_STATE)
+  {
+    ESP_LOGE(TAG, "gpio_install_isr_service failed: %d", err);
+    return false;
+  }
+  err = gpio_isr_handler_add(PAPERS3_GT911_INT_GPIO, &PaperS3TouchControls::touchInterrupt, this);
+  if (err != ESP_OK)
+  {
+    ESP_LOGE(TAG, "gpio_isr_handler_add failed: %d", err);
+    return false;
   }
+  ESP_LOGI(TAG, "GT911 INT on GPIO %d (%s edge)", PAPERS3_GT911_INT_GPIO, interrupt_type == GPIO_INTR_POSEDGE ? "rising" : "falling");
+  return true;
+}
+
+bool PaperS3TouchControls::prepare_for_light_sleep()
+{
+  // polling can't wake us, and mid-gesture we need to see the finger lift
+  if (!use_interrupt || touch_active)
+  {
+    return false;
+  }
+  // Light sleep can only wake on a level, so wake on the one INT goes to
+  // when there's a report. The controller keeps reporting while a finger is
+  // down so a pulse that's too short to catch is followed by another.
+  gpio_intr_disable(PAPERS3_GT911_INT_GPIO);
+  if (gpio_wakeup_enable(PAPERS3_GT911_INT_GPIO, interrupt_type == GPIO_INTR_POSEDGE ? GPIO_INTR_HIGH_LEVEL : GPIO_INTR_LOW_LEVEL) != ESP_OK ||
+      esp_sleep_enable_gpio_wakeup() != ESP_OK)
+  {
+    ESP_LOGE(TAG, "Failed to set up wake on touch");
+    wake_from_light_sleep();
+    return false;
+  }
+  return true;
+}
+
+void PaperS3TouchControls::wake_from_light_sleep()
+{
+  if (!use_interrupt)
+  {
+    return;
+  }
+  gpio_wakeup_disable(PAPERS3_GT911_INT_GPIO);
+  esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_GPIO);
+  gpio_set_intr_type(PAPERS3_GT911_INT_GPIO, interrupt_type);
+  gpio_intr_enable(PAPERS3_GT911_INT_GPIO);
+  // the edge that woke us isn't seen by the ISR - have a look anyway
+  if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_GPIO)
+  {
+    last_interrupt_us = esp_timer_get_time();
+  }
+  xTaskNotifyGive(touch_task);
 }
 
 void PaperS3TouchControls::set_gesture_profile(int profile_index)
@@ -210,50 +331,64 @@ bool PaperS3TouchControls::readTouchPoint(uint16_t *x, uint16_t *y, uint8_t *poi
     return false;
   }
 
-  // GT911 status register at 0x814E
-  uint8_t status = 0;
-  if (gt911_read_reg(i2c_addr, 0x814E, &status, 1) != ESP_OK)
+  // The status register and every point in one transaction.
+  uint8_t data[1 + GT911_MAX_POINTS * GT911_POINT_SIZE] = {0};
+  if (gt911_read_reg(i2c_addr, GT911_STATUS_REG, data, sizeof(data)) != ESP_OK)
   {
     return false;
   }
 
+  uint8_t status = data[0];
   if (!(status & 0x80))
   {
     // No new data
     return false;
   }
 
+  // Clear the status flag so the controller can update.
+  uint8_t zero = 0;
+  gt911_write_reg(i2c_addr, GT911_STATUS_REG, &zero, 1);
+
   uint8_t count = status & 0x0F;
-  if (count == 0)
+  if (count > GT911_MAX_POINTS)
   {
-    // Clear the status flag
-    uint8_t zero = 0;
-    gt911_write_reg(i2c_addr, 0x814E, &zero, 1);
-    return false;
+    count = GT911_MAX_POINTS;
   }
-
   if (points)
   {
     *points = count;
   }
-
-  // Read the first touch point from 0x8150 (X, Y, etc.).
-  uint8_t data[4] = {0};
-  if (gt911_read_reg(i2c_addr, 0x8150, data, sizeof(data)) != ESP_OK)
+  if (count > 0)
   {
-    return false;
+    // Gestures follow the first point (x, y after the track id).
+    const uint8_t *point = data + 1;
+    *x = (uint16_t)(point[2] << 8 | point[1]);
+    *y = (uint16_t)(point[4] << 8 | point[3]);
   }
-
-  *x = (uint16_t)(data[1] << 8 | data[0]);
-  *y = (uint16_t)(data[3] << 8 | data[2]);
-
-  // Clear the status flag so the controller can update.
-  uint8_t zero = 0;
-  gt911_write_reg(i2c_addr, 0x814E, &zero, 1);
-
   return true;
 }
 
+void PaperS3TouchControls::logStats()
+{
+  int64_t now = esp_timer_get_time();
+  int64_t elapsed = now - stats_start_us;
+  if (elapsed < TOUCH_STATS_INTERVAL_US)
+  {
+    return;
+  }
+  if (elapsed > 0)
+  {
+    ESP_LOGI(TAG, "%u wakeups in %llds (%.1f/min), %u actions, latency avg %lldus max %lldus",
+             (unsigned)stats_wakeups, (long long)(elapsed / 1000000), stats_wakeups * 60000000.0 / elapsed, (unsigned)stats_actions,
+             (long long)(stats_actions ? stats_latency_total_us / stats_actions : 0), (long long)stats_latency_max_us);
+  }
+  stats_start_us = now;
+  stats_wakeups = 0;
+  stats_actions = 0;
+  stats_latency_total_us = 0;
+  stats_latency_max_us = 0;
+}
+
 UIAction PaperS3TouchControls::mapTapToAction(uint16_t x, uint16_t y)
 {
   // The GT911 on PaperS3 is configured by M5GFX as 540x960.
@@ -961,13 +1096,41 @@ void PaperS3TouchControls::loop()
   // swipes from single-finger swipes.
   uint8_t max_points = 0;
 
+  TickType_t last_report_tick = 0;
+  // when the report that ended the gesture came in
+  int64_t release_us = 0;
+  stats_start_us = esp_timer_get_time();
+
   while (true)
   {
+    // Sleep until the controller has something for us. Once a finger is down
+    // keep polling so we notice it being lifted even if an edge is missed.
+    TickType_t wait = portMAX_DELAY;
+    if (touch_active)
+    {
+      wait = pdMS_TO_TICKS(TOUCH_ACTIVE_POLL_MS);
+    }
+    else if (!use_interrupt)
+    {
+      wait = pdMS_TO_TICKS(TOUCH_IDLE_POLL_MS);
+    }
+    ulTaskNotifyTake(pdTRUE, wait);
+    stats_wakeups++;
+
     uint16_t x = 0;
     uint16_t y = 0;
     uint8_t points = 0;
+    bool have_report = readTouchPoint(&x, &y, &points);
+    bool touching = have_report && points > 0;
+    bool released = touch_active && ((have_report && points == 0) ||
+                                     (!have_report && (xTaskGetTickCount() - last_report_tick) * portTICK_PERIOD_MS >= TOUCH_RELEASE_TIMEOUT_MS));
+    if (have_report)
+    {
+      last_report_tick = xTaskGetTickCount();
+      release_us = use_interrupt ? last_interrupt_us : esp_timer_get_time();
+    }
 
-    if (readTouchPoint(&x, &y, &points))
+    if (touching)
     {
       if (!touch_active)
       {
@@ -989,61 +1152,70 @@ void PaperS3TouchControls::loop()
         }
       }
     }
-    else
+    else if (released)
     {
-      if (touch_active)
-      {
-        // Touch has just ended – decide between tap and swipe.
-        int dx = static_cast<int>(current_x) - static_cast<int>(start_x);
-        int dy = static_cast<int>(start_y) - static_cast<int>(current_y); // positive when moving up
-        int abs_dx = dx >= 0 ? dx : -dx;
-        int abs_dy = dy >= 0 ? dy : -dy;
+      // Touch has just ended – decide between tap and swipe.
+      int dx = static_cast<int>(current_x) - static_cast<int>(start_x);
+      int dy = static_cast<int>(start_y) - static_cast<int>(current_y); // positive when moving up
+      int abs_dx = dx >= 0 ? dx : -dx;
+      int abs_dy = dy >= 0 ? dy : -dy;
 
-        TickType_t end_tick = xTaskGetTickCount();
-        uint32_t dt_ms = (end_tick - touch_start_tick) * portTICK_PERIOD_MS;
+      TickType_t end_tick = xTaskGetTickCount();
+      uint32_t dt_ms = (end_tick - touch_start_tick) * portTICK_PERIOD_MS;
 
-        UIAction action = NONE;
+      UIAction action = NONE;
 
-        // Long-press: minimal movement and held for longpress_ms.
-        if (dt_ms >= longpress_ms && abs_dx <= static_cast<int>(longpress_move_threshold) &&
-            abs_dy <= static_cast<int>(longpress_move_threshold))
-        {
-          action = mapLongPressToAction(start_x, start_y);
-        }
-        // Horizontal swipe: chapter-level navigation while reading.
-        else if (abs_dx > abs_dy && abs_dx > static_cast<int>(swipe_threshold))
-        {
-          if (ui_state == READING_EPUB)
-          {
-            action = (dx > 0) ? NEXT_SECTION : PREV_SECTION;
-          }
-        }
-        // Vertical swipe up/down.
-        else if (dy > static_cast<int>(swipe_threshold))
-        {
-          action = mapSwipeUpToAction(start_x, start_y, current_x, current_y, max_points);
-        }
-        else if (dy < -static_cast<int>(swipe_threshold))
-        {
-          action = mapSwipeDownToAction(start_x, start_y, current_x, current_y, max_points);
-        }
-        else
+      // Long-press: minimal movement and held for longpress_ms.
+      if (dt_ms >= longpress_ms && abs_dx <= static_cast<int>(longpress_move_threshold) &&
+          abs_dy <= static_cast<int>(longpress_move_threshold))
+      {
+        action = mapLongPressToAction(start_x, start_y);
+      }
+      // Horizontal swipe: chapter-level navigation while reading.
+      else if (abs_dx > abs_dy && abs_dx > static_cast<int>(swipe_threshold))
+      {
+        if (ui_state == READING_EPUB)
         {
-          action = mapTapToAction(start_x, start_y);
+          action = (dx > 0) ? NEXT_SECTION : PREV_SECTION;
         }
+      }
+      // Vertical swipe up/down.
+      else if (dy > static_cast<int>(swipe_threshold))
+      {
+        action = mapSwipeUpToAction(start_x, start_y, current_x, current_y, max_points);
+      }
+      else if (dy < -static_cast<int>(swipe_threshold))
+      {
+        action = mapSwipeDownToAction(start_x, start_y, current_x, current_y, max_points);
+      }
+      else
+      {
+        action = mapTapToAction(start_x, start_y);
+      }
 
-        touch_active = false;
-        max_points = 0;
-        last_action = action;
-        ESP_LOGD(TAG, "Touch at %u,%u (end %u,%u) -> dy=%d, action %d", start_x, start_y, current_x, current_y, dy, (int)action);
-        if (action != NONE && on_action)
+      touch_active = false;
+      max_points = 0;
+      last_action = action;
+      ESP_LOGD(TAG, "Touch at %u,%u (end %u,%u) -> dy=%d, action %d", start_x, start_y, current_x, current_y, dy, (int)action);
+      if (action != NONE && on_action)
+      {
+        // from the controller reporting the lift to the UI getting the action
+        int64_t latency_us = esp_timer_get_time() - release_us;
+        stats_actions++;
+        stats_latency_total_us += latency_us;
+        if (latency_us > stats_latency_max_us)
         {
-          on_action(action);
+          stats_latency_max_us = latency_us;
         }
+        ESP_LOGD(TAG, "Action %d dispatched %lldus after the touch ended", (int)action, (long long)latency_us);
+        on_action(action);
       }
     }
 
-    vTaskDelay(pdMS_TO_TICKS(30));
+    if (!touch_active)
+    {
+      logStats();
+    }
   }
 }
 
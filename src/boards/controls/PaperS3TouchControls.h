@@ -5,6 +5,9 @@
 
 #include <stdint.h>
 #include <functional>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <driver/gpio.h>
 
 class Renderer;
 
@@ -12,6 +15,9 @@ class Renderer;
 // capacitive touch controller. This uses the "old" ESP-IDF I2C
 // driver APIs (i2c_driver_install / i2c_master_*) to avoid
 // conflicts with epdiy's use of the legacy I2C driver.
+//
+// The touch task sleeps until the GT911 raises its INT line and only polls
+// while a finger is down, so the CPU and I2C bus are idle between page turns.
 class PaperS3TouchControls : public TouchControls
 {
 public:
@@ -26,10 +32,19 @@ public:
   // show pressed state feedback (currently a no-op)
   virtual void renderPressedState(Renderer *renderer, UIAction action, bool state = true) override;
 
+  // wake from light sleep on the INT line
+  virtual bool prepare_for_light_sleep() override;
+  virtual void wake_from_light_sleep() override;
+
 private:
   static void touchTask(void *param);
+  static void touchInterrupt(void *param);
+  bool setupInterrupt();
   void loop();
+  // returns true if the controller had a new report - points is 0 when the finger was lifted
   bool readTouchPoint(uint16_t *x, uint16_t *y, uint8_t *points);
+  // logs wakeups per minute and action latency, at most once a minute
+  void logStats();
   UIAction mapTapToAction(uint16_t x, uint16_t y);
   UIAction mapSwipeUpToAction(uint16_t start_x, uint16_t start_y, uint16_t end_x, uint16_t end_y, uint8_t max_points);
   UIAction mapSwipeDownToAction(uint16_t start_x, uint16_t start_y, uint16_t end_x, uint16_t end_y, uint8_t max_points);
@@ -44,4 +59,17 @@ private:
   uint8_t i2c_addr = 0x14; // default GT911 address, will probe 0x14/0x5D
   uint32_t touch_start_tick = 0;
   bool long_press_handled = false;
+
+  TaskHandle_t touch_task = nullptr;
+  // false if the INT line couldn't be set up and we have to poll
+  bool use_interrupt = false;
+  gpio_int_type_t interrupt_type = GPIO_INTR_NEGEDGE;
+  // when the last INT edge arrived - used to measure the latency of an action
+  volatile int64_t last_interrupt_us = 0;
+  // wakeups of the touch task and dispatch latency since stats_start_us
+  int64_t stats_start_us = 0;
+  uint32_t stats_wakeups = 0;
+  uint32_t stats_actions = 0;
+  int64_t stats_latency_total_us = 0;
+  int64_t stats_latency_max_us = 0;
 };
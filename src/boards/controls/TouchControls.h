@@ -13,4 +13,8 @@ public:
   virtual void render(Renderer *renderer) {}
   // show the touched state
   virtual void renderPressedState(Renderer *renderer, UIAction action, bool state = true) {}
+  // get ready for light sleep - returns true if a touch will wake us up (and we aren't in the middle of one)
+  virtual bool prepare_for_light_sleep() { return false; }
+  // put things back after light sleep
+  virtual void wake_from_light_sleep() {}
 };
\ No newline at end of file
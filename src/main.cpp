@@ -10,6 +10,7 @@
 #include <ctype.h>
 #include <esp_random.h>
 #include <memory>
+#include <algorithm>
 #include <span>
 #include <ranges>
 #include <vector>
@@ -82,7 +83,8 @@ enum class UIState
 };
 
 // Default UI state: show the EPUB list on startup. We no longer store this in
-// RTC slow memory; EPUB metadata and selection are persisted via /fs/books_index.bin.
+// RTC slow memory; EPUB metadata and reading positions are persisted in the
+// catalog at /fs/Books/BOOKS.CAT.
 UIState ui_state = UIState::SELECTING_EPUB;
 // State data for the EPUB list and reader.
 EpubListState epub_list_state = {};
@@ -175,51 +177,27 @@ static bool g_request_sleep_now = false;
 
 static int find_last_open_book_index()
 {
-  int last_index = -1;
-  auto items = std::span(epub_list_state.epub_list, epub_list_state.num_epubs);
-  
-  for (auto const [i, item] : std::views::enumerate(items))
-  {
-    if (item.current_section != 0 || item.current_page != 0)
-    {
-      if (last_index < 0)
-      {
-        last_index = i;
-      }
-      else
-      {
-        EpubListItem &best = epub_list_state.epub_list[last_index];
-        if (item.current_section > best.current_section ||
-            (item.current_section == best.current_section && item.current_page > best.current_page))
-        {
-          last_index = i;
-        }
-      }
-    }
-  }
-
-  if (last_index >= 0)
-  {
-    return last_index;
-  }
+  // the catalog remembers the last book that was read
+  return epub_list ? epub_list->get_last_opened() : -1;
+}
 
-  // Fallback: candidate matching
-  for (auto const [i, item] : std::views::enumerate(items))
+// the book selected in the library - it's read from the catalog and kept in epub_list_state.current_book
+static EpubListItem &selected_book(Renderer *renderer)
+{
+  if (!epub_list)
   {
-    if (item.pages_in_current_section > 0)
-    {
-      return i;
-    }
+    epub_list = std::unique_ptr<EpubList>(new EpubList(renderer, epub_list_state));
+    epub_list->load("/fs/Books");
   }
-
-  return -1;
+  epub_list->select_book(epub_list_state.selected_item);
+  return epub_list_state.current_book;
 }
 
 void handleEpub(Renderer *renderer, UIAction action)
 {
   if (!reader)
   {
-    reader = std::unique_ptr<EpubReader>(new EpubReader(epub_list_state.epub_list[epub_list_state.selected_item], renderer));
+    reader = std::unique_ptr<EpubReader>(new EpubReader(selected_book(renderer), renderer));
     reader->set_justified(justify_paragraphs);
     reader->load();
   }
@@ -254,6 +232,7 @@ void handleEpub(Renderer *renderer, UIAction action)
     {
       epub_list = std::unique_ptr<EpubList>(new EpubList(renderer, epub_list_state));
     }
+    epub_list->save_current_book();
     handleEpubList(renderer, NONE, true);
     return;
   case NONE:
@@ -267,7 +246,7 @@ void handleEpubTableContents(Renderer *renderer, UIAction action, bool needs_red
 {
   if (!contents)
   {
-    contents = std::unique_ptr<EpubToc>(new EpubToc(epub_list_state.epub_list[epub_list_state.selected_item], epub_index_state, renderer));
+    contents = std::unique_ptr<EpubToc>(new EpubToc(selected_book(renderer), epub_index_state, renderer));
     contents->set_needs_redraw();
     contents->load();
   }
@@ -288,7 +267,7 @@ void handleEpubTableContents(Renderer *renderer, UIAction action, bool needs_red
     {
       reader.reset();
     }
-    reader = std::unique_ptr<EpubReader>(new EpubReader(epub_list_state.epub_list[epub_list_state.selected_item], renderer));
+    reader = std::unique_ptr<EpubReader>(new EpubReader(selected_book(renderer), renderer));
     reader->set_justified(justify_paragraphs);
     reader->set_state_section(contents->get_selected_toc());
     if (!reader->load())
@@ -916,7 +895,7 @@ void handleReaderMenu(Renderer *renderer, UIAction action)
         {
           contents.reset();
         }
-        contents = std::unique_ptr<EpubToc>(new EpubToc(epub_list_state.epub_list[epub_list_state.selected_item], epub_index_state, renderer));
+        contents = std::unique_ptr<EpubToc>(new EpubToc(selected_book(renderer), epub_index_state, renderer));
         if (!contents->load())
         {
           contents.reset();
@@ -943,6 +922,10 @@ void handleReaderMenu(Renderer *renderer, UIAction action)
         {
           reader.reset();
         }
+        if (epub_list)
+        {
+          epub_list->save_current_book();
+        }
         handleEpubList(renderer, NONE, true);
       }
       else if (reader_menu_selected == 3)
@@ -1152,7 +1135,7 @@ void handleEpubList(Renderer *renderer, UIAction action, bool needs_redraw)
     // Try to show the table of contents if the book has one; otherwise
     // fall back to opening the book directly.
     ui_state = UIState::SELECTING_TABLE_CONTENTS;
-    contents = std::unique_ptr<EpubToc>(new EpubToc(epub_list_state.epub_list[epub_list_state.selected_item], epub_index_state, renderer));
+    contents = std::unique_ptr<EpubToc>(new EpubToc(selected_book(renderer), epub_index_state, renderer));
     if (!contents->load())
     {
       contents.reset();
@@ -1296,12 +1279,12 @@ static void show_sleep_cover(Renderer *renderer)
     }
   }
 
-  if (book_index < 0)
+  if (book_index < 0 || !epub_list || !epub_list->select_book(book_index))
   {
     return;
   }
 
-  EpubListItem &item = epub_list_state.epub_list[book_index];
+  EpubListItem &item = epub_list_state.current_book;
   if (item.cover_path[0] == '\0')
   {
     return;
@@ -1513,6 +1496,65 @@ static void show_sleep_image(Renderer *renderer)
   renderer->flush_display();
 }
 
+// Light sleep between page turns while reading. Unlike deep sleep everything
+// stays in RAM/PSRAM - the book, the parsed section and its layout - so a
+// touch picks up exactly where we left off. Deep sleep is still used once the
+// idle timeout runs out.
+
+// don't bother sleeping for less than this
+static const int64_t light_sleep_min_us = 50 * 1000;
+// how long to stay awake after a wake to let the touch task see the gesture through
+static const uint32_t light_sleep_awake_ms = 250;
+static uint32_t light_sleep_count = 0;
+static int64_t light_sleep_total_us = 0;
+static int64_t light_sleep_stats_start_us = 0;
+// when a touch last woke us up - cleared once the page it was woken for is on screen
+static int64_t light_sleep_wake_us = 0;
+
+static bool light_sleep(TouchControls *touch_controls, int64_t max_sleep_us)
+{
+  if (max_sleep_us < light_sleep_min_us || !touch_controls->prepare_for_light_sleep())
+  {
+    return false;
+  }
+  esp_sleep_enable_timer_wakeup(max_sleep_us);
+  light_sleep_wake_us = 0;
+  int64_t start = esp_timer_get_time();
+  esp_err_t err = esp_light_sleep_start();
+  int64_t end = esp_timer_get_time();
+  esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_TIMER);
+  touch_controls->wake_from_light_sleep();
+  if (err != ESP_OK)
+  {
+    ESP_LOGW("main", "esp_light_sleep_start failed: %s", esp_err_to_name(err));
+    return false;
+  }
+  light_sleep_count++;
+  light_sleep_total_us += end - start;
+  bool woken_by_timer = esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_TIMER;
+  if (!woken_by_timer)
+  {
+    light_sleep_wake_us = end;
+  }
+  ESP_LOGD("main", "Woke from light sleep (%s) after %dms", woken_by_timer ? "timer" : "touch", (int)((end - start) / 1000));
+  return true;
+}
+
+// how much of the time since we last asked we've been asleep - the idle current follows from this
+static void log_light_sleep_stats()
+{
+  int64_t now = esp_timer_get_time();
+  int64_t elapsed = now - light_sleep_stats_start_us;
+  if (elapsed > 0)
+  {
+    ESP_LOGI("main", "Light sleep: %u sleeps, asleep %d%% of the last %ds", (unsigned)light_sleep_count,
+             (int)(light_sleep_total_us * 100 / elapsed), (int)(elapsed / 1000000));
+  }
+  light_sleep_stats_start_us = now;
+  light_sleep_count = 0;
+  light_sleep_total_us = 0;
+}
+
 void main_task(void *param)
 {
   // start the board up
@@ -1623,6 +1665,9 @@ void main_task(void *param)
   int64_t last_battery_update = last_user_interaction;
   bool screen_dirty = false;
   const int64_t battery_update_interval_us = 60 * 1000 * 1000;
+  light_sleep_stats_start_us = last_user_interaction;
+  // how often to look for books the library scan has found
+  const TickType_t library_scan_update_ticks = pdMS_TO_TICKS(250);
   while (true)
   {
     if (g_request_sleep_now)
@@ -1637,8 +1682,26 @@ void main_task(void *param)
       break;
     }
     UIAction ui_action = NONE;
-    // wait for something to happen for 60 seconds
-    if (xQueueReceive(ui_queue, &ui_action, pdMS_TO_TICKS(60000)) == pdTRUE)
+    // if the next page hasn't been drawn ahead of time or the rest of the current section still needs
+    // laying out then don't block - do it a bit at a time between events
+    bool reader_work_pending = ui_state == UIState::READING_EPUB && reader && (reader->has_pending_prerender() || reader->has_pending_layout());
+    bool library_scanning = epub_list && epub_list->is_scanning();
+    // otherwise wait for something to happen for 60 seconds
+    TickType_t wait = reader_work_pending ? 0 : (library_scanning ? library_scan_update_ticks : pdMS_TO_TICKS(60000));
+    // while reading, sleep until the next touch (or it's time to update the battery or give up and deep sleep)
+    // as long as the prefetcher and the library scan aren't busy on the other core
+    if (ui_state == UIState::READING_EPUB && !reader_work_pending && !(reader && reader->has_background_work()) &&
+        !library_scanning && uxQueueMessagesWaiting(ui_queue) == 0)
+    {
+      int64_t now = esp_timer_get_time();
+      int64_t wake_at = std::min(last_battery_update + battery_update_interval_us, last_user_interaction + idle_timeout_us);
+      // after a touch wake don't sit awake for long - either a gesture is in progress or we'll go back to sleep
+      if (light_sleep(touch_controls, wake_at - now) || light_sleep_wake_us)
+      {
+        wait = pdMS_TO_TICKS(light_sleep_awake_ms);
+      }
+    }
+    if (xQueueReceive(ui_queue, &ui_action, wait) == pdTRUE)
     {
       if (ui_action != NONE)
       {
@@ -1657,11 +1720,36 @@ void main_task(void *param)
         screen_dirty = true;
       }
     }
+    else if (reader_work_pending)
+    {
+      // the next page first - it's the one the reader is most likely to turn to
+      if (!reader->prerender_next_page())
+      {
+        reader->layout_in_background();
+      }
+    }
+    if (library_scanning)
+    {
+      // books and covers found by the scan are drawn (and flushed) as they turn up
+      bool library_on_screen = ui_state == UIState::SELECTING_EPUB;
+      if (epub_list->update_scan(library_on_screen) && library_on_screen)
+      {
+        // the catalog is written and the books are in title order now
+        handleEpubList(renderer, NONE, true);
+        touch_controls->render(renderer);
+        if (battery)
+        {
+          draw_battery_level(renderer, battery->get_voltage(), battery->get_percentage());
+        }
+        screen_dirty = true;
+      }
+    }
     int64_t now = esp_timer_get_time();
     if (battery && (now - last_battery_update) >= battery_update_interval_us)
     {
       last_battery_update = now;
       ESP_LOGI("main", "Battery Level %f, percent %d", battery->get_voltage(), battery->get_percentage());
+      log_light_sleep_stats();
       draw_battery_level(renderer, battery->get_voltage(), battery->get_percentage());
 
       int top_width = renderer->get_page_width();
@@ -1675,14 +1763,22 @@ void main_task(void *param)
     {
       renderer->flush_display();
       screen_dirty = false;
+      if (light_sleep_wake_us)
+      {
+        // includes the gesture itself - the touch that woke us is still going on when we wake
+        ESP_LOGI("main", "Wake to render: %dms", (int)((esp_timer_get_time() - light_sleep_wake_us) / 1000));
+        light_sleep_wake_us = 0;
+      }
     }
   }
-  // Persist EPUB list state (including current section/page) so that
-  // cold boots and deep-sleep resumes can restore the last-read book
-  // and page via the BOOKS.IDX index.
+  // Persist the current book's section/page so that cold boots and
+  // deep-sleep resumes can restore the last-read book and page from
+  // the catalog.
   if (epub_list)
   {
-    epub_list->save_index("/fs/Books/BOOKS.IDX");
+    // a half finished scan leaves the old catalog alone - it's picked up again next time
+    epub_list->stop_scan();
+    epub_list->save_current_book();
   }
   show_sleep_image(renderer);
   ESP_LOGI("main", "Saving state");
@@ -54,23 +54,23 @@ void test_parser(void)
       "</body>"
       "</html>";
   {
-    RubbishHtmlParser parser(html, strlen(html), "");
+    RubbishHtmlParser parser(html, strlen(html), "", false);
     parser.layout(new TestRenderer(), new Epub("test"));
     TEST_ASSERT_EQUAL(7, parser.get_blocks().size());
     auto iterator = parser.get_blocks().begin();
     std::advance(iterator, 5);
     Block *img_block = *iterator;
     TEST_ASSERT_EQUAL(BlockType::IMAGE_BLOCK, img_block->getType());
-    TEST_ASSERT_EQUAL_STRING("test.png", reinterpret_cast<ImageBlock *>(img_block)->m_src.c_str());
+    TEST_ASSERT_EQUAL_STRING("test.png", reinterpret_cast<ImageBlock *>(img_block)->m_src);
   }
   {
-    RubbishHtmlParser parser(html, strlen(html), "HTML/");
+    RubbishHtmlParser parser(html, strlen(html), "HTML/", false);
     parser.layout(new TestRenderer(), new Epub("test"));
     TEST_ASSERT_EQUAL(7, parser.get_blocks().size());
     auto iterator = parser.get_blocks().begin();
     std::advance(iterator, 5);
     Block *img_block = *iterator;
     TEST_ASSERT_EQUAL(BlockType::IMAGE_BLOCK, img_block->getType());
-    TEST_ASSERT_EQUAL_STRING("HTML/test.png", reinterpret_cast<ImageBlock *>(img_block)->m_src.c_str());
+    TEST_ASSERT_EQUAL_STRING("HTML/test.png", reinterpret_cast<ImageBlock *>(img_block)->m_src);
   }
 }
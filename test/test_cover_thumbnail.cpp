@@ -0,0 +1,119 @@
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <chrono>
+#include <vector>
+#include <EpubList/Epub.h>
+#include <EpubList/CoverThumbnail.h>
+#include "test_renderer.h"
+
+static const char *THUMBNAIL_PATH = "test_cover.g4";
+
+// keeps what is drawn as an 8 bit gray bitmap
+class BitmapTestRenderer : public FixedWidthTestRenderer
+{
+public:
+  std::vector<uint8_t> pixels;
+  BitmapTestRenderer()
+  {
+    pixels.assign(page_width * page_height, 255);
+  }
+  virtual void draw_pixel(int x, int y, uint8_t color)
+  {
+    if (x >= 0 && x < page_width && y >= 0 && y < page_height)
+    {
+      pixels[y * page_width + x] = color;
+    }
+  }
+};
+
+void test_cover_thumbnail_round_trip(void)
+{
+  // an odd width so the last pixel of each row is on its own in a byte
+  const int WIDTH = 7;
+  const int HEIGHT = 5;
+  uint8_t gray[WIDTH * HEIGHT];
+  for (int i = 0; i < WIDTH * HEIGHT; i++)
+  {
+    gray[i] = i * 255 / (WIDTH * HEIGHT - 1);
+  }
+  std::vector<uint8_t> packed(CoverThumbnail::get_packed_size(WIDTH, HEIGHT));
+  TEST_ASSERT_EQUAL(4 * HEIGHT, packed.size());
+  CoverThumbnail::pack(gray, WIDTH, HEIGHT, packed.data());
+  // black and white come through exactly
+  TEST_ASSERT_EQUAL(0x0, packed[0] >> 4);
+  TEST_ASSERT_EQUAL(0xF, packed[packed.size() - 1] >> 4);
+
+  TEST_ASSERT_TRUE(CoverThumbnail::save(THUMBNAIL_PATH, WIDTH, HEIGHT, packed));
+  std::vector<uint8_t> loaded;
+  TEST_ASSERT_TRUE(CoverThumbnail::load(THUMBNAIL_PATH, WIDTH, HEIGHT, loaded));
+  TEST_ASSERT_TRUE(loaded == packed);
+
+  // drawing the thumbnail is the original to within one gray level
+  BitmapTestRenderer renderer;
+  renderer.draw_packed_gray(3, 2, WIDTH, HEIGHT, loaded.data());
+  for (int y = 0; y < HEIGHT; y++)
+  {
+    for (int x = 0; x < WIDTH; x++)
+    {
+      int drawn = renderer.pixels[(y + 2) * renderer.page_width + x + 3];
+      TEST_ASSERT_TRUE(abs(drawn - gray[y * WIDTH + x]) <= 8);
+    }
+  }
+  TEST_ASSERT_EQUAL(255, renderer.pixels[2 * renderer.page_width + 2]);
+  TEST_ASSERT_EQUAL(255, renderer.pixels[2 * renderer.page_width + 3 + WIDTH]);
+
+  // made for a different grid or margins - it has to be made again
+  TEST_ASSERT_FALSE(CoverThumbnail::load(THUMBNAIL_PATH, WIDTH + 1, HEIGHT, loaded));
+  TEST_ASSERT_FALSE(CoverThumbnail::load(THUMBNAIL_PATH, WIDTH, HEIGHT - 1, loaded));
+
+  // and a truncated one isn't used
+  FILE *fp = fopen(THUMBNAIL_PATH, "r+b");
+  TEST_ASSERT_NOT_NULL(fp);
+  fseek(fp, 0, SEEK_END);
+  long size = ftell(fp);
+  fclose(fp);
+  TEST_ASSERT_EQUAL(0, truncate(THUMBNAIL_PATH, size - 1));
+  TEST_ASSERT_FALSE(CoverThumbnail::load(THUMBNAIL_PATH, WIDTH, HEIGHT, loaded));
+  remove(THUMBNAIL_PATH);
+}
+
+// drawing a cover from its thumbnail against decoding it every time
+void test_cover_thumbnail_epub_benchmark(void)
+{
+  Epub epub("data/pg43-images.epub");
+  TEST_ASSERT_TRUE(epub.load());
+  std::string cover_href = epub.get_cover_image_item();
+  std::vector<uint8_t> cover = epub.get_item_contents_as_vector(cover_href);
+  TEST_ASSERT_TRUE(cover.size() > 0);
+
+  // a grid cell on the Paper S3
+  const int WIDTH = 120;
+  const int HEIGHT = 180;
+  const int RUNS = 9;
+  BitmapTestRenderer renderer;
+  std::vector<uint8_t> gray(WIDTH * HEIGHT);
+  auto start = std::chrono::steady_clock::now();
+  for (int run = 0; run < RUNS; run++)
+  {
+    TEST_ASSERT_TRUE(renderer.decode_image(cover_href, cover.data(), cover.size(), WIDTH, HEIGHT, gray.data()));
+    renderer.draw_pixels(0, 0, WIDTH, HEIGHT, gray.data());
+  }
+  long long decode_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+  std::vector<uint8_t> packed;
+  TEST_ASSERT_TRUE(CoverThumbnail::create(&renderer, THUMBNAIL_PATH, cover_href, cover.data(), cover.size(), WIDTH, HEIGHT, packed));
+  start = std::chrono::steady_clock::now();
+  for (int run = 0; run < RUNS; run++)
+  {
+    TEST_ASSERT_TRUE(CoverThumbnail::load(THUMBNAIL_PATH, WIDTH, HEIGHT, packed));
+    renderer.draw_packed_gray(0, 0, WIDTH, HEIGHT, packed.data());
+  }
+  long long thumbnail_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+  // a 4 bit thumbnail is half the size of the 8 bit bitmap
+  TEST_ASSERT_EQUAL(WIDTH * HEIGHT / 2, packed.size());
+  remove(THUMBNAIL_PATH);
+  printf("cover thumbnails: %d covers decoded %lldus, from thumbnails %lldus\n", RUNS, decode_us, thumbnail_us);
+}
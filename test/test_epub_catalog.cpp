@@ -0,0 +1,271 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <EpubList/EpubCatalog.h>
+
+static const char *CATALOG_PATH = "test_catalog.cat";
+
+static EpubListItem make_book(int number)
+{
+  EpubListItem item = {};
+  snprintf(item.path, sizeof(item.path), "/fs/Books/book%04d.epub", number);
+  // titles come out of the folder in a different order to how they sort
+  snprintf(item.title, sizeof(item.title), "Title %04d", (number * 37) % 1000);
+  snprintf(item.cover_path, sizeof(item.cover_path), "OEBPS/cover%d.jpg", number);
+  return item;
+}
+
+static void build_catalog(int books)
+{
+  EpubCatalog catalog;
+  catalog.set_path(CATALOG_PATH);
+  TEST_ASSERT_TRUE(catalog.begin_build());
+  for (int i = 0; i < books; i++)
+  {
+    TEST_ASSERT_EQUAL(i, catalog.add(make_book(i)));
+  }
+  TEST_ASSERT_TRUE(catalog.finish_build());
+}
+
+void test_epub_catalog_paging(void)
+{
+  const int BOOKS = 200;
+  build_catalog(BOOKS);
+
+  EpubCatalog catalog;
+  catalog.set_path(CATALOG_PATH);
+  TEST_ASSERT_TRUE(catalog.open());
+  TEST_ASSERT_EQUAL(BOOKS, catalog.get_count());
+  TEST_ASSERT_EQUAL(-1, catalog.get_last_opened());
+
+  // every page comes back in title order
+  std::vector<EpubListItem> page;
+  std::string previous;
+  for (int first = 0; first < BOOKS; first += 9)
+  {
+    int expected = BOOKS - first < 9 ? BOOKS - first : 9;
+    TEST_ASSERT_EQUAL(expected, catalog.read_page(first, 9, page));
+    for (auto &item : page)
+    {
+      TEST_ASSERT_TRUE(previous < item.title);
+      previous = item.title;
+    }
+  }
+  TEST_ASSERT_EQUAL(0, catalog.read_page(BOOKS, 9, page));
+
+  // book 190 has the second title
+  EpubListItem book;
+  TEST_ASSERT_TRUE(catalog.read(0, book));
+  TEST_ASSERT_EQUAL_STRING("Title 0000", book.title);
+  TEST_ASSERT_TRUE(catalog.read(1, book));
+  TEST_ASSERT_EQUAL_STRING("Title 0030", book.title);
+  TEST_ASSERT_EQUAL_STRING("/fs/Books/book0190.epub", book.path);
+  TEST_ASSERT_EQUAL_STRING("OEBPS/cover190.jpg", book.cover_path);
+
+  // positions are written back in place and remembered along with the last book read
+  book.current_section = 12;
+  book.current_page = 34;
+  book.pages_in_current_section = 56;
+  TEST_ASSERT_TRUE(catalog.write_position(1, book));
+  TEST_ASSERT_TRUE(catalog.set_last_opened(1));
+
+  EpubCatalog reopened;
+  reopened.set_path(CATALOG_PATH);
+  TEST_ASSERT_TRUE(reopened.open());
+  TEST_ASSERT_EQUAL(1, reopened.get_last_opened());
+  EpubListItem saved;
+  TEST_ASSERT_TRUE(reopened.read(1, saved));
+  TEST_ASSERT_EQUAL(12, saved.current_section);
+  TEST_ASSERT_EQUAL(34, saved.current_page);
+  TEST_ASSERT_EQUAL(56, saved.pages_in_current_section);
+  TEST_ASSERT_EQUAL_STRING(book.title, saved.title);
+  // the neighbours are untouched
+  TEST_ASSERT_TRUE(reopened.read(0, saved));
+  TEST_ASSERT_EQUAL(0, saved.current_section);
+
+  // a catalog that was never finished isn't used - the old one is still there
+  {
+    EpubCatalog unfinished;
+    unfinished.set_path(CATALOG_PATH);
+    TEST_ASSERT_TRUE(unfinished.begin_build());
+    unfinished.add(make_book(1));
+  }
+  TEST_ASSERT_TRUE(reopened.open());
+  TEST_ASSERT_EQUAL(BOOKS, reopened.get_count());
+  TEST_ASSERT_EQUAL(1, reopened.get_last_opened());
+  remove(CATALOG_PATH);
+  remove("test_catalog.TMP");
+}
+
+// opening the library and reading a page shouldn't cost more as the library grows
+void test_epub_catalog_open_cost(void)
+{
+  const int RUNS = 50;
+  long long us[2] = {0, 0};
+  const int sizes[2] = {20, 1000};
+  for (int s = 0; s < 2; s++)
+  {
+    build_catalog(sizes[s]);
+    std::vector<EpubListItem> page;
+    auto start = std::chrono::steady_clock::now();
+    for (int run = 0; run < RUNS; run++)
+    {
+      EpubCatalog catalog;
+      catalog.set_path(CATALOG_PATH);
+      TEST_ASSERT_TRUE(catalog.open());
+      // the last page of the grid
+      TEST_ASSERT_EQUAL(9, catalog.read_page(sizes[s] - 9, 9, page));
+    }
+    us[s] = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count() / RUNS;
+    // only the page being shown is held in memory
+    TEST_ASSERT_EQUAL(9, page.size());
+  }
+  remove(CATALOG_PATH);
+  printf("catalog open + page read: %d books %lldus, %d books %lldus\n", sizes[0], us[0], sizes[1], us[1]);
+}
+
+static const char *LIBRARY_PATH = "test_library";
+static const char *LIBRARY_CATALOG_PATH = "test_library/BOOKS.CAT";
+
+static std::string library_book_path(int number)
+{
+  char path[64];
+  snprintf(path, sizeof(path), "%s/book%04d.epub", LIBRARY_PATH, number);
+  return path;
+}
+
+// not really an EPUB - the catalog only cares about the bytes
+static void write_library_book(const std::string &path, int number, int size)
+{
+  FILE *fp = fopen(path.c_str(), "wb");
+  TEST_ASSERT_NOT_NULL(fp);
+  for (int i = 0; i < size; i++)
+  {
+    fputc((number * 31 + i) & 0xff, fp);
+  }
+  fclose(fp);
+}
+
+struct CountingLoader
+{
+  int calls = 0;
+  bool operator()(const std::string &path, EpubListItem &item)
+  {
+    calls++;
+    item = {};
+    strncpy(item.path, path.c_str(), MAX_PATH_SIZE - 1);
+    // title order is the reverse of the file names
+    snprintf(item.title, sizeof(item.title), "Title %s", path.c_str() + path.size() - 9);
+    for (char *c = item.title + 6; *c; c++)
+    {
+      if (*c >= '0' && *c <= '9')
+      {
+        *c = '9' - (*c - '0');
+      }
+    }
+    return true;
+  }
+};
+
+static long long time_sync(EpubCatalog &catalog, CountingLoader &loader, CatalogSyncStats &stats)
+{
+  auto start = std::chrono::steady_clock::now();
+  TEST_ASSERT_TRUE(catalog.sync(LIBRARY_PATH, [&](const std::string &path, EpubListItem &item)
+                                { return loader(path, item); }, &stats));
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// a rescan only opens the books that are new or have changed
+void test_epub_catalog_sync(void)
+{
+  const int BOOKS = 200;
+  const int BOOK_SIZE = 10 * 1024;
+  mkdir(LIBRARY_PATH, 0777);
+  for (int i = 0; i < BOOKS; i++)
+  {
+    write_library_book(library_book_path(i), i, BOOK_SIZE);
+  }
+  EpubCatalog catalog;
+  catalog.set_path(LIBRARY_CATALOG_PATH);
+  CountingLoader loader;
+  CatalogSyncStats stats;
+  long long full_us = time_sync(catalog, loader, stats);
+  TEST_ASSERT_EQUAL(BOOKS, loader.calls);
+  TEST_ASSERT_EQUAL(BOOKS, stats.added);
+  TEST_ASSERT_TRUE(stats.rewritten);
+  TEST_ASSERT_EQUAL(BOOKS, catalog.get_count());
+  // the last file sorts first
+  EpubListItem book;
+  TEST_ASSERT_TRUE(catalog.read(0, book));
+  TEST_ASSERT_EQUAL_STRING(library_book_path(BOOKS - 1).c_str(), book.path);
+
+  // nothing has changed
+  loader.calls = 0;
+  long long unchanged_us = time_sync(catalog, loader, stats);
+  TEST_ASSERT_EQUAL(0, loader.calls);
+  TEST_ASSERT_FALSE(stats.rewritten);
+  TEST_ASSERT_EQUAL(BOOKS, stats.unchanged);
+  TEST_ASSERT_TRUE(catalog.is_up_to_date(LIBRARY_PATH));
+
+  // a book overwritten in place - same name, so only its size gives it away
+  write_library_book(library_book_path(2), 2000, BOOK_SIZE + 2);
+  TEST_ASSERT_FALSE(catalog.is_up_to_date(LIBRARY_PATH));
+  loader.calls = 0;
+  time_sync(catalog, loader, stats);
+  TEST_ASSERT_EQUAL(1, loader.calls);
+  TEST_ASSERT_EQUAL(1, stats.changed);
+  TEST_ASSERT_EQUAL(BOOKS - 1, stats.unchanged);
+  TEST_ASSERT_TRUE(catalog.is_up_to_date(LIBRARY_PATH));
+
+  // remember where we were in a book that's about to be renamed
+  int renamed_index = 50;
+  TEST_ASSERT_TRUE(catalog.read(renamed_index, book));
+  std::string renamed_from = book.path;
+  book.current_section = 3;
+  book.current_page = 7;
+  TEST_ASSERT_TRUE(catalog.write_position(renamed_index, book));
+  TEST_ASSERT_TRUE(catalog.set_last_opened(renamed_index));
+
+  // one added, one removed and one changed
+  write_library_book(library_book_path(BOOKS), BOOKS, BOOK_SIZE);
+  remove(library_book_path(0).c_str());
+  write_library_book(library_book_path(1), 1000, BOOK_SIZE + 1);
+  loader.calls = 0;
+  long long changed_us = time_sync(catalog, loader, stats);
+  TEST_ASSERT_EQUAL(2, loader.calls);
+  TEST_ASSERT_EQUAL(1, stats.added);
+  TEST_ASSERT_EQUAL(1, stats.changed);
+  TEST_ASSERT_EQUAL(1, stats.removed);
+  TEST_ASSERT_EQUAL(BOOKS - 2, stats.unchanged);
+  TEST_ASSERT_EQUAL(BOOKS, catalog.get_count());
+
+  // a renamed book is recognised by its contents and keeps its place
+  std::string renamed_to = std::string(LIBRARY_PATH) + "/renamed.epub";
+  TEST_ASSERT_EQUAL(0, rename(renamed_from.c_str(), renamed_to.c_str()));
+  loader.calls = 0;
+  long long renamed_us = time_sync(catalog, loader, stats);
+  TEST_ASSERT_EQUAL(0, loader.calls);
+  TEST_ASSERT_EQUAL(1, stats.renamed);
+  TEST_ASSERT_EQUAL(0, stats.removed);
+  int last_opened = catalog.get_last_opened();
+  TEST_ASSERT_TRUE(last_opened >= 0);
+  TEST_ASSERT_TRUE(catalog.read(last_opened, book));
+  TEST_ASSERT_EQUAL_STRING(renamed_to.c_str(), book.path);
+  TEST_ASSERT_EQUAL(3, book.current_section);
+  TEST_ASSERT_EQUAL(7, book.current_page);
+
+  printf("catalog sync: %d books full %lldus, unchanged %lldus, 3 changes %lldus, rename %lldus\n", BOOKS,
+         full_us, unchanged_us, changed_us, renamed_us);
+
+  remove(renamed_to.c_str());
+  for (int i = 0; i <= BOOKS; i++)
+  {
+    remove(library_book_path(i).c_str());
+  }
+  remove(LIBRARY_CATALOG_PATH);
+  rmdir(LIBRARY_PATH);
+}
@@ -0,0 +1,161 @@
+#include <unity.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+#include <Renderer/GlyphBlitter.h>
+#include "test_renderer.h"
+
+static const int FB_WIDTH = 960;
+static const int FB_HEIGHT = 540;
+static int rotation = 3; // EPD_ROT_INVERTED_PORTRAIT
+
+// a copy of epd_draw_pixel - kept out of line like the real one
+static __attribute__((noinline)) void reference_draw_pixel(int x, int y, uint8_t color, uint8_t *frame_buffer)
+{
+  switch (rotation)
+  {
+  case 3:
+  {
+    int t = x;
+    x = y;
+    y = FB_HEIGHT - t - 1;
+    break;
+  }
+  default:
+    break;
+  }
+  if (x < 0 || x >= FB_WIDTH || y < 0 || y >= FB_HEIGHT)
+  {
+    return;
+  }
+  uint8_t *p = &frame_buffer[y * FB_WIDTH / 2 + x / 2];
+  if (x % 2)
+  {
+    *p = (*p & 0x0F) | (color & 0xF0);
+  }
+  else
+  {
+    *p = (*p & 0xF0) | (color >> 4);
+  }
+}
+
+// does what EpdiyFrameBufferRenderer::draw_pixel does
+class FrameBufferTestRenderer : public FixedWidthTestRenderer
+{
+public:
+  uint8_t *frame_buffer;
+  uint8_t gamma_curve[256];
+  bool gray = false;
+  FrameBufferTestRenderer(uint8_t *frame_buffer) : frame_buffer(frame_buffer)
+  {
+    for (int i = 0; i < 256; i++)
+    {
+      gamma_curve[i] = round(255 * pow(i / 255.0, 1.0 / 0.8));
+    }
+  }
+  virtual void draw_pixel(int x, int y, uint8_t color)
+  {
+    color = gamma_curve[color];
+    if (color != 0 && color != 255)
+    {
+      gray = true;
+    }
+    reference_draw_pixel(x, y, color, frame_buffer);
+  }
+};
+
+// something glyph shaped - a ring with anti-aliased edges and transparent space around and inside it
+static std::vector<uint8_t> make_glyph(int width, int height, int pitch)
+{
+  std::vector<uint8_t> glyph(pitch * height, 0);
+  float cx = (width - 1) / 2.0f;
+  float cy = (height - 1) / 2.0f;
+  float radius = (width < height ? width : height) / 2.0f - 1;
+  for (int y = 0; y < height; y++)
+  {
+    for (int x = 0; x < width; x++)
+    {
+      float distance = fabsf(sqrtf((x - cx) * (x - cx) + (y - cy) * (y - cy)) - radius * 0.7f);
+      float coverage = 1.0f - (distance - radius * 0.2f);
+      glyph[y * pitch + x] = coverage <= 0 ? 0 : (coverage >= 1 ? 255 : (uint8_t)(coverage * 255));
+    }
+  }
+  return glyph;
+}
+
+void test_glyph_blit_matches_draw_pixel(void)
+{
+  std::vector<uint8_t> expected(FB_WIDTH * FB_HEIGHT / 2, 0xFF);
+  std::vector<uint8_t> actual(FB_WIDTH * FB_HEIGHT / 2, 0xFF);
+  FrameBufferTestRenderer renderer(expected.data());
+  GlyphBlitter blitter;
+  blitter.init(renderer.gamma_curve);
+  bool gray = false;
+  // odd and even positions, odd sizes, padded pitches and glyphs hanging off every edge
+  int positions[][2] = {{10, 10}, {11, 13}, {-5, 20}, {530, 7}, {100, -6}, {200, 950}, {-3, -3}, {535, 955}};
+  for (unsigned int i = 0; i < sizeof(positions) / sizeof(positions[0]); i++)
+  {
+    int width = 9 + i;
+    int height = 13 + (i % 3);
+    int pitch = width + (i % 2) * 3;
+    std::vector<uint8_t> glyph = make_glyph(width, height, pitch);
+    renderer.draw_glyph(positions[i][0], positions[i][1], width, height, glyph.data(), pitch);
+    gray |= blitter.blit(actual.data(), FB_WIDTH, FB_HEIGHT, positions[i][0], positions[i][1], width, height, glyph.data(), pitch);
+  }
+  TEST_ASSERT_EQUAL(renderer.gray, gray);
+  TEST_ASSERT_EQUAL(0, memcmp(expected.data(), actual.data(), expected.size()));
+}
+
+// stop the compiler seeing through the virtual calls
+static __attribute__((noinline)) Renderer *as_renderer(Renderer *renderer)
+{
+  return renderer;
+}
+
+// full pages of text - about what a 22px font on the Paper S3 puts on screen
+void test_glyph_blit_page_benchmark(void)
+{
+  const int pages = 10;
+  const int glyph_width = 12;
+  const int glyph_height = 16;
+  const int lines = 36;
+  const int glyphs_per_line = 45;
+  std::vector<uint8_t> glyph = make_glyph(glyph_width, glyph_height, glyph_width);
+  std::vector<uint8_t> expected(FB_WIDTH * FB_HEIGHT / 2, 0xFF);
+  std::vector<uint8_t> actual(FB_WIDTH * FB_HEIGHT / 2, 0xFF);
+  FrameBufferTestRenderer renderer(expected.data());
+  Renderer *per_pixel = as_renderer(&renderer);
+  GlyphBlitter blitter;
+  blitter.init(renderer.gamma_curve);
+
+  auto start = std::chrono::steady_clock::now();
+  for (int page = 0; page < pages; page++)
+  {
+    for (int line = 0; line < lines; line++)
+    {
+      for (int i = 0; i < glyphs_per_line; i++)
+      {
+        per_pixel->draw_glyph(10 + i * 11, 35 + line * 25, glyph_width, glyph_height, glyph.data(), glyph_width);
+      }
+    }
+  }
+  auto per_pixel_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+  start = std::chrono::steady_clock::now();
+  for (int page = 0; page < pages; page++)
+  {
+    for (int line = 0; line < lines; line++)
+    {
+      for (int i = 0; i < glyphs_per_line; i++)
+      {
+        blitter.blit(actual.data(), FB_WIDTH, FB_HEIGHT, 10 + i * 11, 35 + line * 25, glyph_width, glyph_height, glyph.data(), glyph_width);
+      }
+    }
+  }
+  auto blit_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+  printf("glyph page render: draw_pixel %lldus/page, direct 4bpp blit %lldus/page\n",
+         (long long)(per_pixel_us / pages), (long long)(blit_us / pages));
+  TEST_ASSERT_EQUAL(0, memcmp(expected.data(), actual.data(), expected.size()));
+}
@@ -0,0 +1,60 @@
+#include <unity.h>
+#include <string.h>
+#include <Renderer/GlyphCache.h>
+
+void test_glyph_cache_lru(void)
+{
+  uint8_t bitmap[10 * 10];
+  for (int i = 0; i < 100; i++)
+  {
+    bitmap[i] = i;
+  }
+  // room for exactly three 10x10 glyphs
+  size_t entry_size = sizeof(CachedGlyph) + 100;
+  GlyphCache cache(entry_size * 3);
+
+  TEST_ASSERT_NULL(cache.find(GlyphCache::make_key(22, 'a')));
+  TEST_ASSERT_EQUAL(1, cache.get_misses());
+  const CachedGlyph *glyph = cache.insert(GlyphCache::make_key(22, 'a'), 1, 9, 10, 10, bitmap, 10);
+  TEST_ASSERT_NOT_NULL(glyph);
+  TEST_ASSERT_EQUAL(1, glyph->left);
+  TEST_ASSERT_EQUAL(9, glyph->top);
+  TEST_ASSERT_EQUAL(0, memcmp(glyph->bitmap, bitmap, 100));
+  cache.insert(GlyphCache::make_key(22, 'b'), 0, 0, 10, 10, bitmap, 10);
+  // the same code point at a different size is a different glyph
+  cache.insert(GlyphCache::make_key(18, 'a'), 0, 0, 10, 10, bitmap, 10);
+  TEST_ASSERT_EQUAL(3, cache.get_count());
+  TEST_ASSERT_EQUAL(entry_size * 3, cache.get_used_bytes());
+
+  // touch 'a' so 'b' becomes the least recently used and is the one evicted
+  TEST_ASSERT_NOT_NULL(cache.find(GlyphCache::make_key(22, 'a')));
+  cache.insert(GlyphCache::make_key(22, 'c'), 0, 0, 10, 10, bitmap, 10);
+  TEST_ASSERT_EQUAL(3, cache.get_count());
+  TEST_ASSERT_EQUAL(1, cache.get_evictions());
+  TEST_ASSERT_NULL(cache.find(GlyphCache::make_key(22, 'b')));
+  TEST_ASSERT_NOT_NULL(cache.find(GlyphCache::make_key(22, 'a')));
+  TEST_ASSERT_NOT_NULL(cache.find(GlyphCache::make_key(18, 'a')));
+  TEST_ASSERT_EQUAL(3, cache.get_hits());
+  TEST_ASSERT_EQUAL(2, cache.get_misses());
+
+  // bitmaps are copied row by row so a padded source pitch is fine
+  uint8_t padded[4 * 16] = {0};
+  for (int row = 0; row < 4; row++)
+  {
+    memset(padded + row * 16, row + 1, 3);
+  }
+  glyph = cache.insert(GlyphCache::make_key(22, 'd'), 0, 0, 3, 4, padded, 16);
+  TEST_ASSERT_NOT_NULL(glyph);
+  TEST_ASSERT_EQUAL(4, glyph->bitmap[3 * 3 + 2]);
+
+  // a glyph bigger than the whole budget is never cached
+  uint8_t big[40 * 40] = {0};
+  TEST_ASSERT_NULL(cache.insert(GlyphCache::make_key(22, 'W'), 0, 0, 40, 40, big, 40));
+
+  // shrinking the budget evicts down to it
+  cache.set_budget(entry_size);
+  TEST_ASSERT_TRUE(cache.get_used_bytes() <= entry_size);
+  cache.clear();
+  TEST_ASSERT_EQUAL(0, cache.get_count());
+  TEST_ASSERT_EQUAL(0, cache.get_used_bytes());
+}
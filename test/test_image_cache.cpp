@@ -0,0 +1,48 @@
+#include <unity.h>
+#include <string.h>
+#include <Renderer/ImageCache.h>
+
+static uint8_t *make_bitmap(int size, uint8_t value)
+{
+  uint8_t *bitmap = ImageCache::allocate_bitmap(size);
+  memset(bitmap, value, size);
+  return bitmap;
+}
+
+void test_image_cache_lru(void)
+{
+  std::string a = ImageCache::make_key("/fs/book.epub", "images/a.jpg", 20, 10);
+  std::string b = ImageCache::make_key("/fs/book.epub", "images/b.jpg", 20, 10);
+  // the same image drawn at another size is a different entry
+  std::string a_small = ImageCache::make_key("/fs/book.epub", "images/a.jpg", 10, 5);
+  TEST_ASSERT_TRUE(a != a_small);
+
+  // room for a and b but not a_small as well
+  size_t budget = 2 * (sizeof(CachedImage) + a.size() + 200) + 10;
+  ImageCache cache(budget);
+  TEST_ASSERT_NULL(cache.find(a));
+  const CachedImage *image = cache.insert(a, 20, 10, make_bitmap(200, 1));
+  TEST_ASSERT_NOT_NULL(image);
+  TEST_ASSERT_EQUAL(20, image->width);
+  TEST_ASSERT_EQUAL(10, image->height);
+  TEST_ASSERT_EQUAL(1, image->bitmap[199]);
+  cache.insert(b, 20, 10, make_bitmap(200, 2));
+  TEST_ASSERT_EQUAL(2, cache.get_count());
+
+  // touch a so b is the least recently used and gets evicted
+  TEST_ASSERT_NOT_NULL(cache.find(a));
+  cache.insert(a_small, 10, 5, make_bitmap(50, 3));
+  TEST_ASSERT_EQUAL(1, cache.get_evictions());
+  TEST_ASSERT_NULL(cache.find(b));
+  TEST_ASSERT_NOT_NULL(cache.find(a));
+  TEST_ASSERT_EQUAL(3, cache.find(a_small)->bitmap[0]);
+  TEST_ASSERT_TRUE(cache.get_used_bytes() <= budget);
+
+  // too big for the whole budget - the cache frees it and says no
+  TEST_ASSERT_NULL(cache.insert(b, 100, 100, make_bitmap(10000, 4)));
+  TEST_ASSERT_NOT_NULL(cache.find(a));
+
+  cache.set_budget(0);
+  TEST_ASSERT_EQUAL(0, cache.get_count());
+  TEST_ASSERT_EQUAL(0, cache.get_used_bytes());
+}
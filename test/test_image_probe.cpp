@@ -0,0 +1,107 @@
+#include <unity.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <Renderer/ImageProbe.h>
+#include <RubbishHtmlParser/RubbishHtmlParser.h>
+#include <RubbishHtmlParser/blocks/ImageBlock.h>
+#include <EpubList/Epub.h>
+#include "test_renderer.h"
+
+void test_image_probe(void)
+{
+  int width = 0;
+  int height = 0;
+  // SOI, an APP0 segment, then a baseline frame header for 640x480
+  const uint8_t jpeg[] = {
+      0xFF, 0xD8,
+      0xFF, 0xE0, 0x00, 0x10, 'J', 'F', 'I', 'F', 0x00, 0x01, 0x01, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00,
+      0xFF, 0xC0, 0x00, 0x11, 0x08, 0x01, 0xE0, 0x02, 0x80, 0x03, 0x01, 0x22, 0x00};
+  TEST_ASSERT_TRUE(probe_image_size(jpeg, sizeof(jpeg), &width, &height));
+  TEST_ASSERT_EQUAL(640, width);
+  TEST_ASSERT_EQUAL(480, height);
+  // the frame header hasn't been read yet
+  TEST_ASSERT_FALSE(probe_image_size(jpeg, 24, &width, &height));
+
+  const uint8_t png[] = {
+      0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A,
+      0x00, 0x00, 0x00, 0x0D, 'I', 'H', 'D', 'R',
+      0x00, 0x00, 0x01, 0x2C, 0x00, 0x00, 0x00, 0xC8, 0x08, 0x02, 0x00, 0x00, 0x00};
+  TEST_ASSERT_TRUE(probe_image_size(png, sizeof(png), &width, &height));
+  TEST_ASSERT_EQUAL(300, width);
+  TEST_ASSERT_EQUAL(200, height);
+  TEST_ASSERT_FALSE(probe_image_size(png, 20, &width, &height));
+
+  // a progressive JPEG has a size but tjpgd can't draw it
+  uint8_t progressive[sizeof(jpeg)];
+  memcpy(progressive, jpeg, sizeof(jpeg));
+  progressive[21] = 0xC2;
+  ImageHeader header;
+  TEST_ASSERT_TRUE(ImageProbeResult::FOUND == probe_image_header(progressive, sizeof(progressive), &header));
+  TEST_ASSERT_TRUE(header.is_jpeg);
+  TEST_ASSERT_FALSE(header.decodable);
+  TEST_ASSERT_TRUE(ImageProbeResult::NEED_MORE_DATA == probe_image_header(jpeg, 24, &header));
+
+  const uint8_t gif[] = {'G', 'I', 'F', '8', '9', 'a', 0x01, 0x00, 0x01, 0x00};
+  TEST_ASSERT_FALSE(probe_image_size(gif, sizeof(gif), &width, &height));
+}
+
+// every image in a picture book - the sizes from the headers should match what the decoder says,
+// without inflating the whole of every image
+void test_image_probe_epub_benchmark(void)
+{
+  Epub *epub = new Epub("data/pg14838-images.epub");
+  TEST_ASSERT_TRUE(epub->load());
+  std::vector<std::string> images;
+  images.push_back(epub->get_cover_image_item());
+  for (int i = 0; i < epub->get_spine_items_count(); i++)
+  {
+    const std::string &item = epub->get_spine_item(i);
+    size_t size = 0;
+    char *html = (char *)epub->get_item_contents(item, &size);
+    TEST_ASSERT_NOT_NULL(html);
+    RubbishHtmlParser parser(html, size, item.substr(0, item.find_last_of('/') + 1), false);
+    free(html);
+    for (auto block : parser.get_blocks())
+    {
+      if (block->getType() == BlockType::IMAGE_BLOCK)
+      {
+        images.push_back(((ImageBlock *)block)->m_src);
+      }
+    }
+  }
+  TEST_ASSERT_TRUE(images.size() > 20);
+
+  FixedWidthTestRenderer renderer;
+  int64_t full_us = 0;
+  int64_t probe_us = 0;
+  for (auto &image : images)
+  {
+    // what layout used to do - inflate the whole image and ask the decoder
+    auto start = std::chrono::steady_clock::now();
+    size_t size = 0;
+    uint8_t *data = epub->get_item_contents(image, &size);
+    TEST_ASSERT_NOT_NULL(data);
+    int width = 0;
+    int height = 0;
+    bool decoded = renderer.get_image_size(image, data, size, &width, &height);
+    free(data);
+    full_us += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    ImageHeader header;
+    TEST_ASSERT_TRUE_MESSAGE(epub->get_item_image_header(image, &header), image.c_str());
+    probe_us += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    if (decoded)
+    {
+      TEST_ASSERT_EQUAL(width, header.width);
+      TEST_ASSERT_EQUAL(height, header.height);
+    }
+  }
+  printf("image sizes for %d images: full inflate %lldus, header probe %lldus\n", (int)images.size(), (long long)full_us, (long long)probe_us);
+  TEST_ASSERT_TRUE(probe_us < full_us);
+  delete epub;
+}
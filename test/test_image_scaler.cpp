@@ -0,0 +1,146 @@
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include <EpubList/Epub.h>
+#include <Renderer/ImageScaler.h>
+#include <Renderer/JPEGHelper.h>
+#include "test_renderer.h"
+
+static const char *GOLDEN_PATH = "fixtures/scaled_gradient.pgm";
+
+// keeps everything drawn so it can be compared with the golden image
+class ScalerTestRenderer : public FixedWidthTestRenderer
+{
+public:
+  std::vector<uint8_t> pixels;
+  int rows_drawn = 0;
+  ScalerTestRenderer(int width, int height)
+  {
+    page_width = width;
+    page_height = height;
+    pixels.assign(width * height, 255);
+  }
+  virtual void draw_pixel(int x, int y, uint8_t color)
+  {
+    if (x >= 0 && x < page_width && y >= 0 && y < page_height)
+    {
+      pixels[y * page_width + x] = color;
+    }
+  }
+  virtual void draw_pixels(int x, int y, int width, int height, const uint8_t *data)
+  {
+    rows_drawn += height;
+    Renderer::draw_pixels(x, y, width, height, data);
+  }
+};
+
+// a horizontal gradient with a fine checkerboard in the bottom half - it aliases badly if we point sample it
+static std::vector<uint8_t> make_source(int width, int height)
+{
+  std::vector<uint8_t> source(width * height);
+  for (int y = 0; y < height; y++)
+  {
+    for (int x = 0; x < width; x++)
+    {
+      source[y * width + x] = y < height / 2 ? x * 255 / (width - 1) : ((x + y) & 1) * 255;
+    }
+  }
+  return source;
+}
+
+static void scale(const std::vector<uint8_t> &source, int source_width, int source_height,
+                  ScalerTestRenderer &renderer, int x, int y, int width, int height)
+{
+  ImageScaler scaler;
+  TEST_ASSERT_TRUE(scaler.begin(&renderer, x, y, source_width, source_height, width, height));
+  for (int row = 0; row < source_height; row++)
+  {
+    scaler.add_row(source.data() + row * source_width);
+  }
+  TEST_ASSERT_TRUE(scaler.is_complete());
+  scaler.end();
+}
+
+static bool read_pgm(const char *path, int *width, int *height, std::vector<uint8_t> &pixels)
+{
+  FILE *fp = fopen(path, "rb");
+  if (!fp)
+  {
+    return false;
+  }
+  int max_value = 0;
+  bool ok = fscanf(fp, "P5 %d %d %d", width, height, &max_value) == 3 && max_value == 255 && fgetc(fp) != EOF;
+  if (ok)
+  {
+    pixels.resize(*width * *height);
+    ok = fread(pixels.data(), 1, pixels.size(), fp) == pixels.size();
+  }
+  fclose(fp);
+  return ok;
+}
+
+void test_image_scaler_golden(void)
+{
+  const int SOURCE_WIDTH = 97;
+  const int SOURCE_HEIGHT = 61;
+  std::vector<uint8_t> source = make_source(SOURCE_WIDTH, SOURCE_HEIGHT);
+  // scaled down into the top left and up into the bottom right of the same image
+  ScalerTestRenderer renderer(200, 120);
+  scale(source, SOURCE_WIDTH, SOURCE_HEIGHT, renderer, 0, 0, 40, 25);
+  scale(source, SOURCE_WIDTH, SOURCE_HEIGHT, renderer, 40, 25, 160, 95);
+  TEST_ASSERT_EQUAL(25 + 95, renderer.rows_drawn);
+
+  // everything ends up on one of the 16 levels and the checkerboard averages out to mid gray
+  long long sum = 0;
+  for (int y = 13; y < 25; y++)
+  {
+    for (int x = 0; x < 40; x++)
+    {
+      sum += renderer.pixels[y * renderer.page_width + x];
+    }
+  }
+  TEST_ASSERT_INT_WITHIN(8, 128, sum / (12 * 40));
+  for (uint8_t pixel : renderer.pixels)
+  {
+    TEST_ASSERT_EQUAL(0, pixel % 17);
+  }
+
+  int width = 0;
+  int height = 0;
+  std::vector<uint8_t> golden;
+  TEST_ASSERT_TRUE(read_pgm(GOLDEN_PATH, &width, &height, golden));
+  TEST_ASSERT_EQUAL(renderer.page_width, width);
+  TEST_ASSERT_EQUAL(renderer.page_height, height);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(golden.data(), renderer.pixels.data(), golden.size());
+}
+
+// a full page cover decoded straight to the screen
+void test_image_scaler_jpeg_benchmark(void)
+{
+  Epub epub("data/pg43-images.epub");
+  TEST_ASSERT_TRUE(epub.load());
+  std::vector<uint8_t> cover = epub.get_item_contents_as_vector(epub.get_cover_image_item());
+  TEST_ASSERT_TRUE(cover.size() > 0);
+
+  JPEGHelper helper;
+  int source_width = 0;
+  int source_height = 0;
+  TEST_ASSERT_TRUE(helper.get_size(cover.data(), cover.size(), &source_width, &source_height));
+  // the Paper S3 in portrait
+  const int RUNS = 5;
+  ScalerTestRenderer renderer(540, 960);
+  auto start = std::chrono::steady_clock::now();
+  for (int run = 0; run < RUNS; run++)
+  {
+    renderer.rows_drawn = 0;
+    TEST_ASSERT_TRUE(helper.render(cover.data(), cover.size(), &renderer, 0, 0, 540, 960));
+  }
+  long long decode_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+  // aspect fit - one side fills the page
+  TEST_ASSERT_TRUE(renderer.rows_drawn == 960 || renderer.rows_drawn == source_height * 540 / source_width ||
+                   renderer.rows_drawn == source_height * 540 / source_width + 1);
+  printf("cover %dx%d to the full page: %lldus\n", source_width, source_height, decode_us / RUNS);
+}
@@ -0,0 +1,73 @@
+#include <unity.h>
+#include <string>
+#include <chrono>
+#include <stdio.h>
+#include <RubbishHtmlParser/RubbishHtmlParser.h>
+#include "test_renderer.h"
+
+static std::string make_long_chapter(int paragraphs)
+{
+  std::string html = "<html><body><h1>A long chapter</h1>";
+  for (int i = 0; i < paragraphs; i++)
+  {
+    html += "<p>Paragraph " + std::to_string(i) + " has some words in it";
+    for (int j = 0; j < i % 7; j++)
+    {
+      html += " and a few more words to make it wrap";
+    }
+    html += "</p>";
+  }
+  html += "</body></html>";
+  return html;
+}
+
+void test_incremental_layout_matches_full_layout(void)
+{
+  std::string html = make_long_chapter(400);
+  RecordingTestRenderer renderer;
+  renderer.page_height = 20;
+
+  auto start = std::chrono::steady_clock::now();
+  RubbishHtmlParser full(html.c_str(), html.size(), "", false);
+  full.layout(&renderer, nullptr);
+  auto full_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+  TEST_ASSERT_TRUE(full.is_layout_complete());
+  TEST_ASSERT_TRUE(full.get_page_count() > 10);
+
+  start = std::chrono::steady_clock::now();
+  RubbishHtmlParser incremental(html.c_str(), html.size(), "", false);
+  incremental.layout_to_page(&renderer, nullptr, 1);
+  auto first_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+  // page 1 is complete once page 2 has been started - and no further
+  TEST_ASSERT_FALSE(incremental.is_layout_complete());
+  TEST_ASSERT_EQUAL(3, incremental.get_page_count());
+  printf("layout: full section %lldus, first two pages %lldus\n", (long long)full_us, (long long)first_us);
+
+  // asking for a page we already have doesn't do any more work
+  incremental.layout_to_page(&renderer, nullptr, 0);
+  TEST_ASSERT_EQUAL(3, incremental.get_page_count());
+
+  // jump ahead a few pages and then let the "background" steps finish the rest
+  incremental.layout_to_page(&renderer, nullptr, 6);
+  TEST_ASSERT_EQUAL(8, incremental.get_page_count());
+  int steps = 0;
+  while (incremental.layout_step(&renderer, nullptr))
+  {
+    steps++;
+  }
+  TEST_ASSERT_TRUE(steps > 0);
+  TEST_ASSERT_TRUE(incremental.is_layout_complete());
+  TEST_ASSERT_EQUAL(full.get_page_count(), incremental.get_page_count());
+  TEST_ASSERT_TRUE(render_all_pages(full, renderer) == render_all_pages(incremental, renderer));
+}
+
+void test_incremental_layout_short_section(void)
+{
+  const char *html = "<html><body><p>Just one line</p></body></html>";
+  FixedWidthTestRenderer renderer;
+  RubbishHtmlParser parser(html, strlen(html), "", false);
+  parser.layout_to_page(&renderer, nullptr, 1);
+  TEST_ASSERT_TRUE(parser.is_layout_complete());
+  TEST_ASSERT_EQUAL(1, parser.get_page_count());
+  TEST_ASSERT_FALSE(parser.layout_step(&renderer, nullptr));
+}
@@ -0,0 +1,180 @@
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <chrono>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <EpubList/Epub.h>
+#include <RubbishHtmlParser/RubbishHtmlParser.h>
+#include <RubbishHtmlParser/blocks/ImageBlock.h>
+#include <Renderer/JPEGHelper.h>
+#include "test_renderer.h"
+
+static bool is_jpeg(const std::vector<uint8_t> &data)
+{
+  return data.size() > 3 && data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF;
+}
+
+// every cover and illustration in the test books that tjpgd can draw
+static void find_jpegs(const char *path, std::vector<std::vector<uint8_t>> &jpegs)
+{
+  Epub epub(path);
+  TEST_ASSERT_TRUE(epub.load());
+  std::vector<std::string> images;
+  images.push_back(epub.get_cover_image_item());
+  for (int i = 0; i < epub.get_spine_items_count(); i++)
+  {
+    const std::string &item = epub.get_spine_item(i);
+    size_t size = 0;
+    char *html = (char *)epub.get_item_contents(item, &size);
+    TEST_ASSERT_NOT_NULL(html);
+    RubbishHtmlParser parser(html, size, item.substr(0, item.find_last_of('/') + 1), false);
+    free(html);
+    for (auto block : parser.get_blocks())
+    {
+      if (block->getType() == BlockType::IMAGE_BLOCK)
+      {
+        images.push_back(((ImageBlock *)block)->m_src);
+      }
+    }
+  }
+  JPEGHelper helper;
+  for (auto &image : images)
+  {
+    std::vector<uint8_t> data = epub.get_item_contents_as_vector(image);
+    int width = 0;
+    int height = 0;
+    // progressive JPEGs have a size but tjpgd can't draw them
+    if (is_jpeg(data) && helper.get_size(data.data(), data.size(), &width, &height))
+    {
+      jpegs.push_back(data);
+    }
+  }
+}
+
+// decoding straight to gray - tjpgd only builds the Y channel so there's no chroma IDCT or colour conversion
+void test_jpeg_decode_benchmark(void)
+{
+  std::vector<std::vector<uint8_t>> jpegs;
+  find_jpegs("data/pg43-images.epub", jpegs);
+  find_jpegs("data/pg14838-images.epub", jpegs);
+  TEST_ASSERT_TRUE(jpegs.size() > 10);
+
+  JPEGHelper helper;
+  // a full page on the Paper S3 - covers are drawn at this size and most illustrations close to it
+  FixedWidthTestRenderer renderer;
+  renderer.page_width = 540;
+  renderer.page_height = 960;
+  size_t max_pool_used = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (auto &jpeg : jpegs)
+  {
+    TEST_ASSERT_TRUE(helper.render(jpeg.data(), jpeg.size(), &renderer, 0, 0, 540, 960));
+    max_pool_used = std::max(max_pool_used, helper.get_pool_used());
+  }
+  // the stream buffer, tables and one MCU - well inside the pool JPEGHelper allocates
+  TEST_ASSERT_TRUE(max_pool_used <= 4096);
+  long long decode_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+  printf("%d JPEGs decoded in %lldus, at most %u bytes of tjpgd pool used\n", (int)jpegs.size(), decode_us,
+         (unsigned)max_pool_used);
+}
+
+// keeps the pixels and where anything was drawn
+class ClipTestRenderer : public FixedWidthTestRenderer
+{
+public:
+  std::vector<uint8_t> pixels;
+  int min_x = INT32_MAX;
+  int min_y = INT32_MAX;
+  int max_x = -1;
+  int max_y = -1;
+  ClipTestRenderer()
+  {
+    page_width = 540;
+    page_height = 960;
+    pixels.assign(page_width * page_height, 255);
+  }
+  virtual void draw_pixel(int x, int y, uint8_t color)
+  {
+    min_x = std::min(min_x, x);
+    min_y = std::min(min_y, y);
+    max_x = std::max(max_x, x);
+    max_y = std::max(max_y, y);
+    if (x >= 0 && x < page_width && y >= 0 && y < page_height)
+    {
+      pixels[y * page_width + x] = color;
+    }
+  }
+};
+
+// the average of each 8x8 block inside the rectangle - dithering from a different starting row
+// moves individual pixels around but not the averages
+static void assert_same_blocks(const ClipTestRenderer &expected, const ClipTestRenderer &actual, int x, int y, int width, int height)
+{
+  for (int block_y = y; block_y + 8 <= y + height; block_y += 8)
+  {
+    for (int block_x = x; block_x + 8 <= x + width; block_x += 8)
+    {
+      int expected_sum = 0;
+      int actual_sum = 0;
+      for (int dy = 0; dy < 8; dy++)
+      {
+        for (int dx = 0; dx < 8; dx++)
+        {
+          expected_sum += expected.pixels[(block_y + dy) * expected.page_width + block_x + dx];
+          actual_sum += actual.pixels[(block_y + dy) * actual.page_width + block_x + dx];
+        }
+      }
+      TEST_ASSERT_INT_WITHIN(12, expected_sum / 64, actual_sum / 64);
+    }
+  }
+}
+
+// a tall image across a page boundary only decodes the band that's on the page
+void test_jpeg_decode_clipped(void)
+{
+  Epub epub("data/pg43-images.epub");
+  TEST_ASSERT_TRUE(epub.load());
+  std::vector<uint8_t> cover = epub.get_item_contents_as_vector(epub.get_cover_image_item());
+  TEST_ASSERT_TRUE(is_jpeg(cover));
+  JPEGHelper helper;
+  const int RUNS = 5;
+
+  ClipTestRenderer full;
+  auto start = std::chrono::steady_clock::now();
+  for (int run = 0; run < RUNS; run++)
+  {
+    TEST_ASSERT_TRUE(helper.render(cover.data(), cover.size(), &full, 0, 0, 540, 960));
+  }
+  long long full_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+  TEST_ASSERT_EQUAL(0, full.min_y);
+
+  // a band in the middle
+  ClipTestRenderer band;
+  start = std::chrono::steady_clock::now();
+  for (int run = 0; run < RUNS; run++)
+  {
+    TEST_ASSERT_TRUE(helper.render_clipped(cover.data(), cover.size(), &band, 0, 0, 540, 960, 100, 300, 200, 160));
+  }
+  long long band_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+  TEST_ASSERT_EQUAL(100, band.min_x);
+  TEST_ASSERT_EQUAL(299, band.max_x);
+  TEST_ASSERT_EQUAL(300, band.min_y);
+  TEST_ASSERT_EQUAL(459, band.max_y);
+  assert_same_blocks(full, band, 100, 300, 200, 160);
+
+  // the bottom of an image that started on the previous page
+  ClipTestRenderer bottom;
+  TEST_ASSERT_TRUE(helper.render(cover.data(), cover.size(), &bottom, 0, -400, 540, 960));
+  TEST_ASSERT_EQUAL(0, bottom.min_y);
+  TEST_ASSERT_EQUAL(full.max_y - 400, bottom.max_y);
+  ClipTestRenderer shifted;
+  memcpy(shifted.pixels.data(), full.pixels.data() + 400 * full.page_width, (full.page_height - 400) * full.page_width);
+  // leaving out the first few rows where the dithering is still settling
+  assert_same_blocks(shifted, bottom, 0, 8, full.max_x + 1, full.max_y - 400 - 8);
+
+  printf("cover %d bytes: full page %lldus, 200x160 band %lldus\n", (int)cover.size(), full_us / RUNS, band_us / RUNS);
+}
@@ -0,0 +1,97 @@
+#include <unity.h>
+#include <string>
+#include <chrono>
+#include <stdio.h>
+#include <RubbishHtmlParser/RubbishHtmlParser.h>
+#include "test_renderer.h"
+
+static const char *CACHE_PATH = "test_layout_cache.lay";
+
+static std::string make_chapter(int paragraphs)
+{
+  std::string html = "<html><body><h1>Cached chapter</h1>";
+  for (int i = 0; i < paragraphs; i++)
+  {
+    html += "<p style=\"text-align: center\">Paragraph " + std::to_string(i) + " with <b>bold</b> and <i>italic</i> words";
+    for (int j = 0; j < i % 5; j++)
+    {
+      html += " that go on long enough to wrap &amp; wrap again";
+    }
+    html += "</p><p>Another one</p>";
+  }
+  html += "</body></html>";
+  return html;
+}
+
+// a section loaded from the cache renders exactly the same pages as the one we parsed and laid out
+void test_layout_cache_round_trip(void)
+{
+  std::string html = make_chapter(200);
+  RecordingTestRenderer renderer;
+  renderer.page_height = 20;
+
+  auto start = std::chrono::steady_clock::now();
+  RubbishHtmlParser parsed(html.c_str(), html.size(), "", true);
+  parsed.layout(&renderer, nullptr);
+  auto parse_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+  TEST_ASSERT_TRUE(parsed.get_page_count() > 10);
+  TEST_ASSERT_TRUE(parsed.save_layout(CACHE_PATH, 1234));
+
+  start = std::chrono::steady_clock::now();
+  RubbishHtmlParser cached("", true);
+  TEST_ASSERT_TRUE(cached.load_layout(CACHE_PATH, 1234));
+  auto load_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+  printf("layout cache: parse and layout %lldus, load from cache %lldus\n", (long long)parse_us, (long long)load_us);
+
+  TEST_ASSERT_TRUE(cached.is_layout_complete());
+  TEST_ASSERT_EQUAL(parsed.get_page_count(), cached.get_page_count());
+  TEST_ASSERT_EQUAL(parsed.get_blocks().size(), cached.get_blocks().size());
+  // laying out a cached section is a no-op
+  cached.layout(&renderer, nullptr);
+  TEST_ASSERT_EQUAL(parsed.get_page_count(), cached.get_page_count());
+  TEST_ASSERT_TRUE(render_all_pages(parsed, renderer) == render_all_pages(cached, renderer));
+  remove(CACHE_PATH);
+}
+
+void test_layout_cache_rejects_stale_and_corrupt(void)
+{
+  std::string html = make_chapter(20);
+  FixedWidthTestRenderer renderer;
+  renderer.page_height = 10;
+  RubbishHtmlParser parsed(html.c_str(), html.size(), "", false);
+  // only complete layouts can be saved
+  parsed.layout_to_page(&renderer, nullptr, 0);
+  TEST_ASSERT_FALSE(parsed.is_layout_complete());
+  TEST_ASSERT_FALSE(parsed.save_layout(CACHE_PATH, 1));
+  parsed.layout(&renderer, nullptr);
+  TEST_ASSERT_TRUE(parsed.save_layout(CACHE_PATH, 1));
+
+  // a different key (e.g. the font size changed) is a miss
+  RubbishHtmlParser stale("", false);
+  TEST_ASSERT_FALSE(stale.load_layout(CACHE_PATH, 2));
+  TEST_ASSERT_FALSE(stale.is_layout_complete());
+  TEST_ASSERT_EQUAL(1, stale.get_blocks().size());
+
+  // a truncated file is rejected and leaves the parser usable
+  FILE *fp = fopen(CACHE_PATH, "rb");
+  TEST_ASSERT_NOT_NULL(fp);
+  fseek(fp, 0, SEEK_END);
+  long size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  std::string contents(size, '\0');
+  TEST_ASSERT_EQUAL(1, fread(&contents[0], size, 1, fp));
+  fclose(fp);
+  fp = fopen(CACHE_PATH, "wb");
+  fwrite(contents.data(), size / 2, 1, fp);
+  fclose(fp);
+  RubbishHtmlParser truncated("", false);
+  TEST_ASSERT_FALSE(truncated.load_layout(CACHE_PATH, 1));
+  truncated.parse(html.c_str(), html.size());
+  truncated.layout(&renderer, nullptr);
+  TEST_ASSERT_EQUAL(parsed.get_page_count(), truncated.get_page_count());
+
+  // and a missing file is just a miss
+  remove(CACHE_PATH);
+  RubbishHtmlParser missing("", false);
+  TEST_ASSERT_FALSE(missing.load_layout(CACHE_PATH, 1));
+}
@@ -0,0 +1,202 @@
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <EpubList/EpubCatalog.h>
+#include <EpubList/LibraryScanner.h>
+
+static const char *SCAN_LIBRARY_PATH = "test_scan_library";
+static const char *SCAN_CATALOG_PATH = "test_scan_library/BOOKS.CAT";
+
+static std::string scan_book_path(int number)
+{
+  char path[64];
+  snprintf(path, sizeof(path), "%s/book%04d.epub", SCAN_LIBRARY_PATH, number);
+  return path;
+}
+
+static void write_scan_book(int number)
+{
+  FILE *fp = fopen(scan_book_path(number).c_str(), "wb");
+  TEST_ASSERT_NOT_NULL(fp);
+  fprintf(fp, "book %d", number);
+  fclose(fp);
+}
+
+// opens books until it gets to block_at and then waits to be let go
+struct GatedLoader
+{
+  std::mutex mutex;
+  std::condition_variable changed;
+  int loaded = 0;
+  int block_at = -1;
+  LibraryScanner *scanner = nullptr;
+  std::atomic<int> thumbnails{0};
+  // thumbnails made for books the scanner didn't say were pending
+  std::atomic<int> thumbnails_not_pending{0};
+
+  bool load(const std::string &path, EpubListItem &item)
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this]
+                 { return loaded != block_at; });
+    loaded++;
+    changed.notify_all();
+    item = {};
+    strncpy(item.path, path.c_str(), MAX_PATH_SIZE - 1);
+    // title order is the reverse of the file names
+    int number = atoi(path.c_str() + path.size() - 9);
+    snprintf(item.title, sizeof(item.title), "Title %04d", 9999 - number);
+    strcpy(item.cover_path, "cover.jpg");
+    return true;
+  }
+  void release()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    block_at = -1;
+    changed.notify_all();
+  }
+  bool wait_for_blocked(int count)
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    return changed.wait_for(lock, std::chrono::seconds(10), [&]
+                            { return loaded == count; });
+  }
+};
+
+// the loader has to be blocked - covers aren't made until every book has been opened
+static LibraryScanner *start_scanner(GatedLoader &loader, const EpubListItem *first_book = nullptr)
+{
+  loader.scanner = new LibraryScanner(
+      SCAN_CATALOG_PATH, SCAN_LIBRARY_PATH, nullptr,
+      [&loader](Renderer *, const std::string &path, EpubListItem &item)
+      { return loader.load(path, item); },
+      [&loader](Renderer *, const EpubListItem &item)
+      {
+        if (!loader.scanner->is_cover_pending(item.path))
+        {
+          loader.thumbnails_not_pending++;
+        }
+        loader.thumbnails++;
+      },
+      first_book);
+  return loader.scanner;
+}
+
+// books show up as they are found and the catalog is only replaced once they've all been opened
+void test_library_scanner_progressive(void)
+{
+  const int BOOKS = 20;
+  mkdir(SCAN_LIBRARY_PATH, 0777);
+  for (int i = 0; i < BOOKS; i++)
+  {
+    write_scan_book(i);
+  }
+  GatedLoader loader;
+  loader.block_at = 5;
+  LibraryScanner *scanner = start_scanner(loader);
+  TEST_ASSERT_TRUE(loader.wait_for_blocked(5));
+  // the last one opened is published just after the loader returns
+  for (int tries = 0; tries < 1000 && scanner->get_book_count() < 5; tries++)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  LibraryScanUpdate update = scanner->take_update();
+  TEST_ASSERT_EQUAL(5, update.books);
+  TEST_ASSERT_FALSE(update.catalog_ready);
+  TEST_ASSERT_FALSE(update.finished);
+  std::vector<EpubListItem> page;
+  TEST_ASSERT_EQUAL(5, scanner->read_page(0, 10, page));
+  // in the order they were found (the order of the folder) with the covers still to come
+  TEST_ASSERT_EQUAL(0, strncmp(page[0].path, SCAN_LIBRARY_PATH, strlen(SCAN_LIBRARY_PATH)));
+  TEST_ASSERT_TRUE(scanner->is_cover_pending(page[0].path));
+  TEST_ASSERT_FALSE(access(SCAN_CATALOG_PATH, F_OK) == 0);
+
+  loader.release();
+  scanner->wait_until_finished();
+  update = scanner->take_update();
+  TEST_ASSERT_TRUE(update.catalog_ready);
+  TEST_ASSERT_TRUE(update.catalog_ok);
+  TEST_ASSERT_TRUE(update.finished);
+  TEST_ASSERT_EQUAL(BOOKS, update.covers_ready.size());
+  TEST_ASSERT_EQUAL(BOOKS, loader.thumbnails);
+  TEST_ASSERT_EQUAL(0, loader.thumbnails_not_pending);
+  TEST_ASSERT_FALSE(scanner->is_cover_pending(page[0].path));
+  delete scanner;
+
+  // the catalog is in title order
+  EpubCatalog catalog;
+  catalog.set_path(SCAN_CATALOG_PATH);
+  TEST_ASSERT_TRUE(catalog.open());
+  TEST_ASSERT_EQUAL(BOOKS, catalog.get_count());
+  TEST_ASSERT_TRUE(catalog.is_up_to_date(SCAN_LIBRARY_PATH));
+  EpubListItem book;
+  TEST_ASSERT_TRUE(catalog.read(0, book));
+  TEST_ASSERT_EQUAL_STRING(scan_book_path(BOOKS - 1).c_str(), book.path);
+  TEST_ASSERT_EQUAL(0, catalog.find(book.path));
+  TEST_ASSERT_EQUAL(BOOKS - 1, catalog.find(scan_book_path(0).c_str()));
+}
+
+// the last book read is there straight away and stopping part way through keeps the old catalog
+void test_library_scanner_stop(void)
+{
+  const int BOOKS = 20;
+  EpubListItem last_book;
+  {
+    EpubCatalog catalog;
+    catalog.set_path(SCAN_CATALOG_PATH);
+    TEST_ASSERT_TRUE(catalog.open());
+    TEST_ASSERT_TRUE(catalog.read(3, last_book));
+  }
+  for (int i = BOOKS; i < BOOKS + 5; i++)
+  {
+    write_scan_book(i);
+  }
+
+  GatedLoader loader;
+  loader.block_at = 1;
+  LibraryScanner *scanner = start_scanner(loader, &last_book);
+  EpubListItem book;
+  // the books that haven't changed may already be following it
+  TEST_ASSERT_TRUE(scanner->get_book_count() >= 1);
+  TEST_ASSERT_TRUE(scanner->read(0, book));
+  TEST_ASSERT_EQUAL_STRING(last_book.path, book.path);
+  // reading it while the scan goes on
+  book.current_page = 12;
+  scanner->set_position(book);
+  TEST_ASSERT_TRUE(scanner->read(0, book));
+  TEST_ASSERT_EQUAL(12, book.current_page);
+
+  TEST_ASSERT_TRUE(loader.wait_for_blocked(1));
+  scanner->stop();
+  loader.release();
+  scanner->wait_until_finished();
+  LibraryScanUpdate update = scanner->take_update();
+  TEST_ASSERT_TRUE(update.catalog_ready);
+  TEST_ASSERT_FALSE(update.catalog_ok);
+  TEST_ASSERT_TRUE(update.finished);
+  TEST_ASSERT_EQUAL(0, loader.thumbnails);
+  delete scanner;
+
+  {
+    EpubCatalog catalog;
+    catalog.set_path(SCAN_CATALOG_PATH);
+    TEST_ASSERT_TRUE(catalog.open());
+    TEST_ASSERT_EQUAL(BOOKS, catalog.get_count());
+    TEST_ASSERT_FALSE(catalog.is_up_to_date(SCAN_LIBRARY_PATH));
+  }
+
+  for (int i = 0; i < BOOKS + 5; i++)
+  {
+    remove(scan_book_path(i).c_str());
+  }
+  remove(SCAN_CATALOG_PATH);
+  rmdir(SCAN_LIBRARY_PATH);
+}
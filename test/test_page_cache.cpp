@@ -0,0 +1,145 @@
+#include <unity.h>
+#include <string.h>
+#include <string>
+#include <EpubList/EpubReader.h>
+#include <Renderer/PageCache.h>
+#include "test_renderer.h"
+
+void test_page_cache_lru(void)
+{
+  PageCache cache(16, 2);
+  uint64_t a = PageCache::make_key(1, 0);
+  uint64_t b = PageCache::make_key(1, 1);
+  uint64_t c = PageCache::make_key(2, 0);
+  TEST_ASSERT_TRUE(a != b && a != c);
+  TEST_ASSERT_NULL(cache.find(a));
+
+  CachedPage *page = cache.insert(a);
+  TEST_ASSERT_NOT_NULL(page);
+  memset(page->buffer, 1, 16);
+  page->has_gray = true;
+  page = cache.insert(b);
+  memset(page->buffer, 2, 16);
+  uint8_t *b_buffer = page->buffer;
+
+  // touch a so b is the one that gets recycled
+  TEST_ASSERT_TRUE(cache.find(a)->has_gray);
+  page = cache.insert(c);
+  TEST_ASSERT_TRUE(page->buffer == b_buffer);
+  TEST_ASSERT_FALSE(page->has_gray);
+  TEST_ASSERT_EQUAL(2, cache.get_count());
+  TEST_ASSERT_FALSE(cache.contains(b));
+  TEST_ASSERT_EQUAL(1, cache.find(a)->buffer[15]);
+  TEST_ASSERT_EQUAL(2, cache.get_hits());
+  TEST_ASSERT_EQUAL(1, cache.get_misses());
+
+  cache.remove(a);
+  TEST_ASSERT_FALSE(cache.contains(a));
+  cache.clear();
+  TEST_ASSERT_EQUAL(0, cache.get_count());
+
+  // no room at all
+  PageCache empty(16, 0);
+  TEST_ASSERT_NULL(empty.insert(a));
+}
+
+// keeps the "framebuffer" as the text it has drawn so pages can be copied around
+class PageBufferTestRenderer : public RecordingTestRenderer
+{
+public:
+  static const size_t PAGE_BUFFER_SIZE = 16 * 1024;
+  uint8_t *offscreen = nullptr;
+  std::string offscreen_drawn;
+  int clears = 0;
+  int restores = 0;
+
+  // every page starts with a clear - the ones that weren't copied from the page cache were drawn
+  int pages_rasterized() { return clears - restores; }
+  std::string &target() { return offscreen ? offscreen_drawn : drawn; }
+  virtual void draw_text(int x, int y, const char *text, bool bold = false, bool italic = false)
+  {
+    target() += std::to_string(x) + "," + std::to_string(y) + ":" + text + " ";
+  }
+  virtual void clear_screen()
+  {
+    target().clear();
+    clears++;
+  }
+  virtual size_t get_page_buffer_size() { return PAGE_BUFFER_SIZE; }
+  virtual bool begin_offscreen(uint8_t *buffer)
+  {
+    offscreen = buffer;
+    offscreen_drawn.clear();
+    return true;
+  }
+  virtual bool end_offscreen()
+  {
+    strncpy((char *)offscreen, offscreen_drawn.c_str(), PAGE_BUFFER_SIZE - 1);
+    offscreen[PAGE_BUFFER_SIZE - 1] = 0;
+    offscreen = nullptr;
+    return false;
+  }
+  virtual void save_page(uint8_t *buffer)
+  {
+    strncpy((char *)buffer, drawn.c_str(), PAGE_BUFFER_SIZE - 1);
+    buffer[PAGE_BUFFER_SIZE - 1] = 0;
+  }
+  virtual void restore_page(const uint8_t *buffer, bool has_gray)
+  {
+    drawn = (const char *)buffer;
+    restores++;
+  }
+};
+
+void test_page_cache_prerendered_page_turns(void)
+{
+  EpubListItem state = {};
+  strcpy(state.path, BOOK_PATH);
+  PageBufferTestRenderer renderer;
+  renderer.page_height = 40;
+  EpubReader reader(state, &renderer);
+  reader.set_layout_cache_dir(NO_CACHE_DIR);
+  reader.set_page_cache_pages(3);
+  TEST_ASSERT_TRUE(reader.load());
+  // section 2 is 6 pages at this height
+  reader.set_state_section(2);
+  reader.render();
+  TEST_ASSERT_EQUAL(1, renderer.pages_rasterized());
+
+  // draw the next page while we're idle - once
+  TEST_ASSERT_TRUE(reader.has_pending_prerender());
+  TEST_ASSERT_TRUE(reader.prerender_next_page());
+  TEST_ASSERT_FALSE(reader.has_pending_prerender());
+  TEST_ASSERT_FALSE(reader.prerender_next_page());
+  TEST_ASSERT_EQUAL(2, renderer.pages_rasterized());
+  // drawing off screen doesn't touch the screen
+  TEST_ASSERT_TRUE(render_fresh(2, 0) == renderer.drawn);
+  TEST_ASSERT_TRUE(render_fresh(2, 0) != render_fresh(2, 1));
+
+  // turning the page is just a copy
+  reader.next();
+  reader.render();
+  TEST_ASSERT_EQUAL(2, renderer.pages_rasterized());
+  TEST_ASSERT_TRUE(render_fresh(2, 1) == renderer.drawn);
+
+  // and so is going back
+  reader.prev();
+  reader.render();
+  TEST_ASSERT_EQUAL(2, renderer.pages_rasterized());
+  TEST_ASSERT_TRUE(render_fresh(2, 0) == renderer.drawn);
+  TEST_ASSERT_EQUAL(2, reader.get_page_cache()->get_hits());
+
+  // a page that isn't cached is drawn as normal and kept for next time
+  reader.next();
+  reader.next();
+  reader.render();
+  TEST_ASSERT_EQUAL(3, renderer.pages_rasterized());
+  TEST_ASSERT_TRUE(render_fresh(2, 2) == renderer.drawn);
+  TEST_ASSERT_EQUAL(3, reader.get_page_cache()->get_count());
+
+  // changing the layout throws the cached pages away
+  renderer.page_height = 30;
+  reader.render();
+  TEST_ASSERT_EQUAL(4, renderer.pages_rasterized());
+  TEST_ASSERT_EQUAL(1, reader.get_page_cache()->get_count());
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <string.h>
+#include <string>
+#include <Renderer/Renderer.h>
+#include <RubbishHtmlParser/RubbishHtmlParser.h>
+#include <EpubList/EpubReader.h>
+
+// every character is one pixel wide so line breaks tell us exactly which words ended up in a block
+class FixedWidthTestRenderer : public Renderer
+{
+public:
+  int page_width = 60;
+  int page_height = 100;
+  virtual void draw_pixel(int x, int y, uint8_t color) {}
+  virtual int get_text_width(const char *text, bool bold = false, bool italic = false) { return strlen(text); }
+  virtual void draw_text(int x, int y, const char *text, bool bold = false, bool italic = false) {}
+  virtual void draw_rect(int x, int y, int width, int height, uint8_t color = 0) {}
+  virtual void draw_triangle(int x0, int y0, int x1, int y1, int x2, int y2, uint8_t color) {}
+  virtual void draw_circle(int x, int y, int r, uint8_t color = 0) {}
+  virtual void fill_triangle(int x0, int y0, int x1, int y1, int x2, int y2, uint8_t color) {}
+  virtual void fill_rect(int x, int y, int width, int height, uint8_t color = 0) {}
+  virtual void fill_circle(int x, int y, int r, uint8_t color = 0) {}
+  virtual void needs_gray(uint8_t color) {}
+  virtual bool has_gray() { return false; }
+  virtual void show_busy() {}
+  virtual void show_img(int x, int y, int width, int height, const uint8_t *img_buffer) {}
+  virtual void clear_screen() {}
+  virtual int get_page_width() { return page_width; }
+  virtual int get_page_height() { return page_height; }
+  virtual int get_space_width() { return 1; }
+  virtual int get_line_height() { return 1; }
+};
+
+// records everything drawn so we can compare what ends up on each page
+class RecordingTestRenderer : public FixedWidthTestRenderer
+{
+public:
+  std::string drawn;
+  virtual void draw_text(int x, int y, const char *text, bool bold = false, bool italic = false)
+  {
+    drawn += std::to_string(x) + "," + std::to_string(y) + ":" + text + " ";
+  }
+};
+
+// everything drawn on each page of a laid out section, one [page] after another
+inline std::string render_all_pages(RubbishHtmlParser &parser, RecordingTestRenderer &renderer)
+{
+  std::string pages;
+  for (int i = 0; i < parser.get_page_count(); i++)
+  {
+    renderer.drawn.clear();
+    parser.render_page(i, &renderer, nullptr);
+    pages += "[" + renderer.drawn + "]";
+  }
+  return pages;
+}
+
+// the book the reader tests page through
+static const char *const BOOK_PATH = "data/pg43-images.epub";
+// a directory inside a file can't be made so the layout cache is never written and every section is parsed and laid out
+static const char *const NO_CACHE_DIR = "data/pg43-images.epub/layout";
+
+// what a reader that has never seen the book draws for a page of a section (page < 0 for its last page)
+inline std::string render_fresh(int section, int page)
+{
+  EpubListItem state = {};
+  strcpy(state.path, BOOK_PATH);
+  RecordingTestRenderer renderer;
+  renderer.page_height = 40;
+  EpubReader reader(state, &renderer);
+  reader.set_layout_cache_dir(NO_CACHE_DIR);
+  reader.load();
+  reader.set_state_section(section);
+  state.current_page = page < 0 ? 0 : page;
+  reader.render();
+  if (page < 0)
+  {
+    while (reader.layout_in_background())
+    {
+    }
+    state.current_page = state.pages_in_current_section - 1;
+    renderer.drawn.clear();
+    reader.render();
+  }
+  return renderer.drawn;
+}
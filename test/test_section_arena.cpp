@@ -0,0 +1,195 @@
+#include <unity.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <EpubList/Epub.h>
+#include <RubbishHtmlParser/RubbishHtmlParser.h>
+#include <RubbishHtmlParser/SectionArena.h>
+#include <RubbishHtmlParser/Page.h>
+#include "test_renderer.h"
+
+void test_section_arena_allocations(void)
+{
+  SectionArena arena;
+  TEST_ASSERT_EQUAL(0, arena.get_chunk_count());
+  char *text = arena.copy_string("hello world", 5);
+  TEST_ASSERT_EQUAL_STRING("hello", text);
+  uint64_t *number = arena.create<uint64_t>(42);
+  TEST_ASSERT_EQUAL(0, (uintptr_t)number % alignof(uint64_t));
+  TEST_ASSERT_EQUAL(42, *number);
+  TEST_ASSERT_EQUAL(1, arena.get_chunk_count());
+  // a big allocation gets its own chunk and we carry on filling the first one
+  uint8_t *big = (uint8_t *)arena.allocate(64 * 1024);
+  memset(big, 0xff, 64 * 1024);
+  TEST_ASSERT_EQUAL(2, arena.get_chunk_count());
+  uint64_t *next = arena.create<uint64_t>(7);
+  TEST_ASSERT_TRUE(next == number + 1);
+  TEST_ASSERT_EQUAL(2, arena.get_chunk_count());
+  TEST_ASSERT_EQUAL(4, arena.get_allocation_count());
+  TEST_ASSERT_TRUE(arena.get_bytes_used() >= 64 * 1024 + 6 + 2 * sizeof(uint64_t));
+  TEST_ASSERT_TRUE(arena.get_bytes_reserved() >= arena.get_bytes_used());
+  // lots of small allocations only take a few chunks from the heap
+  ArenaVector<uint16_t> values(&arena);
+  for (int i = 0; i < 10000; i++)
+  {
+    values.push_back(i);
+  }
+  TEST_ASSERT_EQUAL(9999, values.back());
+  TEST_ASSERT_TRUE(arena.get_chunk_count() < 10);
+  arena.clear();
+  TEST_ASSERT_EQUAL(0, arena.get_chunk_count());
+  TEST_ASSERT_EQUAL(0, arena.get_bytes_used());
+  TEST_ASSERT_EQUAL(0, arena.get_bytes_reserved());
+  TEST_ASSERT_EQUAL(0, arena.get_allocation_count());
+
+  // a parsed section keeps everything in its arena
+  const char *html = "<html><body><p>Some <b>bold</b> words</p><img src=\"a.png\"/><p>More words</p></body></html>";
+  RubbishHtmlParser parser(html, strlen(html), "OEBPS/", false);
+  TEST_ASSERT_EQUAL(3, parser.get_blocks().size());
+  TEST_ASSERT_TRUE(parser.get_arena().get_allocation_count() > 10);
+  TEST_ASSERT_EQUAL(1, parser.get_arena().get_chunk_count());
+}
+
+static long long elapsed_us(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+struct SectionTimes
+{
+  long long build_us = 0;
+  long long layout_us = 0;
+  long long destroy_us = 0;
+};
+
+// the same paragraphs made into blocks and pages one new at a time (arena == nullptr) or in an arena
+static SectionTimes build_section(const std::vector<std::string> &paragraphs, SectionArena *arena, Renderer *renderer)
+{
+  SectionTimes times;
+  auto start = std::chrono::steady_clock::now();
+  std::vector<TextBlock *> blocks;
+  for (const std::string &paragraph : paragraphs)
+  {
+    TextBlock *block = arena ? arena->create<TextBlock>(JUSTIFIED, arena) : new TextBlock(JUSTIFIED);
+    block->add_span(paragraph.c_str(), false, false);
+    block->add_span("and an italic ending", false, true);
+    blocks.push_back(block);
+  }
+  times.build_us = elapsed_us(start);
+
+  start = std::chrono::steady_clock::now();
+  std::vector<Page *> pages;
+  int y = renderer->get_page_height();
+  for (TextBlock *block : blocks)
+  {
+    block->layout(renderer, nullptr);
+    for (int line = 0; line < static_cast<int>(block->line_breaks.size()); line++)
+    {
+      if (y + renderer->get_line_height() > renderer->get_page_height())
+      {
+        pages.push_back(arena ? arena->create<Page>(arena) : new Page(nullptr));
+        y = 0;
+      }
+      pages.back()->elements.push_back(arena ? arena->create<PageLine>(block, line, y) : new PageLine(block, line, y));
+      y += renderer->get_line_height();
+    }
+  }
+  times.layout_us = elapsed_us(start);
+
+  start = std::chrono::steady_clock::now();
+  if (arena)
+  {
+    arena->clear();
+  }
+  else
+  {
+    for (Page *page : pages)
+    {
+      for (PageElement *element : page->elements)
+      {
+        delete element;
+      }
+      delete page;
+    }
+    for (TextBlock *block : blocks)
+    {
+      delete block;
+    }
+  }
+  times.destroy_us = elapsed_us(start);
+  return times;
+}
+
+// parse, layout and destroy times with every block, word table and page element on the heap and in an arena
+void test_section_arena_benchmark(void)
+{
+  FixedWidthTestRenderer renderer;
+  renderer.page_height = 40;
+  std::vector<std::string> paragraphs;
+  for (int i = 0; i < 2000; i++)
+  {
+    std::string paragraph = "Paragraph " + std::to_string(i) + " has some words in it";
+    for (int j = 0; j < i % 7; j++)
+    {
+      paragraph += " and a few more words to make it wrap";
+    }
+    paragraphs.push_back(paragraph);
+  }
+  const int RUNS = 5;
+  SectionTimes heap;
+  SectionTimes arena;
+  for (int run = 0; run < RUNS; run++)
+  {
+    SectionTimes times = build_section(paragraphs, nullptr, &renderer);
+    heap.build_us += times.build_us;
+    heap.layout_us += times.layout_us;
+    heap.destroy_us += times.destroy_us;
+    SectionArena section_arena;
+    times = build_section(paragraphs, &section_arena, &renderer);
+    arena.build_us += times.build_us;
+    arena.layout_us += times.layout_us;
+    arena.destroy_us += times.destroy_us;
+  }
+  printf("section heap:  build %lldus, layout %lldus, destroy %lldus\n", heap.build_us / RUNS, heap.layout_us / RUNS, heap.destroy_us / RUNS);
+  printf("section arena: build %lldus, layout %lldus, destroy %lldus\n", arena.build_us / RUNS, arena.layout_us / RUNS, arena.destroy_us / RUNS);
+
+  // and the real thing - every section of a book parsed, laid out and dropped
+  Epub epub("data/pg14838-images.epub");
+  TEST_ASSERT_TRUE(epub.load());
+  long long parse_us = 0;
+  long long layout_us = 0;
+  long long destroy_us = 0;
+  size_t bytes_used = 0;
+  size_t bytes_reserved = 0;
+  size_t allocations = 0;
+  size_t chunks = 0;
+  for (int i = 0; i < epub.get_spine_items_count(); i++)
+  {
+    const std::string &item = epub.get_spine_item(i);
+    size_t size = 0;
+    char *html = (char *)epub.get_item_contents(item, &size);
+    TEST_ASSERT_NOT_NULL(html);
+    auto start = std::chrono::steady_clock::now();
+    RubbishHtmlParser *parser = new RubbishHtmlParser(html, size, item.substr(0, item.find_last_of('/') + 1), false);
+    parse_us += elapsed_us(start);
+    free(html);
+    start = std::chrono::steady_clock::now();
+    parser->layout(&renderer, &epub);
+    layout_us += elapsed_us(start);
+    TEST_ASSERT_TRUE(parser->is_layout_complete());
+    bytes_used += parser->get_arena().get_bytes_used();
+    bytes_reserved += parser->get_arena().get_bytes_reserved();
+    allocations += parser->get_arena().get_allocation_count();
+    chunks += parser->get_arena().get_chunk_count();
+    start = std::chrono::steady_clock::now();
+    delete parser;
+    destroy_us += elapsed_us(start);
+  }
+  TEST_ASSERT_TRUE(allocations > chunks * 10);
+  printf("pg14838 %d sections: parse %lldus, layout %lldus, destroy %lldus, %u allocations in %u chunks, %u of %u bytes used\n",
+         epub.get_spine_items_count(), parse_us, layout_us, destroy_us, (unsigned)allocations, (unsigned)chunks,
+         (unsigned)bytes_used, (unsigned)bytes_reserved);
+}
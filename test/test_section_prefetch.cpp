@@ -0,0 +1,135 @@
+#include <unity.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <stdio.h>
+#include <EpubList/Epub.h>
+#include <EpubList/EpubReader.h>
+#include <EpubList/SectionPrefetcher.h>
+#include <RubbishHtmlParser/RubbishHtmlParser.h>
+#include "test_renderer.h"
+
+// measures with a copy of itself so the reader can prefetch
+class PrefetchTestRenderer : public RecordingTestRenderer
+{
+public:
+  virtual Renderer *create_measuring_renderer()
+  {
+    FixedWidthTestRenderer *measurer = new FixedWidthTestRenderer();
+    measurer->page_width = page_width;
+    measurer->page_height = page_height;
+    return measurer;
+  }
+};
+
+// render every page up to the end of the current section and then turn onto the first page of the next one
+static void page_to_next_section(EpubReader &reader, EpubListItem &state)
+{
+  int section = state.current_section;
+  while (state.current_section == section)
+  {
+    reader.next();
+    if (state.current_section == section)
+    {
+      reader.render();
+    }
+  }
+}
+
+void test_section_prefetch_matches_foreground_layout(void)
+{
+  EpubListItem state = {};
+  strcpy(state.path, BOOK_PATH);
+  PrefetchTestRenderer renderer;
+  renderer.page_height = 40;
+  EpubReader reader(state, &renderer);
+  reader.set_layout_cache_dir(NO_CACHE_DIR);
+  TEST_ASSERT_TRUE(reader.load());
+  reader.set_state_section(1);
+  reader.render();
+  SectionPrefetcher *prefetcher = reader.get_prefetcher();
+  TEST_ASSERT_NOT_NULL(prefetcher);
+  prefetcher->wait_until_idle();
+  // the sections either side
+  TEST_ASSERT_EQUAL(2, prefetcher->get_completed());
+  TEST_ASSERT_FALSE(reader.has_background_work());
+
+  // page through to the start of the next section - it's ready and waiting
+  page_to_next_section(reader, state);
+  renderer.drawn.clear();
+  auto start = std::chrono::steady_clock::now();
+  reader.render();
+  auto prefetched_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+  TEST_ASSERT_EQUAL(1, prefetcher->get_hits());
+  TEST_ASSERT_TRUE(render_fresh(2, 0) == renderer.drawn);
+
+  // the same page turn without a prefetcher
+  EpubListItem plain_state = {};
+  strcpy(plain_state.path, BOOK_PATH);
+  RecordingTestRenderer plain_renderer;
+  plain_renderer.page_height = 40;
+  EpubReader plain_reader(plain_state, &plain_renderer);
+  plain_reader.set_layout_cache_dir(NO_CACHE_DIR);
+  plain_reader.load();
+  plain_reader.set_state_section(1);
+  plain_reader.render();
+  page_to_next_section(plain_reader, plain_state);
+  start = std::chrono::steady_clock::now();
+  plain_reader.render();
+  auto plain_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+  printf("section prefetch: turning onto the next section %lldus with prefetch, %lldus without\n",
+         (long long)prefetched_us, (long long)plain_us);
+
+  // going back gets the section we just left, on its last page
+  prefetcher->wait_until_idle();
+  reader.prev();
+  TEST_ASSERT_EQUAL(1, state.current_section);
+  TEST_ASSERT_EQUAL(2, prefetcher->get_hits());
+  renderer.drawn.clear();
+  reader.render();
+  TEST_ASSERT_TRUE(render_fresh(1, -1) == renderer.drawn);
+
+  // a TOC jump throws away everything prefetched for where we were
+  prefetcher->wait_until_idle();
+  reader.set_state_section(4);
+  renderer.drawn.clear();
+  reader.render();
+  TEST_ASSERT_EQUAL(2, prefetcher->get_hits());
+  TEST_ASSERT_TRUE(render_fresh(4, 0) == renderer.drawn);
+}
+
+void test_section_prefetch_cancel(void)
+{
+  Epub epub(BOOK_PATH);
+  TEST_ASSERT_TRUE(epub.load());
+  FixedWidthTestRenderer measurer;
+  measurer.page_height = 40;
+  SectionPrefetcher prefetcher(&epub, &measurer, false);
+  std::vector<PrefetchJob> jobs;
+  for (int section = 0; section < epub.get_spine_items_count(); section++)
+  {
+    jobs.push_back({section, (uint32_t)section, -1, std::string(NO_CACHE_DIR) + "/section.lay"});
+  }
+  prefetcher.prefetch(jobs);
+  prefetcher.cancel();
+  bool needs_saving = false;
+  for (auto &job : jobs)
+  {
+    TEST_ASSERT_NULL(prefetcher.take(job.section, job.layout_key, needs_saving));
+  }
+  TEST_ASSERT_EQUAL(0, prefetcher.get_hits());
+
+  // asking for a different set drops whatever isn't in it
+  prefetcher.prefetch({jobs[1], jobs[2]});
+  prefetcher.wait_until_idle();
+  prefetcher.prefetch({jobs[2]});
+  TEST_ASSERT_NULL(prefetcher.take(1, 1, needs_saving));
+  // a section laid out for different settings isn't any use
+  TEST_ASSERT_NULL(prefetcher.take(2, 3, needs_saving));
+  RubbishHtmlParser *parser = prefetcher.take(2, 2, needs_saving);
+  TEST_ASSERT_NOT_NULL(parser);
+  TEST_ASSERT_TRUE(needs_saving);
+  TEST_ASSERT_TRUE(parser->is_layout_complete());
+  delete parser;
+}
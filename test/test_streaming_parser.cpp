@@ -0,0 +1,115 @@
+#include <unity.h>
+#include <string.h>
+#include <stdlib.h>
+#include <iterator>
+#include <algorithm>
+#include <RubbishHtmlParser/blocks/Block.h>
+#include <RubbishHtmlParser/blocks/TextBlock.h>
+#include <RubbishHtmlParser/blocks/ImageBlock.h>
+#include <RubbishHtmlParser/RubbishHtmlParser.h>
+#include <Renderer/Renderer.h>
+#include <EpubList/Epub.h>
+#include <ZipFile/ZipFile.h>
+#include "test_renderer.h"
+
+static void assert_same_blocks(RubbishHtmlParser &expected, RubbishHtmlParser &actual, Renderer *renderer)
+{
+  TEST_ASSERT_EQUAL(expected.get_blocks().size(), actual.get_blocks().size());
+  auto expected_it = expected.get_blocks().begin();
+  auto actual_it = actual.get_blocks().begin();
+  for (; expected_it != expected.get_blocks().end(); ++expected_it, ++actual_it)
+  {
+    TEST_ASSERT_EQUAL((*expected_it)->getType(), (*actual_it)->getType());
+    if ((*expected_it)->getType() == BlockType::IMAGE_BLOCK)
+    {
+      TEST_ASSERT_EQUAL_STRING(((ImageBlock *)*expected_it)->m_src, ((ImageBlock *)*actual_it)->m_src);
+    }
+    else
+    {
+      TextBlock *expected_text = (TextBlock *)*expected_it;
+      TextBlock *actual_text = (TextBlock *)*actual_it;
+      expected_text->layout(renderer, nullptr);
+      actual_text->layout(renderer, nullptr);
+      TEST_ASSERT_EQUAL(expected_text->get_style(), actual_text->get_style());
+      TEST_ASSERT_EQUAL(expected_text->line_breaks.size(), actual_text->line_breaks.size());
+      for (size_t i = 0; i < expected_text->line_breaks.size(); i++)
+      {
+        TEST_ASSERT_EQUAL(expected_text->line_breaks[i], actual_text->line_breaks[i]);
+      }
+    }
+  }
+}
+
+// tags, comments, entities and attributes split at every possible point should parse the same as the whole document
+void test_streaming_parser_chunk_boundaries(void)
+{
+  const char *html =
+      "<?xml version=\"1.0\" encoding=\"utf-8\"?>"
+      "<!DOCTYPE html>"
+      "<html><head><title>Skipped</title><style>p { color: red; }</style></head>"
+      "<body>"
+      "<h1>A &amp; B</h1>"
+      "<!-- a comment with a > in it -->"
+      "<p style=\"text-align: center\">Centered <b>bold</b> and <i>italic</i> text</p>"
+      "<p title='a > b'>Quoted attributes &copy; &#x23;</p>"
+      "<table><tr><td>skipped</td></tr><table><tr><td>nested</td></tr></table></table>"
+      "<img src=\"images/a.png\"/>"
+      "<p><![CDATA[cdata text]]>after</p>"
+      "<div>line<br/>break</div>"
+      "</body></html>";
+  FixedWidthTestRenderer renderer;
+  RubbishHtmlParser whole(html, strlen(html), "OEBPS/", false);
+  TEST_ASSERT_EQUAL(7, whole.get_blocks().size());
+  auto image = whole.get_blocks().begin();
+  std::advance(image, 3);
+  TEST_ASSERT_EQUAL(BlockType::IMAGE_BLOCK, (*image)->getType());
+  TEST_ASSERT_EQUAL_STRING("OEBPS/images/a.png", ((ImageBlock *)*image)->m_src);
+  for (size_t chunk_size = 1; chunk_size < 16; chunk_size++)
+  {
+    // layout can only be run once per block so compare against a fresh copy each time
+    RubbishHtmlParser expected(html, strlen(html), "OEBPS/", false);
+    RubbishHtmlParser streamed("OEBPS/", false);
+    size_t length = strlen(html);
+    for (size_t offset = 0; offset < length; offset += chunk_size)
+    {
+      streamed.feed(html + offset, std::min(chunk_size, length - offset));
+    }
+    streamed.finish();
+    assert_same_blocks(expected, streamed, &renderer);
+  }
+}
+
+// parse every chapter of a real book straight out of the zip inflater and compare with the in memory path
+void test_streaming_parser_epub(void)
+{
+  FixedWidthTestRenderer renderer;
+  Epub *epub = new Epub("fixtures/oebps.epub");
+  TEST_ASSERT_TRUE(epub->load());
+  for (int i = 0; i < epub->get_spine_items_count(); i++)
+  {
+    const std::string &item = epub->get_spine_item(i);
+    size_t size = 0;
+    char *html = (char *)epub->get_item_contents(item, &size);
+    TEST_ASSERT_NOT_NULL(html);
+    RubbishHtmlParser whole(html, size, "", false);
+    free(html);
+
+    ZipFileStream *stream = epub->open_item_stream(item);
+    TEST_ASSERT_NOT_NULL(stream);
+    TEST_ASSERT_EQUAL(size, stream->get_size());
+    RubbishHtmlParser streamed("", false);
+    // deliberately odd sized reads
+    uint8_t chunk[333];
+    size_t read;
+    while ((read = stream->read(chunk, sizeof(chunk))) > 0)
+    {
+      streamed.feed((const char *)chunk, read);
+    }
+    streamed.finish();
+    TEST_ASSERT_FALSE(stream->has_error());
+    TEST_ASSERT_EQUAL(size, stream->get_position());
+    delete stream;
+    assert_same_blocks(whole, streamed, &renderer);
+  }
+  delete epub;
+}
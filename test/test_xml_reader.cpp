@@ -0,0 +1,239 @@
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <cstddef>
+#include <algorithm>
+#include <new>
+#include <string>
+#include <EpubList/Epub.h>
+#include <EpubList/XmlReader.h>
+
+// writes down everything the reader reports so two reads can be compared
+class LoggingXmlHandler : public XmlHandler
+{
+public:
+  std::string log;
+  std::string pending_text;
+  int pending_depth = -1;
+
+  void flush()
+  {
+    // text can arrive in pieces - join them up
+    if (!pending_text.empty())
+    {
+      log += "text(" + std::to_string(pending_depth) + "," + pending_text + ")";
+      pending_text.clear();
+    }
+  }
+  void start_element(const char *name, int depth, const XmlAttribute *attributes, int attribute_count) override
+  {
+    flush();
+    log += "start(" + std::to_string(depth) + "," + name;
+    for (int i = 0; i < attribute_count; i++)
+    {
+      log += std::string(",") + attributes[i].name + "=" + attributes[i].value;
+    }
+    log += ")";
+  }
+  void end_element(const char *name, int depth) override
+  {
+    flush();
+    log += "end(" + std::to_string(depth) + "," + name + ")";
+  }
+  void text(const char *text, size_t length, int depth) override
+  {
+    pending_text.append(text, length);
+    pending_depth = depth;
+  }
+};
+
+static const char *XML_DOCUMENT =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+    "<!DOCTYPE package>\n"
+    "<package xmlns=\"http://www.idpf.org/2007/opf\" version=\"2.0\">\n"
+    "  <metadata xmlns:dc=\"http://purl.org/dc/elements/1.1/\">\n"
+    "    <dc:title>Tom &amp; Jerry &#x2014; &quot;&#233;t&#233;&quot;</dc:title>\n"
+    "    <!-- a comment with <tags> and a > in it -->\n"
+    "    <meta name='cover' content=\"a &lt; b\"/>\n"
+    "    <dc:description><![CDATA[<b>raw</b> &amp;]]></dc:description>\n"
+    "  </metadata>\n"
+    "  <opf:manifest>\n"
+    "    <item id=\"ch1\" href=\"text/ch1.xhtml\" media-type=\"application/xhtml+xml\" />\n"
+    "    <item id=\"img\" href=\"images/a b.jpg\" title=\"x > y\"/>\n"
+    "  </opf:manifest>\n"
+    "</package>\n";
+
+// tags, comments, entities and attributes split at every possible point should read the same as the whole document
+void test_xml_reader_chunk_boundaries(void)
+{
+  size_t length = strlen(XML_DOCUMENT);
+  LoggingXmlHandler whole;
+  XmlReader whole_reader(&whole);
+  whole_reader.feed(XML_DOCUMENT, length);
+  TEST_ASSERT_TRUE(whole_reader.finish());
+  whole.flush();
+  // namespace prefixes are dropped and entities decoded - CDATA is left as it is
+  TEST_ASSERT_NOT_NULL(strstr(whole.log.c_str(), "start(2,title)text(2,Tom & Jerry \xE2\x80\x94 \"\xC3\xA9t\xC3\xA9\")end(2,title)"));
+  TEST_ASSERT_NOT_NULL(strstr(whole.log.c_str(), "start(2,meta,name=cover,content=a < b)end(2,meta)"));
+  TEST_ASSERT_NOT_NULL(strstr(whole.log.c_str(), "text(2,<b>raw</b> &amp;)"));
+  TEST_ASSERT_NOT_NULL(strstr(whole.log.c_str(), "start(1,manifest)"));
+  TEST_ASSERT_NOT_NULL(strstr(whole.log.c_str(), "start(2,item,id=img,href=images/a b.jpg,title=x > y)end(2,item)"));
+  TEST_ASSERT_NULL(strstr(whole.log.c_str(), "comment"));
+
+  for (size_t split = 1; split < length; split++)
+  {
+    LoggingXmlHandler handler;
+    XmlReader reader(&handler);
+    reader.feed(XML_DOCUMENT, split);
+    reader.feed(XML_DOCUMENT + split, length - split);
+    TEST_ASSERT_TRUE(reader.finish());
+    handler.flush();
+    TEST_ASSERT_EQUAL_STRING(whole.log.c_str(), handler.log.c_str());
+  }
+  // and a byte at a time
+  LoggingXmlHandler handler;
+  XmlReader reader(&handler);
+  for (size_t i = 0; i < length; i++)
+  {
+    reader.feed(XML_DOCUMENT + i, 1);
+  }
+  TEST_ASSERT_TRUE(reader.finish());
+  handler.flush();
+  TEST_ASSERT_EQUAL_STRING(whole.log.c_str(), handler.log.c_str());
+}
+
+void test_xml_reader_malformed(void)
+{
+  const char *documents[] = {
+      // never closed
+      "<package><metadata></metadata>",
+      // closed twice
+      "<package></package></package>",
+      // no root element
+      "<?xml version=\"1.0\"?>",
+      // cut off in a tag
+      "<package><item id=\"a\"",
+  };
+  for (const char *document : documents)
+  {
+    LoggingXmlHandler handler;
+    XmlReader reader(&handler);
+    reader.feed(document, strlen(document));
+    TEST_ASSERT_FALSE(reader.finish());
+  }
+  // stopping early isn't an error
+  class StoppingHandler : public XmlHandler
+  {
+  public:
+    XmlReader *reader = nullptr;
+    int elements = 0;
+    void start_element(const char *name, int depth, const XmlAttribute *attributes, int attribute_count) override
+    {
+      elements++;
+      reader->stop();
+    }
+  };
+  StoppingHandler handler;
+  XmlReader reader(&handler);
+  handler.reader = &reader;
+  const char *document = "<container><rootfiles>";
+  reader.feed(document, strlen(document));
+  TEST_ASSERT_TRUE(reader.finish());
+  TEST_ASSERT_EQUAL(1, handler.elements);
+}
+
+// C++ heap in use while loading a book - only counted while measuring
+static bool heap_counting = false;
+static size_t heap_in_use = 0;
+static size_t heap_peak = 0;
+// keeps the size in front of each allocation - big enough to keep the alignment new promises
+static const size_t HEAP_HEADER_SIZE = alignof(std::max_align_t);
+
+void *operator new(size_t size)
+{
+  uint8_t *block = (uint8_t *)malloc(size + HEAP_HEADER_SIZE);
+  if (!block)
+  {
+    throw std::bad_alloc();
+  }
+  *(size_t *)block = heap_counting ? size : 0;
+  if (heap_counting)
+  {
+    heap_in_use += size;
+    heap_peak = std::max(heap_peak, heap_in_use);
+  }
+  return block + HEAP_HEADER_SIZE;
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+  try
+  {
+    return operator new(size);
+  }
+  catch (const std::bad_alloc &)
+  {
+    return nullptr;
+  }
+}
+
+void operator delete(void *ptr) noexcept
+{
+  if (!ptr)
+  {
+    return;
+  }
+  uint8_t *block = (uint8_t *)ptr - HEAP_HEADER_SIZE;
+  size_t size = *(size_t *)block;
+  // anything allocated before we started counting was recorded as 0
+  heap_in_use -= std::min(size, heap_in_use);
+  free(block);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+  operator delete(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept
+{
+  operator delete(ptr);
+}
+
+// how long Epub::load() takes and the most C++ heap it uses for each of the books we have
+void test_epub_load_benchmark(void)
+{
+  const char *books[] = {
+      "fixtures/no_oebps.epub",
+      "fixtures/oebps.epub",
+      "fixtures/relative_paths.epub",
+      "data/pg43-images.epub",
+      "data/pg14838-images.epub",
+  };
+  const int RUNS = 10;
+  for (const char *path : books)
+  {
+    long long total_us = 0;
+    size_t peak = 0;
+    int spine_items = 0;
+    for (int run = 0; run < RUNS; run++)
+    {
+      heap_in_use = 0;
+      heap_peak = 0;
+      heap_counting = true;
+      auto start = std::chrono::steady_clock::now();
+      Epub *epub = new Epub(path);
+      bool loaded = epub->load();
+      total_us += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+      spine_items = epub->get_spine_items_count();
+      delete epub;
+      heap_counting = false;
+      peak = std::max(peak, heap_peak);
+      TEST_ASSERT_TRUE(loaded);
+    }
+    TEST_ASSERT_TRUE(spine_items > 0);
+    printf("Epub::load %s: %d spine items, %lldus, peak heap %u bytes\n", path, spine_items, total_us / RUNS, (unsigned)peak);
+  }
+}
@@ -0,0 +1,65 @@
+#include <unity.h>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <EpubList/Epub.h>
+#include <ZipFile/ZipFile.h>
+
+// compares opening the archive for every item (what we used to do) with the persistent indexed handle
+void test_zip_index_open_cost(void)
+{
+  Epub *epub = new Epub("fixtures/relative_paths.epub");
+  TEST_ASSERT_TRUE_MESSAGE(epub->load(), "Epub load failed");
+  int count = epub->get_spine_items_count();
+  TEST_ASSERT_EQUAL(373, count);
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < count; i++)
+  {
+    ZipFile zip("fixtures/relative_paths.epub");
+    size_t size = 0;
+    uint8_t *data = zip.read_file_to_memory(epub->get_spine_item(i).c_str(), &size);
+    TEST_ASSERT_NOT_NULL_MESSAGE(data, "No content for chapter (fresh archive)");
+    free(data);
+  }
+  auto fresh_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < count; i++)
+  {
+    size_t size = 0;
+    uint8_t *data = epub->get_item_contents(epub->get_spine_item(i), &size);
+    TEST_ASSERT_NOT_NULL_MESSAGE(data, "No content for chapter (shared archive)");
+    free(data);
+  }
+  auto shared_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+  printf("zip open per item: fresh %lldus/item, shared %lldus/item\n",
+         (long long)(fresh_us / count), (long long)(shared_us / count));
+  delete epub;
+}
+
+void test_zip_index_lookup(void)
+{
+  ZipFile zip("fixtures/oebps.epub");
+  TEST_ASSERT_TRUE(zip.open());
+  TEST_ASSERT_TRUE(zip.get_entry_count() > 0);
+  uint32_t index = 0;
+  size_t size = 0;
+  TEST_ASSERT_TRUE(zip.find_file("META-INF/container.xml", &index, &size));
+  TEST_ASSERT_TRUE(size > 0);
+  TEST_ASSERT_FALSE(zip.find_file("META-INF/missing.xml", &index));
+  // the index survives repeated reads without reopening
+  for (int i = 0; i < 3; i++)
+  {
+    size_t read_size = 0;
+    uint8_t *data = zip.read_file_to_memory("META-INF/container.xml", &read_size);
+    TEST_ASSERT_NOT_NULL(data);
+    TEST_ASSERT_EQUAL(size, read_size);
+    free(data);
+  }
+  // a missing archive fails cleanly
+  ZipFile missing("fixtures/does_not_exist.epub");
+  TEST_ASSERT_FALSE(missing.open());
+  TEST_ASSERT_NULL(missing.read_file_to_memory("META-INF/container.xml"));
+}
@@ -7,6 +7,40 @@ void test_epub_load(void);
 void test_epub_relative_image_paths(void);
 void test_html_entity_replacement(void);
 void test_epub_toc_load(void);
+void test_zip_index_lookup(void);
+void test_zip_index_open_cost(void);
+void test_streaming_parser_chunk_boundaries(void);
+void test_streaming_parser_epub(void);
+void test_incremental_layout_matches_full_layout(void);
+void test_incremental_layout_short_section(void);
+void test_layout_cache_round_trip(void);
+void test_layout_cache_rejects_stale_and_corrupt(void);
+void test_glyph_cache_lru(void);
+void test_glyph_blit_matches_draw_pixel(void);
+void test_glyph_blit_page_benchmark(void);
+void test_image_cache_lru(void);
+void test_image_probe(void);
+void test_image_probe_epub_benchmark(void);
+void test_section_prefetch_matches_foreground_layout(void);
+void test_section_prefetch_cancel(void);
+void test_page_cache_lru(void);
+void test_page_cache_prerendered_page_turns(void);
+void test_epub_catalog_paging(void);
+void test_epub_catalog_open_cost(void);
+void test_epub_catalog_sync(void);
+void test_cover_thumbnail_round_trip(void);
+void test_cover_thumbnail_epub_benchmark(void);
+void test_library_scanner_progressive(void);
+void test_library_scanner_stop(void);
+void test_xml_reader_chunk_boundaries(void);
+void test_xml_reader_malformed(void);
+void test_epub_load_benchmark(void);
+void test_section_arena_allocations(void);
+void test_section_arena_benchmark(void);
+void test_image_scaler_golden(void);
+void test_image_scaler_jpeg_benchmark(void);
+void test_jpeg_decode_benchmark(void);
+void test_jpeg_decode_clipped(void);
 
 int main(int argc, char **argv)
 {
@@ -18,6 +52,40 @@ int main(int argc, char **argv)
   RUN_TEST(test_epub_relative_image_paths);
   RUN_TEST(test_html_entity_replacement);
   RUN_TEST(test_epub_toc_load);
+  RUN_TEST(test_zip_index_lookup);
+  RUN_TEST(test_zip_index_open_cost);
+  RUN_TEST(test_streaming_parser_chunk_boundaries);
+  RUN_TEST(test_streaming_parser_epub);
+  RUN_TEST(test_incremental_layout_matches_full_layout);
+  RUN_TEST(test_incremental_layout_short_section);
+  RUN_TEST(test_layout_cache_round_trip);
+  RUN_TEST(test_layout_cache_rejects_stale_and_corrupt);
+  RUN_TEST(test_glyph_cache_lru);
+  RUN_TEST(test_glyph_blit_matches_draw_pixel);
+  RUN_TEST(test_glyph_blit_page_benchmark);
+  RUN_TEST(test_image_cache_lru);
+  RUN_TEST(test_image_probe);
+  RUN_TEST(test_image_probe_epub_benchmark);
+  RUN_TEST(test_section_prefetch_matches_foreground_layout);
+  RUN_TEST(test_section_prefetch_cancel);
+  RUN_TEST(test_page_cache_lru);
+  RUN_TEST(test_page_cache_prerendered_page_turns);
+  RUN_TEST(test_epub_catalog_paging);
+  RUN_TEST(test_epub_catalog_open_cost);
+  RUN_TEST(test_epub_catalog_sync);
+  RUN_TEST(test_cover_thumbnail_round_trip);
+  RUN_TEST(test_cover_thumbnail_epub_benchmark);
+  RUN_TEST(test_library_scanner_progressive);
+  RUN_TEST(test_library_scanner_stop);
+  RUN_TEST(test_xml_reader_chunk_boundaries);
+  RUN_TEST(test_xml_reader_malformed);
+  RUN_TEST(test_epub_load_benchmark);
+  RUN_TEST(test_section_arena_allocations);
+  RUN_TEST(test_section_arena_benchmark);
+  RUN_TEST(test_image_scaler_golden);
+  RUN_TEST(test_image_scaler_jpeg_benchmark);
+  RUN_TEST(test_jpeg_decode_benchmark);
+  RUN_TEST(test_jpeg_decode_clipped);
   UNITY_END();
 
   return 0;